@@ -2686,6 +2686,14 @@ public:
 	 */
 	VImage convf(VImage mask, VOption *options = nullptr) const;
 
+	/**
+	 * FFT convolution operation.
+	 * @param mask Input matrix image.
+	 * @param options Set of options.
+	 * @return Output image.
+	 */
+	VImage convfft(VImage mask, VOption *options = nullptr) const;
+
 	/**
 	 * Int convolution operation.
 	 * @param mask Input matrix image.
@@ -3277,6 +3285,7 @@ public:
 	 * **Optional parameters**
 	 *   - **min_ampl** -- Minimum amplitude of Gaussian, double.
 	 *   - **precision** -- Convolve with this precision, VipsPrecision.
+	 *   - **recursive** -- Blur with a recursive approximation, bool.
 	 *
 	 * @param sigma Sigma of Gaussian.
 	 * @param options Set of options.
@@ -4130,6 +4139,7 @@ public:
 	 * **Optional parameters**
 	 *   - **page** -- First page to load, int.
 	 *   - **n** -- Number of pages to load, -1 for all, int.
+	 *   - **shrink** -- Shrink factor on load, int.
 	 *   - **memory** -- Force open via memory, bool.
 	 *   - **access** -- Required access pattern for this file, VipsAccess.
 	 *   - **fail_on** -- Error level to fail on, VipsFailOn.
@@ -4147,6 +4157,7 @@ public:
 	 * **Optional parameters**
 	 *   - **page** -- First page to load, int.
 	 *   - **n** -- Number of pages to load, -1 for all, int.
+	 *   - **shrink** -- Shrink factor on load, int.
 	 *   - **memory** -- Force open via memory, bool.
 	 *   - **access** -- Required access pattern for this file, VipsAccess.
 	 *   - **fail_on** -- Error level to fail on, VipsFailOn.
@@ -4164,6 +4175,7 @@ public:
 	 * **Optional parameters**
 	 *   - **page** -- First page to load, int.
 	 *   - **n** -- Number of pages to load, -1 for all, int.
+	 *   - **shrink** -- Shrink factor on load, int.
 	 *   - **memory** -- Force open via memory, bool.
 	 *   - **access** -- Required access pattern for this file, VipsAccess.
 	 *   - **fail_on** -- Error level to fail on, VipsFailOn.
@@ -6041,6 +6053,18 @@ public:
 	 */
 	static VImage sum(std::vector<VImage> in, VOption *options = nullptr);
 
+	/**
+	 * Find stats, histogram and percentiles in one pass.
+	 *
+	 * **Optional parameters**
+	 *   - **find_hist** -- Also find the image histogram, bool.
+	 *   - **percent** -- Find thresholds for these percents of pixels, std::vector<double>.
+	 *
+	 * @param options Set of options.
+	 * @return Output array of statistics.
+	 */
+	VImage summary(VOption *options = nullptr) const;
+
 	/**
 	 * Load svg with rsvg.
 	 *
@@ -6212,6 +6236,26 @@ public:
 	 */
 	VImage thumbnail_image(int width, VOption *options = nullptr) const;
 
+	/**
+	 * Generate thumbnails of several sizes from file.
+	 *
+	 * **Optional parameters**
+	 *   - **size** -- Only upsize, only downsize, or both, VipsSize.
+	 *   - **no_rotate** -- Don't use orientation tags to rotate image upright, bool.
+	 *   - **crop** -- Reduce to fill target rectangle, then crop, VipsInteresting.
+	 *   - **linear** -- Reduce in linear light, bool.
+	 *   - **input_profile** -- Fallback input profile, const char *.
+	 *   - **output_profile** -- Fallback output profile, const char *.
+	 *   - **intent** -- Rendering intent, VipsIntent.
+	 *   - **fail_on** -- Error level to fail on, VipsFailOn.
+	 *
+	 * @param filename Filename to read from.
+	 * @param format Filename to save to, with %d for the size.
+	 * @param sizes Make thumbnails of these sizes.
+	 * @param options Set of options.
+	 */
+	static void thumbnail_multi(const char *filename, const char *format, std::vector<int> sizes, VOption *options = nullptr);
+
 	/**
 	 * Generate thumbnail from source.
 	 *
@@ -6245,6 +6289,7 @@ public:
 	 *   - **autorotate** -- Rotate image using orientation tag, bool.
 	 *   - **subifd** -- Subifd index, int.
 	 *   - **unlimited** -- Remove all denial of service limits, bool.
+	 *   - **readahead** -- Max bytes of raw tile data to read ahead, 0 to disable, int.
 	 *   - **memory** -- Force open via memory, bool.
 	 *   - **access** -- Required access pattern for this file, VipsAccess.
 	 *   - **fail_on** -- Error level to fail on, VipsFailOn.
@@ -6265,6 +6310,7 @@ public:
 	 *   - **autorotate** -- Rotate image using orientation tag, bool.
 	 *   - **subifd** -- Subifd index, int.
 	 *   - **unlimited** -- Remove all denial of service limits, bool.
+	 *   - **readahead** -- Max bytes of raw tile data to read ahead, 0 to disable, int.
 	 *   - **memory** -- Force open via memory, bool.
 	 *   - **access** -- Required access pattern for this file, VipsAccess.
 	 *   - **fail_on** -- Error level to fail on, VipsFailOn.
@@ -6285,6 +6331,7 @@ public:
 	 *   - **autorotate** -- Rotate image using orientation tag, bool.
 	 *   - **subifd** -- Subifd index, int.
 	 *   - **unlimited** -- Remove all denial of service limits, bool.
+	 *   - **readahead** -- Max bytes of raw tile data to read ahead, 0 to disable, int.
 	 *   - **memory** -- Force open via memory, bool.
 	 *   - **access** -- Required access pattern for this file, VipsAccess.
 	 *   - **fail_on** -- Error level to fail on, VipsFailOn.
@@ -759,6 +759,19 @@ VImage::convf(VImage mask, VOption *options) const
 	return out;
 }
 
+VImage
+VImage::convfft(VImage mask, VOption *options) const
+{
+	VImage out;
+
+	call("convfft", (options ? options : VImage::option())
+			->set("in", *this)
+			->set("out", &out)
+			->set("mask", mask));
+
+	return out;
+}
+
 VImage
 VImage::convi(VImage mask, VOption *options) const
 {
@@ -3690,6 +3703,18 @@ VImage::sum(std::vector<VImage> in, VOption *options)
 	return out;
 }
 
+VImage
+VImage::summary(VOption *options) const
+{
+	VImage stats;
+
+	call("summary", (options ? options : VImage::option())
+			->set("in", *this)
+			->set("stats", &stats));
+
+	return stats;
+}
+
 VImage
 VImage::svgload(const char *filename, VOption *options)
 {
@@ -3796,6 +3821,15 @@ VImage::thumbnail_image(int width, VOption *options) const
 	return out;
 }
 
+void
+VImage::thumbnail_multi(const char *filename, const char *format, std::vector<int> sizes, VOption *options)
+{
+	call("thumbnail_multi", (options ? options : VImage::option())
+			->set("filename", filename)
+			->set("format", format)
+			->set("sizes", sizes));
+}
+
 VImage
 VImage::thumbnail_source(VSource source, int width, VOption *options)
 {
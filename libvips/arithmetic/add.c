@@ -82,6 +82,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "binary.h"
 
@@ -122,6 +123,14 @@ add_buffer(VipsArithmetic *arithmetic, VipsPel *out, VipsPel **in, int width)
 
 	int x;
 
+#ifdef HAVE_HWY
+	if (vips_arithmetic_hwy_format(format) &&
+		vips_vector_isenabled()) {
+		vips_add_hwy(out, in[0], in[1], sz, format);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	/* Add all input types. Keep types here in sync with
 	 * vips_add_format_table[] below.
 	 */
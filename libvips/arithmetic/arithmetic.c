@@ -323,6 +323,12 @@ typedef struct {
 	 */
 	VipsPel **p;
 
+	/* For fused chains, a line buffer for each intermediate result, and
+	 * the width they were allocated for.
+	 */
+	VipsPel **buf;
+	int buf_width;
+
 } VipsArithmeticSequence;
 
 static int
@@ -340,6 +346,14 @@ vips_arithmetic_stop(void *vseq, void *a, void *b)
 
 	VIPS_FREE(seq->p);
 
+	if (seq->buf) {
+		int i;
+
+		for (i = 0; i < seq->arithmetic->n_chain - 1; i++)
+			VIPS_FREE(seq->buf[i]);
+		VIPS_FREE(seq->buf);
+	}
+
 	VIPS_FREE(seq);
 
 	return 0;
@@ -360,6 +374,8 @@ vips_arithmetic_start(VipsImage *out, void *a, void *b)
 	seq->arithmetic = arithmetic;
 	seq->ir = NULL;
 	seq->p = NULL;
+	seq->buf = NULL;
+	seq->buf_width = 0;
 
 	/* How many images?
 	 */
@@ -389,9 +405,70 @@ vips_arithmetic_start(VipsImage *out, void *a, void *b)
 		return NULL;
 	}
 
+	if (arithmetic->chain) {
+		if (!(seq->buf = VIPS_ARRAY(NULL,
+				  arithmetic->n_chain - 1, VipsPel *))) {
+			vips_arithmetic_stop(seq, NULL, NULL);
+			return NULL;
+		}
+		for (i = 0; i < arithmetic->n_chain - 1; i++)
+			seq->buf[i] = NULL;
+	}
+
 	return seq;
 }
 
+/* Make sure the line buffers for a fused chain are large enough.
+ */
+static int
+vips_arithmetic_chain_buffers(VipsArithmeticSequence *seq, int width)
+{
+	VipsArithmetic *arithmetic = seq->arithmetic;
+
+	int k;
+
+	if (width > seq->buf_width) {
+		for (k = 0; k < arithmetic->n_chain - 1; k++) {
+			VipsImage *im = arithmetic->chain[k]->out;
+
+			VIPS_FREE(seq->buf[k]);
+			if (!(seq->buf[k] = VIPS_ARRAY(NULL,
+					  VIPS_IMAGE_SIZEOF_PEL(im) * width, VipsPel)))
+				return -1;
+		}
+		seq->buf_width = width;
+	}
+
+	return 0;
+}
+
+/* Run a fused chain of operations over a line. Each stage writes to a line
+ * buffer which the next stage reads, and the last writes to the output.
+ */
+static void
+vips_arithmetic_gen_chain(VipsArithmeticSequence *seq,
+	VipsPel *q, int width)
+{
+	VipsArithmetic *arithmetic = seq->arithmetic;
+
+	VipsPel **p;
+	VipsPel *link[2];
+	int k;
+
+	p = seq->p;
+	link[1] = NULL;
+	for (k = 0; k < arithmetic->n_chain; k++) {
+		VipsArithmetic *stage = arithmetic->chain[k];
+		VipsArithmeticClass *class = VIPS_ARITHMETIC_GET_CLASS(stage);
+		VipsPel *dest = k == arithmetic->n_chain - 1 ? q : seq->buf[k];
+
+		class->process_line(stage, dest, p, width);
+
+		link[0] = dest;
+		p = link;
+	}
+}
+
 static int
 vips_arithmetic_gen(VipsRegion *out_region,
 	void *vseq, void *a, void *b, gboolean *stop)
@@ -415,10 +492,17 @@ vips_arithmetic_gen(VipsRegion *out_region,
 	seq->p[i] = NULL;
 	q = (VipsPel *) VIPS_REGION_ADDR(out_region, r->left, r->top);
 
+	if (arithmetic->chain &&
+		vips_arithmetic_chain_buffers(seq, r->width))
+		return -1;
+
 	VIPS_GATE_START("vips_arithmetic_gen: work");
 
 	for (y = 0; y < r->height; y++) {
-		class->process_line(arithmetic, q, seq->p, r->width);
+		if (arithmetic->chain)
+			vips_arithmetic_gen_chain(seq, q, r->width);
+		else
+			class->process_line(arithmetic, q, seq->p, r->width);
 
 		for (i = 0; ir[i]; i++)
 			seq->p[i] += VIPS_REGION_LSKIP(ir[i]);
@@ -432,6 +516,60 @@ vips_arithmetic_gen(VipsRegion *out_region,
 	return 0;
 }
 
+/* The longest chain of operations we fuse. Past this, a new chain starts.
+ */
+#define VIPS_ARITHMETIC_CHAIN_MAX (8)
+
+/* Output images are tagged with the operation that made them. The image
+ * holds a ref to the operation, so it's always safe to use.
+ */
+static GQuark vips__arithmetic_quark = 0;
+
+/* Can we fuse with the operation that made our input? Only for unary
+ * operations where the input needed no decode, cast, bandup or resize, so
+ * the ready image is exactly the pixels the upstream operation makes.
+ */
+static void
+vips_arithmetic_fuse(VipsArithmetic *arithmetic, VipsImage **decode)
+{
+	VipsImage *in = arithmetic->in[0];
+
+	VipsArithmetic *upstream;
+	int i;
+
+	if (arithmetic->n != 1 ||
+		arithmetic->ready[0] != decode[0] ||
+		in->Coding != VIPS_CODING_NONE ||
+		in->dtype != VIPS_IMAGE_PARTIAL ||
+		!(upstream = g_object_get_qdata(G_OBJECT(in),
+			  vips__arithmetic_quark)) ||
+		upstream->out != in ||
+		upstream->n_chain >= VIPS_ARITHMETIC_CHAIN_MAX)
+		return;
+
+	if (upstream->chain) {
+		arithmetic->n_chain = upstream->n_chain + 1;
+		arithmetic->chain = VIPS_ARRAY(arithmetic,
+			arithmetic->n_chain, VipsArithmetic *);
+		for (i = 0; i < upstream->n_chain; i++)
+			arithmetic->chain[i] = upstream->chain[i];
+		arithmetic->sources = upstream->sources;
+	}
+	else {
+		arithmetic->n_chain = 2;
+		arithmetic->chain = VIPS_ARRAY(arithmetic,
+			arithmetic->n_chain, VipsArithmetic *);
+		arithmetic->chain[0] = upstream;
+		arithmetic->sources = upstream->ready;
+	}
+	arithmetic->chain[arithmetic->n_chain - 1] = arithmetic;
+
+#ifdef DEBUG
+	printf("vips_arithmetic_fuse: fused chain of %d\n",
+		arithmetic->n_chain);
+#endif /*DEBUG*/
+}
+
 static int
 vips_arithmetic_build(VipsObject *object)
 {
@@ -483,8 +621,14 @@ vips_arithmetic_build(VipsObject *object)
 	 */
 	arithmetic->ready = size;
 
+	/* If we are fused, we read directly from the start of the chain and
+	 * the intermediate images are never computed.
+	 */
+	vips_arithmetic_fuse(arithmetic, decode);
+
 	if (vips_image_pipeline_array(arithmetic->out,
-			VIPS_DEMAND_STYLE_THINSTRIP, arithmetic->ready))
+			VIPS_DEMAND_STYLE_THINSTRIP,
+			arithmetic->chain ? arithmetic->sources : arithmetic->ready))
 		return -1;
 
 	arithmetic->out->Bands = arithmetic->ready[0]->Bands;
@@ -498,9 +642,13 @@ vips_arithmetic_build(VipsObject *object)
 			vips_arithmetic_start,
 			vips_arithmetic_gen,
 			vips_arithmetic_stop,
-			arithmetic->ready, arithmetic))
+			arithmetic->chain ? arithmetic->sources : arithmetic->ready,
+			arithmetic))
 		return -1;
 
+	g_object_set_qdata(G_OBJECT(arithmetic->out),
+		vips__arithmetic_quark, arithmetic);
+
 	return 0;
 }
 
@@ -514,6 +662,9 @@ vips_arithmetic_class_init(VipsArithmeticClass *class)
 	gobject_class->set_property = vips_object_set_property;
 	gobject_class->get_property = vips_object_get_property;
 
+	vips__arithmetic_quark =
+		g_quark_from_static_string("vips-arithmetic");
+
 	vobject_class->nickname = "arithmetic";
 	vobject_class->description = _("arithmetic operations");
 	vobject_class->build = vips_arithmetic_build;
@@ -567,6 +718,7 @@ vips_arithmetic_operation_init(void)
 	extern GType vips_abs_get_type(void);
 	extern GType vips_sign_get_type(void);
 	extern GType vips_stats_get_type(void);
+	extern GType vips_summary_get_type(void);
 	extern GType vips_hist_find_get_type(void);
 	extern GType vips_hist_find_ndim_get_type(void);
 	extern GType vips_hist_find_indexed_get_type(void);
@@ -609,6 +761,7 @@ vips_arithmetic_operation_init(void)
 	vips_abs_get_type();
 	vips_sign_get_type();
 	vips_stats_get_type();
+	vips_summary_get_type();
 	vips_hist_find_get_type();
 	vips_hist_find_ndim_get_type();
 	vips_hist_find_indexed_get_type();
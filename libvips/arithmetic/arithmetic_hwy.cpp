@@ -0,0 +1,715 @@
+/* Highway kernels for the common arithmetic operations
+ *
+ * 18/10/26
+ * 	- from convf_hwy.cpp
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+#include <cmath>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "parithmetic.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/arithmetic/arithmetic_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+// Compat for Highway versions < 1.3.0
+#ifndef HWY_LANES_CONSTEXPR
+#define HWY_LANES_CONSTEXPR
+#endif
+
+/* Binary operations we handle with a single template.
+ */
+enum {
+	VIPS_HWY_ADD,
+	VIPS_HWY_SUBTRACT,
+	VIPS_HWY_MULTIPLY,
+	VIPS_HWY_DIVIDE
+};
+
+/* Load a vector of pixels, widened to the lane type of d. This is the cast
+ * to the output format the C loops do with (OUT) p[x].
+ */
+template <class D, typename T, HWY_IF_NOT_FLOAT(TFromD<D>)>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_arithmetic_load(D d, const T *HWY_RESTRICT p)
+{
+	const Rebind<T, D> dt;
+
+	return PromoteTo(d, LoadU(dt, p));
+}
+
+template <class D, typename T, HWY_IF_FLOAT(TFromD<D>)>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_arithmetic_load(D d, const T *HWY_RESTRICT p)
+{
+	const Rebind<T, D> dt;
+	const RebindToSigned<D> di;
+
+	return ConvertTo(d, PromoteTo(di, LoadU(dt, p)));
+}
+
+template <class D, HWY_IF_FLOAT(TFromD<D>)>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_arithmetic_load(D d, const float *HWY_RESTRICT p)
+{
+	return LoadU(d, p);
+}
+
+/* Write a mask as 255 / 0 uchar.
+ */
+template <class D, HWY_IF_NOT_FLOAT(TFromD<D>)>
+HWY_ATTR HWY_INLINE void
+vips_arithmetic_store_mask(D d, Mask<D> m, uint8_t *HWY_RESTRICT q)
+{
+	const Rebind<uint8_t, D> du8;
+
+	StoreU(DemoteTo(du8, IfThenElseZero(m, Set(d, 255))), du8, q);
+}
+
+template <class D, HWY_IF_FLOAT(TFromD<D>)>
+HWY_ATTR HWY_INLINE void
+vips_arithmetic_store_mask(D d, Mask<D> m, uint8_t *HWY_RESTRICT q)
+{
+	const RebindToSigned<D> di;
+
+	vips_arithmetic_store_mask(di, RebindMask(di, m), q);
+}
+
+template <int op, class D>
+HWY_ATTR HWY_INLINE Mask<D>
+vips_arithmetic_compare(Vec<D> a, Vec<D> b)
+{
+	switch (op) {
+	case VIPS_OPERATION_RELATIONAL_EQUAL:
+		return Eq(a, b);
+	case VIPS_OPERATION_RELATIONAL_NOTEQ:
+		return Ne(a, b);
+	case VIPS_OPERATION_RELATIONAL_LESS:
+		return Lt(a, b);
+	case VIPS_OPERATION_RELATIONAL_LESSEQ:
+		return Le(a, b);
+	case VIPS_OPERATION_RELATIONAL_MORE:
+		return Gt(a, b);
+	case VIPS_OPERATION_RELATIONAL_MOREEQ:
+	default:
+		return Ge(a, b);
+	}
+}
+
+template <int op, class V>
+HWY_ATTR HWY_INLINE V
+vips_arithmetic_bool(V a, V b)
+{
+	switch (op) {
+	case VIPS_OPERATION_BOOLEAN_AND:
+		return And(a, b);
+	case VIPS_OPERATION_BOOLEAN_OR:
+		return Or(a, b);
+	case VIPS_OPERATION_BOOLEAN_EOR:
+	default:
+		return Xor(a, b);
+	}
+}
+
+/* Each kernel is written as a step over one vector for tag d. The main loop
+ * runs with full vectors, and the tail runs the same step with single-lane
+ * vectors, so the two always agree.
+ */
+template <int op, class D, typename TIn, typename TOut>
+HWY_ATTR HWY_INLINE void
+vips_binary_step(D d,
+	TOut *HWY_RESTRICT q, const TIn *HWY_RESTRICT left,
+	const TIn *HWY_RESTRICT right)
+{
+	const auto a = vips_arithmetic_load(d, left);
+	const auto b = vips_arithmetic_load(d, right);
+
+	switch (op) {
+	case VIPS_HWY_ADD:
+		StoreU(Add(a, b), d, q);
+		break;
+
+	case VIPS_HWY_SUBTRACT:
+		StoreU(Sub(a, b), d, q);
+		break;
+
+	case VIPS_HWY_MULTIPLY:
+		StoreU(Mul(a, b), d, q);
+		break;
+
+	case VIPS_HWY_DIVIDE:
+	default:
+		/* Divide by zero gives zero.
+		 */
+		StoreU(IfThenZeroElse(Eq(b, Zero(d)), Div(a, b)), d, q);
+		break;
+	}
+}
+
+template <int op, typename TIn, typename TOut>
+HWY_ATTR HWY_INLINE void
+vips_binary_loop(VipsPel *pout, VipsPel *pleft, VipsPel *pright, int32_t sz)
+{
+	const ScalableTag<TOut> d;
+	const CappedTag<TOut, 1> d1;
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(d);
+
+	TOut *HWY_RESTRICT q = (TOut *) pout;
+	const TIn *HWY_RESTRICT left = (TIn *) pleft;
+	const TIn *HWY_RESTRICT right = (TIn *) pright;
+
+	int32_t x = 0;
+	for (; x + N <= sz; x += N)
+		vips_binary_step<op>(d, q + x, left + x, right + x);
+	for (; x < sz; x++)
+		vips_binary_step<op>(d1, q + x, left + x, right + x);
+}
+
+template <int op, class D, typename T>
+HWY_ATTR HWY_INLINE void
+vips_relational_step(D d, uint8_t *HWY_RESTRICT q,
+	const T *HWY_RESTRICT left, const T *HWY_RESTRICT right)
+{
+	const auto a = vips_arithmetic_load(d, left);
+	const auto b = vips_arithmetic_load(d, right);
+
+	vips_arithmetic_store_mask(d, vips_arithmetic_compare<op, D>(a, b), q);
+}
+
+/* Compare in TC, a type which can hold every value of T.
+ */
+template <int op, typename T, typename TC>
+HWY_ATTR HWY_INLINE void
+vips_relational_loop(VipsPel *pout, VipsPel *pleft, VipsPel *pright,
+	int32_t sz)
+{
+	const ScalableTag<TC> d;
+	const CappedTag<TC, 1> d1;
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(d);
+
+	uint8_t *HWY_RESTRICT q = (uint8_t *) pout;
+	const T *HWY_RESTRICT left = (T *) pleft;
+	const T *HWY_RESTRICT right = (T *) pright;
+
+	int32_t x = 0;
+	for (; x + N <= sz; x += N)
+		vips_relational_step<op>(d, q + x, left + x, right + x);
+	for (; x < sz; x++)
+		vips_relational_step<op>(d1, q + x, left + x, right + x);
+}
+
+template <int op, class D, typename T>
+HWY_ATTR HWY_INLINE void
+vips_relational_const_step(D d, uint8_t *HWY_RESTRICT q,
+	const T *HWY_RESTRICT p, TFromD<D> c)
+{
+	const auto a = vips_arithmetic_load(d, p);
+
+	vips_arithmetic_store_mask(d,
+		vips_arithmetic_compare<op, D>(a, Set(d, c)), q);
+}
+
+template <int op, typename T, typename TC>
+HWY_ATTR HWY_INLINE void
+vips_relational_const_loop(VipsPel *pout, VipsPel *pin, int32_t sz, TC c)
+{
+	const ScalableTag<TC> d;
+	const CappedTag<TC, 1> d1;
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(d);
+
+	uint8_t *HWY_RESTRICT q = (uint8_t *) pout;
+	const T *HWY_RESTRICT p = (T *) pin;
+
+	int32_t x = 0;
+	for (; x + N <= sz; x += N)
+		vips_relational_const_step<op>(d, q + x, p + x, c);
+	for (; x < sz; x++)
+		vips_relational_const_step<op>(d1, q + x, p + x, c);
+}
+
+template <int op, class D>
+HWY_ATTR HWY_INLINE void
+vips_boolean_step(D d, TFromD<D> *HWY_RESTRICT q,
+	const TFromD<D> *HWY_RESTRICT left, const TFromD<D> *HWY_RESTRICT right)
+{
+	StoreU(vips_arithmetic_bool<op>(LoadU(d, left), LoadU(d, right)), d, q);
+}
+
+template <int op, typename T>
+HWY_ATTR HWY_INLINE void
+vips_boolean_loop(VipsPel *pout, VipsPel *pleft, VipsPel *pright, int32_t sz)
+{
+	const ScalableTag<T> d;
+	const CappedTag<T, 1> d1;
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(d);
+
+	T *HWY_RESTRICT q = (T *) pout;
+	const T *HWY_RESTRICT left = (T *) pleft;
+	const T *HWY_RESTRICT right = (T *) pright;
+
+	int32_t x = 0;
+	for (; x + N <= sz; x += N)
+		vips_boolean_step<op>(d, q + x, left + x, right + x);
+	for (; x < sz; x++)
+		vips_boolean_step<op>(d1, q + x, left + x, right + x);
+}
+
+template <int op, class D>
+HWY_ATTR HWY_INLINE void
+vips_boolean_const_step(D d, TFromD<D> *HWY_RESTRICT q,
+	const TFromD<D> *HWY_RESTRICT p, TFromD<D> c)
+{
+	StoreU(vips_arithmetic_bool<op>(LoadU(d, p), Set(d, c)), d, q);
+}
+
+template <int op, typename T>
+HWY_ATTR HWY_INLINE void
+vips_boolean_const_loop(VipsPel *pout, VipsPel *pin, int32_t sz, T c)
+{
+	const ScalableTag<T> d;
+	const CappedTag<T, 1> d1;
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(d);
+
+	T *HWY_RESTRICT q = (T *) pout;
+	const T *HWY_RESTRICT p = (T *) pin;
+
+	int32_t x = 0;
+	for (; x + N <= sz; x += N)
+		vips_boolean_const_step<op>(d, q + x, p + x, c);
+	for (; x < sz; x++)
+		vips_boolean_const_step<op>(d1, q + x, p + x, c);
+}
+
+template <class D, typename T>
+HWY_ATTR HWY_INLINE void
+vips_linear_step(D d, float *HWY_RESTRICT q,
+	const T *HWY_RESTRICT p, Vec<D> a, Vec<D> b)
+{
+	/* Mul then Add, not MulAdd, so we match the C path exactly.
+	 */
+	StoreU(Add(Mul(a, vips_arithmetic_load(d, p)), b), d, q);
+}
+
+template <class D, typename T>
+HWY_ATTR HWY_INLINE void
+vips_linear_uchar_step(D d, uint8_t *HWY_RESTRICT q,
+	const T *HWY_RESTRICT p, Vec<D> a, Vec<D> b)
+{
+	const RebindToSigned<D> di;
+	const Rebind<uint8_t, D> du8;
+
+	auto t = Add(Mul(a, vips_arithmetic_load(d, p)), b);
+	t = Min(Max(t, Zero(d)), Set(d, 255.0f));
+
+	/* ConvertTo truncates, like the C cast.
+	 */
+	StoreU(DemoteTo(du8, ConvertTo(di, t)), du8, q);
+}
+
+template <typename T>
+HWY_ATTR HWY_INLINE void
+vips_linear_loop(VipsPel *pout, VipsPel *pin, int32_t sz,
+	float a, float b, bool uchar)
+{
+	const ScalableTag<float> d;
+	const CappedTag<float, 1> d1;
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(d);
+
+	const T *HWY_RESTRICT p = (T *) pin;
+
+	int32_t x = 0;
+	if (uchar) {
+		uint8_t *HWY_RESTRICT q = (uint8_t *) pout;
+
+		for (; x + N <= sz; x += N)
+			vips_linear_uchar_step(d, q + x, p + x, Set(d, a), Set(d, b));
+		for (; x < sz; x++)
+			vips_linear_uchar_step(d1, q + x, p + x, Set(d1, a), Set(d1, b));
+	}
+	else {
+		float *HWY_RESTRICT q = (float *) pout;
+
+		for (; x + N <= sz; x += N)
+			vips_linear_step(d, q + x, p + x, Set(d, a), Set(d, b));
+		for (; x < sz; x++)
+			vips_linear_step(d1, q + x, p + x, Set(d1, a), Set(d1, b));
+	}
+}
+
+/* The exported kernels. Only call these for the formats the C side checks
+ * with vips_arithmetic_hwy_format().
+ */
+
+#define SWITCH_BINARY(OP, UC, US) \
+	switch (format) { \
+	case VIPS_FORMAT_UCHAR: \
+		vips_binary_loop<OP, uint8_t, UC>(out, left, right, sz); \
+		break; \
+	case VIPS_FORMAT_USHORT: \
+		vips_binary_loop<OP, uint16_t, US>(out, left, right, sz); \
+		break; \
+	case VIPS_FORMAT_FLOAT: \
+		vips_binary_loop<OP, float, float>(out, left, right, sz); \
+		break; \
+	default: \
+		g_assert_not_reached(); \
+	}
+
+HWY_ATTR void
+vips_add_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int32_t sz, VipsBandFormat format)
+{
+	SWITCH_BINARY(VIPS_HWY_ADD, uint16_t, uint32_t);
+}
+
+HWY_ATTR void
+vips_subtract_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int32_t sz, VipsBandFormat format)
+{
+	SWITCH_BINARY(VIPS_HWY_SUBTRACT, int16_t, int32_t);
+}
+
+HWY_ATTR void
+vips_multiply_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int32_t sz, VipsBandFormat format)
+{
+	SWITCH_BINARY(VIPS_HWY_MULTIPLY, uint16_t, uint32_t);
+}
+
+HWY_ATTR void
+vips_divide_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int32_t sz, VipsBandFormat format)
+{
+	SWITCH_BINARY(VIPS_HWY_DIVIDE, float, float);
+}
+
+HWY_ATTR void
+vips_linear_hwy(VipsPel *out, VipsPel *in,
+	int32_t sz, VipsBandFormat format, float a, float b, gboolean uchar)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		vips_linear_loop<uint8_t>(out, in, sz, a, b, uchar);
+		break;
+	case VIPS_FORMAT_USHORT:
+		vips_linear_loop<uint16_t>(out, in, sz, a, b, uchar);
+		break;
+	case VIPS_FORMAT_FLOAT:
+		vips_linear_loop<float>(out, in, sz, a, b, uchar);
+		break;
+	default:
+		g_assert_not_reached();
+	}
+}
+
+/* Small ints are compared in a signed type one size up, so we never need
+ * unsigned compares.
+ */
+#define SWITCH_RELATIONAL(OP) \
+	switch (format) { \
+	case VIPS_FORMAT_UCHAR: \
+		vips_relational_loop<OP, uint8_t, int16_t>(out, left, right, sz); \
+		break; \
+	case VIPS_FORMAT_USHORT: \
+		vips_relational_loop<OP, uint16_t, int32_t>(out, left, right, sz); \
+		break; \
+	case VIPS_FORMAT_FLOAT: \
+		vips_relational_loop<OP, float, float>(out, left, right, sz); \
+		break; \
+	default: \
+		g_assert_not_reached(); \
+	}
+
+HWY_ATTR void
+vips_relational_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int32_t sz, VipsBandFormat format, VipsOperationRelational relational)
+{
+	switch (relational) {
+	case VIPS_OPERATION_RELATIONAL_EQUAL:
+		SWITCH_RELATIONAL(VIPS_OPERATION_RELATIONAL_EQUAL);
+		break;
+	case VIPS_OPERATION_RELATIONAL_NOTEQ:
+		SWITCH_RELATIONAL(VIPS_OPERATION_RELATIONAL_NOTEQ);
+		break;
+	case VIPS_OPERATION_RELATIONAL_LESS:
+		SWITCH_RELATIONAL(VIPS_OPERATION_RELATIONAL_LESS);
+		break;
+	case VIPS_OPERATION_RELATIONAL_LESSEQ:
+		SWITCH_RELATIONAL(VIPS_OPERATION_RELATIONAL_LESSEQ);
+		break;
+	case VIPS_OPERATION_RELATIONAL_MORE:
+		SWITCH_RELATIONAL(VIPS_OPERATION_RELATIONAL_MORE);
+		break;
+	case VIPS_OPERATION_RELATIONAL_MOREEQ:
+		SWITCH_RELATIONAL(VIPS_OPERATION_RELATIONAL_MOREEQ);
+		break;
+	default:
+		g_assert_not_reached();
+	}
+}
+
+/* Integer constants are clipped to just outside the range of the image
+ * format, which leaves the result of every comparison unchanged.
+ */
+#define SWITCH_RELATIONAL_CONST(OP) \
+	switch (format) { \
+	case VIPS_FORMAT_UCHAR: \
+		vips_relational_const_loop<OP, uint8_t, int16_t>(out, in, sz, \
+			(int16_t) VIPS_CLIP(-1, c, UCHAR_MAX + 1)); \
+		break; \
+	case VIPS_FORMAT_USHORT: \
+		vips_relational_const_loop<OP, uint16_t, int32_t>(out, in, sz, \
+			(int32_t) VIPS_CLIP(-1, c, USHRT_MAX + 1)); \
+		break; \
+	case VIPS_FORMAT_FLOAT: \
+		vips_relational_const_loop<OP, float, float>(out, in, sz, \
+			(float) c); \
+		break; \
+	default: \
+		g_assert_not_reached(); \
+	}
+
+HWY_ATTR void
+vips_relational_const_hwy(VipsPel *out, VipsPel *in,
+	int32_t sz, VipsBandFormat format, VipsOperationRelational relational,
+	double c)
+{
+	switch (relational) {
+	case VIPS_OPERATION_RELATIONAL_EQUAL:
+		SWITCH_RELATIONAL_CONST(VIPS_OPERATION_RELATIONAL_EQUAL);
+		break;
+	case VIPS_OPERATION_RELATIONAL_NOTEQ:
+		SWITCH_RELATIONAL_CONST(VIPS_OPERATION_RELATIONAL_NOTEQ);
+		break;
+	case VIPS_OPERATION_RELATIONAL_LESS:
+		SWITCH_RELATIONAL_CONST(VIPS_OPERATION_RELATIONAL_LESS);
+		break;
+	case VIPS_OPERATION_RELATIONAL_LESSEQ:
+		SWITCH_RELATIONAL_CONST(VIPS_OPERATION_RELATIONAL_LESSEQ);
+		break;
+	case VIPS_OPERATION_RELATIONAL_MORE:
+		SWITCH_RELATIONAL_CONST(VIPS_OPERATION_RELATIONAL_MORE);
+		break;
+	case VIPS_OPERATION_RELATIONAL_MOREEQ:
+		SWITCH_RELATIONAL_CONST(VIPS_OPERATION_RELATIONAL_MOREEQ);
+		break;
+	default:
+		g_assert_not_reached();
+	}
+}
+
+#define SWITCH_BOOLEAN(OP) \
+	switch (format) { \
+	case VIPS_FORMAT_UCHAR: \
+		vips_boolean_loop<OP, uint8_t>(out, left, right, sz); \
+		break; \
+	case VIPS_FORMAT_USHORT: \
+		vips_boolean_loop<OP, uint16_t>(out, left, right, sz); \
+		break; \
+	default: \
+		g_assert_not_reached(); \
+	}
+
+HWY_ATTR void
+vips_boolean_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int32_t sz, VipsBandFormat format, VipsOperationBoolean boolean)
+{
+	switch (boolean) {
+	case VIPS_OPERATION_BOOLEAN_AND:
+		SWITCH_BOOLEAN(VIPS_OPERATION_BOOLEAN_AND);
+		break;
+	case VIPS_OPERATION_BOOLEAN_OR:
+		SWITCH_BOOLEAN(VIPS_OPERATION_BOOLEAN_OR);
+		break;
+	case VIPS_OPERATION_BOOLEAN_EOR:
+		SWITCH_BOOLEAN(VIPS_OPERATION_BOOLEAN_EOR);
+		break;
+	default:
+		g_assert_not_reached();
+	}
+}
+
+/* The C path does (TYPE) (p & c), which is the same as p & (TYPE) c for
+ * these operations.
+ */
+#define SWITCH_BOOLEAN_CONST(OP) \
+	switch (format) { \
+	case VIPS_FORMAT_UCHAR: \
+		vips_boolean_const_loop<OP, uint8_t>(out, in, sz, (uint8_t) c); \
+		break; \
+	case VIPS_FORMAT_USHORT: \
+		vips_boolean_const_loop<OP, uint16_t>(out, in, sz, (uint16_t) c); \
+		break; \
+	default: \
+		g_assert_not_reached(); \
+	}
+
+HWY_ATTR void
+vips_boolean_const_hwy(VipsPel *out, VipsPel *in,
+	int32_t sz, VipsBandFormat format, VipsOperationBoolean boolean, int c)
+{
+	switch (boolean) {
+	case VIPS_OPERATION_BOOLEAN_AND:
+		SWITCH_BOOLEAN_CONST(VIPS_OPERATION_BOOLEAN_AND);
+		break;
+	case VIPS_OPERATION_BOOLEAN_OR:
+		SWITCH_BOOLEAN_CONST(VIPS_OPERATION_BOOLEAN_OR);
+		break;
+	case VIPS_OPERATION_BOOLEAN_EOR:
+		SWITCH_BOOLEAN_CONST(VIPS_OPERATION_BOOLEAN_EOR);
+		break;
+	default:
+		g_assert_not_reached();
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_add_hwy);
+HWY_EXPORT(vips_subtract_hwy);
+HWY_EXPORT(vips_multiply_hwy);
+HWY_EXPORT(vips_divide_hwy);
+HWY_EXPORT(vips_linear_hwy);
+HWY_EXPORT(vips_relational_hwy);
+HWY_EXPORT(vips_relational_const_hwy);
+HWY_EXPORT(vips_boolean_hwy);
+HWY_EXPORT(vips_boolean_const_hwy);
+
+void
+vips_add_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_add_hwy)(out, left, right, sz, format);
+	/* clang-format on */
+}
+
+void
+vips_subtract_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_subtract_hwy)(out, left, right, sz, format);
+	/* clang-format on */
+}
+
+void
+vips_multiply_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_multiply_hwy)(out, left, right, sz, format);
+	/* clang-format on */
+}
+
+void
+vips_divide_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_divide_hwy)(out, left, right, sz, format);
+	/* clang-format on */
+}
+
+void
+vips_linear_hwy(VipsPel *out, VipsPel *in,
+	int sz, VipsBandFormat format, float a, float b, gboolean uchar)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_linear_hwy)(out, in, sz, format,
+		a, b, uchar);
+	/* clang-format on */
+}
+
+void
+vips_relational_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format, VipsOperationRelational relational)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_relational_hwy)(out, left, right, sz,
+		format, relational);
+	/* clang-format on */
+}
+
+void
+vips_relational_const_hwy(VipsPel *out, VipsPel *in,
+	int sz, VipsBandFormat format, VipsOperationRelational relational,
+	double c)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_relational_const_hwy)(out, in, sz,
+		format, relational, c);
+	/* clang-format on */
+}
+
+void
+vips_boolean_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format, VipsOperationBoolean boolean)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_boolean_hwy)(out, left, right, sz,
+		format, boolean);
+	/* clang-format on */
+}
+
+void
+vips_boolean_const_hwy(VipsPel *out, VipsPel *in,
+	int sz, VipsBandFormat format, VipsOperationBoolean boolean, int c)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_boolean_const_hwy)(out, in, sz,
+		format, boolean, c);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
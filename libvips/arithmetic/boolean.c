@@ -73,6 +73,7 @@
 #include <stdlib.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 
 #include "binary.h"
@@ -179,6 +180,17 @@ vips_boolean_buffer(VipsArithmetic *arithmetic,
 
 	int x;
 
+#ifdef HAVE_HWY
+	if ((im->BandFmt == VIPS_FORMAT_UCHAR ||
+			im->BandFmt == VIPS_FORMAT_USHORT) &&
+		boolean->operation <= VIPS_OPERATION_BOOLEAN_EOR &&
+		vips_vector_isenabled()) {
+		vips_boolean_hwy(out, in[0], in[1], sz,
+			im->BandFmt, boolean->operation);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	switch (boolean->operation) {
 	case VIPS_OPERATION_BOOLEAN_AND:
 		SWITCH(LOOP, FLOOP, &);
@@ -524,6 +536,18 @@ vips_boolean_const_buffer(VipsArithmetic *arithmetic,
 
 	int i, x, b;
 
+#ifdef HAVE_HWY
+	if (uconst->is_single &&
+		(im->BandFmt == VIPS_FORMAT_UCHAR ||
+			im->BandFmt == VIPS_FORMAT_USHORT) &&
+		bconst->operation <= VIPS_OPERATION_BOOLEAN_EOR &&
+		vips_vector_isenabled()) {
+		vips_boolean_const_hwy(out, in[0], width * bands,
+			im->BandFmt, bconst->operation, uconst->c_int[0]);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	switch (bconst->operation) {
 	case VIPS_OPERATION_BOOLEAN_AND:
 		SWITCH(LOOPC, FLOOPC, &);
@@ -76,6 +76,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "binary.h"
 
@@ -139,6 +140,15 @@ vips_divide_buffer(VipsArithmetic *arithmetic,
 
 	int x;
 
+#ifdef HAVE_HWY
+	if (vips_arithmetic_hwy_format(vips_image_get_format(im)) &&
+		vips_vector_isenabled()) {
+		vips_divide_hwy(out, in[0], in[1], sz,
+			vips_image_get_format(im));
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	/* Keep types here in sync with vips_divide_format_table[]
 	 * below.
 	 */
@@ -28,6 +28,9 @@
  * 	- unroll common cases
  * 1/2/21 erdmann
  * 	- use double for very large histograms
+ * 18/10/26
+ * 	- uchar scans into several interleaved sub-histograms
+ * 	- ushort only merges the parts of the histogram that were used
  */
 
 /*
@@ -68,14 +71,24 @@
 
 #include "statistic.h"
 
+/* uchar sequences scan into this many interleaved sub-histograms, so runs of
+ * equal pixels don't wait for each other's increments.
+ */
+#define VIPS_HIST_FIND_SUB (4)
+
 /* Accumulate a histogram in one of these.
  */
 typedef struct {
 	int n_bands;	/* Number of bands in output */
 	int band;		/* If one band in out, which band of input */
 	int size;		/* Number of bins for each band */
+	int n_sub;		/* Number of sub-histograms in each band */
 	int mx;			/* Maximum value we have seen */
 	VipsPel **bins; /* double or uint bins */
+
+	/* A bit for each block of 256 bins we've used, for ushort.
+	 */
+	guint64 touched[4];
 } Histogram;
 
 typedef struct _VipsHistFind {
@@ -107,11 +120,12 @@ G_DEFINE_TYPE(VipsHistFind, vips_hist_find, VIPS_TYPE_STATISTIC);
 /* Build a Histogram.
  */
 static Histogram *
-histogram_new(VipsHistFind *hist_find, int n_bands, int band, int size)
+histogram_new(VipsHistFind *hist_find,
+	int n_bands, int band, int size, int n_sub)
 {
 	/* We won't use all of this for uint accumulators.
 	 */
-	int n_bytes = size * sizeof(double);
+	int n_bytes = size * n_sub * sizeof(double);
 
 	Histogram *hist;
 	int i;
@@ -130,7 +144,9 @@ histogram_new(VipsHistFind *hist_find, int n_bands, int band, int size)
 	hist->n_bands = n_bands;
 	hist->band = band;
 	hist->size = size;
+	hist->n_sub = n_sub;
 	hist->mx = 0;
+	memset(hist->touched, 0, sizeof(hist->touched));
 
 	return hist;
 }
@@ -215,6 +231,8 @@ vips_hist_find_start(VipsStatistic *statistic)
 {
 	VipsHistFind *hist_find = (VipsHistFind *) statistic;
 
+	int n_sub;
+
 	/* Make the main hist, if necessary.
 	 */
 	if (!hist_find->hist)
@@ -223,12 +241,21 @@ vips_hist_find_start(VipsStatistic *statistic)
 			hist_find->band,
 			statistic->ready->BandFmt == VIPS_FORMAT_UCHAR
 				? 256
-				: 65536);
+				: 65536,
+			1);
+
+	/* Sub-histograms are only worth it for small uint tables.
+	 */
+	n_sub = statistic->ready->BandFmt == VIPS_FORMAT_UCHAR &&
+			!hist_find->large
+		? VIPS_HIST_FIND_SUB
+		: 1;
 
 	return (void *) histogram_new(hist_find,
 		hist_find->hist->n_bands,
 		hist_find->hist->band,
-		hist_find->hist->size);
+		hist_find->hist->size,
+		n_sub);
 }
 
 /* Join a sub-hist onto the main hist.
@@ -240,24 +267,55 @@ vips_hist_find_stop(VipsStatistic *statistic, void *seq)
 	VipsHistFind *hist_find = (VipsHistFind *) statistic;
 	Histogram *hist = hist_find->hist;
 
-	int i, j;
+	int i, j, k;
 
 	g_assert(sub_hist->n_bands == hist->n_bands &&
 		sub_hist->size == hist->size);
 
+	/* A single uchar band is as wide as the largest value we saw, but the
+	 * sub-histogram scan doesn't track it.
+	 */
+	if (hist->size == 256 &&
+		hist->band >= 0 &&
+		sub_hist->n_sub > 1) {
+		unsigned int *bins = (unsigned int *) sub_hist->bins[0];
+
+		for (j = 255; j > 0; j--) {
+			for (k = 0; k < sub_hist->n_sub; k++)
+				if (bins[k * 256 + j])
+					break;
+			if (k < sub_hist->n_sub)
+				break;
+		}
+
+		sub_hist->mx = j;
+	}
+
 	/* Add on sub-data.
 	 */
 	hist->mx = VIPS_MAX(hist->mx, sub_hist->mx);
 
+	/* ushort hists only add the blocks of 256 bins they have used.
+	 */
 #define SUM(TYPE) \
 	G_STMT_START \
 	{ \
 		TYPE **main_bins = (TYPE **) hist->bins; \
 		TYPE **sub_bins = (TYPE **) sub_hist->bins; \
 \
-		for (i = 0; i < hist->n_bands; i++) \
-			for (j = 0; j < hist->size; j++) \
-				main_bins[i][j] += sub_bins[i][j]; \
+		if (hist->size == 256) { \
+			for (i = 0; i < hist->n_bands; i++) \
+				for (k = 0; k < sub_hist->n_sub; k++) \
+					for (j = 0; j < 256; j++) \
+						main_bins[i][j] += sub_bins[i][k * 256 + j]; \
+		} \
+		else { \
+			for (k = 0; k < 256; k++) \
+				if (sub_hist->touched[k >> 6] & ((guint64) 1 << (k & 63))) \
+					for (i = 0; i < hist->n_bands; i++) \
+						for (j = k * 256; j < (k + 1) * 256; j++) \
+							main_bins[i][j] += sub_bins[i][j]; \
+		} \
 	} \
 	G_STMT_END
 
@@ -283,6 +341,7 @@ vips_hist_find_stop(VipsStatistic *statistic, void *seq)
 \
 			if (v > mx) \
 				mx = v; \
+			touched[v >> 14] |= (guint64) 1 << ((v >> 8) & 63); \
 \
 			bins[z][v] += 1; \
 		} \
@@ -334,12 +393,73 @@ vips_hist_find_stop(VipsStatistic *statistic, void *seq)
 \
 			if (v > mx) \
 				mx = v; \
+			touched[v >> 14] |= (guint64) 1 << ((v >> 8) & 63); \
 \
 			bins[v] += 1; \
 		} \
 	} \
 	G_STMT_END
 
+/* uchar into interleaved sub-histograms, four pixels at a time. Each band of
+ * each pixel goes to a different table, so increments to the same bin don't
+ * queue up behind each other.
+ */
+#define UCSCAN_SUB() \
+	G_STMT_START \
+	{ \
+		unsigned int **bins = (unsigned int **) hist->bins; \
+		VipsPel *p = (VipsPel *) in; \
+\
+		int x, z; \
+\
+		for (x = 0; x + 3 < n; x += 4) { \
+			for (z = 0; z < nb; z++) { \
+				unsigned int *restrict b = bins[z]; \
+\
+				b[p[z]] += 1; \
+				b[256 + p[nb + z]] += 1; \
+				b[512 + p[2 * nb + z]] += 1; \
+				b[768 + p[3 * nb + z]] += 1; \
+			} \
+\
+			p += 4 * nb; \
+		} \
+\
+		for (; x < n; x++) { \
+			for (z = 0; z < nb; z++) \
+				bins[z][p[z]] += 1; \
+\
+			p += nb; \
+		} \
+	} \
+	G_STMT_END
+
+/* uchar of a selected band into sub-histograms.
+ */
+#define UCSCAN1_SUB() \
+	G_STMT_START \
+	{ \
+		unsigned int *restrict b = (unsigned int *) hist->bins[0]; \
+		VipsPel *p = (VipsPel *) in + hist->band; \
+\
+		int x; \
+\
+		for (x = 0; x + 3 < n; x += 4) { \
+			b[p[0]] += 1; \
+			b[256 + p[nb]] += 1; \
+			b[512 + p[2 * nb]] += 1; \
+			b[768 + p[3 * nb]] += 1; \
+\
+			p += 4 * nb; \
+		} \
+\
+		for (; x < n; x++) { \
+			b[p[0]] += 1; \
+			p += nb; \
+		} \
+	} \
+	G_STMT_END
+
 static int
 vips_hist_find_scan(VipsStatistic *statistic, void *seq,
 	int x, int y, void *in, int n)
@@ -348,6 +468,7 @@ vips_hist_find_scan(VipsStatistic *statistic, void *seq,
 	Histogram *hist = (Histogram *) seq;
 	int nb = statistic->ready->Bands;
 	int mx = hist->mx;
+	guint64 *touched = hist->touched;
 
 	int i;
 
@@ -357,7 +478,7 @@ vips_hist_find_scan(VipsStatistic *statistic, void *seq,
 			if (hist_find->large)
 				SCAN(unsigned char, double, UCSCANOP);
 			else
-				SCAN(unsigned char, unsigned int, UCSCANOP);
+				UCSCAN_SUB();
 			mx = 255;
 			break;
 
@@ -377,7 +498,7 @@ vips_hist_find_scan(VipsStatistic *statistic, void *seq,
 			if (hist_find->large)
 				SCAN1(unsigned char, double);
 			else
-				SCAN1(unsigned char, unsigned int);
+				UCSCAN1_SUB();
 			break;
 
 		case VIPS_FORMAT_USHORT:
@@ -45,6 +45,8 @@
  * 30/9/17
  * 	- squash constants with all elements equal so we use 1ary path more
  * 	  often
+ * 18/10/26
+ * 	- add a highway path for single constants
  */
 
 /*
@@ -88,6 +90,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "unary.h"
 
@@ -333,6 +336,23 @@ vips_linear_buffer(VipsArithmetic *arithmetic,
 
 	int i, x, k;
 
+#ifdef HAVE_HWY
+	/* The uchar output path clips, so the input must not be able to make
+	 * NaN.
+	 */
+	if (linear->single_element &&
+		vips_arithmetic_hwy_format(vips_image_get_format(im)) &&
+		(!linear->uchar ||
+			(vips_band_format_isint(vips_image_get_format(im)) &&
+				isfinite(a[0]) &&
+				isfinite(b[0]))) &&
+		vips_vector_isenabled()) {
+		vips_linear_hwy(out, in[0], width * nb, vips_image_get_format(im),
+			a[0], b[0], linear->uchar);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	if (linear->uchar)
 		switch (vips_image_get_format(im)) {
 		case VIPS_FORMAT_UCHAR:
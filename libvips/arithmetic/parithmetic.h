@@ -80,6 +80,16 @@ typedef struct _VipsArithmetic {
 	/* Set this to override class->format_table.
 	 */
 	VipsBandFormat format;
+
+	/* If our input was made by another arithmetic operation, we fuse with
+	 * it and run its process_line ourselves, line by line, rather than
+	 * having it fill a region for us. This is the list of operations to
+	 * run, starting with the one that reads from @sources and ending with
+	 * us. NULL for no fusion.
+	 */
+	struct _VipsArithmetic **chain;
+	int n_chain;
+	VipsImage **sources;
 } VipsArithmetic;
 
 typedef struct _VipsArithmeticClass {
@@ -100,6 +110,33 @@ GType vips_arithmetic_get_type(void);
 void vips_arithmetic_set_format_table(VipsArithmeticClass *klass,
 	const VipsBandFormat *format_table);
 
+/* The formats the Highway kernels handle.
+ */
+#define vips_arithmetic_hwy_format(F) \
+	((F) == VIPS_FORMAT_UCHAR || \
+		(F) == VIPS_FORMAT_USHORT || \
+		(F) == VIPS_FORMAT_FLOAT)
+
+void vips_add_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format);
+void vips_subtract_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format);
+void vips_multiply_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format);
+void vips_divide_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format);
+void vips_linear_hwy(VipsPel *out, VipsPel *in,
+	int sz, VipsBandFormat format, float a, float b, gboolean uchar);
+void vips_relational_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format, VipsOperationRelational relational);
+void vips_relational_const_hwy(VipsPel *out, VipsPel *in,
+	int sz, VipsBandFormat format, VipsOperationRelational relational,
+	double c);
+void vips_boolean_hwy(VipsPel *out, VipsPel *left, VipsPel *right,
+	int sz, VipsBandFormat format, VipsOperationBoolean boolean);
+void vips_boolean_const_hwy(VipsPel *out, VipsPel *in,
+	int sz, VipsBandFormat format, VipsOperationBoolean boolean, int c);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
@@ -74,6 +74,7 @@
 #include <stdlib.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "binary.h"
 #include "unaryconst.h"
@@ -184,6 +185,15 @@ vips_relational_buffer(VipsArithmetic *arithmetic,
 		VIPS_SWAP(VipsPel *, in0, in1);
 	}
 
+#ifdef HAVE_HWY
+	if (vips_arithmetic_hwy_format(vips_image_get_format(im)) &&
+		vips_vector_isenabled()) {
+		vips_relational_hwy(out, in0, in1, sz,
+			vips_image_get_format(im), op);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	switch (op) {
 	case VIPS_OPERATION_RELATIONAL_EQUAL:
 		SWITCH(RLOOP, CLOOP, ==, CEQUAL);
@@ -530,6 +540,22 @@ vips_relational_const_buffer(VipsArithmetic *arithmetic,
 
 	int i, x, b;
 
+#ifdef HAVE_HWY
+	/* Int images need an int constant, float images a constant we can
+	 * represent exactly as a float.
+	 */
+	if (uconst->is_single &&
+		vips_arithmetic_hwy_format(im->BandFmt) &&
+		(is_int ||
+			(im->BandFmt == VIPS_FORMAT_FLOAT &&
+				(float) uconst->c_double[0] == uconst->c_double[0])) &&
+		vips_vector_isenabled()) {
+		vips_relational_const_hwy(out, in[0], width * bands,
+			im->BandFmt, rconst->relational, uconst->c_double[0]);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	switch (rconst->relational) {
 	case VIPS_OPERATION_RELATIONAL_EQUAL:
 		if (is_int) {
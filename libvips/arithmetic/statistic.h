@@ -95,6 +95,24 @@ struct _VipsStatisticClass {
 
 GType vips_statistic_get_type(void);
 
+/* Names for the columns of the vips_stats() matrix.
+ */
+enum {
+	COL_MIN = 0,
+	COL_MAX = 1,
+	COL_SUM = 2,
+	COL_SUM2 = 3,
+	COL_AVG = 4,
+	COL_SD = 5,
+	COL_XMIN = 6,
+	COL_YMIN = 7,
+	COL_XMAX = 8,
+	COL_YMAX = 9,
+	COL_LAST = 10
+};
+
+void vips__stats_finish(VipsImage *out, int bands, guint64 pels);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
@@ -27,6 +27,8 @@
  * 7/11/11
  * 	- redone as a class
  * 	- track maxpos / minpos too
+ * 18/10/26
+ * 	- split out vips__stats_finish() for vips_summary()
  */
 
 /*
@@ -86,57 +88,24 @@ typedef VipsStatisticClass VipsStatsClass;
 
 G_DEFINE_TYPE(VipsStats, vips_stats, VIPS_TYPE_STATISTIC);
 
-/* Names for our columns.
+/* Fill in row 0 of a stats matrix from the per-band rows, then the mean and
+ * deviation columns. Shared with vips_summary().
  */
-enum {
-	COL_MIN = 0,
-	COL_MAX = 1,
-	COL_SUM = 2,
-	COL_SUM2 = 3,
-	COL_AVG = 4,
-	COL_SD = 5,
-	COL_XMIN = 6,
-	COL_YMIN = 7,
-	COL_XMAX = 8,
-	COL_YMAX = 9,
-	COL_LAST = 10
-};
-
-static int
-vips_stats_build(VipsObject *object)
+void
+vips__stats_finish(VipsImage *out, int bands, guint64 pels)
 {
-	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
-	VipsStatistic *statistic = VIPS_STATISTIC(object);
-	VipsStats *stats = (VipsStats *) object;
+	guint64 vals = pels * bands;
 
-	guint64 vals, pels;
 	double *row0, *row;
 	int b, y, i;
 
-	if (vips_object_argument_isset(object, "in")) {
-		int bands = vips_image_get_bands(statistic->in);
-
-		if (vips_check_noncomplex(class->nickname, statistic->in))
-			return -1;
-
-		g_object_set(object,
-			"out", vips_image_new_matrix(COL_LAST, bands + 1),
-			NULL);
-	}
-
-	if (VIPS_OBJECT_CLASS(vips_stats_parent_class)->build(object))
-		return -1;
-
-	pels = VIPS_IMAGE_N_PELS(statistic->ready);
-	vals = pels * vips_image_get_bands(statistic->ready);
-
-	row0 = VIPS_MATRIX(stats->out, 0, 0);
-	row = VIPS_MATRIX(stats->out, 0, 1);
+	row0 = VIPS_MATRIX(out, 0, 0);
+	row = VIPS_MATRIX(out, 0, 1);
 	for (i = 0; i < COL_LAST; i++)
 		row0[i] = row[i];
 
-	for (b = 1; b < vips_image_get_bands(statistic->ready); b++) {
-		row = VIPS_MATRIX(stats->out, 0, b + 1);
+	for (b = 1; b < bands; b++) {
+		row = VIPS_MATRIX(out, 0, b + 1);
 
 		if (row[COL_MIN] < row0[COL_MIN]) {
 			row0[COL_MIN] = row[COL_MIN];
@@ -154,8 +123,8 @@ vips_stats_build(VipsObject *object)
 		row0[COL_SUM2] += row[COL_SUM2];
 	}
 
-	for (y = 1; y < vips_image_get_height(stats->out); y++) {
-		double *row = VIPS_MATRIX(stats->out, 0, y);
+	for (y = 1; y < vips_image_get_height(out); y++) {
+		double *row = VIPS_MATRIX(out, 0, y);
 
 		row[COL_AVG] = row[COL_SUM] / pels;
 		row[COL_SD] = sqrt(
@@ -169,6 +138,32 @@ vips_stats_build(VipsObject *object)
 		fabs(row0[COL_SUM2] -
 			(row0[COL_SUM] * row0[COL_SUM] / vals)) /
 		(vals - 1));
+}
+
+static int
+vips_stats_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsStatistic *statistic = VIPS_STATISTIC(object);
+	VipsStats *stats = (VipsStats *) object;
+
+	if (vips_object_argument_isset(object, "in")) {
+		int bands = vips_image_get_bands(statistic->in);
+
+		if (vips_check_noncomplex(class->nickname, statistic->in))
+			return -1;
+
+		g_object_set(object,
+			"out", vips_image_new_matrix(COL_LAST, bands + 1),
+			NULL);
+	}
+
+	if (VIPS_OBJECT_CLASS(vips_stats_parent_class)->build(object))
+		return -1;
+
+	vips__stats_finish(stats->out,
+		vips_image_get_bands(statistic->ready),
+		VIPS_IMAGE_N_PELS(statistic->ready));
 
 	return 0;
 }
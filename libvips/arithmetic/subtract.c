@@ -75,6 +75,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "binary.h"
 
@@ -118,6 +119,15 @@ vips_subtract_buffer(VipsArithmetic *arithmetic,
 
 	int x;
 
+#ifdef HAVE_HWY
+	if (vips_arithmetic_hwy_format(vips_image_get_format(im)) &&
+		vips_vector_isenabled()) {
+		vips_subtract_hwy(out, in[0], in[1], sz,
+			vips_image_get_format(im));
+		return;
+	}
+#endif /*HAVE_HWY*/
+
 	/* Keep types here in sync with bandfmt_subtract[]
 	 * below.
 	 */
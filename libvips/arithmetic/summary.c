@@ -0,0 +1,599 @@
+/* find stats, a histogram and percentiles in a single pass
+ *
+ * 18/10/26
+ * 	- from stats.c and hist_find.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#include <vips/vips.h>
+#include <vips/internal.h>
+
+#include "statistic.h"
+
+/* Per-thread accumulators, and the final result.
+ */
+typedef struct {
+	/* COL_LAST doubles for each band, as for vips_stats().
+	 */
+	double *stats;
+	gboolean set;
+
+	/* A histogram per band, or NULL.
+	 */
+	guint64 **bins;
+	int mx;
+} VipsSummaryState;
+
+typedef struct _VipsSummary {
+	VipsStatistic parent_instance;
+
+	/* Optional inputs.
+	 */
+	gboolean find_hist;
+	VipsArrayDouble *percent;
+
+	/* Outputs.
+	 */
+	VipsImage *stats;
+	VipsImage *hist;
+	VipsArrayDouble *thresholds;
+
+	/* Number of histogram bins, or 0 for no histogram.
+	 */
+	int size;
+
+	/* Sub-states are summed into this.
+	 */
+	VipsSummaryState *state;
+
+} VipsSummary;
+
+typedef VipsStatisticClass VipsSummaryClass;
+
+G_DEFINE_TYPE(VipsSummary, vips_summary, VIPS_TYPE_STATISTIC);
+
+static void
+vips_summary_state_free(VipsSummaryState *state, int bands)
+{
+	if (state->bins)
+		for (int b = 0; b < bands; b++)
+			VIPS_FREE(state->bins[b]);
+	VIPS_FREE(state->bins);
+	VIPS_FREE(state->stats);
+	VIPS_FREE(state);
+}
+
+static VipsSummaryState *
+vips_summary_state_new(VipsSummary *summary, int bands)
+{
+	VipsSummaryState *state;
+
+	if (!(state = VIPS_NEW(NULL, VipsSummaryState)))
+		return NULL;
+	state->stats = NULL;
+	state->set = FALSE;
+	state->bins = NULL;
+	state->mx = 0;
+
+	if (!(state->stats = VIPS_ARRAY(NULL, bands * COL_LAST, double))) {
+		vips_summary_state_free(state, bands);
+		return NULL;
+	}
+
+	if (summary->size) {
+		if (!(state->bins = VIPS_ARRAY(NULL, bands, guint64 *))) {
+			vips_summary_state_free(state, bands);
+			return NULL;
+		}
+		memset(state->bins, 0, bands * sizeof(guint64 *));
+
+		for (int b = 0; b < bands; b++) {
+			if (!(state->bins[b] =
+						VIPS_ARRAY(NULL, summary->size, guint64))) {
+				vips_summary_state_free(state, bands);
+				return NULL;
+			}
+			memset(state->bins[b], 0, summary->size * sizeof(guint64));
+		}
+	}
+
+	return state;
+}
+
+/* Pick the value for the histogram, as vips_hist_find() would after its
+ * cast to uchar or ushort.
+ */
+#define HIST_UCHAR(V) (V)
+#define HIST_CHAR(V) (VIPS_MAX(0, (V)))
+#define HIST_USHORT(V) (V)
+#define HIST_INT(V) (VIPS_CLIP(0, (V), USHRT_MAX))
+#define HIST_UINT(V) (VIPS_MIN((V), USHRT_MAX))
+#define HIST_FLOAT(V) \
+	((V) == (V) ? (int) VIPS_CLIP(0, (double) (V), USHRT_MAX) : 0)
+
+/* Stats as vips_stats(), and the histogram as we go.
+ */
+#define LOOP(TYPE, HIST) \
+	{ \
+		for (b = 0; b < bands; b++) { \
+			TYPE *p = ((TYPE *) in) + b; \
+			double *q = local->stats + b * COL_LAST; \
+			guint64 *restrict bins = local->bins ? local->bins[b] : NULL; \
+			TYPE small, big; \
+			double sum, sum2; \
+			int xmin, ymin; \
+			int xmax, ymax; \
+\
+			if (local->set) { \
+				small = q[COL_MIN]; \
+				big = q[COL_MAX]; \
+				sum = q[COL_SUM]; \
+				sum2 = q[COL_SUM2]; \
+				xmin = q[COL_XMIN]; \
+				ymin = q[COL_YMIN]; \
+				xmax = q[COL_XMAX]; \
+				ymax = q[COL_YMAX]; \
+			} \
+			else { \
+				small = p[0]; \
+				big = p[0]; \
+				sum = 0; \
+				sum2 = 0; \
+				xmin = x; \
+				ymin = y; \
+				xmax = x; \
+				ymax = y; \
+			} \
+\
+			for (i = 0; i < n; i++) { \
+				TYPE value = *p; \
+\
+				sum += value; \
+				sum2 += (double) value * (double) value; \
+				if (value > big) { \
+					big = value; \
+					xmax = x + i; \
+					ymax = y; \
+				} \
+				else if (value < small) { \
+					small = value; \
+					xmin = x + i; \
+					ymin = y; \
+				} \
+\
+				if (bins) { \
+					int v = HIST(value); \
+\
+					if (v > mx) \
+						mx = v; \
+					bins[v] += 1; \
+				} \
+\
+				p += bands; \
+			} \
+\
+			q[COL_MIN] = small; \
+			q[COL_MAX] = big; \
+			q[COL_SUM] = sum; \
+			q[COL_SUM2] = sum2; \
+			q[COL_XMIN] = xmin; \
+			q[COL_YMIN] = ymin; \
+			q[COL_XMAX] = xmax; \
+			q[COL_YMAX] = ymax; \
+		} \
+\
+		local->set = TRUE; \
+	}
+
+static int
+vips_summary_scan(VipsStatistic *statistic, void *seq,
+	int x, int y, void *in, int n)
+{
+	const int bands = vips_image_get_bands(statistic->ready);
+	VipsSummaryState *local = (VipsSummaryState *) seq;
+
+	int mx = local->mx;
+	int b, i;
+
+	switch (vips_image_get_format(statistic->ready)) {
+	case VIPS_FORMAT_UCHAR:
+		LOOP(unsigned char, HIST_UCHAR);
+		break;
+	case VIPS_FORMAT_CHAR:
+		LOOP(signed char, HIST_CHAR);
+		break;
+	case VIPS_FORMAT_USHORT:
+		LOOP(unsigned short, HIST_USHORT);
+		break;
+	case VIPS_FORMAT_SHORT:
+		LOOP(signed short, HIST_INT);
+		break;
+	case VIPS_FORMAT_UINT:
+		LOOP(unsigned int, HIST_UINT);
+		break;
+	case VIPS_FORMAT_INT:
+		LOOP(signed int, HIST_INT);
+		break;
+	case VIPS_FORMAT_FLOAT:
+		LOOP(float, HIST_FLOAT);
+		break;
+	case VIPS_FORMAT_DOUBLE:
+		LOOP(double, HIST_FLOAT);
+		break;
+
+	default:
+		g_assert_not_reached();
+	}
+
+	local->mx = mx;
+
+	return 0;
+}
+
+static void *
+vips_summary_start(VipsStatistic *statistic)
+{
+	VipsSummary *summary = (VipsSummary *) statistic;
+
+	return (void *) vips_summary_state_new(summary,
+		vips_image_get_bands(statistic->ready));
+}
+
+/* Add a thread's results to the main set. Histograms only need to be summed
+ * up to the largest value that thread saw.
+ */
+static int
+vips_summary_stop(VipsStatistic *statistic, void *seq)
+{
+	const int bands = vips_image_get_bands(statistic->ready);
+	VipsSummary *summary = (VipsSummary *) statistic;
+	VipsSummaryState *global = summary->state;
+	VipsSummaryState *local = (VipsSummaryState *) seq;
+
+	int b, i;
+
+	if (local->set && !global->set) {
+		memcpy(global->stats, local->stats,
+			bands * COL_LAST * sizeof(double));
+		global->set = TRUE;
+	}
+	else if (local->set && global->set) {
+		for (b = 0; b < bands; b++) {
+			double *p = local->stats + b * COL_LAST;
+			double *q = global->stats + b * COL_LAST;
+
+			if (p[COL_MIN] < q[COL_MIN]) {
+				q[COL_MIN] = p[COL_MIN];
+				q[COL_XMIN] = p[COL_XMIN];
+				q[COL_YMIN] = p[COL_YMIN];
+			}
+
+			if (p[COL_MAX] > q[COL_MAX]) {
+				q[COL_MAX] = p[COL_MAX];
+				q[COL_XMAX] = p[COL_XMAX];
+				q[COL_YMAX] = p[COL_YMAX];
+			}
+
+			q[COL_SUM] += p[COL_SUM];
+			q[COL_SUM2] += p[COL_SUM2];
+		}
+	}
+
+	if (local->set &&
+		local->bins) {
+		for (b = 0; b < bands; b++)
+			for (i = 0; i <= local->mx; i++)
+				global->bins[b][i] += local->bins[b][i];
+		global->mx = VIPS_MAX(global->mx, local->mx);
+	}
+
+	vips_summary_state_free(local, bands);
+
+	return 0;
+}
+
+/* The histogram as vips_hist_find() makes it: uint, unless it could
+ * overflow.
+ */
+static VipsImage *
+vips_summary_make_hist(VipsSummary *summary, int bands, gboolean large)
+{
+	VipsSummaryState *state = summary->state;
+	int width = summary->size == 256 ? 256 : state->mx + 1;
+
+	VipsImage *hist;
+	VipsPel *line;
+
+	hist = vips_image_new_memory();
+	vips_image_init_fields(hist,
+		width, 1, bands,
+		large ? VIPS_FORMAT_DOUBLE : VIPS_FORMAT_UINT,
+		VIPS_CODING_NONE, VIPS_INTERPRETATION_HISTOGRAM, 1.0, 1.0);
+	if (vips_image_write_prepare(hist)) {
+		g_object_unref(hist);
+		return NULL;
+	}
+
+	line = VIPS_IMAGE_ADDR(hist, 0, 0);
+	for (int x = 0; x < width; x++)
+		for (int b = 0; b < bands; b++) {
+			if (large)
+				((double *) line)[x * bands + b] = state->bins[b][x];
+			else
+				((unsigned int *) line)[x * bands + b] = state->bins[b][x];
+		}
+
+	return hist;
+}
+
+/* The threshold below which @percent of pixels lie, averaged over bands, as
+ * vips_percent() finds it from the normalised cumulative histogram.
+ */
+static int
+vips_summary_threshold(VipsSummary *summary,
+	int bands, int width, double percent)
+{
+	VipsSummaryState *state = summary->state;
+	double target = (percent / 100.0) * width;
+
+	double total;
+
+	total = 0.0;
+	for (int b = 0; b < bands; b++) {
+		guint64 n = 0;
+		guint64 cum;
+		int x;
+
+		for (x = 0; x < width; x++)
+			n += state->bins[b][x];
+
+		cum = 0;
+		for (x = 0; x < width; x++) {
+			cum += state->bins[b][x];
+			if (n > 0 &&
+				floor((double) cum * (width - 1) / n) > target)
+				break;
+		}
+
+		total += x;
+	}
+
+	return total / bands;
+}
+
+static int
+vips_summary_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsStatistic *statistic = VIPS_STATISTIC(object);
+	VipsSummary *summary = (VipsSummary *) object;
+
+	int bands;
+	double *stats;
+
+	if (vips_object_argument_isset(object, "in")) {
+		bands = vips_image_get_bands(statistic->in);
+
+		if (vips_check_noncomplex(class->nickname, statistic->in))
+			return -1;
+
+		g_object_set(object,
+			"stats", vips_image_new_matrix(COL_LAST, bands + 1),
+			NULL);
+
+		/* We need the histogram for percentiles too. It's the size
+		 * vips_hist_find() would use.
+		 */
+		if (summary->find_hist ||
+			summary->percent)
+			summary->size =
+				vips_band_format_is8bit(statistic->in->BandFmt)
+				? 256
+				: 65536;
+
+		if (!(summary->state = vips_summary_state_new(summary, bands)))
+			return -1;
+	}
+
+	if (VIPS_OBJECT_CLASS(vips_summary_parent_class)->build(object))
+		return -1;
+
+	/* Copy the stats we found into the matrix and finish it off.
+	 */
+	bands = vips_image_get_bands(statistic->ready);
+	stats = summary->state->stats;
+	for (int b = 0; b < bands; b++)
+		memcpy(VIPS_MATRIX(summary->stats, 0, b + 1),
+			stats + b * COL_LAST,
+			COL_LAST * sizeof(double));
+	vips__stats_finish(summary->stats,
+		bands, VIPS_IMAGE_N_PELS(statistic->ready));
+
+	if (summary->size) {
+		gboolean large = VIPS_IMAGE_N_PELS(statistic->ready) >=
+			((guint64) 1 << 32);
+		VipsImage *hist;
+
+		if (!(hist = vips_summary_make_hist(summary, bands, large)))
+			return -1;
+		g_object_set(object, "hist", hist, NULL);
+
+		if (summary->percent) {
+			int n;
+			double *percent =
+				vips_array_double_get(summary->percent, &n);
+			double *thresholds;
+			VipsArrayDouble *array;
+
+			if (!(thresholds = VIPS_ARRAY(object, n, double)))
+				return -1;
+			for (int i = 0; i < n; i++)
+				thresholds[i] = vips_summary_threshold(summary,
+					bands, hist->Xsize, percent[i]);
+
+			array = vips_array_double_new(thresholds, n);
+			g_object_set(object, "thresholds", array, NULL);
+			vips_area_unref(VIPS_AREA(array));
+		}
+	}
+
+	return 0;
+}
+
+static void
+vips_summary_dispose(GObject *gobject)
+{
+	VipsSummary *summary = (VipsSummary *) gobject;
+	VipsStatistic *statistic = VIPS_STATISTIC(gobject);
+
+	if (summary->state &&
+		statistic->in) {
+		vips_summary_state_free(summary->state,
+			vips_image_get_bands(statistic->in));
+		summary->state = NULL;
+	}
+
+	G_OBJECT_CLASS(vips_summary_parent_class)->dispose(gobject);
+}
+
+static void
+vips_summary_class_init(VipsSummaryClass *class)
+{
+	GObjectClass *gobject_class = (GObjectClass *) class;
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+	VipsStatisticClass *sclass = VIPS_STATISTIC_CLASS(class);
+
+	gobject_class->dispose = vips_summary_dispose;
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	object_class->nickname = "summary";
+	object_class->description =
+		_("find stats, histogram and percentiles in one pass");
+	object_class->build = vips_summary_build;
+
+	sclass->start = vips_summary_start;
+	sclass->scan = vips_summary_scan;
+	sclass->stop = vips_summary_stop;
+
+	VIPS_ARG_IMAGE(class, "stats", 100,
+		_("Stats"),
+		_("Output array of statistics"),
+		VIPS_ARGUMENT_REQUIRED_OUTPUT,
+		G_STRUCT_OFFSET(VipsSummary, stats));
+
+	VIPS_ARG_BOOL(class, "find_hist", 110,
+		_("Find histogram"),
+		_("Also find the image histogram"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsSummary, find_hist),
+		FALSE);
+
+	VIPS_ARG_BOXED(class, "percent", 111,
+		_("Percent"),
+		_("Find thresholds for these percents of pixels"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsSummary, percent),
+		VIPS_TYPE_ARRAY_DOUBLE);
+
+	VIPS_ARG_IMAGE(class, "hist", 120,
+		_("Histogram"),
+		_("Output histogram"),
+		VIPS_ARGUMENT_OPTIONAL_OUTPUT,
+		G_STRUCT_OFFSET(VipsSummary, hist));
+
+	VIPS_ARG_BOXED(class, "thresholds", 121,
+		_("Thresholds"),
+		_("Threshold below which lie each percent of pixels"),
+		VIPS_ARGUMENT_OPTIONAL_OUTPUT,
+		G_STRUCT_OFFSET(VipsSummary, thresholds),
+		VIPS_TYPE_ARRAY_DOUBLE);
+}
+
+static void
+vips_summary_init(VipsSummary *summary)
+{
+}
+
+/**
+ * vips_summary: (method)
+ * @in: image to scan
+ * @stats: (out): image of statistics
+ * @...: `NULL`-terminated list of optional named arguments
+ *
+ * Find several statistics in a single pass through @in. This is much
+ * quicker than running [method@Image.stats], [method@Image.hist_find] and
+ * [method@Image.percent] one after the other, since each of those will
+ * compute the whole of @in again.
+ *
+ * @stats is always made, and is exactly as [method@Image.stats] would make
+ * it: min, max, sum, sum of squares, mean, deviation and the positions of
+ * min and max, for all bands in row 0 and then for each band.
+ *
+ * Set @find_hist to also make @hist, the same histogram as
+ * [method@Image.hist_find] would find for all bands.
+ *
+ * Set @percent to an array of percentages to find @thresholds, the value
+ * below which each percent of pixels lie, as [method@Image.percent] would
+ * find it. This also makes @hist.
+ *
+ * ::: tip "Optional arguments"
+ *     * @find_hist: `gboolean`, also find the histogram
+ *     * @percent: [struct@ArrayDouble], find thresholds for these percents
+ *     * @hist: output [class@Image], histogram
+ *     * @thresholds: output [struct@ArrayDouble], thresholds for @percent
+ *
+ * ::: seealso
+ *     [method@Image.stats], [method@Image.hist_find], [method@Image.percent].
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int
+vips_summary(VipsImage *in, VipsImage **stats, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, stats);
+	result = vips_call_split("summary", ap, in, stats);
+	va_end(ap);
+
+	return result;
+}
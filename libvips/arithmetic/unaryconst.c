@@ -4,6 +4,8 @@
  * 	- from arith_binary_const
  * 21/8/19
  * 	- revise to fix out of range comparisons
+ * 18/10/26
+ * 	- add is_single
  */
 
 /*
@@ -117,6 +119,13 @@ vips_unary_const_build(VipsObject *object)
 				uconst->is_int = FALSE;
 				break;
 			}
+
+		uconst->is_single = TRUE;
+		for (i = 0; i < n; i += step)
+			if (uconst->c_double[i] != uconst->c_double[0]) {
+				uconst->is_single = FALSE;
+				break;
+			}
 	}
 
 	if (VIPS_OBJECT_CLASS(vips_unary_const_parent_class)->build(object))
@@ -63,11 +63,14 @@ typedef struct _VipsUnaryConst {
 	 * and double versions.
 	 *
 	 * is_int is TRUE if the two arrays are equal for every element.
+	 *
+	 * is_single is TRUE if every band of the constant is the same.
 	 */
 	int n;
 	int *c_int;
 	double *c_double;
 	gboolean is_int;
+	gboolean is_single;
 
 } VipsUnaryConst;
 
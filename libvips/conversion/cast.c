@@ -56,6 +56,9 @@
  * 	- remove old overflow/underflow detect
  * 8/12/20
  * 	- fix range clip in int32 -> unsigned casts [ewelot]
+ * 18/10/26
+ * 	- add a highway path for the common formats
+ * 	- only take the highway path if decode leaves a format change
  */
 
 /*
@@ -100,6 +103,7 @@
 #include <math.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 #include <vips/debug.h>
 
@@ -112,6 +116,10 @@ typedef struct _VipsCast {
 	VipsBandFormat format;
 	gboolean shift;
 
+	/* Use the highway kernel for this pair of formats.
+	 */
+	gboolean hwy;
+
 } VipsCast;
 
 typedef VipsConversionClass VipsCastClass;
@@ -375,6 +383,14 @@ vips_cast_gen(VipsRegion *out_region,
 		VipsPel *in = VIPS_REGION_ADDR(ir, r->left, r->top + y);
 		VipsPel *out = VIPS_REGION_ADDR(out_region, r->left, r->top + y);
 
+#ifdef HAVE_HWY
+		if (cast->hwy) {
+			vips_cast_hwy(out, in, sz,
+				ir->im->BandFmt, cast->format, cast->shift);
+			continue;
+		}
+#endif /*HAVE_HWY*/
+
 		switch (ir->im->BandFmt) {
 		case VIPS_FORMAT_UCHAR:
 			BAND_SWITCH_INNER(unsigned char,
@@ -493,6 +509,24 @@ vips_cast_build(VipsObject *object)
 		in = t[1];
 	}
 
+#ifdef HAVE_HWY
+	/* The vector path only does @shift between uchar and ushort, other
+	 * int -> int shifts stay in C. Decode can leave us with the target
+	 * format (eg. LABQ to float), and that's a plain copy in C.
+	 */
+	cast->hwy = in->BandFmt != cast->format &&
+		vips_cast_hwy_format(in->BandFmt) &&
+		vips_cast_hwy_format(cast->format) &&
+		(!cast->shift ||
+			!vips_band_format_isint(in->BandFmt) ||
+			!vips_band_format_isint(cast->format) ||
+			(in->BandFmt == VIPS_FORMAT_UCHAR &&
+				cast->format == VIPS_FORMAT_USHORT) ||
+			(in->BandFmt == VIPS_FORMAT_USHORT &&
+				cast->format == VIPS_FORMAT_UCHAR)) &&
+		vips_vector_isenabled();
+#endif /*HAVE_HWY*/
+
 	if (vips_image_pipelinev(conversion->out,
 			VIPS_DEMAND_STYLE_THINSTRIP, in, NULL))
 		return -1;
@@ -0,0 +1,437 @@
+/* Highway kernels for vips_cast()
+ *
+ * 18/10/26
+ * 	- from arithmetic_hwy.cpp
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconversion.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/conversion/cast_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+// Compat for Highway versions < 1.3.0
+#ifndef HWY_LANES_CONSTEXPR
+#define HWY_LANES_CONSTEXPR
+#endif
+
+/* The range of each int output type. We clip real input to this before
+ * truncating, just as CAST_FLOAT_INT does.
+ */
+template <typename T>
+struct VipsCastRange;
+
+template <>
+struct VipsCastRange<uint8_t> {
+	static constexpr double lo() { return 0; }
+	static constexpr double hi() { return UCHAR_MAX; }
+};
+
+template <>
+struct VipsCastRange<uint16_t> {
+	static constexpr double lo() { return 0; }
+	static constexpr double hi() { return USHRT_MAX; }
+};
+
+template <>
+struct VipsCastRange<int16_t> {
+	static constexpr double lo() { return SHRT_MIN; }
+	static constexpr double hi() { return SHRT_MAX; }
+};
+
+template <>
+struct VipsCastRange<int32_t> {
+	static constexpr double lo() { return INT_MIN; }
+	static constexpr double hi() { return INT_MAX; }
+};
+
+/* Every int format we handle fits in int32, so int values are always
+ * worked on as int32 lanes.
+ */
+template <class D, typename T>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_int(D d, const T *HWY_RESTRICT p)
+{
+	const Rebind<T, D> dt;
+
+	return PromoteTo(d, LoadU(dt, p));
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_int(D d, const int32_t *HWY_RESTRICT p)
+{
+	return LoadU(d, p);
+}
+
+/* DemoteTo saturates, so this is the CAST_UCHAR etc. clip.
+ */
+template <class D, typename T>
+HWY_ATTR HWY_INLINE void
+vips_cast_store_int(D d, Vec<D> v, T *HWY_RESTRICT q)
+{
+	const Rebind<T, D> dt;
+
+	StoreU(DemoteTo(dt, v), dt, q);
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE void
+vips_cast_store_int(D d, Vec<D> v, int32_t *HWY_RESTRICT q)
+{
+	StoreU(v, d, q);
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_double(D d, const float *HWY_RESTRICT p)
+{
+	const Rebind<float, D> df;
+
+	return PromoteTo(d, LoadU(df, p));
+}
+
+template <class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_load_double(D d, const double *HWY_RESTRICT p)
+{
+	return LoadU(d, p);
+}
+
+/* Clip real values to the range of the output type, with NaN mapped to
+ * zero.
+ */
+template <typename TOut, class D>
+HWY_ATTR HWY_INLINE Vec<D>
+vips_cast_clip(D d, Vec<D> v)
+{
+	const auto lo = Set(d, (TFromD<D>) VipsCastRange<TOut>::lo());
+	const auto hi = Set(d, (TFromD<D>) VipsCastRange<TOut>::hi());
+
+	return Min(Max(IfThenZeroElse(IsNaN(v), v), lo), hi);
+}
+
+/* Each kind of cast is a step over one vector for tag d, and d is int32,
+ * float or double depending on the widest type the step needs. The main loop
+ * runs with full vectors, the tail with single-lane vectors.
+ */
+struct VipsCastIntInt {
+	typedef int32_t lane;
+
+	template <class D, typename TIn, typename TOut>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, TOut *HWY_RESTRICT q, const TIn *HWY_RESTRICT p)
+	{
+		vips_cast_store_int(d, vips_cast_load_int(d, p), q);
+	}
+};
+
+struct VipsCastIntFloat {
+	typedef int32_t lane;
+
+	template <class D, typename TIn>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, float *HWY_RESTRICT q, const TIn *HWY_RESTRICT p)
+	{
+		const RebindToFloat<D> df;
+
+		StoreU(ConvertTo(df, vips_cast_load_int(d, p)), df, q);
+	}
+};
+
+struct VipsCastIntDouble {
+	typedef double lane;
+
+	template <class D, typename TIn>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, double *HWY_RESTRICT q, const TIn *HWY_RESTRICT p)
+	{
+		const Rebind<int32_t, D> di;
+
+		StoreU(PromoteTo(d, vips_cast_load_int(di, p)), d, q);
+	}
+};
+
+/* float to a format smaller than int: the range is exact as float, so we can
+ * clip and truncate in float lanes.
+ */
+struct VipsCastFloatInt {
+	typedef float lane;
+
+	template <class D, typename TOut>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, TOut *HWY_RESTRICT q, const float *HWY_RESTRICT p)
+	{
+		const RebindToSigned<D> di;
+		const auto v = vips_cast_clip<TOut>(d, LoadU(d, p));
+
+		vips_cast_store_int(di, ConvertTo(di, v), q);
+	}
+};
+
+/* INT_MAX can't be represented as a float, so float to int, and all double
+ * to int casts, clip as double.
+ */
+struct VipsCastDoubleInt {
+	typedef double lane;
+
+	template <class D, typename TIn, typename TOut>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, TOut *HWY_RESTRICT q, const TIn *HWY_RESTRICT p)
+	{
+		const Rebind<int32_t, D> di;
+		const auto v = vips_cast_clip<TOut>(d, vips_cast_load_double(d, p));
+
+		vips_cast_store_int(di, DemoteTo(di, v), q);
+	}
+};
+
+struct VipsCastFloatDouble {
+	typedef double lane;
+
+	template <class D>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, double *HWY_RESTRICT q, const float *HWY_RESTRICT p)
+	{
+		StoreU(vips_cast_load_double(d, p), d, q);
+	}
+};
+
+struct VipsCastDoubleFloat {
+	typedef double lane;
+
+	template <class D>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, float *HWY_RESTRICT q, const double *HWY_RESTRICT p)
+	{
+		const Rebind<float, D> df;
+
+		StoreU(DemoteTo(df, LoadU(d, p)), df, q);
+	}
+};
+
+/* The @shift casts between uchar and ushort, see SHIFT_LEFT and SHIFT_RIGHT
+ * in cast.c.
+ */
+struct VipsCastShiftLeft {
+	typedef int32_t lane;
+
+	template <class D>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, uint16_t *HWY_RESTRICT q, const uint8_t *HWY_RESTRICT p)
+	{
+		const auto v = vips_cast_load_int(d, p);
+		const auto bit = And(v, Set(d, 1));
+
+		vips_cast_store_int(d,
+			Or(ShiftLeft<8>(v), Sub(ShiftLeft<8>(bit), bit)), q);
+	}
+};
+
+struct VipsCastShiftRight {
+	typedef int32_t lane;
+
+	template <class D>
+	static HWY_ATTR HWY_INLINE void
+	step(D d, uint8_t *HWY_RESTRICT q, const uint16_t *HWY_RESTRICT p)
+	{
+		vips_cast_store_int(d, ShiftRight<8>(vips_cast_load_int(d, p)), q);
+	}
+};
+
+template <class Kind, typename TIn, typename TOut>
+HWY_ATTR HWY_INLINE void
+vips_cast_loop(VipsPel *pout, VipsPel *pin, int32_t sz)
+{
+	typedef typename Kind::lane T;
+	const ScalableTag<T> d;
+	const CappedTag<T, 1> d1;
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(d);
+
+	TOut *HWY_RESTRICT q = (TOut *) pout;
+	const TIn *HWY_RESTRICT p = (TIn *) pin;
+
+	int32_t x = 0;
+	for (; x + N <= sz; x += N)
+		Kind::step(d, q + x, p + x);
+	for (; x < sz; x++)
+		Kind::step(d1, q + x, p + x);
+}
+
+/* Pick the kernel for an int input type.
+ */
+#define SWITCH_INT_OUT(TIn) \
+	{ \
+		switch (out_format) { \
+		case VIPS_FORMAT_UCHAR: \
+			vips_cast_loop<VipsCastIntInt, TIn, uint8_t>(out, in, sz); \
+			break; \
+		case VIPS_FORMAT_USHORT: \
+			vips_cast_loop<VipsCastIntInt, TIn, uint16_t>(out, in, sz); \
+			break; \
+		case VIPS_FORMAT_SHORT: \
+			vips_cast_loop<VipsCastIntInt, TIn, int16_t>(out, in, sz); \
+			break; \
+		case VIPS_FORMAT_INT: \
+			vips_cast_loop<VipsCastIntInt, TIn, int32_t>(out, in, sz); \
+			break; \
+		case VIPS_FORMAT_FLOAT: \
+			vips_cast_loop<VipsCastIntFloat, TIn, float>(out, in, sz); \
+			break; \
+		case VIPS_FORMAT_DOUBLE: \
+			vips_cast_loop<VipsCastIntDouble, TIn, double>(out, in, sz); \
+			break; \
+		default: \
+			g_assert_not_reached(); \
+		} \
+	}
+
+HWY_ATTR void
+vips_cast_hwy(VipsPel *out, VipsPel *in, int32_t sz,
+	VipsBandFormat in_format, VipsBandFormat out_format, gboolean shift)
+{
+	if (shift &&
+		in_format == VIPS_FORMAT_UCHAR &&
+		out_format == VIPS_FORMAT_USHORT) {
+		vips_cast_loop<VipsCastShiftLeft, uint8_t, uint16_t>(out, in, sz);
+		return;
+	}
+	if (shift &&
+		in_format == VIPS_FORMAT_USHORT &&
+		out_format == VIPS_FORMAT_UCHAR) {
+		vips_cast_loop<VipsCastShiftRight, uint16_t, uint8_t>(out, in, sz);
+		return;
+	}
+
+	switch (in_format) {
+	case VIPS_FORMAT_UCHAR:
+		SWITCH_INT_OUT(uint8_t);
+		break;
+
+	case VIPS_FORMAT_USHORT:
+		SWITCH_INT_OUT(uint16_t);
+		break;
+
+	case VIPS_FORMAT_SHORT:
+		SWITCH_INT_OUT(int16_t);
+		break;
+
+	case VIPS_FORMAT_INT:
+		SWITCH_INT_OUT(int32_t);
+		break;
+
+	case VIPS_FORMAT_FLOAT:
+		switch (out_format) {
+		case VIPS_FORMAT_UCHAR:
+			vips_cast_loop<VipsCastFloatInt, float, uint8_t>(out, in, sz);
+			break;
+		case VIPS_FORMAT_USHORT:
+			vips_cast_loop<VipsCastFloatInt, float, uint16_t>(out, in, sz);
+			break;
+		case VIPS_FORMAT_SHORT:
+			vips_cast_loop<VipsCastFloatInt, float, int16_t>(out, in, sz);
+			break;
+		case VIPS_FORMAT_INT:
+			vips_cast_loop<VipsCastDoubleInt, float, int32_t>(out, in, sz);
+			break;
+		case VIPS_FORMAT_DOUBLE:
+			vips_cast_loop<VipsCastFloatDouble, float, double>(out, in, sz);
+			break;
+		default:
+			g_assert_not_reached();
+		}
+		break;
+
+	case VIPS_FORMAT_DOUBLE:
+		switch (out_format) {
+		case VIPS_FORMAT_UCHAR:
+			vips_cast_loop<VipsCastDoubleInt, double, uint8_t>(out, in, sz);
+			break;
+		case VIPS_FORMAT_USHORT:
+			vips_cast_loop<VipsCastDoubleInt, double, uint16_t>(out, in, sz);
+			break;
+		case VIPS_FORMAT_SHORT:
+			vips_cast_loop<VipsCastDoubleInt, double, int16_t>(out, in, sz);
+			break;
+		case VIPS_FORMAT_INT:
+			vips_cast_loop<VipsCastDoubleInt, double, int32_t>(out, in, sz);
+			break;
+		case VIPS_FORMAT_FLOAT:
+			vips_cast_loop<VipsCastDoubleFloat, double, float>(out, in, sz);
+			break;
+		default:
+			g_assert_not_reached();
+		}
+		break;
+
+	default:
+		g_assert_not_reached();
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_cast_hwy);
+
+void
+vips_cast_hwy(VipsPel *out, VipsPel *in, int sz,
+	VipsBandFormat in_format, VipsBandFormat out_format, gboolean shift)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_cast_hwy)(out, in, sz,
+		in_format, out_format, shift);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
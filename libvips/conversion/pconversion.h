@@ -66,6 +66,19 @@ typedef struct _VipsConversionClass {
 
 GType vips_conversion_get_type(void);
 
+/* The formats the vips_cast() Highway kernels handle.
+ */
+#define vips_cast_hwy_format(F) \
+	((F) == VIPS_FORMAT_UCHAR || \
+		(F) == VIPS_FORMAT_USHORT || \
+		(F) == VIPS_FORMAT_SHORT || \
+		(F) == VIPS_FORMAT_INT || \
+		(F) == VIPS_FORMAT_FLOAT || \
+		(F) == VIPS_FORMAT_DOUBLE)
+
+void vips_cast_hwy(VipsPel *out, VipsPel *in, int sz,
+	VipsBandFormat in_format, VipsBandFormat out_format, gboolean shift);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
@@ -5,6 +5,9 @@
  * 8/5/17
  * 	- default to float ... int will often lose precision and should not be
  * 	  the default
+ * 18/10/26
+ * 	- use convfft for large float masks
+ * 	- document the error bound relative to the mask and input
  */
 
 /*
@@ -58,6 +61,37 @@ typedef VipsConvolutionClass VipsConvClass;
 
 G_DEFINE_TYPE(VipsConv, vips_conv, VIPS_TYPE_CONVOLUTION);
 
+/* Float masks with at least this many non-zero elements go via the FFT.
+ */
+#define VIPS_CONV_FFT_MIN (31 * 31)
+
+/* Should we convolve with the FFT? Only for large, dense masks, and only for
+ * real images.
+ */
+static gboolean
+vips_conv_usefft(VipsImage *in, VipsImage *M)
+{
+#ifdef HAVE_FFTW
+	double *coeff = (double *) VIPS_IMAGE_ADDR(M, 0, 0);
+	int ne = M->Xsize * M->Ysize;
+
+	int nnz;
+	int i;
+
+	if (vips_band_format_iscomplex(in->BandFmt))
+		return FALSE;
+
+	nnz = 0;
+	for (i = 0; i < ne; i++)
+		if (coeff[i])
+			nnz += 1;
+
+	return nnz >= VIPS_CONV_FFT_MIN;
+#else  /*!HAVE_FFTW*/
+	return FALSE;
+#endif /*HAVE_FFTW*/
+}
+
 static int
 vips_conv_build(VipsObject *object)
 {
@@ -87,9 +121,16 @@ vips_conv_build(VipsObject *object)
 
 	switch (conv->precision) {
 	case VIPS_PRECISION_FLOAT:
-		if (vips_convf(in, &t[1], convolution->M, NULL) ||
-			vips_image_write(t[1], convolution->out))
-			return -1;
+		if (vips_conv_usefft(in, convolution->M)) {
+			if (vips_convfft(in, &t[1], convolution->M, NULL) ||
+				vips_image_write(t[1], convolution->out))
+				return -1;
+		}
+		else {
+			if (vips_convf(in, &t[1], convolution->M, NULL) ||
+				vips_image_write(t[1], convolution->out))
+				return -1;
+		}
 		break;
 
 	case VIPS_PRECISION_INTEGER:
@@ -183,6 +224,14 @@ vips_conv_init(VipsConv *conv)
  * [enum@Vips.BandFormat.DOUBLE], in which case @out is also
  * [enum@Vips.BandFormat.DOUBLE].
  *
+ * If libvips was built with fftw, float convolutions with masks of more
+ * than 31x31 non-zero elements are computed with [method@Image.convfft].
+ * This is much faster, and the result differs from [method@Image.convf]
+ * only by rounding. The difference is well under 1e-5 of the sum of the
+ * absolute mask elements, divided by scale, times the largest absolute
+ * input value. For masks with negative elements, such as edge detectors,
+ * this can be large compared to the output.
+ *
  * If @precision is [enum@Vips.Precision.INTEGER], then elements of @mask
  * are converted to integers before convolution, using `rint()`,
  * and the output image always has the same [enum@BandFormat] as the input
@@ -51,6 +51,8 @@
  * 	- remove pts for a small speedup
  * 2/8/22 kleisauke
  * 	- bake the scale into the mask
+ * 18/10/26
+ * 	- add a Highway path for 8, 16 and 32-bit float input
  */
 
 /*
@@ -94,6 +96,7 @@
 #include <limits.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 
 #include "pconvolution.h"
 
@@ -179,27 +182,15 @@ vips_convf_start(VipsImage *out, void *a, void *b)
 		} \
 	}
 
-/* Convolve!
+/* Prepare the section of the input image we need for @r and (re)build the
+ * offset array.
  */
 static int
-vips_convf_gen(VipsRegion *out_region,
-	void *vseq, void *a, void *b, gboolean *stop)
+vips_convf_prepare(VipsConvfSequence *seq, VipsRect *r)
 {
-	VipsConvfSequence *seq = (VipsConvfSequence *) vseq;
-	VipsConvf *convf = (VipsConvf *) b;
-	VipsConvolution *convolution = (VipsConvolution *) convf;
-	VipsImage *M = convolution->M;
-	double offset = vips_image_get_offset(M);
-	VipsImage *in = (VipsImage *) a;
+	VipsConvf *convf = seq->convf;
+	VipsImage *M = ((VipsConvolution *) convf)->M;
 	VipsRegion *ir = seq->ir;
-	double *restrict t = convf->coeff;
-	const int nnz = convf->nnz;
-	VipsRect *r = &out_region->valid;
-	int le = r->left;
-	int to = r->top;
-	int bo = VIPS_RECT_BOTTOM(r);
-	int sz = VIPS_REGION_N_ELEMENTS(out_region) *
-		(vips_band_format_iscomplex(in->BandFmt) ? 2 : 1);
 
 	VipsRect s;
 	int x, y, z, i;
@@ -219,18 +210,48 @@ vips_convf_gen(VipsRegion *out_region,
 	if (seq->last_bpl != VIPS_REGION_LSKIP(ir)) {
 		seq->last_bpl = VIPS_REGION_LSKIP(ir);
 
-		for (i = 0; i < nnz; i++) {
+		for (i = 0; i < convf->nnz; i++) {
 			z = convf->coeff_pos[i];
 			x = z % M->Xsize;
 			y = z / M->Xsize;
 
 			seq->offsets[i] =
-				(VIPS_REGION_ADDR(ir, x + le, y + to) -
-					VIPS_REGION_ADDR(ir, le, to)) /
+				(VIPS_REGION_ADDR(ir, x + r->left, y + r->top) -
+					VIPS_REGION_ADDR(ir, r->left, r->top)) /
 				VIPS_IMAGE_SIZEOF_ELEMENT(ir->im);
 		}
 	}
 
+	return 0;
+}
+
+/* Convolve!
+ */
+static int
+vips_convf_gen(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsConvfSequence *seq = (VipsConvfSequence *) vseq;
+	VipsConvf *convf = (VipsConvf *) b;
+	VipsConvolution *convolution = (VipsConvolution *) convf;
+	VipsImage *M = convolution->M;
+	double offset = vips_image_get_offset(M);
+	VipsImage *in = (VipsImage *) a;
+	VipsRegion *ir = seq->ir;
+	double *restrict t = convf->coeff;
+	const int nnz = convf->nnz;
+	VipsRect *r = &out_region->valid;
+	int le = r->left;
+	int to = r->top;
+	int bo = VIPS_RECT_BOTTOM(r);
+	int sz = VIPS_REGION_N_ELEMENTS(out_region) *
+		(vips_band_format_iscomplex(in->BandFmt) ? 2 : 1);
+
+	int x, y;
+
+	if (vips_convf_prepare(seq, r))
+		return -1;
+
 	VIPS_GATE_START("vips_convf_gen: work");
 
 	for (y = to; y < bo; y++) {
@@ -281,6 +302,63 @@ vips_convf_gen(VipsRegion *out_region,
 	return 0;
 }
 
+#ifdef HAVE_HWY
+static int
+vips_convf_vector_gen(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsConvfSequence *seq = (VipsConvfSequence *) vseq;
+	VipsConvf *convf = (VipsConvf *) b;
+	VipsConvolution *convolution = (VipsConvolution *) convf;
+	double offset = vips_image_get_offset(convolution->M);
+	VipsImage *in = (VipsImage *) a;
+	VipsRegion *ir = seq->ir;
+	VipsRect *r = &out_region->valid;
+	int ne = VIPS_REGION_N_ELEMENTS(out_region);
+
+	if (vips_convf_prepare(seq, r))
+		return -1;
+
+	VIPS_GATE_START("vips_convf_vector_gen: work");
+
+	switch (in->BandFmt) {
+	case VIPS_FORMAT_UCHAR:
+		vips_convf_uchar_hwy(out_region, ir, r,
+			ne, convf->nnz, offset, seq->offsets, convf->coeff);
+		break;
+
+	case VIPS_FORMAT_CHAR:
+		vips_convf_char_hwy(out_region, ir, r,
+			ne, convf->nnz, offset, seq->offsets, convf->coeff);
+		break;
+
+	case VIPS_FORMAT_USHORT:
+		vips_convf_ushort_hwy(out_region, ir, r,
+			ne, convf->nnz, offset, seq->offsets, convf->coeff);
+		break;
+
+	case VIPS_FORMAT_SHORT:
+		vips_convf_short_hwy(out_region, ir, r,
+			ne, convf->nnz, offset, seq->offsets, convf->coeff);
+		break;
+
+	case VIPS_FORMAT_FLOAT:
+		vips_convf_float_hwy(out_region, ir, r,
+			ne, convf->nnz, offset, seq->offsets, convf->coeff);
+		break;
+
+	default:
+		g_assert_not_reached();
+	}
+
+	VIPS_GATE_STOP("vips_convf_vector_gen: work");
+
+	VIPS_COUNT_PIXELS(out_region, "vips_convf_vector_gen");
+
+	return 0;
+}
+#endif /*HAVE_HWY*/
+
 static int
 vips_convf_build(VipsObject *object)
 {
@@ -294,6 +372,7 @@ vips_convf_build(VipsObject *object)
 	int ne;
 	int i;
 	double scale;
+	VipsGenerateFn generate;
 
 	if (VIPS_OBJECT_CLASS(vips_convf_parent_class)->build(object))
 		return -1;
@@ -340,6 +419,26 @@ vips_convf_build(VipsObject *object)
 		return -1;
 	in = t[0];
 
+	/* 8 and 16-bit int and float input can use the vector path. It
+	 * accumulates in double, like the C path, and writes float. Double,
+	 * 32-bit int and complex stay on the C path.
+	 */
+#ifdef HAVE_HWY
+	if ((in->BandFmt == VIPS_FORMAT_UCHAR ||
+			in->BandFmt == VIPS_FORMAT_CHAR ||
+			in->BandFmt == VIPS_FORMAT_USHORT ||
+			in->BandFmt == VIPS_FORMAT_SHORT ||
+			in->BandFmt == VIPS_FORMAT_FLOAT) &&
+		vips_vector_isenabled()) {
+		generate = vips_convf_vector_gen;
+		g_info("convf: using vector path");
+	}
+	else
+#endif /*HAVE_HWY*/
+		/* Default to the C path.
+		 */
+		generate = vips_convf_gen;
+
 	g_object_set(convf, "out", vips_image_new(), NULL);
 	if (vips_image_pipelinev(convolution->out,
 			VIPS_DEMAND_STYLE_SMALLTILE, in, NULL))
@@ -357,7 +456,7 @@ vips_convf_build(VipsObject *object)
 	convolution->out->Ysize -= M->Ysize - 1;
 
 	if (vips_image_generate(convolution->out,
-			vips_convf_start, vips_convf_gen, vips_convf_stop, in, convf))
+			vips_convf_start, generate, vips_convf_stop, in, convf))
 		return -1;
 
 	convolution->out->Xoffset = -M->Xsize / 2;
@@ -0,0 +1,274 @@
+/* 18/10/26
+ * 	- from convi_hwy.cpp
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "pconvolution.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/convolution/convf_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+using DF64 = ScalableTag<double>;
+using DF32 = Rebind<float, DF64>;
+using DI32 = Rebind<int32_t, DF64>;
+constexpr DF64 df64;
+constexpr DF32 df32;
+constexpr DI32 di32;
+
+// Compat for Highway versions < 1.3.0
+#ifndef HWY_LANES_CONSTEXPR
+#define HWY_LANES_CONSTEXPR
+#endif
+
+/* Load a vector of pixels and widen to double.
+ */
+template <typename T>
+HWY_ATTR HWY_INLINE Vec<DF64>
+vips_convf_load(const T *HWY_RESTRICT p)
+{
+	const Rebind<T, DF64> dt;
+
+	return PromoteTo(df64, PromoteTo(di32, LoadU(dt, p)));
+}
+
+template <>
+HWY_ATTR HWY_INLINE Vec<DF64>
+vips_convf_load(const float *HWY_RESTRICT p)
+{
+	return PromoteTo(df64, LoadU(df32, p));
+}
+
+/* Each output element is offset + sum of coeff * input, computed across
+ * N elements at a time. Like the C path, we multiply and add in double, in
+ * mask order, and only round to float on store. Accumulate into four
+ * independent vectors to hide the latency of the adds.
+ */
+template <typename T>
+HWY_ATTR HWY_INLINE void
+vips_convf_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int32_t ne, int32_t nnz, double offset,
+	const int32_t *HWY_RESTRICT offsets, const double *HWY_RESTRICT coeff)
+{
+	int32_t bo = VIPS_RECT_BOTTOM(r);
+
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(df64);
+
+	const auto v_offset = Set(df64, offset);
+
+	for (int32_t y = r->top; y < bo; ++y) {
+		const T *HWY_RESTRICT p =
+			(T *) VIPS_REGION_ADDR(ir, r->left, y);
+		float *HWY_RESTRICT q =
+			(float *) VIPS_REGION_ADDR(out_region, r->left, y);
+
+		/* Main loop: unrolled.
+		 */
+		int32_t x = 0;
+		for (; x + 4 * N <= ne; x += 4 * N) {
+			auto sum0 = v_offset;
+			auto sum1 = v_offset;
+			auto sum2 = v_offset;
+			auto sum3 = v_offset;
+
+			for (int32_t i = 0; i < nnz; ++i) {
+				const auto c = Set(df64, coeff[i]);
+				const T *HWY_RESTRICT s = p + x + offsets[i];
+
+				sum0 = Add(sum0, Mul(c, vips_convf_load(s + 0 * N)));
+				sum1 = Add(sum1, Mul(c, vips_convf_load(s + 1 * N)));
+				sum2 = Add(sum2, Mul(c, vips_convf_load(s + 2 * N)));
+				sum3 = Add(sum3, Mul(c, vips_convf_load(s + 3 * N)));
+			}
+
+			StoreU(DemoteTo(df32, sum0), df32, q + x + 0 * N);
+			StoreU(DemoteTo(df32, sum1), df32, q + x + 1 * N);
+			StoreU(DemoteTo(df32, sum2), df32, q + x + 2 * N);
+			StoreU(DemoteTo(df32, sum3), df32, q + x + 3 * N);
+		}
+
+		/* One vector at a time.
+		 */
+		for (; x + N <= ne; x += N) {
+			auto sum = v_offset;
+
+			for (int32_t i = 0; i < nnz; ++i)
+				sum = Add(sum, Mul(Set(df64, coeff[i]),
+								   vips_convf_load(p + x + offsets[i])));
+
+			StoreU(DemoteTo(df32, sum), df32, q + x);
+		}
+
+		/* `ne` was not a multiple of the vector length `N`;
+		 * proceed one by one.
+		 */
+		for (; x < ne; ++x) {
+			double sum = offset;
+
+			for (int32_t i = 0; i < nnz; ++i)
+				sum += coeff[i] * p[x + offsets[i]];
+
+			q[x] = sum;
+		}
+	}
+}
+
+HWY_ATTR void
+vips_convf_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int32_t ne, int32_t nnz, double offset,
+	const int32_t *HWY_RESTRICT offsets, const double *HWY_RESTRICT coeff)
+{
+	vips_convf_hwy<uint8_t>(out_region, ir, r,
+		ne, nnz, offset, offsets, coeff);
+}
+
+HWY_ATTR void
+vips_convf_char_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int32_t ne, int32_t nnz, double offset,
+	const int32_t *HWY_RESTRICT offsets, const double *HWY_RESTRICT coeff)
+{
+	vips_convf_hwy<int8_t>(out_region, ir, r,
+		ne, nnz, offset, offsets, coeff);
+}
+
+HWY_ATTR void
+vips_convf_ushort_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int32_t ne, int32_t nnz, double offset,
+	const int32_t *HWY_RESTRICT offsets, const double *HWY_RESTRICT coeff)
+{
+	vips_convf_hwy<uint16_t>(out_region, ir, r,
+		ne, nnz, offset, offsets, coeff);
+}
+
+HWY_ATTR void
+vips_convf_short_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int32_t ne, int32_t nnz, double offset,
+	const int32_t *HWY_RESTRICT offsets, const double *HWY_RESTRICT coeff)
+{
+	vips_convf_hwy<int16_t>(out_region, ir, r,
+		ne, nnz, offset, offsets, coeff);
+}
+
+HWY_ATTR void
+vips_convf_float_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int32_t ne, int32_t nnz, double offset,
+	const int32_t *HWY_RESTRICT offsets, const double *HWY_RESTRICT coeff)
+{
+	vips_convf_hwy<float>(out_region, ir, r,
+		ne, nnz, offset, offsets, coeff);
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_convf_uchar_hwy);
+HWY_EXPORT(vips_convf_char_hwy);
+HWY_EXPORT(vips_convf_ushort_hwy);
+HWY_EXPORT(vips_convf_short_hwy);
+HWY_EXPORT(vips_convf_float_hwy);
+
+void
+vips_convf_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_convf_uchar_hwy)(out_region, ir, r, ne, nnz,
+		offset, offsets, coeff);
+	/* clang-format on */
+}
+
+void
+vips_convf_char_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_convf_char_hwy)(out_region, ir, r, ne, nnz,
+		offset, offsets, coeff);
+	/* clang-format on */
+}
+
+void
+vips_convf_ushort_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_convf_ushort_hwy)(out_region, ir, r, ne, nnz,
+		offset, offsets, coeff);
+	/* clang-format on */
+}
+
+void
+vips_convf_short_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_convf_short_hwy)(out_region, ir, r, ne, nnz,
+		offset, offsets, coeff);
+	/* clang-format on */
+}
+
+void
+vips_convf_float_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_convf_float_hwy)(out_region, ir, r, ne, nnz,
+		offset, offsets, coeff);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
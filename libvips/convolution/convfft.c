@@ -0,0 +1,551 @@
+/* convfft
+ *
+ * 18/10/26
+ * 	- from convf.c
+ * 	- fix the block size and plan in build
+ * 	- document the error bound
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/*
+#define DEBUG
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vips/vips.h>
+#include <vips/internal.h>
+
+#include "pconvolution.h"
+
+#ifdef HAVE_FFTW
+
+#include <fftw3.h>
+
+typedef struct {
+	VipsConvolution parent_instance;
+
+	/* The mask with the scale baked in.
+	 */
+	double *coeff;
+
+	/* The FFT block size, picked in build, and plans for it.
+	 */
+	int n_width;
+	int n_height;
+	VipsFftPlan *forward;
+	VipsFftPlan *inverse;
+
+	/* conj(FFT(mask)) / (n_width * n_height), (n_width / 2 + 1) * n_height
+	 * elements.
+	 */
+	fftw_complex *spectrum;
+} VipsConvfft;
+
+typedef VipsConvolutionClass VipsConvfftClass;
+
+G_DEFINE_TYPE(VipsConvfft, vips_convfft, VIPS_TYPE_CONVOLUTION);
+
+static void
+vips_convfft_finalize(GObject *gobject)
+{
+	VipsConvfft *convfft = (VipsConvfft *) gobject;
+
+	VIPS_FREEF(vips__fft_plan_unref, convfft->forward);
+	VIPS_FREEF(vips__fft_plan_unref, convfft->inverse);
+	VIPS_FREEF(fftw_free, convfft->spectrum);
+
+	G_OBJECT_CLASS(vips_convfft_parent_class)->finalize(gobject);
+}
+
+/* The smallest n' >= n with no prime factors larger than 5. fftw is fastest
+ * for these sizes.
+ */
+static int
+vips_convfft_good_size(int n)
+{
+	for (;; n++) {
+		int m;
+
+		m = n;
+		while (m % 2 == 0)
+			m /= 2;
+		while (m % 3 == 0)
+			m /= 3;
+		while (m % 5 == 0)
+			m /= 5;
+
+		if (m == 1)
+			return n;
+	}
+}
+
+/* The block size for one axis. A block covers a tile of output plus the
+ * mask, but must be at least twice the mask size or we'll waste most of
+ * each transform. There's no point going over the size of the input.
+ */
+static int
+vips_convfft_block_size(int tile, int mask, int input)
+{
+	return vips_convfft_good_size(
+		VIPS_MIN(VIPS_MAX(tile + mask - 1, 2 * mask), input));
+}
+
+/* Make the plans and the mask spectrum for our block size.
+ */
+static int
+vips_convfft_plan(VipsConvfft *convfft)
+{
+	VipsImage *M = ((VipsConvolution *) convfft)->M;
+	const int n_width = convfft->n_width;
+	const int n_height = convfft->n_height;
+	const int n_real = n_width * n_height;
+	const int n_half = (n_width / 2 + 1) * n_height;
+
+	double *buf;
+	int x, y, i;
+
+	/* Plans must be run on buffers with the same alignment as the ones
+	 * they were made for. Sequences use fftw_malloc() too, so that's
+	 * always true.
+	 */
+	if (!(convfft->spectrum = fftw_malloc(n_half * sizeof(fftw_complex))) ||
+		!(buf = fftw_malloc(n_real * sizeof(double)))) {
+		vips_error("convfft", "%s", _("out of memory"));
+		return -1;
+	}
+
+	if (!(convfft->forward = vips__fft_plan_get(VIPS_FFT_R2C,
+			  n_width, n_height, buf, convfft->spectrum)) ||
+		!(convfft->inverse = vips__fft_plan_get(VIPS_FFT_C2R,
+			  n_width, n_height, convfft->spectrum, buf))) {
+		fftw_free(buf);
+		return -1;
+	}
+
+	/* Planning can scribble on the arrays, so only now put the mask at the
+	 * top-left of a zeroed block.
+	 */
+	memset(buf, 0, n_real * sizeof(double));
+	for (y = 0; y < M->Ysize; y++)
+		for (x = 0; x < M->Xsize; x++)
+			buf[y * n_width + x] = convfft->coeff[y * M->Xsize + x];
+
+	vips__fft_plan_execute(convfft->forward, buf, convfft->spectrum);
+	fftw_free(buf);
+
+	/* Multiplying by the conjugate gives correlation, which is what convf
+	 * computes. fftw transforms are unnormalised, so we fold the scale in
+	 * here too.
+	 */
+	for (i = 0; i < n_half; i++) {
+		convfft->spectrum[i][0] /= (double) n_real;
+		convfft->spectrum[i][1] /= -(double) n_real;
+	}
+
+	return 0;
+}
+
+/* Our sequence value.
+ */
+typedef struct {
+	VipsConvfft *convfft;
+	VipsRegion *ir; /* Input region */
+
+	/* Block buffers.
+	 */
+	double *real;
+	fftw_complex *complex;
+} VipsConvfftSequence;
+
+/* Free a sequence value.
+ */
+static int
+vips_convfft_stop(void *vseq, void *a, void *b)
+{
+	VipsConvfftSequence *seq = (VipsConvfftSequence *) vseq;
+
+	VIPS_UNREF(seq->ir);
+	VIPS_FREEF(fftw_free, seq->real);
+	VIPS_FREEF(fftw_free, seq->complex);
+	VIPS_FREE(seq);
+
+	return 0;
+}
+
+/* Convolution start function.
+ */
+static void *
+vips_convfft_start(VipsImage *out, void *a, void *b)
+{
+	VipsImage *in = (VipsImage *) a;
+	VipsConvfft *convfft = (VipsConvfft *) b;
+	const int n_real = convfft->n_width * convfft->n_height;
+	const int n_half = (convfft->n_width / 2 + 1) * convfft->n_height;
+
+	VipsConvfftSequence *seq;
+
+	if (!(seq = VIPS_NEW(NULL, VipsConvfftSequence)))
+		return NULL;
+
+	seq->convfft = convfft;
+	seq->ir = vips_region_new(in);
+	seq->real = fftw_malloc(n_real * sizeof(double));
+	seq->complex = fftw_malloc(n_half * sizeof(fftw_complex));
+
+	if (!seq->ir ||
+		!seq->real ||
+		!seq->complex) {
+		vips_convfft_stop(seq, NULL, NULL);
+		vips_error("convfft", "%s", _("out of memory"));
+		return NULL;
+	}
+
+	return (void *) seq;
+}
+
+#define FILL(TYPE) \
+	{ \
+		TYPE *p = (TYPE *) VIPS_REGION_ADDR(ir, left, top + y) + b; \
+\
+		for (x = 0; x < in_width; x++) { \
+			real[x] = *p; \
+			p += bands; \
+		} \
+	}
+
+#define EMIT(TYPE) \
+	{ \
+		TYPE *q = (TYPE *) VIPS_REGION_ADDR(out_region, left, top + y) + b; \
+\
+		for (x = 0; x < width; x++) { \
+			*q = real[x] + offset; \
+			q += bands; \
+		} \
+	}
+
+/* Convolve one band of a width by height block of output at left, top. The
+ * input we need starts at the same position and is larger by the mask size.
+ */
+static void
+vips_convfft_block(VipsConvfftSequence *seq, VipsRegion *out_region,
+	int left, int top, int width, int height, int b)
+{
+	VipsConvfft *convfft = seq->convfft;
+	VipsImage *M = ((VipsConvolution *) convfft)->M;
+	VipsRegion *ir = seq->ir;
+	const int bands = ir->im->Bands;
+	const int in_width = width + M->Xsize - 1;
+	const int in_height = height + M->Ysize - 1;
+	const int n_width = convfft->n_width;
+	const int n_height = convfft->n_height;
+	const int n_half = (n_width / 2 + 1) * n_height;
+	const double offset = vips_image_get_offset(M);
+	fftw_complex *restrict c = seq->complex;
+	fftw_complex *restrict s = convfft->spectrum;
+
+	double *real;
+	int x, y, i;
+
+	/* The input for this block, zero padded to the FFT size.
+	 */
+	memset(seq->real, 0, n_width * n_height * sizeof(double));
+	for (y = 0; y < in_height; y++) {
+		real = seq->real + y * n_width;
+
+		switch (ir->im->BandFmt) {
+		case VIPS_FORMAT_UCHAR:
+			FILL(unsigned char);
+			break;
+
+		case VIPS_FORMAT_CHAR:
+			FILL(signed char);
+			break;
+
+		case VIPS_FORMAT_USHORT:
+			FILL(unsigned short);
+			break;
+
+		case VIPS_FORMAT_SHORT:
+			FILL(signed short);
+			break;
+
+		case VIPS_FORMAT_UINT:
+			FILL(unsigned int);
+			break;
+
+		case VIPS_FORMAT_INT:
+			FILL(signed int);
+			break;
+
+		case VIPS_FORMAT_FLOAT:
+			FILL(float);
+			break;
+
+		case VIPS_FORMAT_DOUBLE:
+			FILL(double);
+			break;
+
+		default:
+			g_assert_not_reached();
+		}
+	}
+
+	vips__fft_plan_execute(convfft->forward, seq->real, c);
+
+	for (i = 0; i < n_half; i++) {
+		double re = c[i][0] * s[i][0] - c[i][1] * s[i][1];
+		double im = c[i][0] * s[i][1] + c[i][1] * s[i][0];
+
+		c[i][0] = re;
+		c[i][1] = im;
+	}
+
+	vips__fft_plan_execute(convfft->inverse, c, seq->real);
+
+	/* The top-left width by height of the result is the valid part, the
+	 * rest has wrapped around.
+	 */
+	for (y = 0; y < height; y++) {
+		real = seq->real + y * n_width;
+
+		switch (out_region->im->BandFmt) {
+		case VIPS_FORMAT_DOUBLE:
+			EMIT(double);
+			break;
+
+		default:
+			EMIT(float);
+			break;
+		}
+	}
+}
+
+/* Convolve!
+ */
+static int
+vips_convfft_gen(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsConvfftSequence *seq = (VipsConvfftSequence *) vseq;
+	VipsConvfft *convfft = (VipsConvfft *) b;
+	VipsImage *M = ((VipsConvolution *) convfft)->M;
+	VipsRect *r = &out_region->valid;
+	int bands = out_region->im->Bands;
+
+	/* Each FFT block makes n - mask + 1 valid pixels on each axis.
+	 */
+	const int block_width = convfft->n_width - M->Xsize + 1;
+	const int block_height = convfft->n_height - M->Ysize + 1;
+
+	VipsRect s;
+	int x, y, i;
+
+	/* Prepare the section of the input image we need. A little larger
+	 * than the section of the output image we are producing.
+	 */
+	s = *r;
+	s.width += M->Xsize - 1;
+	s.height += M->Ysize - 1;
+	if (vips_region_prepare(seq->ir, &s))
+		return -1;
+
+	VIPS_GATE_START("vips_convfft_gen: work");
+
+	for (y = 0; y < r->height; y += block_height)
+		for (x = 0; x < r->width; x += block_width)
+			for (i = 0; i < bands; i++)
+				vips_convfft_block(seq, out_region,
+					r->left + x, r->top + y,
+					VIPS_MIN(block_width, r->width - x),
+					VIPS_MIN(block_height, r->height - y),
+					i);
+
+	VIPS_GATE_STOP("vips_convfft_gen: work");
+
+	VIPS_COUNT_PIXELS(out_region, "vips_convfft_gen");
+
+	return 0;
+}
+
+static int
+vips_convfft_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsConvolution *convolution = (VipsConvolution *) object;
+	VipsConvfft *convfft = (VipsConvfft *) object;
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 4);
+
+	VipsImage *in;
+	VipsImage *M;
+	double *coeff;
+	int ne;
+	int i;
+	double scale;
+
+	if (VIPS_OBJECT_CLASS(vips_convfft_parent_class)->build(object))
+		return -1;
+
+	in = convolution->in;
+	M = convolution->M;
+
+	if (vips_check_noncomplex(class->nickname, in))
+		return -1;
+
+	/* Bake the scale into the mask.
+	 */
+	coeff = (double *) VIPS_IMAGE_ADDR(M, 0, 0);
+	ne = M->Xsize * M->Ysize;
+	scale = vips_image_get_scale(M);
+	if (!(convfft->coeff = VIPS_ARRAY(object, ne, double)))
+		return -1;
+	for (i = 0; i < ne; i++)
+		convfft->coeff[i] = coeff[i] / scale;
+
+	/* Fix the block size and plan now, so generate never has to. Planning
+	 * is slow, and would stall the workers.
+	 */
+	convfft->n_width = vips_convfft_block_size(vips__tile_width,
+		M->Xsize, in->Xsize + M->Xsize - 1);
+	convfft->n_height = vips_convfft_block_size(vips__tile_height,
+		M->Ysize, in->Ysize + M->Ysize - 1);
+	if (vips_convfft_plan(convfft))
+		return -1;
+
+	if (vips_embed(in, &t[0],
+			M->Xsize / 2, M->Ysize / 2,
+			in->Xsize + M->Xsize - 1, in->Ysize + M->Ysize - 1,
+			"extend", VIPS_EXTEND_COPY,
+			NULL))
+		return -1;
+	in = t[0];
+
+	g_object_set(convfft, "out", vips_image_new(), NULL);
+	if (vips_image_pipelinev(convolution->out,
+			VIPS_DEMAND_STYLE_SMALLTILE, in, NULL))
+		return -1;
+
+	convolution->out->Xoffset = 0;
+	convolution->out->Yoffset = 0;
+
+	/* Prepare output. Consider a 7x7 mask and a 7x7 image -- the output
+	 * would be 1x1.
+	 */
+	if (in->BandFmt != VIPS_FORMAT_DOUBLE)
+		convolution->out->BandFmt = VIPS_FORMAT_FLOAT;
+	convolution->out->Xsize -= M->Xsize - 1;
+	convolution->out->Ysize -= M->Ysize - 1;
+
+	if (vips_image_generate(convolution->out,
+			vips_convfft_start, vips_convfft_gen, vips_convfft_stop,
+			in, convfft))
+		return -1;
+
+	convolution->out->Xoffset = -M->Xsize / 2;
+	convolution->out->Yoffset = -M->Ysize / 2;
+
+	return 0;
+}
+
+static void
+vips_convfft_class_init(VipsConvfftClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *object_class = (VipsObjectClass *) class;
+
+	gobject_class->finalize = vips_convfft_finalize;
+
+	object_class->nickname = "convfft";
+	object_class->description = _("FFT convolution operation");
+	object_class->build = vips_convfft_build;
+}
+
+static void
+vips_convfft_init(VipsConvfft *convfft)
+{
+	convfft->coeff = NULL;
+	convfft->forward = NULL;
+	convfft->inverse = NULL;
+	convfft->spectrum = NULL;
+}
+
+#endif /*HAVE_FFTW*/
+
+/**
+ * vips_convfft: (method)
+ * @in: input image
+ * @out: (out): output image
+ * @mask: convolve with this mask
+ * @...: `NULL`-terminated list of optional named arguments
+ *
+ * Convolution. This is a low-level operation, see [method@Image.conv] for
+ * something more convenient.
+ *
+ * Perform a convolution of @in with @mask, computing the same result as
+ * [method@Image.convf], but with the FFT. Each tile of output is cut into
+ * blocks, and each block is transformed, multiplied by the transformed mask,
+ * and transformed back (overlap-save). The block size is picked when the
+ * operation is built, from the tile size and the mask size. The cost per
+ * pixel depends only on the block size, so this is much faster than
+ * [method@Image.convf] for large masks.
+ *
+ * The result differs from [method@Image.convf] only by rounding. The
+ * difference is well under 1e-5 of the sum of the absolute mask elements,
+ * divided by scale, times the largest absolute input value.
+ *
+ * The output image is always [enum@Vips.BandFormat.FLOAT] unless @in is
+ * [enum@Vips.BandFormat.DOUBLE], in which case @out is also
+ * [enum@Vips.BandFormat.DOUBLE]. Complex images are not supported.
+ *
+ * This operation is only available if libvips was built with fftw.
+ *
+ * ::: seealso
+ *     [method@Image.conv], [method@Image.convf].
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int
+vips_convfft(VipsImage *in, VipsImage **out, VipsImage *mask, ...)
+{
+	va_list ap;
+	int result;
+
+	va_start(ap, mask);
+	result = vips_call_split("convfft", ap, in, out, mask);
+	va_end(ap);
+
+	return result;
+}
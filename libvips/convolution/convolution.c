@@ -147,6 +147,9 @@ vips_convolution_operation_init(void)
 	extern GType vips_conv_get_type(void);
 	extern GType vips_conva_get_type(void);
 	extern GType vips_convf_get_type(void);
+#ifdef HAVE_FFTW
+	extern GType vips_convfft_get_type(void);
+#endif /*HAVE_FFTW*/
 	extern GType vips_convi_get_type(void);
 	extern GType vips_convsep_get_type(void);
 	extern GType vips_convasep_get_type(void);
@@ -163,6 +166,9 @@ vips_convolution_operation_init(void)
 	vips_conv_get_type();
 	vips_conva_get_type();
 	vips_convf_get_type();
+#ifdef HAVE_FFTW
+	vips_convfft_get_type();
+#endif /*HAVE_FFTW*/
 	vips_convi_get_type();
 	vips_compass_get_type();
 	vips_convsep_get_type();
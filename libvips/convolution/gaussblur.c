@@ -7,6 +7,10 @@
  * 21/9/20
  * 	- allow sigma zero, meaning no blur
  * 	- sigma < 0.2 is just copy
+ * 18/10/26
+ * 	- add "recursive", a Young - van Vliet IIR path for large sigma
+ * 	- use it by default for sigma >= 30 with float or approximate
+ * 	  precision
  */
 
 /*
@@ -47,6 +51,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include <vips/vips.h>
@@ -60,6 +65,16 @@ typedef struct _VipsGaussblur {
 	gdouble sigma;
 	gdouble min_ampl;
 	VipsPrecision precision;
+	gboolean recursive;
+
+	/* Coefficients for the recursive filter, and the number of pixels
+	 * of run-in we need each side of an output area.
+	 */
+	double B;
+	double b1;
+	double b2;
+	double b3;
+	int margin;
 
 } VipsGaussblur;
 
@@ -67,15 +82,396 @@ typedef VipsOperationClass VipsGaussblurClass;
 
 G_DEFINE_TYPE(VipsGaussblur, vips_gaussblur, VIPS_TYPE_OPERATION);
 
+/* If @recursive is not set, use the recursive filter for sigma this large
+ * or larger, unless precision is integer. Below this, the mask is cheaper
+ * and exact to @min_ampl.
+ */
+#define VIPS_GAUSSBLUR_RECURSIVE_SIGMA (30.0)
+
+/* The recursive filter needs this many sigmas of run-in to settle.
+ */
+#define VIPS_GAUSSBLUR_MARGIN (4)
+
+/* Filter up to this many values at once.
+ */
+#define VIPS_GAUSSBLUR_LANES (256)
+
+/* Young and van Vliet, "Recursive implementation of the Gaussian filter",
+ * Signal Processing 44 (1995).
+ */
+static void
+vips_gaussblur_coefficients(VipsGaussblur *gaussblur)
+{
+	double sigma = gaussblur->sigma;
+
+	double q, q2, q3, b0;
+
+	if (sigma >= 2.5)
+		q = 0.98711 * sigma - 0.96330;
+	else
+		q = 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+	q2 = q * q;
+	q3 = q2 * q;
+
+	b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+	gaussblur->b1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+	gaussblur->b2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+	gaussblur->b3 = 0.422205 * q3 / b0;
+	gaussblur->B = 1.0 - (gaussblur->b1 + gaussblur->b2 + gaussblur->b3);
+
+	gaussblur->margin = ceil(VIPS_GAUSSBLUR_MARGIN * sigma) + 3;
+}
+
+/* Run the filter forwards then backwards over @length lines of @lanes
+ * independent values. The buffer has three lines of padding at each end, and
+ * the three lines before the data must be set to the first line. Since the
+ * gain is one, that's the steady state for a constant run-in, and the same
+ * holds for the backward pass.
+ *
+ * All the lanes are independent, so the inner loops vectorise.
+ */
+static void
+vips_gaussblur_iir(VipsGaussblur *gaussblur,
+	double *buf, int lanes, int length)
+{
+	const double B = gaussblur->B;
+	const double b1 = gaussblur->b1;
+	const double b2 = gaussblur->b2;
+	const double b3 = gaussblur->b3;
+
+	int x, i;
+
+	for (x = 3; x < length + 3; x++) {
+		double *restrict q = buf + (size_t) x * lanes;
+		const double *restrict p1 = q - lanes;
+		const double *restrict p2 = p1 - lanes;
+		const double *restrict p3 = p2 - lanes;
+
+		for (i = 0; i < lanes; i++)
+			q[i] = B * q[i] + b1 * p1[i] + b2 * p2[i] + b3 * p3[i];
+	}
+
+	for (x = length + 3; x < length + 6; x++)
+		memcpy(buf + (size_t) x * lanes,
+			buf + (size_t) (length + 2) * lanes,
+			lanes * sizeof(double));
+
+	for (x = length + 2; x >= 3; x--) {
+		double *restrict q = buf + (size_t) x * lanes;
+		const double *restrict p1 = q + lanes;
+		const double *restrict p2 = p1 + lanes;
+		const double *restrict p3 = p2 + lanes;
+
+		for (i = 0; i < lanes; i++)
+			q[i] = B * q[i] + b1 * p1[i] + b2 * p2[i] + b3 * p3[i];
+	}
+}
+
+typedef struct _VipsGaussblurSequence {
+	VipsRegion *ir;
+
+	double *buf;
+	size_t size;
+} VipsGaussblurSequence;
+
+static int
+vips_gaussblur_stop(void *vseq, void *a, void *b)
+{
+	VipsGaussblurSequence *seq = (VipsGaussblurSequence *) vseq;
+
+	VIPS_UNREF(seq->ir);
+	VIPS_FREE(seq->buf);
+	VIPS_FREE(seq);
+
+	return 0;
+}
+
+static void *
+vips_gaussblur_start(VipsImage *out, void *a, void *b)
+{
+	VipsImage *in = (VipsImage *) a;
+	VipsGaussblurSequence *seq;
+
+	if (!(seq = VIPS_NEW(NULL, VipsGaussblurSequence)))
+		return NULL;
+	seq->buf = NULL;
+	seq->size = 0;
+
+	if (!(seq->ir = vips_region_new(in))) {
+		vips_gaussblur_stop(seq, in, b);
+		return NULL;
+	}
+
+	return (void *) seq;
+}
+
+/* Get a buffer for @length lines of @lanes values, plus padding.
+ */
+static double *
+vips_gaussblur_buffer(VipsGaussblurSequence *seq, int lanes, int length)
+{
+	size_t size = (size_t) lanes * (length + 6);
+
+	if (size > seq->size) {
+		VIPS_FREE(seq->buf);
+		if (!(seq->buf = VIPS_ARRAY(NULL, size, double)))
+			return NULL;
+		seq->size = size;
+	}
+
+	return seq->buf;
+}
+
+/* Horizontal pass. Each output line needs margin pixels either side. Filter
+ * a group of lines at once, transposed so that the bands of each line sit
+ * next to each other.
+ */
+#define HLOAD(TYPE) \
+	{ \
+		for (j = 0; j < n_lines; j++) { \
+			TYPE *restrict p = (TYPE *) \
+				VIPS_REGION_ADDR(ir, r->left, r->top + y + j); \
+\
+			for (x = 0; x < length; x++) \
+				for (k = 0; k < bands; k++) \
+					buf[(x + 3) * lanes + j * bands + k] = \
+						p[x * bands + k]; \
+		} \
+	}
+
+#define HSTORE(TYPE) \
+	{ \
+		for (j = 0; j < n_lines; j++) { \
+			TYPE *restrict q = (TYPE *) \
+				VIPS_REGION_ADDR(out_region, r->left, r->top + y + j); \
+\
+			for (x = 0; x < r->width; x++) \
+				for (k = 0; k < bands; k++) \
+					q[x * bands + k] = \
+						buf[(x + margin + 3) * lanes + j * bands + k]; \
+		} \
+	}
+
+static int
+vips_gaussblur_hgen(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsGaussblurSequence *seq = (VipsGaussblurSequence *) vseq;
+	VipsImage *in = (VipsImage *) a;
+	VipsGaussblur *gaussblur = (VipsGaussblur *) b;
+	VipsRect *r = &out_region->valid;
+	VipsRegion *ir = seq->ir;
+	int margin = gaussblur->margin;
+	int bands = in->Bands;
+	int length = r->width + 2 * margin;
+	int group = VIPS_MAX(1, VIPS_GAUSSBLUR_LANES / bands);
+
+	VipsRect s;
+	int x, y, j, k;
+
+	s = *r;
+	s.width += 2 * margin;
+	if (vips_region_prepare(ir, &s))
+		return -1;
+
+	for (y = 0; y < r->height; y += group) {
+		int n_lines = VIPS_MIN(group, r->height - y);
+		int lanes = n_lines * bands;
+
+		double *buf;
+
+		if (!(buf = vips_gaussblur_buffer(seq, lanes, length)))
+			return -1;
+
+		if (in->BandFmt == VIPS_FORMAT_DOUBLE)
+			HLOAD(double)
+		else
+			HLOAD(float)
+
+		for (x = 0; x < 3; x++)
+			memcpy(buf + x * lanes, buf + 3 * lanes,
+				lanes * sizeof(double));
+
+		vips_gaussblur_iir(gaussblur, buf, lanes, length);
+
+		if (in->BandFmt == VIPS_FORMAT_DOUBLE)
+			HSTORE(double)
+		else
+			HSTORE(float)
+	}
+
+	return 0;
+}
+
+/* Vertical pass. Each output column needs margin pixels above and below.
+ * Lines are already lanes of independent values, so just filter strips of
+ * columns.
+ */
+#define VLOAD(TYPE) \
+	{ \
+		for (y = 0; y < length; y++) { \
+			TYPE *restrict p = (TYPE *) \
+				VIPS_REGION_ADDR(ir, r->left, r->top + y) + i; \
+\
+			for (x = 0; x < lanes; x++) \
+				buf[(y + 3) * lanes + x] = p[x]; \
+		} \
+	}
+
+#define VSTORE(TYPE) \
+	{ \
+		for (y = 0; y < r->height; y++) { \
+			TYPE *restrict q = (TYPE *) \
+				VIPS_REGION_ADDR(out_region, r->left, r->top + y) + i; \
+\
+			for (x = 0; x < lanes; x++) \
+				q[x] = buf[(y + margin + 3) * lanes + x]; \
+		} \
+	}
+
+static int
+vips_gaussblur_vgen(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsGaussblurSequence *seq = (VipsGaussblurSequence *) vseq;
+	VipsImage *in = (VipsImage *) a;
+	VipsGaussblur *gaussblur = (VipsGaussblur *) b;
+	VipsRect *r = &out_region->valid;
+	VipsRegion *ir = seq->ir;
+	int margin = gaussblur->margin;
+	int ne = r->width * in->Bands;
+	int length = r->height + 2 * margin;
+
+	VipsRect s;
+	int x, y, i;
+
+	s = *r;
+	s.height += 2 * margin;
+	if (vips_region_prepare(ir, &s))
+		return -1;
+
+	for (i = 0; i < ne; i += VIPS_GAUSSBLUR_LANES) {
+		int lanes = VIPS_MIN(VIPS_GAUSSBLUR_LANES, ne - i);
+
+		double *buf;
+
+		if (!(buf = vips_gaussblur_buffer(seq, lanes, length)))
+			return -1;
+
+		if (in->BandFmt == VIPS_FORMAT_DOUBLE)
+			VLOAD(double)
+		else
+			VLOAD(float)
+
+		for (y = 0; y < 3; y++)
+			memcpy(buf + y * lanes, buf + 3 * lanes,
+				lanes * sizeof(double));
+
+		vips_gaussblur_iir(gaussblur, buf, lanes, length);
+
+		if (in->BandFmt == VIPS_FORMAT_DOUBLE)
+			VSTORE(double)
+		else
+			VSTORE(float)
+	}
+
+	return 0;
+}
+
+/* Blur with the recursive filter. The work per pixel does not depend on
+ * sigma, but each region needs a run-in margin of about 4 sigma on each
+ * side. We make fat strips so the horizontal margin is paid once per line,
+ * and the vertical margin is shared by a whole strip.
+ */
+static int
+vips_gaussblur_recursive(VipsGaussblur *gaussblur,
+	VipsImage *in, VipsImage **out)
+{
+	VipsObject *object = (VipsObject *) gaussblur;
+	VipsImage **t = (VipsImage **) vips_object_local_array(object, 6);
+
+	VipsBandFormat format;
+	int margin;
+
+	vips_gaussblur_coefficients(gaussblur);
+	margin = gaussblur->margin;
+
+	if (vips_image_decode(in, &t[0]))
+		return -1;
+	in = t[0];
+
+	format = in->BandFmt == VIPS_FORMAT_DOUBLE ?
+		VIPS_FORMAT_DOUBLE : VIPS_FORMAT_FLOAT;
+	if (vips_cast(in, &t[1], format, NULL) ||
+		vips_embed(t[1], &t[2], margin, margin,
+			in->Xsize + 2 * margin, in->Ysize + 2 * margin,
+			"extend", VIPS_EXTEND_COPY,
+			NULL))
+		return -1;
+
+	t[3] = vips_image_new();
+	if (vips_image_pipelinev(t[3], VIPS_DEMAND_STYLE_FATSTRIP, t[2], NULL))
+		return -1;
+	t[3]->Xsize = in->Xsize;
+	if (vips_image_generate(t[3],
+			vips_gaussblur_start, vips_gaussblur_hgen, vips_gaussblur_stop,
+			t[2], gaussblur))
+		return -1;
+
+	t[4] = vips_image_new();
+	if (vips_image_pipelinev(t[4], VIPS_DEMAND_STYLE_FATSTRIP, t[3], NULL))
+		return -1;
+	t[4]->Ysize = in->Ysize;
+	if (vips_image_generate(t[4],
+			vips_gaussblur_start, vips_gaussblur_vgen, vips_gaussblur_stop,
+			t[3], gaussblur))
+		return -1;
+
+	vips_reorder_margin_hint(t[4], (2 * margin + 1) * (2 * margin + 1));
+
+	/* Same output format as the mask path: INTEGER precision keeps the
+	 * input format, anything else makes a float image.
+	 */
+	if (gaussblur->precision != VIPS_PRECISION_INTEGER ||
+		vips_band_format_isfloat(in->BandFmt)) {
+		*out = t[4];
+		g_object_ref(*out);
+	}
+	else if (vips_round(t[4], &t[5], VIPS_OPERATION_ROUND_RINT, NULL) ||
+		vips_cast(t[5], out, in->BandFmt, NULL))
+		return -1;
+
+	return 0;
+}
+
 static int
 vips_gaussblur_build(VipsObject *object)
 {
 	VipsGaussblur *gaussblur = (VipsGaussblur *) object;
 	VipsImage **t = (VipsImage **) vips_object_local_array(object, 2);
 
+	gboolean recursive;
+
 	if (VIPS_OBJECT_CLASS(vips_gaussblur_parent_class)->build(object))
 		return -1;
 
+	/* Pick the recursive filter automatically for large sigma. It's only
+	 * accurate to about 1% of the range, so integer precision, which
+	 * should match the mask exactly, stays on the mask path.
+	 */
+	if (vips_object_argument_isset(object, "recursive"))
+		recursive = gaussblur->recursive;
+	else
+		recursive = gaussblur->sigma >= VIPS_GAUSSBLUR_RECURSIVE_SIGMA &&
+			gaussblur->precision != VIPS_PRECISION_INTEGER;
+
+	/* The filter coefficients are only defined for sigma >= 0.5, and
+	 * there's no complex path.
+	 */
+	if (gaussblur->sigma < 0.5 ||
+		vips_band_format_iscomplex(gaussblur->in->BandFmt))
+		recursive = FALSE;
+
 	/* vips_gaussmat() will make a 1x1 pixel mask for anything smaller than
 	 * this.
 	 */
@@ -83,6 +479,10 @@ vips_gaussblur_build(VipsObject *object)
 		if (vips_copy(gaussblur->in, &t[1], NULL))
 			return -1;
 	}
+	else if (recursive) {
+		if (vips_gaussblur_recursive(gaussblur, gaussblur->in, &t[1]))
+			return -1;
+	}
 	else {
 		if (vips_gaussmat(&t[0],
 				gaussblur->sigma, gaussblur->min_ampl,
@@ -160,6 +560,13 @@ vips_gaussblur_class_init(VipsGaussblurClass *class)
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
 		G_STRUCT_OFFSET(VipsGaussblur, precision),
 		VIPS_TYPE_PRECISION, VIPS_PRECISION_INTEGER);
+
+	VIPS_ARG_BOOL(class, "recursive", 5,
+		_("Recursive"),
+		_("Blur with a recursive approximation"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsGaussblur, recursive),
+		FALSE);
 }
 
 static void
@@ -183,9 +590,21 @@ vips_gaussblur_init(VipsGaussblur *gaussblur)
  * Set @min_ampl smaller to generate a larger, more accurate mask. Set @sigma
  * larger to make the blur more blurry.
  *
+ * Set @recursive to use a recursive (IIR) approximation to a gaussian
+ * instead, and ignore @min_ampl. The work per pixel does not depend on
+ * @sigma, but each strip of output needs about 4 @sigma lines of run-in
+ * above and below, so cost still grows with @sigma, just far more slowly
+ * than with a mask. Output format follows @precision, as for the mask path.
+ *
+ * If @recursive is not set, it is turned on for @sigma of 30 or more when
+ * @precision is float or approximate. The recursive filter is within about
+ * 1% of the range of a gaussian mask, so integer precision, which matches
+ * the mask exactly, never switches automatically.
+ *
  * ::: tip "Optional arguments"
  *     * @precision: [enum@Precision], precision for blur, default int
  *     * @min_ampl: `gdouble`, minimum amplitude, default 0.2
+ *     * @recursive: `gboolean`, use a recursive filter, default automatic
  *
  * ::: seealso
  *     [ctor@Image.gaussmat], [method@Image.convsep].
@@ -75,6 +75,22 @@ void vips_convi_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
 	int ne, int nnz, int offset, const int *restrict offsets,
 	const short *restrict mant, int exp);
 
+void vips_convf_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff);
+void vips_convf_char_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff);
+void vips_convf_ushort_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff);
+void vips_convf_short_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff);
+void vips_convf_float_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
+	int ne, int nnz, double offset, const int *restrict offsets,
+	const double *restrict coeff);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
@@ -2259,6 +2259,12 @@ vips_foreign_find_save_buffer(const char *name)
  * If @thumbnail is `TRUE`, then fetch a stored thumbnail rather than the
  * image.
  *
+ * Single page loads of grid images, such as most HEIC photos, support
+ * random access. Only the grid tiles that a pipeline needs are decoded,
+ * and several tiles can decode at once. This needs libheif 1.19 or later.
+ * Use @fail_on to set the type of tile decode error that will cause load to
+ * fail. By default, tiles which fail to decode are left black.
+ *
  * By default, input image dimensions are limited to 16384x16384.
  * If @unlimited is `TRUE`, this increases to the maximum of 65535x65535.
  *
@@ -2270,6 +2276,7 @@ vips_foreign_find_save_buffer(const char *name)
  *     * @n: `gint`, load this many pages
  *     * @thumbnail: `gboolean`, fetch thumbnail instead of image
  *     * @unlimited: `gboolean`, remove all denial of service limits
+ *     * @fail_on: [enum@FailOn], types of read error to fail on
  *
  * ::: seealso
  *     [ctor@Image.new_from_file].
@@ -2307,6 +2314,7 @@ vips_heifload(const char *filename, VipsImage **out, ...)
  *     * @n: `gint`, load this many pages
  *     * @thumbnail: `gboolean`, fetch thumbnail instead of image
  *     * @unlimited: `gboolean`, remove all denial of service limits
+ *     * @fail_on: [enum@FailOn], types of read error to fail on
  *
  * ::: seealso
  *     [ctor@Image.heifload].
@@ -2346,6 +2354,7 @@ vips_heifload_buffer(void *buf, size_t len, VipsImage **out, ...)
  *     * @n: `gint`, load this many pages
  *     * @thumbnail: `gboolean`, fetch thumbnail instead of image
  *     * @unlimited: `gboolean`, remove all denial of service limits
+ *     * @fail_on: [enum@FailOn], types of read error to fail on
  *
  * ::: seealso
  *     [ctor@Image.heifload].
@@ -2530,6 +2539,19 @@ vips_heifsave_target(VipsImage *in, VipsTarget *target, ...)
  * The JPEG-XL loader and saver are experimental features and may change
  * in future libvips versions.
  *
+ * Use @page to select a page to render, numbering from zero, and @n to
+ * select the number of pages to render. The default is 1. Pages are
+ * rendered in a vertical column.
+ *
+ * Use @shrink to shrink the image by an integer factor during load. For a
+ * single frame, decode stops as soon as libjxl has enough progressive
+ * detail for that factor, so shrink 8 needs only the DC pass.
+ *
+ * ::: tip "Optional arguments"
+ *     * @page: `gint`, page (frame) to read
+ *     * @n: `gint`, load this many pages
+ *     * @shrink: `gint`, shrink by this much on load
+ *
  * ::: seealso
  *     [ctor@Image.new_from_file].
  *
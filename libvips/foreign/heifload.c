@@ -28,6 +28,11 @@
  * 	- add @unlimited
  * 13/03/23 MathemanFlo
  * 	- add bits per sample metadata
+ * 18/10/26
+ * 	- take decode threads from the shared libvips budget
+ * 	- decode only the grid tiles we need for single page loads
+ * 	- lock the reader, and keep a read position per thread
+ * 	- honour fail_on for grid tile decode errors
  */
 
 /*
@@ -199,6 +204,14 @@ typedef struct _VipsForeignLoadHeif {
 	int stride;
 	const uint8_t *data;
 
+	/* TRUE if we are loading a single page from a grid image. We can
+	 * decode tiles independently and on demand.
+	 */
+	gboolean tiled;
+#ifdef HAVE_HEIF_DECODE_IMAGE_TILE
+	struct heif_image_tiling tiling;
+#endif /*HAVE_HEIF_DECODE_IMAGE_TILE*/
+
 	/* Set from subclasses.
 	 */
 	VipsSource *source;
@@ -209,6 +222,14 @@ typedef struct _VipsForeignLoadHeif {
 	 */
 	struct heif_reader *reader;
 
+	/* libheif can call the reader from several threads at once when
+	 * decoding grid tiles. VipsSource is not threadsafe, so reader calls
+	 * hold this lock, and each thread has its own read position in
+	 * @position, so that one thread's seek can't move another's read.
+	 */
+	GMutex source_lock;
+	GHashTable *position;
+
 } VipsForeignLoadHeif;
 
 #ifdef HAVE_HEIF_INIT
@@ -328,11 +349,86 @@ vips_foreign_load_heif_dispose(GObject *gobject)
 	VIPS_FREEF(heif_context_free, heif->ctx);
 	VIPS_FREE(heif->id);
 	VIPS_FREE(heif->reader);
+	VIPS_FREEF(g_hash_table_destroy, heif->position);
 	VIPS_UNREF(heif->source);
 
 	G_OBJECT_CLASS(vips_foreign_load_heif_parent_class)->dispose(gobject);
 }
 
+static void
+vips_foreign_load_heif_finalize(GObject *gobject)
+{
+	VipsForeignLoadHeif *heif = (VipsForeignLoadHeif *) gobject;
+
+	g_mutex_clear(&heif->source_lock);
+
+	G_OBJECT_CLASS(vips_foreign_load_heif_parent_class)->finalize(gobject);
+}
+
+#ifdef HAVE_HEIF_DECODE_IMAGE_TILE
+/* Most phone HEICs are grids of independently coded tiles. If we are
+ * loading a single page, we can decode just the tiles that are needed.
+ *
+ * This runs before the header is read, so it has to pick the page in the
+ * same way as vips_foreign_load_heif_header().
+ */
+static gboolean
+vips_foreign_load_heif_is_tiled(VipsForeignLoadHeif *heif)
+{
+	VipsObject *object = VIPS_OBJECT(heif);
+
+	heif_item_id id;
+	struct heif_image_handle *handle;
+	struct heif_error error;
+	gboolean tiled;
+
+	if (heif->n != 1 ||
+		heif->thumbnail)
+		return FALSE;
+
+	if (!vips_object_argument_isset(object, "page") &&
+		!vips_object_argument_isset(object, "n")) {
+		error = heif_context_get_primary_image_ID(heif->ctx, &id);
+		if (error.code)
+			return FALSE;
+	}
+	else {
+		int n_top = heif_context_get_number_of_top_level_images(heif->ctx);
+
+		heif_item_id *ids;
+
+		if (heif->page < 0 ||
+			heif->page >= n_top)
+			return FALSE;
+
+		ids = VIPS_ARRAY(NULL, n_top, heif_item_id);
+		heif_context_get_list_of_top_level_image_IDs(heif->ctx, ids, n_top);
+		id = ids[heif->page];
+		g_free(ids);
+	}
+
+	error = heif_context_get_image_handle(heif->ctx, id, &handle);
+	if (error.code)
+		return FALSE;
+
+	/* Ask for tiling after the image transformations, so tile coordinates
+	 * are in the output space. We don't handle tilings with an offset,
+	 * or which don't cover the output exactly.
+	 */
+	error = heif_image_handle_get_image_tiling(handle, TRUE, &heif->tiling);
+	tiled = !error.code &&
+		heif->tiling.num_columns * heif->tiling.num_rows > 1 &&
+		heif->tiling.left_offset == 0 &&
+		heif->tiling.top_offset == 0 &&
+		heif->tiling.image_width == heif_image_handle_get_width(handle) &&
+		heif->tiling.image_height == heif_image_handle_get_height(handle);
+
+	heif_image_handle_release(handle);
+
+	return tiled;
+}
+#endif /*HAVE_HEIF_DECODE_IMAGE_TILE*/
+
 static int
 vips_foreign_load_heif_build(VipsObject *object)
 {
@@ -376,6 +472,10 @@ vips_foreign_load_heif_build(VipsObject *object)
 			vips__heif_error(&error);
 			return -1;
 		}
+
+#ifdef HAVE_HEIF_DECODE_IMAGE_TILE
+		heif->tiled = vips_foreign_load_heif_is_tiled(heif);
+#endif /*HAVE_HEIF_DECODE_IMAGE_TILE*/
 	}
 
 	return VIPS_OBJECT_CLASS(vips_foreign_load_heif_parent_class)
@@ -434,9 +534,12 @@ vips_foreign_load_heif_is_a(const char *buf, int len)
 static VipsForeignFlags
 vips_foreign_load_heif_get_flags(VipsForeignLoad *load)
 {
-	/* FIXME .. could support random access for grid images.
-	 */
-	return VIPS_FOREIGN_SEQUENTIAL;
+	VipsForeignLoadHeif *heif = (VipsForeignLoadHeif *) load;
+
+	if (heif->tiled)
+		return VIPS_FOREIGN_PARTIAL;
+	else
+		return VIPS_FOREIGN_SEQUENTIAL;
 }
 
 /* We've selected the page. Try to select the associated thumbnail instead,
@@ -845,8 +948,13 @@ vips_foreign_load_heif_set_header(VipsForeignLoadHeif *heif, VipsImage *out)
 
 	/* FIXME .. we always decode to RGB in generate. We should check for
 	 * all grey images, perhaps.
+	 *
+	 * Tiled loads have a tilecache on the output.
 	 */
-	if (vips_image_pipelinev(out, VIPS_DEMAND_STYLE_THINSTRIP, NULL))
+	if (vips_image_pipelinev(out,
+			heif->tiled ?
+				VIPS_DEMAND_STYLE_SMALLTILE : VIPS_DEMAND_STYLE_THINSTRIP,
+			NULL))
 		return -1;
 	vips_image_init_fields(out,
 		heif->page_width, heif->page_height * heif->n, bands,
@@ -1006,6 +1114,27 @@ vips_foreign_load_heif_header(VipsForeignLoad *load)
 	return 0;
 }
 
+/* We may need to swap bytes and shift to fill 16 bits.
+ */
+static void
+vips_foreign_load_heif_unpack(VipsForeignLoadHeif *heif, VipsPel *p, int ne)
+{
+	if (heif->bits_per_pixel > 8) {
+		int shift = 16 - heif->bits_per_pixel;
+
+		int i;
+
+		for (i = 0; i < ne; i++) {
+			/* We've asked for big endian, we must write native.
+			 */
+			guint16 v = ((p[0] << 8) | p[1]) << shift;
+
+			*((guint16 *) p) = v;
+			p += 2;
+		}
+	}
+}
+
 static int
 vips_foreign_load_heif_generate(VipsRegion *out_region,
 	void *seq, void *a, void *b, gboolean *stop)
@@ -1033,12 +1162,25 @@ vips_foreign_load_heif_generate(VipsRegion *out_region,
 		struct heif_error error;
 		struct heif_decoding_options *options;
 
+#ifdef HAVE_HEIF_CONTEXT_SET_MAX_DECODING_THREADS
+		/* libheif starts threads to decode grid images, so take them
+		 * from the libvips budget.
+		 */
+		int n_threads = vips__threads_reserve(vips_concurrency_get());
+
+		heif_context_set_max_decoding_threads(heif->ctx, n_threads);
+#endif /*HAVE_HEIF_CONTEXT_SET_MAX_DECODING_THREADS*/
+
 		options = heif_decoding_options_alloc();
 		error = heif_decode_image(heif->handle, &heif->img,
 			heif_colorspace_RGB,
 			chroma,
 			options);
 		heif_decoding_options_free(options);
+
+#ifdef HAVE_HEIF_CONTEXT_SET_MAX_DECODING_THREADS
+		vips__threads_release(n_threads);
+#endif /*HAVE_HEIF_CONTEXT_SET_MAX_DECODING_THREADS*/
 		if (error.code) {
 			vips__heif_error(&error);
 			return -1;
@@ -1078,33 +1220,139 @@ vips_foreign_load_heif_generate(VipsRegion *out_region,
 		heif->data + (size_t) heif->stride * line,
 		VIPS_IMAGE_SIZEOF_LINE(out_region->im));
 
-	/* We may need to swap bytes and shift to fill 16 bits.
-	 */
-	if (heif->bits_per_pixel > 8) {
-		int shift = 16 - heif->bits_per_pixel;
-		int ne = VIPS_REGION_N_ELEMENTS(out_region);
+	vips_foreign_load_heif_unpack(heif,
+		VIPS_REGION_ADDR(out_region, 0, r->top),
+		VIPS_REGION_N_ELEMENTS(out_region));
 
-		int i;
-		VipsPel *p;
+	return 0;
+}
 
-		p = VIPS_REGION_ADDR(out_region, 0, r->top);
-		for (i = 0; i < ne; i++) {
-			/* We've asked for big endian, we must write native.
+#ifdef HAVE_HEIF_DECODE_IMAGE_TILE
+/* A tile failed to decode. Fail if fail_on asks for it, or leave the part
+ * of the region it covers black.
+ */
+static int
+vips_foreign_load_heif_tile_error(VipsForeignLoadHeif *heif,
+	VipsRegion *out_region, VipsRect *hit, gboolean truncated)
+{
+	VipsForeignLoad *load = (VipsForeignLoad *) heif;
+	VipsFailOn fail_on = truncated ?
+		VIPS_FAIL_ON_TRUNCATED : VIPS_FAIL_ON_ERROR;
+
+	int z;
+
+	if (load->fail_on >= fail_on)
+		return -1;
+
+	for (z = 0; z < hit->height; z++)
+		memset(VIPS_REGION_ADDR(out_region, hit->left, hit->top + z),
+			0, VIPS_IMAGE_SIZEOF_PEL(out_region->im) * hit->width);
+
+	return 0;
+}
+
+/* Decode the grid tiles that touch out_region. Tiles are decoded
+ * independently, so many threads can run this at once. The reader locks
+ * around each call into our VipsSource.
+ */
+static int
+vips_foreign_load_heif_generate_tiled(VipsRegion *out_region,
+	void *seq, void *a, void *b, gboolean *stop)
+{
+	VipsForeignLoadHeif *heif = (VipsForeignLoadHeif *) a;
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(heif);
+	VipsRect *r = &out_region->valid;
+	int tile_width = heif->tiling.tile_width;
+	int tile_height = heif->tiling.tile_height;
+	enum heif_chroma chroma =
+		vips__heif_chroma(heif->bits_per_pixel, heif->has_alpha);
+	size_t ps = VIPS_IMAGE_SIZEOF_PEL(out_region->im);
+
+	int x, y;
+
+#ifdef DEBUG_VERBOSE
+	printf("vips_foreign_load_heif_generate_tiled: "
+		   "left = %d, top = %d, width = %d, height = %d\n",
+		r->left, r->top, r->width, r->height);
+#endif /*DEBUG_VERBOSE*/
+
+	for (y = VIPS_ROUND_DOWN(r->top, tile_height);
+		 y < VIPS_RECT_BOTTOM(r); y += tile_height)
+		for (x = VIPS_ROUND_DOWN(r->left, tile_width);
+			 x < VIPS_RECT_RIGHT(r); x += tile_width) {
+			struct heif_image *img;
+			struct heif_decoding_options *options;
+			struct heif_error error;
+			const uint8_t *data;
+			int stride;
+			VipsRect tile;
+			VipsRect hit;
+			int z;
+
+			tile.left = x;
+			tile.top = y;
+			tile.width = tile_width;
+			tile.height = tile_height;
+			vips_rect_intersectrect(&tile, r, &hit);
+
+			options = heif_decoding_options_alloc();
+			error = heif_image_handle_decode_image_tile(heif->handle, &img,
+				heif_colorspace_RGB, chroma, options,
+				x / tile_width, y / tile_height);
+			heif_decoding_options_free(options);
+			if (error.code) {
+				vips__heif_error(&error);
+				if (vips_foreign_load_heif_tile_error(heif, out_region,
+						&hit,
+						error.subcode == heif_suberror_End_of_data))
+					return -1;
+				continue;
+			}
+
+			/* Edge tiles can overhang the image, but must not be
+			 * smaller than the area they cover.
 			 */
-			guint16 v = ((p[0] << 8) | p[1]) << shift;
+			if (heif_image_get_width(img, heif_channel_interleaved) <
+					VIPS_MIN(tile_width, heif->page_width - x) ||
+				heif_image_get_height(img, heif_channel_interleaved) <
+					VIPS_MIN(tile_height, heif->page_height - y) ||
+				!(data = heif_image_get_plane_readonly(img,
+					  heif_channel_interleaved, &stride))) {
+				heif_image_release(img);
+				vips_error(class->nickname,
+					"%s", _("bad tile on decode"));
+				if (vips_foreign_load_heif_tile_error(heif, out_region,
+						&hit, FALSE))
+					return -1;
+				continue;
+			}
 
-			*((guint16 *) p) = v;
-			p += 2;
+			for (z = 0; z < hit.height; z++) {
+				VipsPel *q = VIPS_REGION_ADDR(out_region,
+					hit.left, hit.top + z);
+
+				memcpy(q,
+					data +
+						(size_t) stride * (hit.top - y + z) +
+						ps * (hit.left - x),
+					ps * hit.width);
+				vips_foreign_load_heif_unpack(heif, q,
+					hit.width * out_region->im->Bands);
+			}
+
+			heif_image_release(img);
 		}
-	}
 
 	return 0;
 }
+#endif /*HAVE_HEIF_DECODE_IMAGE_TILE*/
 
 static void
 vips_foreign_load_heif_minimise(VipsObject *object, VipsForeignLoadHeif *heif)
 {
+	g_mutex_lock(&heif->source_lock);
 	vips_source_minimise(heif->source);
+	g_mutex_unlock(&heif->source_lock);
 }
 
 static int
@@ -1128,11 +1376,31 @@ vips_foreign_load_heif_load(VipsForeignLoad *load)
 	g_signal_connect(t[0], "minimise",
 		G_CALLBACK(vips_foreign_load_heif_minimise), heif);
 
-	if (vips_image_generate(t[0],
-			NULL, vips_foreign_load_heif_generate, NULL, heif, NULL) ||
-		vips_sequential(t[0], &t[1], NULL) ||
-		vips_image_write(t[1], load->real))
-		return -1;
+	if (heif->tiled) {
+#ifdef HAVE_HEIF_DECODE_IMAGE_TILE
+		/* Generate to out, adding a cache. Enough tiles for two complete
+		 * rows, plus 50%. Set "threaded" so many tiles can decode at once.
+		 */
+		if (vips_image_generate(t[0],
+				NULL, vips_foreign_load_heif_generate_tiled, NULL,
+				heif, NULL) ||
+			vips_tilecache(t[0], &t[1],
+				"tile_width", (int) heif->tiling.tile_width,
+				"tile_height", (int) heif->tiling.tile_height,
+				"max_tiles", 3 * (int) heif->tiling.num_columns,
+				"threaded", TRUE,
+				NULL) ||
+			vips_image_write(t[1], load->real))
+			return -1;
+#endif /*HAVE_HEIF_DECODE_IMAGE_TILE*/
+	}
+	else {
+		if (vips_image_generate(t[0],
+				NULL, vips_foreign_load_heif_generate, NULL, heif, NULL) ||
+			vips_sequential(t[0], &t[1], NULL) ||
+			vips_image_write(t[1], load->real))
+			return -1;
+	}
 
 	if (vips_source_decode(heif->source))
 		return -1;
@@ -1151,6 +1419,7 @@ vips_foreign_load_heif_class_init(VipsForeignLoadHeifClass *class)
 	vips__heif_init();
 
 	gobject_class->dispose = vips_foreign_load_heif_dispose;
+	gobject_class->finalize = vips_foreign_load_heif_finalize;
 	gobject_class->set_property = vips_object_set_property;
 	gobject_class->get_property = vips_object_get_property;
 
@@ -1204,12 +1473,40 @@ vips_foreign_load_heif_class_init(VipsForeignLoadHeifClass *class)
 #endif
 }
 
+/* The read position for the calling thread. Call with source_lock held.
+ */
+static gint64 *
+vips_foreign_load_heif_position(VipsForeignLoadHeif *heif)
+{
+	GThread *self = g_thread_self();
+
+	gint64 *position;
+
+	if (!heif->position)
+		heif->position = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, g_free);
+
+	if (!(position = g_hash_table_lookup(heif->position, self))) {
+		position = g_new(gint64, 1);
+		*position = vips_source_seek(heif->source, 0L, SEEK_CUR);
+		g_hash_table_insert(heif->position, self, position);
+	}
+
+	return position;
+}
+
 static gint64
 vips_foreign_load_heif_get_position(void *userdata)
 {
 	VipsForeignLoadHeif *heif = (VipsForeignLoadHeif *) userdata;
 
-	return vips_source_seek(heif->source, 0L, SEEK_CUR);
+	gint64 position;
+
+	g_mutex_lock(&heif->source_lock);
+	position = *vips_foreign_load_heif_position(heif);
+	g_mutex_unlock(&heif->source_lock);
+
+	return position;
 }
 
 /* libheif read() does not work like unix read().
@@ -1222,18 +1519,33 @@ vips_foreign_load_heif_read(void *data, size_t size, void *userdata)
 {
 	VipsForeignLoadHeif *heif = (VipsForeignLoadHeif *) userdata;
 
-	while (size > 0) {
+	gint64 *position;
+	int result;
+
+	g_mutex_lock(&heif->source_lock);
+
+	/* Another thread may have moved the source since our last seek.
+	 */
+	position = vips_foreign_load_heif_position(heif);
+	result = vips_source_seek(heif->source, *position, SEEK_SET) == -1;
+
+	while (!result &&
+		size > 0) {
 		gint64 bytes_read;
 
 		bytes_read = vips_source_read(heif->source, data, size);
 		if (bytes_read <= 0)
-			return -1;
-
-		size -= bytes_read;
-		data = (char *) data + bytes_read;
+			result = -1;
+		else {
+			size -= bytes_read;
+			data = (char *) data + bytes_read;
+			*position += bytes_read;
+		}
 	}
 
-	return 0;
+	g_mutex_unlock(&heif->source_lock);
+
+	return result;
 }
 
 static int
@@ -1241,9 +1553,19 @@ vips_foreign_load_heif_seek(gint64 position, void *userdata)
 {
 	VipsForeignLoadHeif *heif = (VipsForeignLoadHeif *) userdata;
 
+	int result;
+
+	g_mutex_lock(&heif->source_lock);
+
 	/* Return 0 on success.
 	 */
-	return vips_source_seek(heif->source, position, SEEK_SET) == -1;
+	result = vips_source_seek(heif->source, position, SEEK_SET) == -1;
+	if (!result)
+		*vips_foreign_load_heif_position(heif) = position;
+
+	g_mutex_unlock(&heif->source_lock);
+
+	return result;
 }
 
 /* libheif calls this to mean "I intend to read() to this position, please
@@ -1254,17 +1576,19 @@ vips_foreign_load_heif_wait_for_file_size(gint64 target_size, void *userdata)
 {
 	VipsForeignLoadHeif *heif = (VipsForeignLoadHeif *) userdata;
 
-	gint64 old_position;
 	gint64 result;
 	enum heif_reader_grow_status status;
 
-	/* We seek the VipsSource to the position and check for errors.
+	g_mutex_lock(&heif->source_lock);
+
+	/* We seek the VipsSource to the position and check for errors. Reads
+	 * seek back to the thread's own position, so we needn't restore it.
 	 */
-	old_position = vips_source_seek(heif->source, 0L, SEEK_CUR);
 	result = vips_source_seek(heif->source, target_size, SEEK_SET);
-	vips_source_seek(heif->source, old_position, SEEK_SET);
 
-	if (result < 0 || old_position < 0)
+	g_mutex_unlock(&heif->source_lock);
+
+	if (result < 0)
 		/* Unable to seek to this point, so it's beyond EOF.
 		 */
 		status = heif_reader_grow_status_size_beyond_eof;
@@ -1282,6 +1606,7 @@ vips_foreign_load_heif_init(VipsForeignLoadHeif *heif)
 {
 	heif->n = 1;
 	heif->unlimited = vips_unlimited_get();
+	g_mutex_init(&heif->source_lock);
 
 	heif->reader = VIPS_ARRAY(NULL, 1, struct heif_reader);
 
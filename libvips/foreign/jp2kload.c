@@ -11,6 +11,11 @@
  * 18/9/24
  *	- revise offset handling
  *	- test that decoded image matches header
+ * 18/10/26
+ *	- take codec threads from the shared libvips budget for each decode
+ *	- decode tiles in parallel with a codec per thread
+ *	- set "page-sizes"
+ *	- count errors atomically, since tile codecs report from many threads
  */
 
 /*
@@ -92,6 +97,12 @@ typedef struct _VipsForeignLoadJp2k {
 	opj_dparameters_t parameters;	/* Core decompress params */
 	opj_image_t *image;				/* Read image to here */
 	opj_codestream_info_v2_t *info; /* Tile geometry */
+	gint64 length;					/* Length of source */
+
+	/* Tiled images decode with a codec per thread. They share our
+	 * source, so reads are locked.
+	 */
+	GMutex lock;
 
 	/* Geometry of full size image
 	 */
@@ -106,7 +117,8 @@ typedef struct _VipsForeignLoadJp2k {
 	int height;
 
 	/* Number of errors reported during load -- use this to block load of
-	 * corrupted images.
+	 * corrupted images. Tile codecs report from many threads, so only
+	 * touch this with g_atomic_int_*().
 	 */
 	int n_errors;
 
@@ -152,6 +164,16 @@ vips_foreign_load_jp2k_dispose(GObject *gobject)
 	G_OBJECT_CLASS(vips_foreign_load_jp2k_parent_class)->dispose(gobject);
 }
 
+static void
+vips_foreign_load_jp2k_finalize(GObject *gobject)
+{
+	VipsForeignLoadJp2k *jp2k = (VipsForeignLoadJp2k *) gobject;
+
+	g_mutex_clear(&jp2k->lock);
+
+	G_OBJECT_CLASS(vips_foreign_load_jp2k_parent_class)->finalize(gobject);
+}
+
 static OPJ_SIZE_T
 vips_foreign_load_jp2k_read_source(void *buffer, size_t length, void *client)
 {
@@ -324,7 +346,7 @@ vips_foreign_load_jp2k_error_callback(const char *msg, void *client)
 #endif /*DEBUG*/
 
 	vips_error(class->nickname, "%s", msg);
-	jp2k->n_errors += 1;
+	g_atomic_int_inc(&jp2k->n_errors);
 }
 
 static void
@@ -601,12 +623,42 @@ vips_foreign_load_jp2k_set_header(VipsForeignLoadJp2k *jp2k, VipsImage *out)
 		vips_image_set_blob_copy(out, VIPS_META_ICC_NAME,
 			jp2k->image->icc_profile_buf, jp2k->image->icc_profile_len);
 
-	/* Map number of layers in image to pages.
+	/* Map number of layers in image to pages. We can compute the size of
+	 * each layer without decoding, so thumbnail doesn't need to open them.
 	 */
 	if (jp2k->info &&
-		jp2k->info->m_default_tile_info.tccp_info)
-		vips_image_set_int(out, VIPS_META_N_PAGES,
-			jp2k->info->m_default_tile_info.tccp_info->numresolutions);
+		jp2k->info->m_default_tile_info.tccp_info) {
+		int n_pages =
+			jp2k->info->m_default_tile_info.tccp_info->numresolutions;
+
+		vips_image_set_int(out, VIPS_META_N_PAGES, n_pages);
+
+		if (n_pages > 0 &&
+			n_pages < 32) {
+			int *sizes = VIPS_ARRAY(NULL, 2 * n_pages, int);
+
+			for (int i = 0; i < n_pages; i++) {
+				int shrink = 1 << i;
+
+				/* openjpeg reduces component bounds with a ceil
+				 * divide, then we remove the offset, see
+				 * vips_foreign_load_jp2k_header().
+				 */
+				sizes[2 * i] =
+					VIPS_ROUND_UP(jp2k->opj_x1, shrink) / shrink -
+					VIPS_ROUND_UP(jp2k->opj_x0, shrink) / shrink -
+					VIPS_ROUND_UINT((double) jp2k->opj_x0 / shrink);
+				sizes[2 * i + 1] =
+					VIPS_ROUND_UP(jp2k->opj_y1, shrink) / shrink -
+					VIPS_ROUND_UP(jp2k->opj_y0, shrink) / shrink -
+					VIPS_ROUND_UINT((double) jp2k->opj_y0 / shrink);
+			}
+
+			vips_image_set_array_int(out, VIPS_META_PAGE_SIZES,
+				sizes, 2 * n_pages);
+			g_free(sizes);
+		}
+	}
 
 	vips_image_set_int(out,
 		VIPS_META_BITS_PER_SAMPLE, jp2k->image->comps[0].prec);
@@ -673,6 +725,8 @@ vips_foreign_load_jp2k_header(VipsForeignLoad *load)
 
 	jp2k->codec_format = vips_foreign_load_jp2k_get_codec_format(jp2k->source);
 	vips_source_rewind(jp2k->source);
+	if ((jp2k->length = vips_source_length(jp2k->source)) < 0)
+		return -1;
 	if (!(jp2k->codec = opj_create_decompress(jp2k->codec_format)))
 		return -1;
 
@@ -683,8 +737,6 @@ vips_foreign_load_jp2k_header(VipsForeignLoad *load)
 	if (!opj_setup_decoder(jp2k->codec, &jp2k->parameters))
 		return -1;
 
-	opj_codec_set_threads(jp2k->codec, vips_concurrency_get());
-
 	if (!opj_read_header(jp2k->stream, jp2k->codec, &jp2k->image))
 		return -1;
 	if (!(jp2k->info = opj_get_cstr_info(jp2k->codec)))
@@ -968,7 +1020,7 @@ vips_foreign_load_jp2k_is_match(VipsForeignLoadJp2k *jp2k,
 	VipsInterpretation interpretation =
 		vips_foreign_load_jp2k_get_interpretation(image, format);
 	gboolean ycc = vips_foreign_load_jp2k_get_ycc(image);
-	gboolean upsample = vips_foreign_load_jp2k_get_upsample(jp2k->image);
+	gboolean upsample = vips_foreign_load_jp2k_get_upsample(image);
 
 	if (format != load->out->BandFmt ||
 		interpretation != load->out->Type ||
@@ -979,6 +1031,71 @@ vips_foreign_load_jp2k_is_match(VipsForeignLoadJp2k *jp2k,
 	return TRUE;
 }
 
+/* openjpeg makes its pool of threads when the codec reads the header, and
+ * keeps it until the codec is destroyed. Make a codec for each decode of an
+ * untiled image, so we only hold threads from the libvips budget while the
+ * decode runs.
+ */
+static int
+vips_foreign_load_jp2k_reopen(VipsForeignLoadJp2k *jp2k, int n_threads)
+{
+	VIPS_FREEF(opj_destroy_codec, jp2k->codec);
+	VIPS_FREEF(opj_stream_destroy, jp2k->stream);
+	VIPS_FREEF(opj_image_destroy, jp2k->image);
+
+	if (vips_source_rewind(jp2k->source))
+		return -1;
+	if (!(jp2k->stream = vips_foreign_load_jp2k_stream(jp2k->source)) ||
+		!(jp2k->codec = opj_create_decompress(jp2k->codec_format))) {
+		vips_error("jp2kload", "%s", _("unable to create jp2k codec"));
+		return -1;
+	}
+	vips_foreign_load_jp2k_attach_handlers(jp2k, jp2k->codec);
+	if (!opj_setup_decoder(jp2k->codec, &jp2k->parameters)) {
+		vips_error("jp2kload", "%s", _("unable to read jp2k header"));
+		return -1;
+	}
+
+	/* This fails if openjpeg was built without thread support, but we
+	 * can still decode.
+	 */
+	(void) opj_codec_set_threads(jp2k->codec, n_threads);
+
+	if (!opj_read_header(jp2k->stream, jp2k->codec, &jp2k->image)) {
+		vips_error("jp2kload", "%s", _("unable to read jp2k header"));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+vips_foreign_load_jp2k_decode(VipsForeignLoadJp2k *jp2k, VipsRect *opj)
+{
+	int n_threads;
+	int result;
+
+	/* Take threads for the openjpeg pool from the libvips budget. If
+	 * that's all in use, decode in this thread.
+	 */
+	n_threads = vips__threads_reserve(vips_concurrency_get());
+
+	result = 0;
+	if (vips_foreign_load_jp2k_reopen(jp2k, n_threads) ||
+		!opj_set_decode_area(jp2k->codec, jp2k->image,
+			opj->left, opj->top,
+			VIPS_RECT_RIGHT(opj), VIPS_RECT_BOTTOM(opj)) ||
+		!opj_decode(jp2k->codec, jp2k->stream, jp2k->image))
+		result = -1;
+
+	/* Destroying the codec stops its threads. We still need the image.
+	 */
+	VIPS_FREEF(opj_destroy_codec, jp2k->codec);
+	vips__threads_release(n_threads);
+
+	return result;
+}
+
 /* Read a tile from an untiled jp2k file.
  */
 static int
@@ -999,7 +1116,7 @@ vips_foreign_load_jp2k_generate_untiled(VipsRegion *out,
 	/* If openjpeg has flagged an error, the library is not in a known
 	 * state and it's not safe to call again.
 	 */
-	if (jp2k->n_errors)
+	if (g_atomic_int_get(&jp2k->n_errors))
 		return 0;
 
 	/* To opj image space. Coordinates are always in the highest res level.
@@ -1011,11 +1128,7 @@ vips_foreign_load_jp2k_generate_untiled(VipsRegion *out,
 		.height = r->height * jp2k->shrink
 	};
 
-	if (!opj_set_decode_area(jp2k->codec, jp2k->image,
-			opj.left, opj.top, VIPS_RECT_RIGHT(&opj), VIPS_RECT_BOTTOM(&opj)))
-		return -1;
-
-	if (!opj_decode(jp2k->codec, jp2k->stream, jp2k->image))
+	if (vips_foreign_load_jp2k_decode(jp2k, &opj))
 		return -1;
 
 	if (vips_foreign_load_jp2k_check_supported(jp2k->image))
@@ -1048,12 +1161,139 @@ vips_foreign_load_jp2k_generate_untiled(VipsRegion *out,
 	 * spot is errors.
 	 */
 	if (load->fail_on >= VIPS_FAIL_ON_ERROR &&
-		jp2k->n_errors > 0)
+		g_atomic_int_get(&jp2k->n_errors) > 0)
+		return -1;
+
+	return 0;
+}
+
+/* Per-thread decode state for tiled images. Each thread has its own codec
+ * and stream, so tiles can decode in parallel. Streams track their own
+ * position and seek the shared source under a lock for each read.
+ */
+typedef struct _VipsForeignLoadJp2kSeq {
+	VipsForeignLoadJp2k *jp2k;
+
+	gint64 position;
+	opj_stream_t *stream;
+	opj_codec_t *codec;
+	opj_image_t *image;
+} VipsForeignLoadJp2kSeq;
+
+static OPJ_SIZE_T
+vips_foreign_load_jp2k_seq_read(void *buffer, size_t length, void *client)
+{
+	VipsForeignLoadJp2kSeq *seq = (VipsForeignLoadJp2kSeq *) client;
+	VipsForeignLoadJp2k *jp2k = seq->jp2k;
+
+	gint64 bytes_read;
+
+	g_mutex_lock(&jp2k->lock);
+	if (vips_source_seek(jp2k->source, seq->position, SEEK_SET) == -1)
+		bytes_read = -1;
+	else
+		bytes_read = vips_source_read(jp2k->source, buffer, length);
+	g_mutex_unlock(&jp2k->lock);
+
+	/* openjpeg read uses -1 for both EOF and error return.
+	 */
+	if (bytes_read <= 0)
 		return -1;
 
+	seq->position += bytes_read;
+
+	return bytes_read;
+}
+
+static OPJ_OFF_T
+vips_foreign_load_jp2k_seq_skip(OPJ_OFF_T n_bytes, void *client)
+{
+	VipsForeignLoadJp2kSeq *seq = (VipsForeignLoadJp2kSeq *) client;
+
+	if (seq->position + n_bytes < 0 ||
+		seq->position + n_bytes > seq->jp2k->length)
+		return -1;
+
+	seq->position += n_bytes;
+
+	return n_bytes;
+}
+
+static OPJ_BOOL
+vips_foreign_load_jp2k_seq_seek(OPJ_OFF_T position, void *client)
+{
+	VipsForeignLoadJp2kSeq *seq = (VipsForeignLoadJp2kSeq *) client;
+
+	if (position < 0 ||
+		position > seq->jp2k->length)
+		return OPJ_FALSE;
+
+	seq->position = position;
+
+	return OPJ_TRUE;
+}
+
+static int
+vips_foreign_load_jp2k_seq_stop(void *vseq, void *a, void *b)
+{
+	VipsForeignLoadJp2kSeq *seq = (VipsForeignLoadJp2kSeq *) vseq;
+
+	VIPS_FREEF(opj_destroy_codec, seq->codec);
+	VIPS_FREEF(opj_stream_destroy, seq->stream);
+	VIPS_FREEF(opj_image_destroy, seq->image);
+	g_free(seq);
+
 	return 0;
 }
 
+static void *
+vips_foreign_load_jp2k_seq_start(VipsImage *out, void *a, void *b)
+{
+	VipsForeignLoadJp2k *jp2k = (VipsForeignLoadJp2k *) a;
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(jp2k);
+
+	VipsForeignLoadJp2kSeq *seq;
+
+	seq = g_new0(VipsForeignLoadJp2kSeq, 1);
+	seq->jp2k = jp2k;
+
+	if (!(seq->stream = opj_stream_create(OPJ_J2K_STREAM_CHUNK_SIZE, TRUE))) {
+		vips_error(class->nickname, "%s", _("unable to create jp2k stream"));
+		vips_foreign_load_jp2k_seq_stop(seq, NULL, NULL);
+		return NULL;
+	}
+	opj_stream_set_user_data(seq->stream, seq, NULL);
+	opj_stream_set_user_data_length(seq->stream, jp2k->length);
+	opj_stream_set_read_function(seq->stream,
+		vips_foreign_load_jp2k_seq_read);
+	opj_stream_set_skip_function(seq->stream,
+		vips_foreign_load_jp2k_seq_skip);
+	opj_stream_set_seek_function(seq->stream,
+		vips_foreign_load_jp2k_seq_seek);
+
+	/* Same setup as the header codec, but single-threaded, since we
+	 * have a codec in every libvips worker.
+	 */
+	if (!(seq->codec = opj_create_decompress(jp2k->codec_format))) {
+		vips_error(class->nickname, "%s", _("unable to create jp2k codec"));
+		vips_foreign_load_jp2k_seq_stop(seq, NULL, NULL);
+		return NULL;
+	}
+	vips_foreign_load_jp2k_attach_handlers(jp2k, seq->codec);
+
+	/* openjpeg usually reports the reason for these through our error
+	 * handler, but not always, so make sure there's a message.
+	 */
+	if (!opj_setup_decoder(seq->codec, &jp2k->parameters) ||
+		!opj_read_header(seq->stream, seq->codec, &seq->image)) {
+		vips_error(class->nickname, "%s", _("unable to read jp2k header"));
+		vips_foreign_load_jp2k_seq_stop(seq, NULL, NULL);
+		return NULL;
+	}
+
+	return seq;
+}
+
 /* Read a tile from the file.
  *
  * - jp2k tiles get smaller with `->shrink`, so we may need to fetch many jp2k
@@ -1064,12 +1304,14 @@ vips_foreign_load_jp2k_generate_untiled(VipsRegion *out,
  */
 static int
 vips_foreign_load_jp2k_generate_tiled(VipsRegion *out,
-	void *seq, void *a, void *b, gboolean *stop)
+	void *vseq, void *a, void *b, gboolean *stop)
 {
+	VipsForeignLoadJp2kSeq *seq = (VipsForeignLoadJp2kSeq *) vseq;
 	VipsForeignLoad *load = (VipsForeignLoad *) a;
 	VipsForeignLoadJp2k *jp2k = (VipsForeignLoadJp2k *) load;
 	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(jp2k);
 	VipsRect *r = &out->valid;
+	opj_image_t *image = seq->image;
 
 	int x, y, z;
 
@@ -1082,7 +1324,7 @@ vips_foreign_load_jp2k_generate_tiled(VipsRegion *out,
 	/* If openjpeg has flagged an error, the library is not in a known
 	 * state and it's not safe to call again.
 	 */
-	if (jp2k->n_errors)
+	if (g_atomic_int_get(&jp2k->n_errors))
 		return 0;
 
 	y = 0;
@@ -1110,17 +1352,17 @@ vips_foreign_load_jp2k_generate_tiled(VipsRegion *out,
 #ifdef DEBUG_VERBOSE
 			printf("   fetch tile %d\n", tile_index);
 #endif /*DEBUG_VERBOSE*/
-			if (!opj_get_decoded_tile(jp2k->codec,
-					jp2k->stream, jp2k->image, tile_index))
+			if (!opj_get_decoded_tile(seq->codec,
+					seq->stream, image, tile_index))
 				return -1;
 
-			if (vips_foreign_load_jp2k_check_supported(jp2k->image))
+			if (vips_foreign_load_jp2k_check_supported(image))
 				return -1;
 
 			/* Tragically, jp2k allows the decoded image to not match the
 			 * wrapper.
 			 */
-			if (!vips_foreign_load_jp2k_is_match(jp2k, jp2k->image)) {
+			if (!vips_foreign_load_jp2k_is_match(jp2k, image)) {
 				vips_error(class->nickname,
 					"%s", _("decoded image does not match container"));
 				return -1;
@@ -1132,8 +1374,8 @@ vips_foreign_load_jp2k_generate_tiled(VipsRegion *out,
 			tile = (VipsRect) {
 				.left = r->left + x,
 				.top = r->top + y,
-				.width = jp2k->image->comps[0].w,
-				.height = jp2k->image->comps[0].h
+				.width = image->comps[0].w,
+				.height = image->comps[0].h
 			};
 			vips_rect_intersectrect(&tile, r, &hit);
 
@@ -1143,16 +1385,16 @@ vips_foreign_load_jp2k_generate_tiled(VipsRegion *out,
 				VipsPel *q = VIPS_REGION_ADDR(out, hit.left, hit.top + z);
 
 				vips_foreign_load_jp2k_pack(jp2k->upsample,
-					jp2k->image, out->im, q,
+					image, out->im, q,
 					hit.left - tile.left,
 					hit.top - tile.top + z,
 					hit.width);
 
 				if (jp2k->ycc_to_rgb)
-					vips_foreign_load_jp2k_ycc_to_rgb(jp2k->image, out->im, q,
+					vips_foreign_load_jp2k_ycc_to_rgb(image, out->im, q,
 						hit.width);
 
-				vips_foreign_load_jp2k_ljust(jp2k->image,
+				vips_foreign_load_jp2k_ljust(image,
 					out->im, q, hit.width);
 			}
 
@@ -1166,7 +1408,7 @@ vips_foreign_load_jp2k_generate_tiled(VipsRegion *out,
 	 * spot is errors.
 	 */
 	if (load->fail_on >= VIPS_FAIL_ON_ERROR &&
-		jp2k->n_errors > 0)
+		g_atomic_int_get(&jp2k->n_errors) > 0)
 		return -1;
 
 	return 0;
@@ -1182,6 +1424,7 @@ vips_foreign_load_jp2k_load(VipsForeignLoad *load)
 	int tile_width;
 	int tile_height;
 	int tiles_across;
+	gboolean threaded;
 
 #ifdef DEBUG
 	printf("vips_foreign_load_jp2k_load:\n");
@@ -1198,6 +1441,7 @@ vips_foreign_load_jp2k_load(VipsForeignLoad *load)
 		tile_width = jp2k->width;
 		tile_height = jp2k->height;
 		tiles_across = 1;
+		threaded = FALSE;
 
 		if (vips_image_generate(t[0],
 				NULL, vips_foreign_load_jp2k_generate_untiled, NULL,
@@ -1210,20 +1454,25 @@ vips_foreign_load_jp2k_load(VipsForeignLoad *load)
 		tile_width = jp2k->info->tdx;
 		tile_height = jp2k->info->tdy;
 		tiles_across = jp2k->info->tw;
+		threaded = TRUE;
 
 		if (vips_image_generate(t[0],
-				NULL, vips_foreign_load_jp2k_generate_tiled, NULL,
+				vips_foreign_load_jp2k_seq_start,
+				vips_foreign_load_jp2k_generate_tiled,
+				vips_foreign_load_jp2k_seq_stop,
 				jp2k, NULL))
 			return -1;
 	}
 
 	/* Copy to out, adding a cache. Enough tiles for two complete
-	 * rows, plus 50%.
+	 * rows, plus 50%. Tiled images have a codec per thread, so they can
+	 * decode many tiles at once.
 	 */
 	if (vips_tilecache(t[0], &t[1],
 			"tile_width", tile_width,
 			"tile_height", tile_height,
 			"max_tiles", 3 * tiles_across,
+			"threaded", threaded,
 			NULL))
 		return -1;
 
@@ -1242,6 +1491,7 @@ vips_foreign_load_jp2k_class_init(VipsForeignLoadJp2kClass *class)
 	VipsForeignLoadClass *load_class = (VipsForeignLoadClass *) class;
 
 	gobject_class->dispose = vips_foreign_load_jp2k_dispose;
+	gobject_class->finalize = vips_foreign_load_jp2k_finalize;
 	gobject_class->set_property = vips_object_set_property;
 	gobject_class->get_property = vips_object_get_property;
 
@@ -1276,6 +1526,7 @@ vips_foreign_load_jp2k_class_init(VipsForeignLoadJp2kClass *class)
 static void
 vips_foreign_load_jp2k_init(VipsForeignLoadJp2k *jp2k)
 {
+	g_mutex_init(&jp2k->lock);
 }
 
 typedef struct _VipsForeignLoadJp2kFile {
@@ -2,6 +2,8 @@
  *
  * 18/3/20
  * 	- from jp2kload.c
+ * 18/10/26
+ * 	- take codec threads from the shared libvips budget while we compress
  */
 
 /*
@@ -97,6 +99,10 @@ typedef struct _VipsForeignSaveJp2k {
 	opj_cparameters_t parameters;
 	opj_image_t *image;
 
+	/* Threads reserved for the codec.
+	 */
+	int n_threads;
+
 	/* The line of tiles we are building, and the buffer we
 	 * unpack to for output.
 	 */
@@ -130,6 +136,9 @@ vips_foreign_save_jp2k_dispose(GObject *gobject)
 	VIPS_FREEF(opj_stream_destroy, jp2k->stream);
 	VIPS_FREEF(opj_image_destroy, jp2k->image);
 
+	vips__threads_release(jp2k->n_threads);
+	jp2k->n_threads = 0;
+
 	VIPS_UNREF(jp2k->target);
 	VIPS_UNREF(jp2k->strip);
 
@@ -897,7 +906,12 @@ vips_foreign_save_jp2k_build(VipsObject *object)
 	if (!opj_setup_encoder(jp2k->codec, &jp2k->parameters, jp2k->image))
 		return -1;
 
-	opj_codec_set_threads(jp2k->codec, vips_concurrency_get());
+	/* openjpeg starts its own pool of threads, so take them from the
+	 * libvips budget. The pool is made by opj_start_compress() and lasts
+	 * as long as the codec.
+	 */
+	jp2k->n_threads = vips__threads_reserve(vips_concurrency_get());
+	opj_codec_set_threads(jp2k->codec, jp2k->n_threads);
 
 	if (!(jp2k->stream = vips_foreign_save_jp2k_target(jp2k->target)))
 		return -1;
@@ -943,6 +957,13 @@ vips_foreign_save_jp2k_build(VipsObject *object)
 
 	opj_end_compress(jp2k->codec, jp2k->stream);
 
+	/* Destroying the codec stops its threads, so hand them back now, not
+	 * when we are disposed.
+	 */
+	VIPS_FREEF(opj_destroy_codec, jp2k->codec);
+	vips__threads_release(jp2k->n_threads);
+	jp2k->n_threads = 0;
+
 	if (vips_target_end(jp2k->target))
 		return -1;
 
@@ -1195,6 +1216,7 @@ typedef struct _TileCompress {
 	opj_image_t *image;
 	opj_stream_t *stream;
 	VipsPel *accumulate;
+	int n_threads;
 } TileCompress;
 
 /* Unpack from @tile within @region to the int data pointers on @image with
@@ -1316,6 +1338,9 @@ vips__foreign_save_jp2k_compress_free(TileCompress *compress)
 	VIPS_FREEF(opj_image_destroy, compress->image);
 	VIPS_FREEF(opj_stream_destroy, compress->stream);
 	VIPS_FREE(compress->accumulate);
+
+	vips__threads_release(compress->n_threads);
+	compress->n_threads = 0;
 }
 
 /* Compress area @tile within @region and write to @target as a @tile_width by
@@ -1380,8 +1405,6 @@ vips__foreign_save_jp2k_compress(VipsRegion *region,
 		return -1;
 	}
 
-	opj_codec_set_threads(compress.codec, vips_concurrency_get());
-
 	if (save_as_ycc)
 		vips_foreign_save_jp2k_rgb_to_ycc(region,
 			tile, compress.image->comps[0].prec);
@@ -1396,6 +1419,13 @@ vips__foreign_save_jp2k_compress(VipsRegion *region,
 		vips_foreign_save_jp2k_unpack_image(region,
 			tile, compress.image);
 
+	/* We're usually called from many threads at once, so only use
+	 * codec threads if there are some spare. They are held until
+	 * compress_free().
+	 */
+	compress.n_threads = vips__threads_reserve(vips_concurrency_get());
+	opj_codec_set_threads(compress.codec, compress.n_threads);
+
 	if (!(compress.stream = vips_foreign_save_jp2k_target(target))) {
 		vips__foreign_save_jp2k_compress_free(&compress);
 		return -1;
@@ -79,7 +79,7 @@ typedef struct {
 typedef struct _ReadJpeg {
 	VipsImage *out;
 
-	/* Shrink by this much during load. 1, 2, 4, 8.
+	/* Shrink by this much during load. 1, 2, 4, 8, 16, 32.
 	 */
 	int shrink;
 
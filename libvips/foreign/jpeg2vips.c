@@ -114,6 +114,9 @@
  * 	- add fail_on support
  * 2/8/22
  *      - add "unlimited"
+ * 18/10/26
+ * 	- add shrink 16 and 32: decode at 1/8 then block average, and only
+ * 	  decode the DC scan of progressive images
  */
 
 /*
@@ -534,7 +537,7 @@ read_jpeg_header(ReadJpeg *jpeg, VipsImage *out)
 	 * for YUV YCCK etc.
 	 */
 	jpeg_read_header(cinfo, TRUE);
-	cinfo->scale_denom = jpeg->shrink;
+	cinfo->scale_denom = VIPS_MIN(jpeg->shrink, 8);
 	cinfo->scale_num = 1;
 	jpeg_calc_output_dimensions(cinfo);
 
@@ -898,7 +901,11 @@ read_jpeg_image(ReadJpeg *jpeg, VipsImage *out)
 {
 	struct jpeg_decompress_struct *cinfo = &jpeg->cinfo;
 	VipsImage **t = (VipsImage **)
-		vips_object_local_array(VIPS_OBJECT(out), 5);
+		vips_object_local_array(VIPS_OBJECT(out), 6);
+
+	/* libjpeg stops at 1/8, we block average for anything more.
+	 */
+	int block_shrink = VIPS_MAX(1, jpeg->shrink / 8);
 
 	VipsImage *im;
 
@@ -917,8 +924,25 @@ read_jpeg_image(ReadJpeg *jpeg, VipsImage *out)
 	if (vips_source_decode(jpeg->source))
 		return -1;
 
+	/* At 1/8 libjpeg only uses the DC coefficients. For progressive
+	 * images these are usually all in the first scan, so for large
+	 * shrinks we can decode just that scan and skip all the AC data.
+	 * The first scan can leave off the low bits of DC, so don't do this
+	 * for shrink 8, we'd change the result.
+	 */
+	if (jpeg->shrink > 8 &&
+		cinfo->progressive_mode &&
+		cinfo->comps_in_scan == cinfo->num_components &&
+		cinfo->Ss == 0) {
+		cinfo->buffered_image = TRUE;
+		cinfo->do_block_smoothing = FALSE;
+	}
+
 	jpeg_start_decompress(cinfo);
 
+	if (cinfo->buffered_image)
+		jpeg_start_output(cinfo, 1);
+
 #ifdef DEBUG
 	printf("read_jpeg_image: starting decompress\n");
 #endif /*DEBUG*/
@@ -933,10 +957,19 @@ read_jpeg_image(ReadJpeg *jpeg, VipsImage *out)
 			"tile_height", 8,
 			NULL) ||
 		vips_extract_area(t[1], &t[2],
-			0, 0, jpeg->output_width, jpeg->output_height, NULL))
+			0, 0,
+			jpeg->output_width * block_shrink,
+			jpeg->output_height * block_shrink,
+			NULL))
 		return -1;
 	im = t[2];
 
+	if (block_shrink > 1) {
+		if (vips_shrink(im, &t[5], block_shrink, block_shrink, NULL))
+			return -1;
+		im = t[5];
+	}
+
 	if (jpeg->autorotate &&
 		vips_image_get_orientation(im) != 1) {
 		/* We have to copy to memory before calling autorot, since it
@@ -6,6 +6,8 @@
  * 	- split to make load, load from buffer and load from file
  * 24/7/21
  * 	- add fail_on support
+ * 18/10/26
+ * 	- allow shrink 16 and 32
  */
 
 /*
@@ -111,7 +113,9 @@ vips_foreign_load_jpeg_build(VipsObject *object)
 	if (jpeg->shrink != 1 &&
 		jpeg->shrink != 2 &&
 		jpeg->shrink != 4 &&
-		jpeg->shrink != 8) {
+		jpeg->shrink != 8 &&
+		jpeg->shrink != 16 &&
+		jpeg->shrink != 32) {
 		vips_error("VipsFormatLoadJpeg",
 			_("bad shrink factor %d"), jpeg->shrink);
 		return -1;
@@ -189,7 +193,7 @@ vips_foreign_load_jpeg_class_init(VipsForeignLoadJpegClass *class)
 		_("Shrink factor on load"),
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
 		G_STRUCT_OFFSET(VipsForeignLoadJpeg, shrink),
-		1, 8, 1);
+		1, 32, 1);
 
 	VIPS_ARG_BOOL(class, "autorotate", 21,
 		_("Autorotate"),
@@ -436,8 +440,10 @@ vips_foreign_load_jpeg_buffer_init(VipsForeignLoadJpegBuffer *buffer)
  * including CMYK and YCbCr.
  *
  * @shrink means shrink by this integer factor during load.  Possible values
- * are 1, 2, 4 and 8. Shrinking during read is very much faster than
- * decompressing the whole image and then shrinking later.
+ * are 1, 2, 4, 8, 16 and 32. Shrinking during read is very much faster than
+ * decompressing the whole image and then shrinking later. Shrinks of 16 and
+ * 32 decode at 1/8 and then block average. For progressive images, these
+ * only decode the first scan, which is usually all that's needed.
  *
  * Use @fail_on to set the type of error that will cause load to fail. By
  * default, loaders are permissive, that is, [enum@Vips.FailOn.NONE].
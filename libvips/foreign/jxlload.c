@@ -6,6 +6,9 @@
  * 	- reset read point for _load
  * 13/3/23 MathemanFlo
  * 	- add bits per sample metadata
+ * 18/10/26
+ * 	- run libjxl jobs in the libvips threadset
+ * 	- add "shrink", stopping single frame decode at the DC pass
  */
 
 /*
@@ -56,7 +59,6 @@
 #ifdef HAVE_LIBJXL
 
 #include <jxl/decode.h>
-#include <jxl/thread_parallel_runner.h>
 
 #include "pforeign.h"
 
@@ -66,8 +68,6 @@
  *
  * - add animation support
  *
- * - add "shrink" option to read out 8x shrunk image?
- *
  * - fix scRGB gamma
  */
 
@@ -126,7 +126,6 @@ typedef struct _VipsForeignLoadJxl {
 
 	/* Decompress state.
 	 */
-	void *runner;
 	JxlDecoder *decoder;
 
 	/* Our input buffer.
@@ -167,7 +166,6 @@ vips_foreign_load_jxl_dispose(GObject *gobject)
 	printf("vips_foreign_load_jxl_dispose:\n");
 #endif /*DEBUG*/
 
-	VIPS_FREEF(JxlThreadParallelRunnerDestroy, jxl->runner);
 	VIPS_FREEF(JxlDecoderDestroy, jxl->decoder);
 	VIPS_FREE(jxl->icc_data);
 	VIPS_FREE(jxl->exif_data);
@@ -179,6 +177,46 @@ vips_foreign_load_jxl_dispose(GObject *gobject)
 	G_OBJECT_CLASS(vips_foreign_load_jxl_parent_class)->dispose(gobject);
 }
 
+typedef struct _VipsJxlRun {
+	void *jpegxl_opaque;
+	JxlParallelRunFunction func;
+} VipsJxlRun;
+
+static void
+vips_jxl_run(void *a, guint i, int thread)
+{
+	VipsJxlRun *run = (VipsJxlRun *) a;
+
+	run->func(run->jpegxl_opaque, i, thread);
+}
+
+/* A libjxl parallel runner which uses the libvips threadset, so we don't
+ * start a set of threads for every image. This is shared with jxlsave.
+ */
+JxlParallelRetCode
+vips__jxl_parallel_runner(void *runner_opaque, void *jpegxl_opaque,
+	JxlParallelRunInit init, JxlParallelRunFunction func,
+	uint32_t start_range, uint32_t end_range)
+{
+	int n_jobs = end_range - start_range;
+	VipsJxlRun run = { jpegxl_opaque, func };
+
+	int n_threads;
+
+	n_threads = 1 +
+		vips__threads_reserve(VIPS_MIN(vips_concurrency_get(), n_jobs) - 1);
+
+	if (init(jpegxl_opaque, n_threads)) {
+		vips__threads_release(n_threads - 1);
+		return JXL_PARALLEL_RET_RUNNER_ERROR;
+	}
+
+	vips__parallel_range("jxl", n_threads,
+		start_range, end_range, vips_jxl_run, &run);
+
+	return JXL_PARALLEL_RET_SUCCESS;
+}
+
 static void
 vips_foreign_load_jxl_error(VipsForeignLoadJxl *jxl, const char *details)
 {
@@ -198,11 +236,10 @@ vips_foreign_load_jxl_build(VipsObject *object)
 	printf("vips_foreign_load_jxl_build:\n");
 #endif /*DEBUG*/
 
-	jxl->runner = JxlThreadParallelRunnerCreate(NULL, vips_concurrency_get());
 	jxl->decoder = JxlDecoderCreate(NULL);
 
 	if (JxlDecoderSetParallelRunner(jxl->decoder,
-			JxlThreadParallelRunner, jxl->runner)) {
+			vips__jxl_parallel_runner, NULL)) {
 		vips_foreign_load_jxl_error(jxl, "JxlDecoderSetParallelRunner");
 		return -1;
 	}
@@ -359,6 +396,10 @@ vips_foreign_load_jxl_print_status(JxlDecoderStatus status)
 		printf("JXL_DEC_FULL_IMAGE\n");
 		break;
 
+	case JXL_DEC_FRAME_PROGRESSION:
+		printf("JXL_DEC_FRAME_PROGRESSION\n");
+		break;
+
 	case JXL_DEC_JPEG_RECONSTRUCTION:
 		printf("JXL_DEC_JPEG_RECONSTRUCTION\n");
 		break;
@@ -582,6 +623,24 @@ vips_foreign_load_jxl_read_frame(VipsForeignLoadJxl *jxl, VipsImage *frame,
 			}
 			break;
 
+		case JXL_DEC_FRAME_PROGRESSION:
+			/* We only see these for single frame shrink-on-load. Once
+			 * there's enough detail for our shrink, render what we have
+			 * and stop. The DC pass alone is enough for shrink 8.
+			 */
+			if (jxl->frame_no >= frame_no &&
+				JxlDecoderGetIntendedDownsamplingRatio(jxl->decoder) <=
+					(size_t) jxl->shrink) {
+				if (JxlDecoderFlushImage(jxl->decoder)) {
+					vips_foreign_load_jxl_error(jxl, "JxlDecoderFlushImage");
+					return -1;
+				}
+
+				return 0;
+			}
+
+			break;
+
 		case JXL_DEC_FULL_IMAGE:
 			/* We decoded the required frame and can return
 			 */
@@ -786,8 +845,24 @@ vips_foreign_load_jxl_set_cicp(const JxlColorEncoding *enc, VipsImage *out)
 	vips_image_set_int(out, "cicp-full-range-flag", 1);
 }
 
+/* The per-axis shrink we apply. Very small images are shrunk to a single
+ * pixel.
+ */
+static void
+vips_foreign_load_jxl_get_shrink(VipsForeignLoadJxl *jxl,
+	int *hshrink, int *vshrink)
+{
+	*hshrink = VIPS_MIN(jxl->shrink, jxl->info.xsize);
+	*vshrink = VIPS_MIN(jxl->shrink, jxl->info.ysize);
+}
+
+/* Set the header for an image shrunk by hshrink x vshrink. Frames are
+ * always decoded at full size, so load uses 1, 1 for the image it decodes
+ * to.
+ */
 static int
-vips_foreign_load_jxl_set_header(VipsForeignLoadJxl *jxl, VipsImage *out)
+vips_foreign_load_jxl_set_header(VipsForeignLoadJxl *jxl, VipsImage *out,
+	int hshrink, int vshrink)
 {
 	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(jxl);
 
@@ -873,7 +948,8 @@ vips_foreign_load_jxl_set_header(VipsForeignLoadJxl *jxl, VipsImage *out)
 		vips_image_set_int(out, VIPS_META_N_PAGES, jxl->frame_count);
 
 		if (jxl->n > 1)
-			vips_image_set_int(out, VIPS_META_PAGE_HEIGHT, jxl->info.ysize);
+			vips_image_set_int(out, VIPS_META_PAGE_HEIGHT,
+				jxl->info.ysize / vshrink);
 
 		if (jxl->is_animated) {
 			int *delay = (int *) jxl->delay->data;
@@ -907,7 +983,8 @@ vips_foreign_load_jxl_set_header(VipsForeignLoadJxl *jxl, VipsImage *out)
 	}
 
 	vips_image_init_fields(out,
-		jxl->info.xsize, jxl->info.ysize * jxl->n, jxl->format.num_channels,
+		jxl->info.xsize / hshrink, (jxl->info.ysize / vshrink) * jxl->n,
+		jxl->format.num_channels,
 		format, VIPS_CODING_NONE, interpretation, 1.0, 1.0);
 
 	/* Even though this is a full image reader, we hint thinstrip since
@@ -1168,7 +1245,10 @@ vips_foreign_load_jxl_header(VipsForeignLoad *load)
 	if (vips_foreign_load_jxl_fix_exif(jxl))
 		return -1;
 
-	if (vips_foreign_load_jxl_set_header(jxl, load->out))
+	int hshrink;
+	int vshrink;
+	vips_foreign_load_jxl_get_shrink(jxl, &hshrink, &vshrink);
+	if (vips_foreign_load_jxl_set_header(jxl, load->out, hshrink, vshrink))
 		return -1;
 
 	VIPS_SETSTR(load->out->filename,
@@ -1182,16 +1262,21 @@ vips_foreign_load_jxl_load(VipsForeignLoad *load)
 {
 	VipsForeignLoadJxl *jxl = (VipsForeignLoadJxl *) load;
 	VipsImage **t = (VipsImage **)
-		vips_object_local_array(VIPS_OBJECT(load), 3);
+		vips_object_local_array(VIPS_OBJECT(load), 4);
 
+	int hshrink;
+	int vshrink;
+	int events;
 	VipsImage *out;
 
 #ifdef DEBUG
 	printf("vips_foreign_load_jxl_load:\n");
 #endif /*DEBUG*/
 
+	vips_foreign_load_jxl_get_shrink(jxl, &hshrink, &vshrink);
+
 	t[0] = vips_image_new();
-	if (vips_foreign_load_jxl_set_header(jxl, t[0]))
+	if (vips_foreign_load_jxl_set_header(jxl, t[0], 1, 1))
 		return -1;
 
 	/* We have to rewind ... we can't be certain the header
@@ -1200,14 +1285,29 @@ vips_foreign_load_jxl_load(VipsForeignLoad *load)
 	if (vips_source_rewind(jxl->source))
 		return -1;
 
+	/* For a single frame with shrink, we can ask for progressive
+	 * events and stop early, see vips_foreign_load_jxl_read_frame().
+	 * Animations need every frame fully decoded for blending.
+	 */
+	events = JXL_DEC_FRAME | JXL_DEC_FULL_IMAGE;
+	if (jxl->shrink > 1 &&
+		jxl->n == 1)
+		events |= JXL_DEC_FRAME_PROGRESSION;
+
 	JxlDecoderRewind(jxl->decoder);
-	if (JxlDecoderSubscribeEvents(jxl->decoder,
-				JXL_DEC_FRAME | JXL_DEC_FULL_IMAGE)) {
+	if (JxlDecoderSubscribeEvents(jxl->decoder, events)) {
 		vips_foreign_load_jxl_error(jxl,
 			"JxlDecoderSubscribeEvents");
 		return -1;
 	}
 
+	if ((events & JXL_DEC_FRAME_PROGRESSION) &&
+		JxlDecoderSetProgressiveDetail(jxl->decoder, kLastPasses)) {
+		vips_foreign_load_jxl_error(jxl,
+			"JxlDecoderSetProgressiveDetail");
+		return -1;
+	}
+
 	if (vips_foreign_load_jxl_fill_input(jxl, 0) < 0)
 		return -1;
 	if (JxlDecoderSetInput(jxl->decoder,
@@ -1234,6 +1334,32 @@ vips_foreign_load_jxl_load(VipsForeignLoad *load)
 		out = t[0];
 	}
 
+	if (hshrink > 1 ||
+		vshrink > 1) {
+		int width = jxl->info.xsize / hshrink;
+		int height = jxl->info.ysize / vshrink;
+		VipsImage **page = (VipsImage **)
+			vips_object_local_array(VIPS_OBJECT(load), jxl->n);
+
+		/* Trim each frame to a multiple of the shrink, then block
+		 * shrink the whole strip. This way no output pixel mixes
+		 * two frames.
+		 */
+		for (int i = 0; i < jxl->n; i++)
+			if (vips_extract_area(out, &page[i],
+					0, i * jxl->info.ysize,
+					width * hshrink, height * vshrink, NULL))
+				return -1;
+
+		if (vips_arrayjoin(page, &t[2], jxl->n, "across", 1, NULL) ||
+			vips_shrink(t[2], &t[3], hshrink, vshrink, NULL))
+			return -1;
+
+		out = t[3];
+		if (jxl->n > 1)
+			vips_image_set_int(out, VIPS_META_PAGE_HEIGHT, height);
+	}
+
 	if (vips_image_write(out, load->real))
 		return -1;
 
@@ -1283,11 +1409,19 @@ vips_foreign_load_jxl_class_init(VipsForeignLoadJxlClass *class)
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
 		G_STRUCT_OFFSET(VipsForeignLoadJxl, n),
 		-1, 100000, 1);
+
+	VIPS_ARG_INT(class, "shrink", 22,
+		_("Shrink"),
+		_("Shrink factor on load"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsForeignLoadJxl, shrink),
+		1, 8, 1);
 }
 
 static void
 vips_foreign_load_jxl_init(VipsForeignLoadJxl *jxl)
 {
+	jxl->shrink = 1;
 	jxl->n = 1;
 	jxl->delay = g_array_new(FALSE, FALSE, sizeof(int));
 }
@@ -6,6 +6,8 @@
  * 	- add ICC profile support
  * 8/5/25
  *	- write with JxlEncoderAddChunkedFrame() for lower memory use
+ * 18/10/26
+ *	- run libjxl jobs in the libvips threadset
  */
 
 /*
@@ -55,7 +57,6 @@
 #include <vips/internal.h>
 
 #include <jxl/encode.h>
-#include <jxl/thread_parallel_runner.h>
 
 #include "pforeign.h"
 
@@ -116,7 +117,6 @@ typedef struct _VipsForeignSaveJxl {
 
 	/* Encoder state.
 	 */
-	void *runner;
 	JxlEncoder *encoder;
 
 	/* Write buffer.
@@ -579,7 +579,6 @@ vips_foreign_save_jxl_finalize(GObject *gobject)
 {
 	VipsForeignSaveJxl *jxl = (VipsForeignSaveJxl *) gobject;
 
-	VIPS_FREEF(JxlThreadParallelRunnerDestroy, jxl->runner);
 	VIPS_FREEF(JxlEncoderDestroy, jxl->encoder);
 
 #ifdef HAVE_LIBJXL_0_9
@@ -1156,11 +1155,10 @@ vips_foreign_save_jxl_build(VipsObject *object)
 	if (jxl->distance == 0)
 		jxl->lossless = TRUE;
 
-	jxl->runner = JxlThreadParallelRunnerCreate(NULL, vips_concurrency_get());
 	jxl->encoder = JxlEncoderCreate(NULL);
 
 	if (JxlEncoderSetParallelRunner(jxl->encoder,
-			JxlThreadParallelRunner, jxl->runner)) {
+			vips__jxl_parallel_runner, NULL)) {
 		vips_foreign_save_jxl_error(jxl, "JxlDecoderSetParallelRunner");
 		return -1;
 	}
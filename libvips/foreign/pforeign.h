@@ -71,7 +71,7 @@ int vips__tiff_read_header_source(VipsSource *source, VipsImage *out,
 	gboolean unlimited);
 int vips__tiff_read_source(VipsSource *source, VipsImage *out,
 	int page, int n, gboolean autorotate, int subifd, VipsFailOn fail_on,
-	gboolean unlimited);
+	gboolean unlimited, int readahead);
 
 extern const char *vips__foreign_tiff_suffs[];
 
@@ -207,6 +207,14 @@ int vips__foreign_save_jp2k_compress(VipsRegion *region,
 
 extern const char *vips__jxl_suffs[];
 
+#ifdef HAVE_LIBJXL
+#include <jxl/parallel_runner.h>
+
+JxlParallelRetCode vips__jxl_parallel_runner(void *runner_opaque,
+	void *jpegxl_opaque, JxlParallelRunInit init,
+	JxlParallelRunFunction func, uint32_t start_range, uint32_t end_range);
+#endif /*HAVE_LIBJXL*/
+
 struct _VipsArchive;
 typedef struct _VipsArchive VipsArchive;
 void vips__archive_free(VipsArchive *archive);
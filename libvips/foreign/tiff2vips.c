@@ -213,6 +213,11 @@
  *  - fix demand hinting
  * 3/2/23 MathemanFlo
  * 	- add bits per sample metadata
+ * 18/10/26
+ * 	- read the raw tiles of the next tile row ahead in the background
+ * 	- decompress LZW, deflate, zstd and webp tiles and strips outside the
+ * 	  lock
+ * 	- record page and subifd sizes as metadata
  */
 
 /*
@@ -271,6 +276,20 @@
 #include "jpeg.h"
 #endif /*HAVE_JPEG*/
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif /*HAVE_ZLIB*/
+
+#if defined(HAVE_ZSTD) && defined(COMPRESSION_ZSTD)
+#define RTIFF_ZSTD
+#include <zstd.h>
+#endif /*defined(HAVE_ZSTD) && defined(COMPRESSION_ZSTD)*/
+
+#if defined(HAVE_LIBWEBP) && defined(COMPRESSION_WEBP)
+#define RTIFF_WEBP
+#include <webp/decode.h>
+#endif /*defined(HAVE_LIBWEBP) && defined(COMPRESSION_WEBP)*/
+
 /* Compression types we handle ourselves.
  */
 static int rtiff_we_decompress[] = {
@@ -279,9 +298,48 @@ static int rtiff_we_decompress[] = {
 #endif /*HAVE_JPEG*/
 	JP2K_YCC,
 	JP2K_RGB,
-	JP2K_LOSSY
+	JP2K_LOSSY,
+	COMPRESSION_LZW,
+#ifdef HAVE_ZLIB
+	COMPRESSION_ADOBE_DEFLATE,
+	COMPRESSION_DEFLATE,
+#endif /*HAVE_ZLIB*/
+#ifdef RTIFF_ZSTD
+	COMPRESSION_ZSTD,
+#endif /*RTIFF_ZSTD*/
+#ifdef RTIFF_WEBP
+	COMPRESSION_WEBP,
+#endif /*RTIFF_WEBP*/
 };
 
+/* Strips up to this size can be read with the tile reader.
+ */
+#define RTIFF_MAX_TILED_STRIP_SIZE (4 * 1024 * 1024)
+
+/* The general purpose codecs we decompress with rtiff_decompress_codec().
+ */
+static gboolean
+rtiff_is_codec(int compression)
+{
+	switch (compression) {
+	case COMPRESSION_LZW:
+#ifdef HAVE_ZLIB
+	case COMPRESSION_ADOBE_DEFLATE:
+	case COMPRESSION_DEFLATE:
+#endif /*HAVE_ZLIB*/
+#ifdef RTIFF_ZSTD
+	case COMPRESSION_ZSTD:
+#endif /*RTIFF_ZSTD*/
+#ifdef RTIFF_WEBP
+	case COMPRESSION_WEBP:
+#endif /*RTIFF_WEBP*/
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
+
 /* What we read from the tiff dir to set our read strategy. For multipage
  * read, we need to read and compare lots of these, so it needs to be broken
  * out as a separate thing.
@@ -303,6 +361,12 @@ typedef struct _RtiffHeader {
 	int alpha_band;
 	guint16 compression;
 
+	/* TIFFTAG_PREDICTOR, and TRUE if samples need byte swapping after
+	 * decompression.
+	 */
+	int predictor;
+	gboolean byte_swapped;
+
 	/* Is this directory tiled.
 	 */
 	gboolean tiled;
@@ -349,6 +413,12 @@ typedef struct _RtiffHeader {
 	 */
 	gboolean we_decompress;
 
+	/* TRUE for a strip image we read with the tile reader, so strips can
+	 * be decompressed in parallel. The tile fields are set to the strip
+	 * geometry.
+	 */
+	gboolean tiled_strips;
+
 	/* TRUE if we use TIFFRGBAImage or TIFFReadRGBATile.
 	 * Used for COMPRESSION_OJPEG
 	 */
@@ -356,6 +426,32 @@ typedef struct _RtiffHeader {
 
 } RtiffHeader;
 
+/* We record the size of each page and subifd for files with up to this many,
+ * so pyramid detection doesn't need to open every level.
+ */
+#define RTIFF_MAX_SIZES (64)
+
+/* A row of raw tiles read ahead of the workers.
+ */
+typedef struct _RtiffAhead {
+	/* The page and tile row held here, page is -1 for an empty slot.
+	 */
+	int page;
+	int row;
+
+	/* Tiles first to first + n - 1 are held. strile has the file offset
+	 * and byte count of each one.
+	 */
+	guint32 first;
+	int n;
+	toff_t *strile;
+
+	/* The raw bytes, from file offset onwards.
+	 */
+	toff_t offset;
+	VipsPel *buf;
+} RtiffAhead;
+
 /* Scanline-type process function.
  */
 struct _Rtiff;
@@ -388,6 +484,14 @@ typedef struct _Rtiff {
 	 */
 	int n_pages;
 
+	/* Width and height of each page, and of each subifd of the selected
+	 * page. Zero sizes if there are too many to record.
+	 */
+	int n_page_sizes;
+	int page_sizes[2 * RTIFF_MAX_SIZES];
+	int n_subifd_sizes;
+	int subifd_sizes[2 * RTIFF_MAX_SIZES];
+
 	/* The current page we have set.
 	 */
 	int current_page;
@@ -422,6 +526,28 @@ typedef struct _Rtiff {
 	/* Stop processing due to an error or warning.
 	 */
 	gboolean failed;
+
+	/* Max bytes of raw tile data to hold in read-ahead, 0 to disable.
+	 */
+	int readahead;
+
+	/* When we decompress tiles ourselves, the first request for a tile
+	 * in a row starts a background read of the raw tiles of the next
+	 * row, so I/O for that row overlaps with decode of this one. Each of
+	 * the two slots holds at most half of @readahead bytes.
+	 *
+	 * Everything here is protected by ahead_lock. The background read
+	 * runs while ahead_busy is set and fetches the row in ahead_want,
+	 * ahead_cond is signalled when it stops.
+	 */
+	GMutex ahead_lock;
+	GCond ahead_cond;
+	RtiffAhead ahead[2];
+	gboolean ahead_busy;
+	int ahead_want_page;
+	int ahead_want_row;
+	int ahead_done_page;
+	int ahead_done_row;
 } Rtiff;
 
 /* Convert IEEE 754-2008 16-bit float to 32-bit float
@@ -586,7 +712,24 @@ get_orientation(TIFF *tiff)
 static void
 rtiff_free(Rtiff *rtiff)
 {
+	int i;
+
+	/* Wait for any background read to finish.
+	 */
+	g_mutex_lock(&rtiff->ahead_lock);
+	while (rtiff->ahead_busy)
+		g_cond_wait(&rtiff->ahead_cond, &rtiff->ahead_lock);
+	g_mutex_unlock(&rtiff->ahead_lock);
+
+	for (i = 0; i < VIPS_NUMBER(rtiff->ahead); i++) {
+		VIPS_FREE(rtiff->ahead[i].strile);
+		VIPS_FREE(rtiff->ahead[i].buf);
+		rtiff->ahead[i].page = -1;
+	}
+
 	VIPS_FREEF(TIFFClose, rtiff->tiff);
+	g_mutex_clear(&rtiff->ahead_lock);
+	g_cond_clear(&rtiff->ahead_cond);
 	g_rec_mutex_clear(&rtiff->lock);
 	VIPS_UNREF(rtiff->source);
 }
@@ -604,6 +747,7 @@ rtiff_minimise_cb(VipsImage *image, Rtiff *rtiff)
 	 * threads, and this minimise handler is not inside the lock.
 	 */
 	if (!rtiff->header.tiled &&
+		!rtiff->header.tiled_strips &&
 		rtiff->source)
 		vips_source_minimise(rtiff->source);
 }
@@ -648,9 +792,10 @@ rtiff_handler_warning(TIFF *tiff, void *user_data,
 static Rtiff *
 rtiff_new(VipsSource *source, VipsImage *out,
 	int page, int n, gboolean autorotate, int subifd, VipsFailOn fail_on,
-	gboolean unlimited)
+	gboolean unlimited, int readahead)
 {
 	Rtiff *rtiff;
+	int i;
 
 	if (!(rtiff = VIPS_NEW(out, Rtiff)))
 		return NULL;
@@ -666,6 +811,8 @@ rtiff_new(VipsSource *source, VipsImage *out,
 	g_rec_mutex_init(&rtiff->lock);
 	rtiff->tiff = NULL;
 	rtiff->n_pages = 0;
+	rtiff->n_page_sizes = 0;
+	rtiff->n_subifd_sizes = 0;
 	rtiff->current_page = -1;
 	rtiff->sfn = NULL;
 	rtiff->client = NULL;
@@ -674,6 +821,19 @@ rtiff_new(VipsSource *source, VipsImage *out,
 	rtiff->contig_buf = NULL;
 	rtiff->y_pos = 0;
 	rtiff->failed = FALSE;
+	rtiff->readahead = readahead;
+	g_mutex_init(&rtiff->ahead_lock);
+	g_cond_init(&rtiff->ahead_cond);
+	for (i = 0; i < VIPS_NUMBER(rtiff->ahead); i++) {
+		rtiff->ahead[i].page = -1;
+		rtiff->ahead[i].strile = NULL;
+		rtiff->ahead[i].buf = NULL;
+	}
+	rtiff->ahead_busy = FALSE;
+	rtiff->ahead_want_page = -1;
+	rtiff->ahead_want_row = -1;
+	rtiff->ahead_done_page = -1;
+	rtiff->ahead_done_row = -1;
 
 	g_signal_connect(out, "close",
 		G_CALLBACK(rtiff_close_cb), rtiff);
@@ -844,6 +1004,24 @@ rtiff_set_page(Rtiff *rtiff, int page)
 	return 0;
 }
 
+/* Get the width and height of the current directory.
+ */
+static void
+rtiff_get_size(Rtiff *rtiff, int *size)
+{
+	guint32 width;
+	guint32 height;
+
+	if (!TIFFGetField(rtiff->tiff, TIFFTAG_IMAGEWIDTH, &width) ||
+		!TIFFGetField(rtiff->tiff, TIFFTAG_IMAGELENGTH, &height))
+		width = height = 0;
+
+	size[0] = VIPS_MIN(width, G_MAXINT);
+	size[1] = VIPS_MIN(height, G_MAXINT);
+}
+
+/* Count pages, and note the size of each while we pass.
+ */
 static int
 rtiff_n_pages(Rtiff *rtiff)
 {
@@ -851,8 +1029,14 @@ rtiff_n_pages(Rtiff *rtiff)
 
 	(void) TIFFSetDirectory(rtiff->tiff, 0);
 
-	for (n = 1; TIFFReadDirectory(rtiff->tiff); n++)
-		;
+	n = 0;
+	do {
+		if (n < RTIFF_MAX_SIZES)
+			rtiff_get_size(rtiff, &rtiff->page_sizes[2 * n]);
+		n += 1;
+	} while (TIFFReadDirectory(rtiff->tiff));
+
+	rtiff->n_page_sizes = n <= RTIFF_MAX_SIZES ? n : 0;
 
 	/* Make sure the nest set_page() will set the directory.
 	 */
@@ -865,6 +1049,49 @@ rtiff_n_pages(Rtiff *rtiff)
 	return n;
 }
 
+/* Note the size of each subifd in the selected page. No error if we can't,
+ * we just won't set the metadata.
+ */
+static void
+rtiff_subifd_sizes(Rtiff *rtiff)
+{
+	guint16 subifd_count;
+	toff_t *subifd_offsets;
+	toff_t offsets[RTIFF_MAX_SIZES];
+	gboolean failed;
+	int i;
+
+	rtiff->n_subifd_sizes = 0;
+
+	if (!TIFFSetDirectory(rtiff->tiff, rtiff->page) ||
+		!TIFFGetField(rtiff->tiff, TIFFTAG_SUBIFD,
+			&subifd_count, &subifd_offsets) ||
+		subifd_count > RTIFF_MAX_SIZES)
+		return;
+
+	/* The offset array belongs to the directory, so we must copy it before
+	 * we move away.
+	 */
+	memcpy(offsets, subifd_offsets, subifd_count * sizeof(toff_t));
+
+	/* A damaged subifd shouldn't fail the page we're loading.
+	 */
+	failed = rtiff->failed;
+	for (i = 0; i < subifd_count; i++) {
+		if (!TIFFSetSubDirectory(rtiff->tiff, offsets[i]))
+			break;
+		rtiff_get_size(rtiff, &rtiff->subifd_sizes[2 * i]);
+	}
+	rtiff->failed = failed;
+
+	if (i == subifd_count)
+		rtiff->n_subifd_sizes = subifd_count;
+
+	/* Make sure the next set_page() will set the directory.
+	 */
+	rtiff->current_page = -1;
+}
+
 static int
 rtiff_check_samples(Rtiff *rtiff, int samples_per_pixel)
 {
@@ -1878,6 +2105,13 @@ rtiff_set_header(Rtiff *rtiff, VipsImage *out)
 
 	vips_image_set_int(out, VIPS_META_N_PAGES, rtiff->n_pages);
 
+	if (rtiff->n_page_sizes > 0)
+		vips_image_set_array_int(out, VIPS_META_PAGE_SIZES,
+			rtiff->page_sizes, 2 * rtiff->n_page_sizes);
+	if (rtiff->n_subifd_sizes > 0)
+		vips_image_set_array_int(out, VIPS_META_SUBIFD_SIZES,
+			rtiff->subifd_sizes, 2 * rtiff->n_subifd_sizes);
+
 	/* We have a range of output paths. Look at the tiff header and try to
 	 * route the input image to the best output path.
 	 */
@@ -1936,10 +2170,14 @@ rtiff_set_header(Rtiff *rtiff, VipsImage *out)
 
 	/* Hint smalltile for tiled images, since we may be decompressing
 	 * outside the lock and THINSTRIP would prevent parallel tile decode.
+	 * Strips we decompress ourselves are full width, so ask for fatstrip
+	 * to get a different strip to each thread.
 	 */
 	vips_image_pipelinev(out,
 		rtiff->header.tiled ?
-			VIPS_DEMAND_STYLE_SMALLTILE : VIPS_DEMAND_STYLE_THINSTRIP,
+			VIPS_DEMAND_STYLE_SMALLTILE :
+			rtiff->header.tiled_strips ?
+				VIPS_DEMAND_STYLE_FATSTRIP : VIPS_DEMAND_STYLE_THINSTRIP,
 		NULL);
 
 	return 0;
@@ -2240,8 +2478,371 @@ rtiff_decompress_jpeg(Rtiff *rtiff, void *data, size_t data_len, void *out)
 }
 #endif /*HAVE_JPEG*/
 
+/* TIFF LZW, as written by libtiff. Codes are MSB first and the code width
+ * changes one code early. Old-style "compat" LZW is LSB first with no early
+ * change.
+ */
+#define RTIFF_LZW_CLEAR (256)
+#define RTIFF_LZW_EOI (257)
+#define RTIFF_LZW_FIRST (258)
+#define RTIFF_LZW_MAX_BITS (12)
+#define RTIFF_LZW_TABLE_SIZE (1 << RTIFF_LZW_MAX_BITS)
+
+typedef struct _RtiffLzwCode {
+	guint16 prefix;
+	guint16 length;
+	VipsPel suffix;
+	VipsPel first;
+} RtiffLzwCode;
+
+/* Decompress LZW data. libtiff's decoder is internal, so we need our own to
+ * be able to run outside the lock.
+ *
+ * Return the number of bytes written to out, or -1 for a corrupt stream.
+ */
+static gint64
+rtiff_decompress_lzw(VipsPel *in, size_t in_length,
+	VipsPel *out, size_t out_length)
+{
+	gboolean compat = in_length >= 2 && in[0] == 0 && (in[1] & 0x1);
+	int early = compat ? 0 : 1;
+
+	RtiffLzwCode *table;
+	size_t in_pos;
+	size_t out_pos;
+	guint32 bits;
+	int n_bits;
+	int width;
+	int next;
+	int old;
+	int i;
+
+	if (!(table = VIPS_ARRAY(NULL, RTIFF_LZW_TABLE_SIZE, RtiffLzwCode)))
+		return -1;
+	for (i = 0; i < 256; i++) {
+		table[i].prefix = 0;
+		table[i].length = 1;
+		table[i].suffix = i;
+		table[i].first = i;
+	}
+
+	in_pos = 0;
+	out_pos = 0;
+	bits = 0;
+	n_bits = 0;
+	width = 9;
+	next = RTIFF_LZW_FIRST;
+	old = -1;
+
+	while (out_pos < out_length) {
+		int code;
+		size_t p;
+		int c;
+
+		while (n_bits < width) {
+			if (in_pos >= in_length)
+				break;
+
+			if (compat)
+				bits |= (guint32) in[in_pos++] << n_bits;
+			else
+				bits = (bits << 8) | in[in_pos++];
+			n_bits += 8;
+		}
+		if (n_bits < width)
+			break;
+
+		if (compat) {
+			code = bits & ((1 << width) - 1);
+			bits >>= width;
+		}
+		else {
+			code = (bits >> (n_bits - width)) & ((1 << width) - 1);
+			bits &= (1 << (n_bits - width)) - 1;
+		}
+		n_bits -= width;
+
+		if (code == RTIFF_LZW_EOI)
+			break;
+
+		if (code == RTIFF_LZW_CLEAR) {
+			width = 9;
+			next = RTIFF_LZW_FIRST;
+			old = -1;
+			continue;
+		}
+
+		if (old != -1 &&
+			next < RTIFF_LZW_TABLE_SIZE &&
+			code <= next) {
+			/* code == next is the KwKwK case, the new string is the old
+			 * string plus its own first byte.
+			 */
+			table[next].prefix = old;
+			table[next].length = table[old].length + 1;
+			table[next].suffix =
+				code == next ? table[old].first : table[code].first;
+			table[next].first = table[old].first;
+			next += 1;
+
+			if (next + early >= (1 << width) &&
+				width < RTIFF_LZW_MAX_BITS)
+				width += 1;
+		}
+
+		if (code >= next) {
+			g_free(table);
+			return -1;
+		}
+
+		/* Strings are stored backwards. Write from the end, clipping
+		 * against the end of the output.
+		 */
+		p = out_pos + table[code].length;
+		for (c = code;; c = table[c].prefix) {
+			p -= 1;
+			if (p < out_length)
+				out[p] = table[c].suffix;
+			if (table[c].length == 1)
+				break;
+		}
+		out_pos += table[code].length;
+
+		old = code;
+	}
+
+	g_free(table);
+
+	return VIPS_MIN(out_pos, out_length);
+}
+
+#ifdef HAVE_ZLIB
+static gint64
+rtiff_decompress_deflate(VipsPel *in, size_t in_length,
+	VipsPel *out, size_t out_length)
+{
+	z_stream stream = { 0 };
+	int result;
+
+	if (inflateInit(&stream) != Z_OK)
+		return -1;
+
+	stream.next_in = in;
+	stream.avail_in = in_length;
+	stream.next_out = out;
+	stream.avail_out = out_length;
+	result = inflate(&stream, Z_FINISH);
+	inflateEnd(&stream);
+
+	/* Z_BUF_ERROR means we ran out of input or output, the caller checks
+	 * the length.
+	 */
+	if (result != Z_STREAM_END &&
+		result != Z_OK &&
+		result != Z_BUF_ERROR)
+		return -1;
+
+	return out_length - stream.avail_out;
+}
+#endif /*HAVE_ZLIB*/
+
+#ifdef RTIFF_ZSTD
+static gint64
+rtiff_decompress_zstd(VipsPel *in, size_t in_length,
+	VipsPel *out, size_t out_length)
+{
+	size_t result;
+
+	result = ZSTD_decompress(out, out_length, in, in_length);
+	if (ZSTD_isError(result))
+		return -1;
+
+	return result;
+}
+#endif /*RTIFF_ZSTD*/
+
+#ifdef RTIFF_WEBP
+/* Each tile or strip is a complete webp image.
+ */
+static gint64
+rtiff_decompress_webp(Rtiff *rtiff, VipsPel *in, size_t in_length,
+	VipsPel *out, size_t out_length)
+{
+	size_t row_size = rtiff->header.tile_row_size;
+
+	int width;
+	int height;
+	VipsPel *result;
+
+	if (!WebPGetInfo(in, in_length, &width, &height) ||
+		width != rtiff->header.tile_width ||
+		(size_t) height * row_size > out_length)
+		return -1;
+
+	if (rtiff->header.samples_per_pixel == 4)
+		result = WebPDecodeRGBAInto(in, in_length,
+			out, out_length, row_size);
+	else
+		result = WebPDecodeRGBInto(in, in_length,
+			out, out_length, row_size);
+	if (!result)
+		return -1;
+
+	return (size_t) height * row_size;
+}
+#endif /*RTIFF_WEBP*/
+
+#define RTIFF_HORIZONTAL_ACC(TYPE) \
+	{ \
+		TYPE *p = (TYPE *) row; \
+\
+		for (x = spp; x < n; x++) \
+			p[x] += p[x - spp]; \
+	}
+
+/* Undo a TIFF predictor, one row at a time.
+ */
 static int
-rtiff_decompress_tile(Rtiff *rtiff, tdata_t *in, tsize_t size, tdata_t *out)
+rtiff_predictor_undo(Rtiff *rtiff, VipsPel *buf, size_t length)
+{
+	int spp = rtiff->header.samples_per_pixel;
+	int bytes_per_sample = rtiff->header.bits_per_sample >> 3;
+	size_t row_size = rtiff->header.tile_row_size;
+	int n = row_size / bytes_per_sample;
+	int height = length / row_size;
+
+	VipsPel *tmp;
+	VipsPel *row;
+	size_t i;
+	int x, y, b;
+
+	if (rtiff->header.predictor == PREDICTOR_HORIZONTAL) {
+		for (y = 0; y < height; y++) {
+			row = buf + y * row_size;
+
+			switch (bytes_per_sample) {
+			case 1:
+				RTIFF_HORIZONTAL_ACC(guchar);
+				break;
+
+			case 2:
+				RTIFF_HORIZONTAL_ACC(guint16);
+				break;
+
+			case 4:
+				RTIFF_HORIZONTAL_ACC(guint32);
+				break;
+
+			default:
+				g_assert_not_reached();
+				break;
+			}
+		}
+	}
+	else if (rtiff->header.predictor == PREDICTOR_FLOATINGPOINT) {
+		/* Bytes are differenced, then stored as a plane of most
+		 * significant bytes, then the next most significant, and so on.
+		 */
+		if (!(tmp = vips_malloc(NULL, row_size)))
+			return -1;
+
+		for (y = 0; y < height; y++) {
+			row = buf + y * row_size;
+
+			for (i = spp; i < row_size; i++)
+				row[i] += row[i - spp];
+
+			memcpy(tmp, row, row_size);
+			for (x = 0; x < n; x++)
+				for (b = 0; b < bytes_per_sample; b++)
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+					row[bytes_per_sample * x + b] = tmp[b * n + x];
+#else
+					row[bytes_per_sample * x + b] =
+						tmp[(bytes_per_sample - b - 1) * n + x];
+#endif
+		}
+
+		g_free(tmp);
+	}
+
+	return 0;
+}
+
+/* Decompress one of the general purpose codecs, then fix byte order and undo
+ * any predictor.
+ */
+static int
+rtiff_decompress_codec(Rtiff *rtiff, VipsPel *in, size_t in_length,
+	VipsPel *out, size_t out_length)
+{
+	gint64 length;
+
+	switch (rtiff->header.compression) {
+	case COMPRESSION_LZW:
+		length = rtiff_decompress_lzw(in, in_length, out, out_length);
+		break;
+
+#ifdef HAVE_ZLIB
+	case COMPRESSION_ADOBE_DEFLATE:
+	case COMPRESSION_DEFLATE:
+		length = rtiff_decompress_deflate(in, in_length, out, out_length);
+		break;
+#endif /*HAVE_ZLIB*/
+
+#ifdef RTIFF_ZSTD
+	case COMPRESSION_ZSTD:
+		length = rtiff_decompress_zstd(in, in_length, out, out_length);
+		break;
+#endif /*RTIFF_ZSTD*/
+
+#ifdef RTIFF_WEBP
+	case COMPRESSION_WEBP:
+		length = rtiff_decompress_webp(rtiff,
+			in, in_length, out, out_length);
+		break;
+#endif /*RTIFF_WEBP*/
+
+	default:
+		g_assert_not_reached();
+		length = -1;
+		break;
+	}
+
+	/* Short or damaged data fails for any fail_on level. With the
+	 * default of none we zero-fill the rest of the tile and warn, so
+	 * the damaged area is obvious.
+	 */
+	if (length < (gint64) out_length) {
+		if (rtiff->fail_on >= VIPS_FAIL_ON_TRUNCATED) {
+			vips_error("tiff2vips", "%s", _("truncated or damaged tile"));
+			return -1;
+		}
+
+		length = VIPS_MAX(0, length);
+		memset(out + length, 0, out_length - length);
+
+		g_warning("%s", _("truncated or damaged tile"));
+	}
+
+	if (rtiff->header.byte_swapped &&
+		rtiff->header.predictor != PREDICTOR_FLOATINGPOINT) {
+		if (rtiff->header.bits_per_sample == 16)
+			TIFFSwabArrayOfShort((guint16 *) out, out_length / 2);
+		else if (rtiff->header.bits_per_sample == 32)
+			TIFFSwabArrayOfLong((guint32 *) out, out_length / 4);
+	}
+
+	if (rtiff->header.predictor != PREDICTOR_NONE &&
+		rtiff_predictor_undo(rtiff, out, out_length))
+		return -1;
+
+	return 0;
+}
+
+static int
+rtiff_decompress_tile(Rtiff *rtiff,
+	tdata_t *in, tsize_t size, tdata_t *out, tsize_t out_length)
 {
 	g_assert(rtiff->header.we_decompress);
 
@@ -2267,7 +2868,9 @@ rtiff_decompress_tile(Rtiff *rtiff, tdata_t *in, tsize_t size, tdata_t *out)
 #endif /*HAVE_JPEG*/
 
 	default:
-		g_assert_not_reached();
+		if (rtiff_decompress_codec(rtiff,
+				(VipsPel *) in, size, (VipsPel *) out, out_length))
+			return -1;
 		break;
 	}
 
@@ -2303,6 +2906,337 @@ rtiff_read_rgba_tile(Rtiff *rtiff, int x, int y, tdata_t *buf)
 	return 0;
 }
 
+/* Tiles closer together than this in the file are read ahead with a single
+ * read, the bytes in between are just skipped.
+ */
+#define RTIFF_AHEAD_GAP (16 * 1024)
+
+/* Read exactly length bytes at offset from the source.
+ */
+static int
+rtiff_read_source_range(Rtiff *rtiff, toff_t offset, VipsPel *buf,
+	tsize_t length)
+{
+	if (vips_source_seek(rtiff->source, offset, SEEK_SET) < 0)
+		return -1;
+
+	while (length > 0) {
+		gint64 bytes_read;
+
+		bytes_read = vips_source_read(rtiff->source, buf, length);
+		if (bytes_read <= 0)
+			return -1;
+
+		buf += bytes_read;
+		length -= bytes_read;
+	}
+
+	return 0;
+}
+
+/* Look up the file offset and byte count of a tile on the current page.
+ * Call with the lock held.
+ *
+ * With TIFFGetStrileOffset() we never force libtiff to load the whole
+ * offset and byte count arrays. Before libtiff 4.1, the arrays are loaded
+ * with the directory anyway.
+ */
+static gboolean
+rtiff_strile(Rtiff *rtiff, guint32 tile_no, toff_t *offset, toff_t *size)
+{
+	guint32 n_tiles = rtiff->header.tiled
+		? TIFFNumberOfTiles(rtiff->tiff)
+		: TIFFNumberOfStrips(rtiff->tiff);
+
+	if (tile_no >= n_tiles)
+		return FALSE;
+
+#ifdef HAVE_TIFF_GET_STRILE_OFFSET
+	*offset = TIFFGetStrileOffset(rtiff->tiff, tile_no);
+	*size = TIFFGetStrileByteCount(rtiff->tiff, tile_no);
+#else  /*!HAVE_TIFF_GET_STRILE_OFFSET*/
+	toff_t *offsets;
+	toff_t *sizes;
+
+	if (!TIFFGetField(rtiff->tiff, rtiff->header.tiled ?
+				TIFFTAG_TILEOFFSETS : TIFFTAG_STRIPOFFSETS,
+			&offsets) ||
+		!TIFFGetField(rtiff->tiff, rtiff->header.tiled ?
+				TIFFTAG_TILEBYTECOUNTS : TIFFTAG_STRIPBYTECOUNTS,
+			&sizes))
+		return FALSE;
+	*offset = offsets[tile_no];
+	*size = sizes[tile_no];
+#endif /*HAVE_TIFF_GET_STRILE_OFFSET*/
+
+	return *offset != 0 &&
+		*size != 0 &&
+		*offset + *size > *offset;
+}
+
+/* Read a raw tile, or a raw strip if we are reading strips as tiles.
+ */
+static tsize_t
+rtiff_read_raw(Rtiff *rtiff, guint32 tile_no, tdata_t buf, tsize_t buf_length)
+{
+	if (rtiff->header.tiled)
+		return TIFFReadRawTile(rtiff->tiff, tile_no, buf, buf_length);
+	else
+		return TIFFReadRawStrip(rtiff->tiff, tile_no, buf, buf_length);
+}
+
+/* Tiles (or strips) across a page, and the number of tile rows.
+ */
+static int
+rtiff_tiles_across(Rtiff *rtiff)
+{
+	return VIPS_ROUND_UP(rtiff->header.width, rtiff->header.tile_width) /
+		rtiff->header.tile_width;
+}
+
+static int
+rtiff_tiles_down(Rtiff *rtiff)
+{
+	return VIPS_ROUND_UP(rtiff->header.height, rtiff->header.tile_height) /
+		rtiff->header.tile_height;
+}
+
+/* Copy a raw tile out of read-ahead. Call with ahead_lock held. Return the
+ * size of the tile, or 0 if it's not there.
+ */
+static tsize_t
+rtiff_ahead_get(Rtiff *rtiff, int page, guint32 tile_no,
+	tdata_t buf, tsize_t buf_length)
+{
+	int i;
+
+	for (i = 0; i < VIPS_NUMBER(rtiff->ahead); i++) {
+		RtiffAhead *ahead = &rtiff->ahead[i];
+
+		if (ahead->page == page &&
+			tile_no >= ahead->first &&
+			tile_no < ahead->first + ahead->n) {
+			toff_t offset = ahead->strile[2 * (tile_no - ahead->first)];
+			toff_t size = ahead->strile[2 * (tile_no - ahead->first) + 1];
+
+			if (size > (toff_t) buf_length)
+				return 0;
+
+#ifdef DEBUG_VERBOSE
+			printf("rtiff_ahead_get: tile %u from read-ahead\n", tile_no);
+#endif /*DEBUG_VERBOSE*/
+
+			memcpy(buf, ahead->buf + (offset - ahead->offset), size);
+
+			return size;
+		}
+	}
+
+	return 0;
+}
+
+/* Read the raw tiles of a row into a new slot. Call with the lock held and
+ * the page set.
+ *
+ * We take the run of tiles from the start of the row which are packed
+ * together in the file, up to half of rtiff->readahead bytes. Tiles past
+ * the end of the run are left for the workers to read.
+ */
+static void
+rtiff_ahead_read(Rtiff *rtiff, int page, int row, RtiffAhead *ahead)
+{
+	int tiles_across = rtiff_tiles_across(rtiff);
+	toff_t limit = rtiff->readahead / 2;
+
+	toff_t start;
+	toff_t end;
+	int n;
+
+	ahead->page = -1;
+	ahead->first = (guint32) row * tiles_across;
+	if (!(ahead->strile = VIPS_ARRAY(NULL, 2 * tiles_across, toff_t)))
+		return;
+
+	start = 0;
+	end = 0;
+	for (n = 0; n < tiles_across; n++) {
+		toff_t offset;
+		toff_t size;
+
+		if (!rtiff_strile(rtiff, ahead->first + n, &offset, &size) ||
+			(n > 0 &&
+				(offset < end ||
+					offset - end > RTIFF_AHEAD_GAP)) ||
+			offset + size - (n > 0 ? start : offset) > limit)
+			break;
+
+		if (n == 0)
+			start = offset;
+		end = offset + size;
+		ahead->strile[2 * n] = offset;
+		ahead->strile[2 * n + 1] = size;
+	}
+	if (n == 0)
+		return;
+
+#ifdef DEBUG_VERBOSE
+	printf("rtiff_ahead_read: page %d, row %d, %d tiles, %" G_GUINT64_FORMAT
+		   " bytes\n",
+		page, row, n, (guint64) (end - start));
+#endif /*DEBUG_VERBOSE*/
+
+	/* A short read (truncated file?) leaves the tiles to the workers, so
+	 * they get the same errors as without read-ahead.
+	 */
+	if (!(ahead->buf = vips_malloc(NULL, end - start)) ||
+		rtiff_read_source_range(rtiff, start, ahead->buf, end - start))
+		return;
+
+	ahead->page = page;
+	ahead->row = row;
+	ahead->n = n;
+	ahead->offset = start;
+}
+
+/* The background read. Fetch rows until we've done the last one asked for.
+ */
+static void
+rtiff_ahead_work(void *data, void *user_data)
+{
+	Rtiff *rtiff = (Rtiff *) data;
+
+	g_mutex_lock(&rtiff->ahead_lock);
+
+	while (rtiff->ahead_done_page != rtiff->ahead_want_page ||
+		rtiff->ahead_done_row != rtiff->ahead_want_row) {
+		int page = rtiff->ahead_want_page;
+		int row = rtiff->ahead_want_row;
+		RtiffAhead ahead = { 0 };
+
+		ahead.page = -1;
+
+		rtiff->ahead_done_page = page;
+		rtiff->ahead_done_row = row;
+
+		g_mutex_unlock(&rtiff->ahead_lock);
+
+		/* libtiff and the source are shared with the workers.
+		 */
+		g_rec_mutex_lock(&rtiff->lock);
+		if (!rtiff_set_page(rtiff, page))
+			rtiff_ahead_read(rtiff, page, row, &ahead);
+
+		g_mutex_lock(&rtiff->ahead_lock);
+
+		/* Replace the slot which isn't holding the row before this
+		 * one, since workers are probably still using that. We publish
+		 * before we drop the lock, so workers that queued on it for
+		 * a tile in this row will find it.
+		 */
+		if (ahead.page != -1) {
+			RtiffAhead *slot =
+				rtiff->ahead[0].page == page &&
+					rtiff->ahead[0].row == row - 1
+				? &rtiff->ahead[1]
+				: &rtiff->ahead[0];
+
+			VIPS_FREE(slot->strile);
+			VIPS_FREE(slot->buf);
+			*slot = ahead;
+		}
+		else {
+			VIPS_FREE(ahead.strile);
+			VIPS_FREE(ahead.buf);
+		}
+
+		g_rec_mutex_unlock(&rtiff->lock);
+	}
+
+	rtiff->ahead_busy = FALSE;
+	g_cond_broadcast(&rtiff->ahead_cond);
+
+	g_mutex_unlock(&rtiff->ahead_lock);
+}
+
+/* Ask for a row to be read ahead. Call with ahead_lock held.
+ */
+static void
+rtiff_ahead_want(Rtiff *rtiff, int page, int row)
+{
+	int i;
+
+	if (rtiff->readahead <= 0 ||
+		row >= rtiff_tiles_down(rtiff) ||
+		(rtiff->ahead_want_page == page &&
+			rtiff->ahead_want_row == row))
+		return;
+
+	for (i = 0; i < VIPS_NUMBER(rtiff->ahead); i++)
+		if (rtiff->ahead[i].page == page &&
+			rtiff->ahead[i].row == row)
+			return;
+
+	rtiff->ahead_want_page = page;
+	rtiff->ahead_want_row = row;
+
+	if (!rtiff->ahead_busy) {
+		if (vips_thread_execute("tiffahead", rtiff_ahead_work, rtiff))
+			/* No thread, so no read-ahead. Workers read their own
+			 * tiles.
+			 */
+			vips_error_clear();
+		else
+			rtiff->ahead_busy = TRUE;
+	}
+}
+
+/* Read the raw bytes for a tile, from read-ahead if we can. Request the
+ * row after this one, so it will be in memory by the time workers get to
+ * it.
+ *
+ * Return the size of the raw tile, or -1 for error.
+ */
+static tsize_t
+rtiff_read_raw_tile(Rtiff *rtiff, int page, guint32 tile_no,
+	tdata_t buf, tsize_t buf_length)
+{
+	int row = tile_no / rtiff_tiles_across(rtiff);
+
+	tsize_t size;
+
+	g_mutex_lock(&rtiff->ahead_lock);
+	rtiff_ahead_want(rtiff, page, row + 1);
+	size = rtiff_ahead_get(rtiff, page, tile_no, buf, buf_length);
+	g_mutex_unlock(&rtiff->ahead_lock);
+
+	if (size > 0)
+		return size;
+
+	g_rec_mutex_lock(&rtiff->lock);
+
+	if (rtiff_set_page(rtiff, page)) {
+		g_rec_mutex_unlock(&rtiff->lock);
+		return -1;
+	}
+
+	/* The background read might have finished while we waited for the
+	 * lock.
+	 */
+	g_mutex_lock(&rtiff->ahead_lock);
+	size = rtiff_ahead_get(rtiff, page, tile_no, buf, buf_length);
+	g_mutex_unlock(&rtiff->ahead_lock);
+
+	if (size <= 0)
+		size = rtiff_read_raw(rtiff, tile_no, buf, buf_length);
+
+	if (size <= 0)
+		vips_foreign_load_invalidate(rtiff->out);
+
+	g_rec_mutex_unlock(&rtiff->lock);
+
+	return size;
+}
+
 /* Select a page and decompress a tile. This has to be a single operation,
  * since it changes the current page number in TIFF.
  */
@@ -2322,30 +3256,34 @@ rtiff_read_tile(RtiffSeq *seq, tdata_t *buf, int page, int x, int y)
 	/* Compressed tiles load to compressed_buf.
 	 */
 	if (rtiff->header.we_decompress) {
-		ttile_t tile_no;
-
-		g_rec_mutex_lock(&rtiff->lock);
+		/* Tiles and strips of the first plane are numbered across
+		 * then down, as TIFFComputeTile() would, but we don't need
+		 * the lock to find out.
+		 */
+		guint32 tile_no = (y / rtiff->header.tile_height) *
+				rtiff_tiles_across(rtiff) +
+			x / rtiff->header.tile_width;
 
-		if (rtiff_set_page(rtiff, page)) {
-			g_rec_mutex_unlock(&rtiff->lock);
-			return -1;
-		}
+		tsize_t out_length;
 
-		tile_no = TIFFComputeTile(rtiff->tiff, x, y, 0, 0);
+		/* The final strip on a page can be short.
+		 */
+		if (rtiff->header.tiled)
+			out_length = rtiff->header.tile_size;
+		else
+			out_length = rtiff->header.tile_row_size *
+				VIPS_MIN(rtiff->header.tile_height,
+					rtiff->header.height - y);
 
-		size = TIFFReadRawTile(rtiff->tiff, tile_no,
+		size = rtiff_read_raw_tile(rtiff, page, tile_no,
 			seq->compressed_buf, seq->compressed_buf_length);
-		if (size <= 0) {
-			vips_foreign_load_invalidate(rtiff->out);
-			g_rec_mutex_unlock(&rtiff->lock);
+		if (size <= 0)
 			return -1;
-		}
-
-		g_rec_mutex_unlock(&rtiff->lock);
 
 		/* Decompress outside the lock, so we get parallelism.
 		 */
-		if (rtiff_decompress_tile(rtiff, seq->compressed_buf, size, buf)) {
+		if (rtiff_decompress_tile(rtiff,
+				seq->compressed_buf, size, buf, out_length)) {
 			vips_error("tiff2vips", _("decompress error tile %d x %d"), x, y);
 			return -1;
 		}
@@ -2617,6 +3555,8 @@ rtiff_read_tilewise(Rtiff *rtiff, VipsImage *out)
 	VipsImage **t = (VipsImage **) vips_object_local_array(VIPS_OBJECT(out), 4);
 
 	VipsImage *in;
+	int cache_height;
+	int max_tiles;
 
 #ifdef DEBUG
 	printf("tiff2vips: rtiff_read_tilewise\n");
@@ -2652,15 +3592,27 @@ rtiff_read_tilewise(Rtiff *rtiff, VipsImage *out)
 	/* Generate to out, adding a cache. Enough tiles for two complete rows.
 	 * Set "threaded", so we allow many tiles to be read at once. We lock
 	 * around each tile read.
+	 *
+	 * Strips are a whole row each, so keep enough to give every thread
+	 * its own strip, and hold several very short strips per cache tile.
 	 */
+	if (rtiff->header.tiled_strips) {
+		cache_height = VIPS_MAX(VIPS_ROUND_DOWN(16, tile_height), tile_height);
+		max_tiles = 2 * vips_concurrency_get() + 2;
+	}
+	else {
+		cache_height = tile_height;
+		max_tiles = 2 * (1 + t[0]->Xsize / tile_width);
+	}
+
 	if (
 		vips_image_generate(t[0],
 			rtiff_seq_start, rtiff_fill_region, rtiff_seq_stop,
 			rtiff, NULL) ||
 		vips_tilecache(t[0], &t[1],
 			"tile_width", tile_width,
-			"tile_height", tile_height,
-			"max_tiles", 2 * (1 + t[0]->Xsize / tile_width),
+			"tile_height", cache_height,
+			"max_tiles", max_tiles,
 			"threaded", TRUE,
 			NULL) ||
 		rtiff_unpremultiply(rtiff, t[1], &t[2]))
@@ -3002,6 +3954,70 @@ rtiff_read_stripwise(Rtiff *rtiff, VipsImage *out)
 	return 0;
 }
 
+/* JPEG and JP2K we can always decompress. The general purpose codecs need
+ * the layout checking, since we must undo byte swapping and the predictor
+ * ourselves. Anything else we leave to libtiff.
+ */
+static gboolean
+rtiff_can_decompress(Rtiff *rtiff, RtiffHeader *header)
+{
+	int bits_per_sample = header->bits_per_sample;
+	guint16 fill_order;
+
+	if (header->compression == COMPRESSION_JPEG ||
+		header->compression == JP2K_YCC ||
+		header->compression == JP2K_RGB ||
+		header->compression == JP2K_LOSSY)
+		return TRUE;
+
+	if (header->separate ||
+		header->read_as_rgba)
+		return FALSE;
+
+	TIFFGetFieldDefaulted(rtiff->tiff, TIFFTAG_FILLORDER, &fill_order);
+	if (fill_order != FILLORDER_MSB2LSB)
+		return FALSE;
+
+	/* We only swap whole 16 and 32 bit samples.
+	 */
+	if (bits_per_sample > 8 &&
+		bits_per_sample != 16 &&
+		bits_per_sample != 32)
+		return FALSE;
+
+	switch (header->predictor) {
+	case PREDICTOR_NONE:
+		break;
+
+	case PREDICTOR_HORIZONTAL:
+		if (bits_per_sample != 8 &&
+			bits_per_sample != 16 &&
+			bits_per_sample != 32)
+			return FALSE;
+		break;
+
+	case PREDICTOR_FLOATINGPOINT:
+		if (header->sample_format != SAMPLEFORMAT_IEEEFP ||
+			(bits_per_sample != 16 &&
+				bits_per_sample != 32))
+			return FALSE;
+		break;
+
+	default:
+		return FALSE;
+	}
+
+#ifdef RTIFF_WEBP
+	if (header->compression == COMPRESSION_WEBP &&
+		(bits_per_sample != 8 ||
+			(header->samples_per_pixel != 3 &&
+				header->samples_per_pixel != 4)))
+		return FALSE;
+#endif /*RTIFF_WEBP*/
+
+	return TRUE;
+}
+
 /* Load from a tiff dir into one of our tiff header structs.
  */
 static int
@@ -3015,6 +4031,7 @@ rtiff_header_read(Rtiff *rtiff, RtiffHeader *header)
 	char *image_description;
 	guint32 max_tile_dimension;
 	gboolean can_read_as_rgba;
+	guint16 predictor;
 
 	if (!tfget32(rtiff->tiff, TIFFTAG_IMAGEWIDTH,
 			&header->width) ||
@@ -3031,6 +4048,8 @@ rtiff_header_read(Rtiff *rtiff, RtiffHeader *header)
 		return -1;
 
 	header->read_as_rgba = FALSE;
+	header->we_decompress = FALSE;
+	header->tiled_strips = FALSE;
 
 	/* TIFF images which can be read by TIFFRGBAImage or TIFFReadRGBATile.
 	 */
@@ -3046,6 +4065,12 @@ rtiff_header_read(Rtiff *rtiff, RtiffHeader *header)
 
 	TIFFGetFieldDefaulted(rtiff->tiff,
 		TIFFTAG_COMPRESSION, &header->compression);
+	/* Only some codecs have a predictor.
+	 */
+	if (!TIFFGetFieldDefaulted(rtiff->tiff, TIFFTAG_PREDICTOR, &predictor))
+		predictor = PREDICTOR_NONE;
+	header->predictor = predictor;
+	header->byte_swapped = TIFFIsByteSwapped(rtiff->tiff);
 
 	/* We'll decode old-style JPEG using the libtiff RGBA path.
 	 */
@@ -3160,6 +4185,10 @@ rtiff_header_read(Rtiff *rtiff, RtiffHeader *header)
 	 */
 	header->tiled = TIFFIsTiled(rtiff->tiff);
 
+	if (header->we_decompress &&
+		!rtiff_can_decompress(rtiff, header))
+		header->we_decompress = FALSE;
+
 	if (header->read_as_rgba) {
 		header->we_decompress = FALSE;
 		header->photometric_interpretation = PHOTOMETRIC_RGB;
@@ -3328,12 +4357,43 @@ rtiff_header_read(Rtiff *rtiff, RtiffHeader *header)
 			header->read_size);
 #endif /*DEBUG*/
 
-		/* Stop some compiler warnings.
+		/* If we can decompress the strips ourselves, read them with the
+		 * tile reader, with a tile for each strip. Strips can then be
+		 * decompressed in parallel, outside the lock.
+		 *
+		 * Only do this for the general purpose codecs we decode
+		 * ourselves. Each thread needs a buffer for the compressed and
+		 * for the decompressed strip, so leave large strips to the
+		 * scanline reader.
 		 */
-		header->tile_width = 0;
-		header->tile_height = 0;
-		header->tile_size = 0;
-		header->tile_row_size = 0;
+		header->tiled_strips = header->we_decompress &&
+			rtiff_is_codec(header->compression) &&
+			!header->separate &&
+			header->rows_per_strip <= 128 &&
+			header->strip_size > 0 &&
+			header->strip_size <= RTIFF_MAX_TILED_STRIP_SIZE &&
+			header->scanline_size > 0;
+
+		if (header->tiled_strips) {
+			header->tile_width = header->width;
+			header->tile_height = header->rows_per_strip;
+			header->tile_size = header->strip_size;
+			header->tile_row_size = header->scanline_size;
+		}
+		else {
+			/* Stop some compiler warnings.
+			 */
+			header->we_decompress = FALSE;
+			header->tile_width = 0;
+			header->tile_height = 0;
+			header->tile_size = 0;
+			header->tile_row_size = 0;
+		}
+
+#ifdef DEBUG
+		printf("rtiff_header_read: header.tiled_strips = %d\n",
+			header->tiled_strips);
+#endif /*DEBUG*/
 	}
 
 	TIFFGetFieldDefaulted(rtiff->tiff, TIFFTAG_EXTRASAMPLES,
@@ -3370,6 +4430,8 @@ rtiff_header_equal(RtiffHeader *h1, RtiffHeader *h2)
 		h1->photometric_interpretation != h2->photometric_interpretation ||
 		h1->sample_format != h2->sample_format ||
 		h1->compression != h2->compression ||
+		h1->predictor != h2->predictor ||
+		h1->we_decompress != h2->we_decompress ||
 		h1->separate != h2->separate ||
 		h1->tiled != h2->tiled ||
 		h1->orientation != h2->orientation)
@@ -3406,6 +4468,7 @@ rtiff_header_read_all(Rtiff *rtiff)
 	 * corrupt.
 	 */
 	rtiff->n_pages = rtiff_n_pages(rtiff);
+	rtiff_subifd_sizes(rtiff);
 
 	if (rtiff_set_page(rtiff, rtiff->page) ||
 		rtiff_header_read(rtiff, &rtiff->header))
@@ -3490,7 +4553,7 @@ vips__tiff_read_header_source(VipsSource *source, VipsImage *out,
 	vips__tiff_init();
 
 	if (!(rtiff = rtiff_new(source, out,
-			  page, n, autorotate, subifd, fail_on, unlimited)) ||
+			  page, n, autorotate, subifd, fail_on, unlimited, 0)) ||
 		rtiff_header_read_all(rtiff))
 		return -1;
 
@@ -3514,7 +4577,7 @@ vips__tiff_read_header_source(VipsSource *source, VipsImage *out,
 int
 vips__tiff_read_source(VipsSource *source, VipsImage *out,
 	int page, int n, gboolean autorotate, int subifd, VipsFailOn fail_on,
-	gboolean unlimited)
+	gboolean unlimited, int readahead)
 {
 	Rtiff *rtiff;
 
@@ -3525,11 +4588,12 @@ vips__tiff_read_source(VipsSource *source, VipsImage *out,
 	vips__tiff_init();
 
 	if (!(rtiff = rtiff_new(source, out,
-			  page, n, autorotate, subifd, fail_on, unlimited)) ||
+			  page, n, autorotate, subifd, fail_on, unlimited, readahead)) ||
 		rtiff_header_read_all(rtiff))
 		return -1;
 
-	if (rtiff->header.tiled) {
+	if (rtiff->header.tiled ||
+		rtiff->header.tiled_strips) {
 		if (rtiff_read_tilewise(rtiff, out))
 			return -1;
 	}
@@ -81,6 +81,10 @@ typedef struct _VipsForeignLoadTiff {
 	 */
 	gboolean unlimited;
 
+	/* Max bytes of raw tile data to read ahead.
+	 */
+	int readahead;
+
 } VipsForeignLoadTiff;
 
 typedef VipsForeignLoadClass VipsForeignLoadTiffClass;
@@ -157,7 +161,7 @@ vips_foreign_load_tiff_load(VipsForeignLoad *load)
 
 	if (vips__tiff_read_source(tiff->source, load->real,
 			tiff->page, tiff->n, tiff->autorotate, tiff->subifd,
-			load->fail_on, tiff->unlimited))
+			load->fail_on, tiff->unlimited, tiff->readahead))
 		return -1;
 
 	return 0;
@@ -231,6 +235,13 @@ vips_foreign_load_tiff_class_init(VipsForeignLoadTiffClass *class)
 		G_STRUCT_OFFSET(VipsForeignLoadTiff, unlimited),
 		FALSE);
 #endif
+
+	VIPS_ARG_INT(class, "readahead", 25,
+		_("Read ahead"),
+		_("Max bytes of raw tile data to read ahead, 0 to disable"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsForeignLoadTiff, readahead),
+		0, 1024 * 1024 * 1024, 4 * 1024 * 1024);
 }
 
 static void
@@ -240,6 +251,7 @@ vips_foreign_load_tiff_init(VipsForeignLoadTiff *tiff)
 	tiff->n = 1;
 	tiff->subifd = -1;
 	tiff->unlimited = vips_unlimited_get();
+	tiff->readahead = 4 * 1024 * 1024;
 }
 
 typedef struct _VipsForeignLoadTiffSource {
@@ -510,6 +522,13 @@ vips_foreign_load_tiff_buffer_init(VipsForeignLoadTiffBuffer *buffer)
  * for decoding each input file to 50MB to prevent denial of service attacks.
  * Set @unlimited to remove this limit.
  *
+ * For tiled images with compression types libvips decodes itself, the first
+ * request for a tile in a row of tiles starts a background read of the raw
+ * tiles of the next row, so file reads overlap with decode. Tiles which are
+ * packed together in the file are fetched with a single read. @readahead
+ * sets the maximum memory for raw tiles read ahead, up to half of it for each
+ * of two rows. Set 0 to disable it.
+ *
  * Any ICC profile is read and attached to the VIPS image as
  * [const@META_ICC_NAME]. Any XMP metadata is read and attached to the image
  * as [const@META_XMP_NAME]. Any IPTC is attached as [const@META_IPTC_NAME]. The
@@ -525,6 +544,7 @@ vips_foreign_load_tiff_buffer_init(VipsForeignLoadTiffBuffer *buffer)
  *     * @subifd: `gint`, select this subifd index
  *     * @fail_on: [enum@FailOn], types of read error to fail on
  *     * @unlimited: `gboolean`, remove all denial of service limits
+ *     * @readahead: `gint`, max bytes of raw tile data to read ahead
  *
  * ::: seealso
  *     [ctor@Image.new_from_file], [method@Image.autorot].
@@ -565,6 +585,7 @@ vips_tiffload(const char *filename, VipsImage **out, ...)
  *     * @subifd: `gint`, select this subifd index
  *     * @fail_on: [enum@FailOn], types of read error to fail on
  *     * @unlimited: `gboolean`, remove all denial of service limits
+ *     * @readahead: `gint`, max bytes of raw tile data to read ahead
  *
  * ::: seealso
  *     [ctor@Image.tiffload].
@@ -607,6 +628,7 @@ vips_tiffload_buffer(void *buf, size_t len, VipsImage **out, ...)
  *     * @subifd: `gint`, select this subifd index
  *     * @fail_on: [enum@FailOn], types of read error to fail on
  *     * @unlimited: `gboolean`, remove all denial of service limits
+ *     * @readahead: `gint`, max bytes of raw tile data to read ahead
  *
  * ::: seealso
  *     [ctor@Image.tiffload].
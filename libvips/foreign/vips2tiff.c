@@ -206,6 +206,10 @@
  * 	- switch to terget API for output
  * 24/9/23
  *  - add threaded write of tiled JPEG and JP2K
+ * 18/10/26
+ * 	- compress tiles for all pyramid layers in parallel, write through a
+ * 	  single ordered writer
+ * 	- report time spent shrinking, compressing and writing
  */
 
 /*
@@ -326,6 +330,11 @@ struct _Layer {
 	VipsRegion *strip; /* The current strip of pixels */
 	VipsRegion *copy;  /* Pixels we copy to the next strip */
 
+	/* Regions on image left over from written pipeline jobs, ready to
+	 * be reused for the next tile. Only touched by the writing thread.
+	 */
+	GSList *spare;
+
 	Layer *below; /* The smaller layer below us */
 	Layer *above; /* The larger layer above */
 };
@@ -390,6 +399,28 @@ struct _Wtiff {
 	/* Lock thread calls into libtiff with this.
 	 */
 	GMutex lock;
+
+	/* In pyramid mode with we_compress, tiles from every layer are
+	 * queued here in write order, compressed by background workers, and
+	 * written in order by the thread that queued them. pending holds the
+	 * jobs no worker has picked up yet. Workers exit as soon as pending
+	 * is empty and are restarted when more tiles arrive, so they only
+	 * hold threadset threads while there is work. All protected by lock.
+	 */
+	GQueue jobs;
+	GQueue pending;
+	int max_jobs;
+	int max_workers;
+	int n_workers;
+	gboolean kill;
+	GCond done_cond;
+
+	/* Time spent in each phase, in microseconds. Compress time is summed
+	 * over all threads.
+	 */
+	gint64 shrink_time;
+	gint64 compress_time;
+	gint64 write_time;
 };
 
 /* libvips uses size_t for the length of binary data items, but libtiff wants
@@ -486,6 +517,7 @@ wtiff_layer_init(Wtiff *wtiff, Layer **layer, Layer *above,
 		(*layer)->y = 0;
 		(*layer)->strip = NULL;
 		(*layer)->copy = NULL;
+		(*layer)->spare = NULL;
 
 		(*layer)->below = NULL;
 		(*layer)->above = above;
@@ -1211,14 +1243,23 @@ layer_free(Layer *layer)
 	VIPS_FREEF(TIFFClose, layer->tif);
 	VIPS_UNREF(layer->strip);
 	VIPS_UNREF(layer->copy);
+	g_slist_free_full(layer->spare, g_object_unref);
+	layer->spare = NULL;
 	VIPS_UNREF(layer->image);
 }
 
+static void wtiff_pipeline_stop(Wtiff *wtiff);
+
 static void
 wtiff_free(Wtiff *wtiff)
 {
 	Layer *layer;
 
+	/* Shut down any compress workers before we free the layers their
+	 * jobs point to.
+	 */
+	wtiff_pipeline_stop(wtiff);
+
 	/* Free all pyramid resources.
 	 */
 	for (layer = wtiff->layer; layer; layer = layer->below) {
@@ -1229,6 +1270,7 @@ wtiff_free(Wtiff *wtiff)
 	VIPS_UNREF(wtiff->ready);
 	VIPS_FREE(wtiff->tbuf);
 	g_mutex_clear(&wtiff->lock);
+	g_cond_clear(&wtiff->done_cond);
 	VIPS_FREE(wtiff);
 }
 
@@ -1396,6 +1438,16 @@ wtiff_new(VipsImage *input, VipsTarget *target,
 	wtiff->n_pages = 1;
 	wtiff->image_height = input->Ysize;
 	g_mutex_init(&wtiff->lock);
+	g_queue_init(&wtiff->jobs);
+	g_queue_init(&wtiff->pending);
+	wtiff->max_jobs = 0;
+	wtiff->max_workers = 0;
+	wtiff->n_workers = 0;
+	wtiff->kill = FALSE;
+	g_cond_init(&wtiff->done_cond);
+	wtiff->shrink_time = 0;
+	wtiff->compress_time = 0;
+	wtiff->write_time = 0;
 
 	/* Any pre-processing on the image.
 	 */
@@ -1822,6 +1874,8 @@ wtiff_tile_compare(WtiffTile *a, WtiffTile *b, void *user_data)
 static int
 wtiff_row_write(WtiffRow *row, TIFF *tif)
 {
+	gint64 start = g_get_monotonic_time();
+
 	GSList *p;
 
 	row->tiles = g_slist_sort(row->tiles,
@@ -1837,6 +1891,8 @@ wtiff_row_write(WtiffRow *row, TIFF *tif)
 		}
 	}
 
+	row->wtiff->write_time += g_get_monotonic_time() - start;
+
 	return 0;
 }
 
@@ -1869,38 +1925,21 @@ wtiff_layer_row_allocate(VipsThreadState *state, void *a, gboolean *stop)
 	return 0;
 }
 
-/* Compress a tile from a threadpool.
+/* Compress @tile within @region to a memory buffer. Called from many threads
+ * at once.
  */
 static int
-wtiff_layer_row_work(VipsThreadState *state, void *a)
+wtiff_compress_tile(Wtiff *wtiff, VipsRegion *region, VipsRect *tile,
+	unsigned char **buffer, size_t *length)
 {
-	WtiffRow *row = (WtiffRow *) a;
-	Wtiff *wtiff = row->wtiff;
-	Layer *layer = row->layer;
-	VipsImage *im = layer->image;
-	VipsRegion *strip = row->strip;
-	VipsRect *valid = &strip->valid;
+	gint64 start = g_get_monotonic_time();
 
-	VipsRect image;
-	VipsRect tile;
 	VipsTarget *target;
 	int result;
-	unsigned char *buffer;
-	size_t length;
-
-	image.left = 0;
-	image.top = 0;
-	image.width = im->Xsize;
-	image.height = im->Ysize;
-	tile.left = state->x;
-	tile.top = valid->top;
-	tile.width = wtiff->tilew;
-	tile.height = wtiff->tileh;
-	vips_rect_intersectrect(&tile, &image, &tile);
 
 #ifdef DEBUG_VERBOSE
 	printf("Compressing %dx%d tile at position %dx%d\n",
-		tile.width, tile.height, tile.left, tile.top);
+		tile->width, tile->height, tile->left, tile->top);
 #endif /*DEBUG_VERBOSE*/
 
 	target = vips_target_new_to_memory();
@@ -1919,7 +1958,7 @@ wtiff_layer_row_work(VipsThreadState *state, void *a)
 		 * FIXME ... try again with openjpeg 2.5, when that comes.
 		 */
 		result = vips__foreign_save_jp2k_compress(
-			strip, &tile, target,
+			region, tile, target,
 			wtiff->tilew, wtiff->tileh,
 			!wtiff->rgbjpeg,
 			// !wtiff->rgbjpeg && wtiff->Q < 90,
@@ -1930,7 +1969,7 @@ wtiff_layer_row_work(VipsThreadState *state, void *a)
 
 #ifdef HAVE_JPEG
 	case COMPRESSION_JPEG:
-		result = wtiff_compress_jpeg(wtiff, strip, &tile, target);
+		result = wtiff_compress_jpeg(wtiff, region, tile, target);
 		break;
 #endif /*HAVE_JPEG*/
 
@@ -1945,15 +1984,332 @@ wtiff_layer_row_work(VipsThreadState *state, void *a)
 		return -1;
 	}
 
-	buffer = vips_target_steal(target, &length);
+	*buffer = vips_target_steal(target, length);
+
+	g_object_unref(target);
+
+	g_mutex_lock(&wtiff->lock);
+	wtiff->compress_time += g_get_monotonic_time() - start;
+	g_mutex_unlock(&wtiff->lock);
+
+	return 0;
+}
+
+/* Compress a tile from a threadpool.
+ */
+static int
+wtiff_layer_row_work(VipsThreadState *state, void *a)
+{
+	WtiffRow *row = (WtiffRow *) a;
+	Wtiff *wtiff = row->wtiff;
+	Layer *layer = row->layer;
+	VipsImage *im = layer->image;
+	VipsRegion *strip = row->strip;
+	VipsRect *valid = &strip->valid;
+
+	VipsRect image;
+	VipsRect tile;
+	unsigned char *buffer;
+	size_t length;
+
+	image.left = 0;
+	image.top = 0;
+	image.width = im->Xsize;
+	image.height = im->Ysize;
+	tile.left = state->x;
+	tile.top = valid->top;
+	tile.width = wtiff->tilew;
+	tile.height = wtiff->tileh;
+	vips_rect_intersectrect(&tile, &image, &tile);
+
+	if (wtiff_compress_tile(wtiff, strip, &tile, &buffer, &length))
+		return -1;
 
 	if (wtiff_row_add_tile(row, tile.left, tile.top, buffer, length)) {
-		g_object_unref(target);
 		g_free(buffer);
 		return -1;
 	}
 
-	g_object_unref(target);
+	return 0;
+}
+
+/* A tile queued for compress and write by the pyramid pipeline.
+ */
+typedef struct _WtiffJob {
+	Layer *layer;
+
+	/* A private copy of the pixels, since the layer strip will have moved
+	 * on by the time a worker gets to us.
+	 */
+	VipsRegion *region;
+	VipsRect tile;
+
+	/* Set by the worker.
+	 */
+	gboolean done;
+	int result;
+	unsigned char *buffer;
+	size_t length;
+} WtiffJob;
+
+/* Free a job from the writing thread. The region goes back to the layer
+ * for the next tile.
+ */
+static void
+wtiff_job_free(WtiffJob *job)
+{
+	if (job->region)
+		job->layer->spare = g_slist_prepend(job->layer->spare, job->region);
+	VIPS_FREE(job->buffer);
+	VIPS_FREE(job);
+}
+
+/* A background compress worker. Take jobs off the pending queue until
+ * it's empty, or we're told to stop, then exit.
+ */
+static void
+wtiff_pipeline_work(void *data, void *user_data)
+{
+	Wtiff *wtiff = (Wtiff *) data;
+
+	g_mutex_lock(&wtiff->lock);
+
+	for (;;) {
+		WtiffJob *job;
+		int result;
+		unsigned char *buffer;
+		size_t length;
+
+		if (wtiff->kill ||
+			!(job = (WtiffJob *) g_queue_pop_head(&wtiff->pending)))
+			break;
+
+		g_mutex_unlock(&wtiff->lock);
+
+		buffer = NULL;
+		length = 0;
+		result = wtiff_compress_tile(wtiff,
+			job->region, &job->tile, &buffer, &length);
+
+		g_mutex_lock(&wtiff->lock);
+
+		job->result = result;
+		job->buffer = buffer;
+		job->length = length;
+		job->done = TRUE;
+		g_cond_broadcast(&wtiff->done_cond);
+	}
+
+	/* We are exiting: tell the main thread.
+	 */
+	wtiff->n_workers -= 1;
+	g_cond_broadcast(&wtiff->done_cond);
+
+	g_mutex_unlock(&wtiff->lock);
+}
+
+/* Start another worker, if we are below the limit. Call with the lock held,
+ * after queueing a job.
+ */
+static int
+wtiff_pipeline_start(Wtiff *wtiff)
+{
+	if (wtiff->max_workers == 0) {
+		wtiff->max_workers = VIPS_MAX(1, vips_concurrency_get());
+
+		/* Enough jobs in flight to keep every worker busy while we
+		 * wait for the oldest tile to finish.
+		 */
+		wtiff->max_jobs = VIPS_MAX(16, 4 * wtiff->max_workers);
+	}
+
+	if (wtiff->n_workers < wtiff->max_workers &&
+		!g_queue_is_empty(&wtiff->pending)) {
+		wtiff->n_workers += 1;
+
+		if (vips_thread_execute("tiffsave", wtiff_pipeline_work, wtiff)) {
+			wtiff->n_workers -= 1;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Write the oldest job, waiting for it to compress if we must. Only the
+ * thread which queues jobs calls this, so libtiff is only ever used from one
+ * thread.
+ */
+static int
+wtiff_pipeline_write_head(Wtiff *wtiff)
+{
+	WtiffJob *job;
+	gint64 start;
+	int result;
+
+	g_mutex_lock(&wtiff->lock);
+	if ((job = (WtiffJob *) g_queue_peek_head(&wtiff->jobs)) &&
+		!job->done &&
+		g_queue_remove(&wtiff->pending, job)) {
+		/* No worker has started on it (the threadset might be capped
+		 * and busy), so do it ourselves.
+		 */
+		g_mutex_unlock(&wtiff->lock);
+		job->result = wtiff_compress_tile(wtiff,
+			job->region, &job->tile, &job->buffer, &job->length);
+		g_mutex_lock(&wtiff->lock);
+		job->done = TRUE;
+	}
+	while ((job = (WtiffJob *) g_queue_peek_head(&wtiff->jobs)) &&
+		!job->done)
+		g_cond_wait(&wtiff->done_cond, &wtiff->lock);
+	if (job)
+		g_queue_pop_head(&wtiff->jobs);
+	g_mutex_unlock(&wtiff->lock);
+
+	if (!job)
+		return 0;
+
+	if (job->result) {
+		wtiff_job_free(job);
+		return -1;
+	}
+
+	start = g_get_monotonic_time();
+
+	result = 0;
+	if (TIFFWriteRawTile(job->layer->tif,
+			TIFFComputeTile(job->layer->tif,
+				job->tile.left, job->tile.top, 0, 0),
+			job->buffer, job->length) == -1) {
+		vips_error("vips2tiff", "%s", _("TIFF write tile failed"));
+		result = -1;
+	}
+
+	wtiff->write_time += g_get_monotonic_time() - start;
+
+	wtiff_job_free(job);
+
+	return result;
+}
+
+/* Write all queued tiles. We must do this before we finish a page.
+ */
+static int
+wtiff_pipeline_flush(Wtiff *wtiff)
+{
+	while (!g_queue_is_empty(&wtiff->jobs))
+		if (wtiff_pipeline_write_head(wtiff))
+			return -1;
+
+	return 0;
+}
+
+/* Stop all workers and throw away any unwritten jobs.
+ */
+static void
+wtiff_pipeline_stop(Wtiff *wtiff)
+{
+	WtiffJob *job;
+
+	g_mutex_lock(&wtiff->lock);
+	wtiff->kill = TRUE;
+	while (wtiff->n_workers > 0)
+		g_cond_wait(&wtiff->done_cond, &wtiff->lock);
+	g_mutex_unlock(&wtiff->lock);
+
+	while ((job = (WtiffJob *) g_queue_pop_head(&wtiff->jobs)))
+		wtiff_job_free(job);
+	g_queue_clear(&wtiff->pending);
+}
+
+/* Queue a line of tiles for compress, then write any tiles which have
+ * finished. If the queue is full, block until the oldest tile is done.
+ */
+static int
+wtiff_pipeline_add(Wtiff *wtiff, Layer *layer, VipsRegion *strip)
+{
+	VipsImage *im = layer->image;
+
+	VipsRect image;
+
+	image.left = 0;
+	image.top = 0;
+	image.width = im->Xsize;
+	image.height = im->Ysize;
+
+	for (int x = 0; x < im->Xsize; x += wtiff->tilew) {
+		WtiffJob *job;
+
+		if (!(job = VIPS_NEW(NULL, WtiffJob)))
+			return -1;
+		job->layer = layer;
+		job->region = NULL;
+		job->tile.left = x;
+		job->tile.top = strip->valid.top;
+		job->tile.width = wtiff->tilew;
+		job->tile.height = wtiff->tileh;
+		vips_rect_intersectrect(&job->tile, &image, &job->tile);
+		job->done = FALSE;
+		job->result = 0;
+		job->buffer = NULL;
+		job->length = 0;
+
+		/* Reuse a region from an earlier tile if we can. It was
+		 * last used by a worker, so we must take it back first.
+		 */
+		if (layer->spare) {
+			job->region = (VipsRegion *) layer->spare->data;
+			layer->spare =
+				g_slist_delete_link(layer->spare, layer->spare);
+			vips__region_take_ownership(job->region);
+		}
+		else if (!(job->region = vips_region_new(im))) {
+			wtiff_job_free(job);
+			return -1;
+		}
+
+		if (vips_region_buffer(job->region, &job->tile)) {
+			wtiff_job_free(job);
+			return -1;
+		}
+		vips_region_copy(strip, job->region,
+			&job->tile, job->tile.left, job->tile.top);
+
+		/* The region will be used by a worker, then given back to us.
+		 */
+		vips__region_no_ownership(job->region);
+
+		g_mutex_lock(&wtiff->lock);
+		g_queue_push_tail(&wtiff->jobs, job);
+		g_queue_push_tail(&wtiff->pending, job);
+		if (wtiff_pipeline_start(wtiff)) {
+			g_mutex_unlock(&wtiff->lock);
+			return -1;
+		}
+		g_mutex_unlock(&wtiff->lock);
+
+		/* Write everything that's ready, and block if we have too
+		 * much in flight.
+		 */
+		for (;;) {
+			WtiffJob *head;
+			gboolean ready;
+
+			g_mutex_lock(&wtiff->lock);
+			head = (WtiffJob *) g_queue_peek_head(&wtiff->jobs);
+			ready = head &&
+				(head->done ||
+					(int) g_queue_get_length(&wtiff->jobs) >= wtiff->max_jobs);
+			g_mutex_unlock(&wtiff->lock);
+
+			if (!ready)
+				break;
+
+			if (wtiff_pipeline_write_head(wtiff))
+				return -1;
+		}
+	}
 
 	return 0;
 }
@@ -1974,7 +2330,16 @@ wtiff_layer_write_tiles(Wtiff *wtiff, Layer *layer, VipsRegion *strip)
 	image.width = im->Xsize;
 	image.height = im->Ysize;
 
-	if (wtiff->we_compress) {
+	if (wtiff->we_compress &&
+		wtiff->pyramid) {
+		/* Pyramid layers arrive in bursts as strips cascade down, so
+		 * queue tiles from all layers to a single set of workers rather
+		 * than waiting for each strip in turn.
+		 */
+		if (wtiff_pipeline_add(wtiff, layer, strip))
+			return -1;
+	}
+	else if (wtiff->we_compress) {
 		/* If we're compressing ourselves, we can do the whole strip in
 		 * parallel.
 		 */
@@ -2011,6 +2376,8 @@ wtiff_layer_write_tiles(Wtiff *wtiff, Layer *layer, VipsRegion *strip)
 	else {
 		/* If we're using libtiff compression, we have to be serial.
 		 */
+		gint64 start = g_get_monotonic_time();
+
 		for (x = 0; x < im->Xsize; x += wtiff->tilew) {
 			VipsRect tile;
 
@@ -2031,6 +2398,8 @@ wtiff_layer_write_tiles(Wtiff *wtiff, Layer *layer, VipsRegion *strip)
 				return -1;
 			}
 		}
+
+		wtiff->write_time += g_get_monotonic_time() - start;
 	}
 
 	return 0;
@@ -2044,6 +2413,7 @@ wtiff_layer_write_strip(Wtiff *wtiff, Layer *layer, VipsRegion *strip)
 	VipsImage *im = layer->image;
 	VipsRect *area = &strip->valid;
 	int height = VIPS_MIN(wtiff->tileh, area->height);
+	gint64 start = g_get_monotonic_time();
 
 	int y;
 
@@ -2084,6 +2454,8 @@ wtiff_layer_write_strip(Wtiff *wtiff, Layer *layer, VipsRegion *strip)
 			return -1;
 	}
 
+	wtiff->write_time += g_get_monotonic_time() - start;
+
 	return 0;
 }
 
@@ -2101,6 +2473,7 @@ layer_strip_shrink(Layer *layer)
 
 	VipsRect target;
 	VipsRect source;
+	gint64 start;
 
 	/* Our pixels might cross a strip boundary in the layer below, so we
 	 * have to write repeatedly until we run out of pixels.
@@ -2137,8 +2510,10 @@ layer_strip_shrink(Layer *layer)
 		if (vips_rect_isempty(&target))
 			break;
 
+		start = g_get_monotonic_time();
 		(void) vips_region_shrink_method(from, to, &target,
 			layer->wtiff->region_shrink);
+		layer->wtiff->shrink_time += g_get_monotonic_time() - start;
 
 		below->write_y += target.height;
 
@@ -2514,12 +2889,19 @@ wtiff_page_end(Wtiff *wtiff)
 	printf("wtiff_page_end: page %d\n", wtiff->page_number);
 #endif /*DEBUG*/
 
+	/* Any tiles still being compressed must be written before we can
+	 * close the layers.
+	 */
+	if (wtiff_pipeline_flush(wtiff))
+		return -1;
+
 	if (!TIFFWriteDirectory(wtiff->layer->tif))
 		return -1;
 
 	/* Append any pyr layers, if necessary.
 	 */
 	if (wtiff->layer->below) {
+		gint64 start = g_get_monotonic_time();
 		Layer *layer;
 
 		/* Free any lower pyramid resources ... this will
@@ -2534,6 +2916,8 @@ wtiff_page_end(Wtiff *wtiff)
 		if (wtiff_gather(wtiff))
 			return -1;
 
+		wtiff->write_time += g_get_monotonic_time() - start;
+
 		/* unref all the lower targets.
 		 */
 		for (layer = wtiff->layer->below; layer; layer = layer->below)
@@ -2650,6 +3034,12 @@ vips__tiff_write_target(VipsImage *input, VipsTarget *target,
 		return -1;
 	}
 
+	g_info("vips2tiff: %.3fs shrinking, %.3fs compressing (all threads), "
+		   "%.3fs writing",
+		wtiff->shrink_time / 1e6,
+		wtiff->compress_time / 1e6,
+		wtiff->write_time / 1e6);
+
 	wtiff_free(wtiff);
 
 	return 0;
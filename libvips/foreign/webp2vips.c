@@ -28,6 +28,8 @@
  * 	- revise for source IO
  * 27/10/21
  * 	- disable shrink-on-load if we need subpixel accuracy in animations
+ * 18/10/26
+ * 	- decode stills incrementally, and as RGB if there's no alpha
  */
 
 /*
@@ -80,6 +82,10 @@
 
 #include "pforeign.h"
 
+/* Feed stills to the incremental decoder this many bytes at a time.
+ */
+#define INCREMENTAL_CHUNK_SIZE (64 * 1024)
+
 /* What we track during a read.
  */
 typedef struct {
@@ -157,6 +163,19 @@ typedef struct {
 	 */
 	WebPMuxAnimDispose dispose_method;
 	VipsRect dispose_rect;
+
+	/* Stills are decoded incrementally. We feed the frame to @idec a
+	 * chunk at a time and hand scanlines on as they appear, so
+	 * downstream can start work before decode finishes.
+	 *
+	 * This does not save memory: libwebp's public API can only decode
+	 * into a buffer for the whole frame, so @idec holds every decoded
+	 * line until the read ends.
+	 */
+	gboolean incremental;
+	WebPIDecoder *idec;
+	size_t bytes_fed;
+	int last_y;
 } Read;
 
 const char *
@@ -334,6 +353,7 @@ read_free(Read *read)
 	WebPDemuxReleaseIterator(&read->iter);
 	VIPS_UNREF(read->frame);
 	VIPS_FREEF(WebPDemuxDelete, read->demux);
+	VIPS_FREEF(WebPIDelete, read->idec);
 	WebPFreeDecBuffer(&read->config.output);
 
 	VIPS_UNREF(read->source);
@@ -368,6 +388,10 @@ read_new(VipsImage *out, VipsSource *source, int page, int n, double scale)
 	read->frame = NULL;
 	read->dispose_method = WEBP_MUX_DISPOSE_NONE;
 	read->frame_no = 0;
+	read->incremental = FALSE;
+	read->idec = NULL;
+	read->bytes_fed = 0;
+	read->last_y = 0;
 
 	/* Everything has to stay open until read has finished, unfortunately,
 	 * since webp relies on us mapping the whole source.
@@ -535,6 +559,7 @@ read_header(Read *read, VipsImage *out)
 		read->width = read->frame_width;
 		read->height = read->frame_height;
 		read->frame_count = 1;
+		read->incremental = TRUE;
 	}
 
 	/* height can be huge if this is an animated webp image.
@@ -565,19 +590,22 @@ read_header(Read *read, VipsImage *out)
 		}
 	}
 
-	/* The canvas is always RGBA, we drop alpha to RGB on output if we
-	 * can.
+	/* The animation canvas is always RGBA, we drop alpha to RGB on output
+	 * if we can. Stills decode straight to the output format and don't
+	 * need a canvas.
 	 */
-	read->frame = vips_image_new_memory();
-	vips_image_init_fields(read->frame,
-		read->frame_width, read->frame_height, 4,
-		VIPS_FORMAT_UCHAR, VIPS_CODING_NONE,
-		VIPS_INTERPRETATION_sRGB,
-		1.0, 1.0);
-	if (vips_image_pipelinev(read->frame,
-			VIPS_DEMAND_STYLE_THINSTRIP, NULL) ||
-		vips_image_write_prepare(read->frame))
-		return -1;
+	if (!read->incremental) {
+		read->frame = vips_image_new_memory();
+		vips_image_init_fields(read->frame,
+			read->frame_width, read->frame_height, 4,
+			VIPS_FORMAT_UCHAR, VIPS_CODING_NONE,
+			VIPS_INTERPRETATION_sRGB,
+			1.0, 1.0);
+		if (vips_image_pipelinev(read->frame,
+				VIPS_DEMAND_STYLE_THINSTRIP, NULL) ||
+			vips_image_write_prepare(read->frame))
+			return -1;
+	}
 
 	vips_image_init_fields(out,
 		read->width, read->height,
@@ -729,6 +757,73 @@ read_next_frame(Read *read)
 	return 0;
 }
 
+/* Feed the incremental decoder until scanline @line of the still is
+ * available.
+ */
+static int
+read_incremental(Read *read, VipsRegion *out_region, int line)
+{
+	const guint8 *bytes = read->iter.fragment.bytes;
+	size_t size = read->iter.fragment.size;
+
+	VipsPel *rgb;
+	int stride;
+
+	if (!read->idec) {
+		/* libwebp allocates the output buffer, in RGB if we don't
+		 * need alpha.
+		 */
+		read->config.output.colorspace = read->alpha ? MODE_RGBA : MODE_RGB;
+		read->config.output.is_external_memory = 0;
+		if (read->scale != 1.0) {
+			read->config.options.use_scaling = 1;
+			read->config.options.scaled_width = read->frame_width;
+			read->config.options.scaled_height = read->frame_height;
+		}
+
+		if (!(read->idec = WebPIDecode(NULL, 0, &read->config))) {
+			vips_error("webp2vips", "%s", _("unable to read pixels"));
+			return -1;
+		}
+	}
+
+	while (read->last_y <= line) {
+		VP8StatusCode status;
+
+		if (read->bytes_fed >= size) {
+			vips_error("webp2vips", "%s", _("truncated image"));
+			return -1;
+		}
+
+		/* The fragment is mapped for the lifetime of the read, so
+		 * we can grow the buffer we give libwebp rather than copy.
+		 */
+		read->bytes_fed =
+			VIPS_MIN(size, read->bytes_fed + INCREMENTAL_CHUNK_SIZE);
+		status = WebPIUpdate(read->idec, bytes, read->bytes_fed);
+		if (status != VP8_STATUS_OK &&
+			status != VP8_STATUS_SUSPENDED) {
+			vips_error("webp2vips", _("unable to read pixels: %s"),
+				vips__error_webp(status));
+			return -1;
+		}
+
+		if (!WebPIDecGetRGB(read->idec, &read->last_y, NULL, NULL, NULL))
+			read->last_y = 0;
+	}
+
+	if (!(rgb = WebPIDecGetRGB(read->idec, NULL, NULL, NULL, &stride))) {
+		vips_error("webp2vips", "%s", _("unable to read pixels"));
+		return -1;
+	}
+
+	memcpy(VIPS_REGION_ADDR(out_region, 0, line),
+		rgb + (size_t) stride * line,
+		VIPS_REGION_SIZEOF_LINE(out_region));
+
+	return 0;
+}
+
 static int
 read_webp_generate(VipsRegion *out_region,
 	void *seq, void *a, void *b, gboolean *stop)
@@ -747,6 +842,9 @@ read_webp_generate(VipsRegion *out_region,
 
 	g_assert(r->height == 1);
 
+	if (read->incremental)
+		return read_incremental(read, out_region, r->top);
+
 	while (read->frame_no < frame) {
 		if (read_next_frame(read))
 			return -1;
@@ -442,6 +442,11 @@ vips_foreign_load_webp_buffer_init(VipsForeignLoadWebpBuffer *buffer)
  * the size on load. Animated webp images don't support shrink-on-load, so a
  * further resize may be necessary.
  *
+ * Still images are decoded incrementally, so scanlines reach the pipeline
+ * as soon as libwebp produces them. This is not streaming: libwebp needs a
+ * buffer for the whole decoded image, 3 bytes per pixel for opaque images
+ * and 4 with alpha, after any shrink-on-load.
+ *
  * The loader supports ICC, EXIF and XMP metadata.
  *
  * ::: tip "Optional arguments"
@@ -0,0 +1,466 @@
+/* a process-wide cache of fftw plans
+ *
+ * 18/10/26
+ * 	- from fwfft.c
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+/*
+#define DEBUG
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vips/vips.h>
+#include <vips/internal.h>
+
+#include "pfreqfilt.h"
+
+#ifdef HAVE_FFTW
+
+#include <fftw3.h>
+
+/* Planning is slow (we plan with FFTW_MEASURE), so we keep plans for the
+ * sizes we've seen. Plans can be in use by other threads when they drop out
+ * of the cache, so they are refcounted.
+ */
+#define VIPS_FFT_PLAN_MAX (64)
+
+/* Only bother with threaded plans for transforms larger than this many
+ * pixels.
+ */
+#define VIPS_FFT_THREADED_MIN (256 * 256)
+
+struct _VipsFftPlan {
+	/* Everything we key on. Plans can only be executed on arrays with the
+	 * same alignment and in-placeness as the arrays they were made for.
+	 */
+	VipsFftKind kind;
+	int width;
+	int height;
+	int in_alignment;
+	int out_alignment;
+	gboolean inplace;
+	int n_threads;
+
+	fftw_plan plan;
+
+	/* Protected by vips__fft_lock.
+	 */
+	int ref_count;
+	gboolean cached;
+};
+
+/* Protected by vips__fft_lock.
+ */
+static GHashTable *vips_fft_plans = NULL;
+
+static guint
+vips_fft_plan_hash(gconstpointer key)
+{
+	const VipsFftPlan *plan = (VipsFftPlan *) key;
+
+	return (plan->width << 16) ^
+		(plan->height << 4) ^
+		(plan->kind << 2) ^
+		(plan->in_alignment << 8) ^
+		(plan->out_alignment << 12) ^
+		plan->inplace ^
+		plan->n_threads;
+}
+
+static gboolean
+vips_fft_plan_equal(gconstpointer a, gconstpointer b)
+{
+	const VipsFftPlan *plan1 = (VipsFftPlan *) a;
+	const VipsFftPlan *plan2 = (VipsFftPlan *) b;
+
+	return plan1->kind == plan2->kind &&
+		plan1->width == plan2->width &&
+		plan1->height == plan2->height &&
+		plan1->in_alignment == plan2->in_alignment &&
+		plan1->out_alignment == plan2->out_alignment &&
+		plan1->inplace == plan2->inplace &&
+		plan1->n_threads == plan2->n_threads;
+}
+
+/* Call with vips__fft_lock held.
+ */
+static void
+vips_fft_plan_free(VipsFftPlan *plan)
+{
+#ifdef DEBUG
+	printf("vips_fft_plan_free: %d x %d, kind %d\n",
+		plan->width, plan->height, plan->kind);
+#endif /*DEBUG*/
+
+	VIPS_FREEF(fftw_destroy_plan, plan->plan);
+	g_free(plan);
+}
+
+#ifdef HAVE_FFTW_THREADS_SET_CALLBACK
+typedef struct _VipsFftJob {
+	void *(*work)(char *);
+	char *jobdata;
+	size_t elsize;
+} VipsFftJob;
+
+static void
+vips_fft_job(void *a, guint i, int thread)
+{
+	VipsFftJob *job = (VipsFftJob *) a;
+
+	job->work(job->jobdata + job->elsize * i);
+}
+
+/* fftw runs the jobs for threaded plans with this, so they run in the libvips
+ * threadset rather than in threads fftw starts.
+ */
+static void
+vips_fft_parallel_loop(void *(*work)(char *),
+	char *jobdata, size_t elsize, int njobs, void *data)
+{
+	VipsFftJob job = { work, jobdata, elsize };
+	int n_threads = 1 + vips__threads_reserve(njobs - 1);
+
+	vips__parallel_range("fftw", n_threads, 0, njobs, vips_fft_job, &job);
+}
+#endif /*HAVE_FFTW_THREADS_SET_CALLBACK*/
+
+/* Call with vips__fft_lock held.
+ */
+static void
+vips_fft_init(void)
+{
+	const char *filename;
+
+	if (vips_fft_plans)
+		return;
+
+	vips_fft_plans = g_hash_table_new(
+		vips_fft_plan_hash, vips_fft_plan_equal);
+
+#ifdef HAVE_FFTW_THREADS
+	fftw_init_threads();
+#ifdef HAVE_FFTW_THREADS_SET_CALLBACK
+	fftw_threads_set_callback(vips_fft_parallel_loop, NULL);
+#endif /*HAVE_FFTW_THREADS_SET_CALLBACK*/
+#endif /*HAVE_FFTW_THREADS*/
+
+	/* Preload any wisdom we've been given.
+	 */
+	if ((filename = g_getenv("VIPS_FFT_WISDOM")) &&
+		!fftw_import_wisdom_from_filename(filename))
+		g_warning("unable to load FFT wisdom from \"%s\"", filename);
+}
+
+/* Make a plan for the key fields of @plan, planning on scratch arrays with
+ * the same alignment.
+ */
+static fftw_plan
+vips_fft_plan_make(VipsFftPlan *plan)
+{
+	const guint64 n = (guint64) plan->width * plan->height;
+	const guint64 n_half = (guint64) (plan->width / 2 + 1) * plan->height;
+
+	guint64 in_size;
+	guint64 out_size;
+	char *in_scratch;
+	char *out_scratch;
+	void *in;
+	void *out;
+	fftw_plan result;
+
+	switch (plan->kind) {
+	case VIPS_FFT_R2C:
+		in_size = n * sizeof(double);
+		out_size = n_half * sizeof(fftw_complex);
+		break;
+
+	case VIPS_FFT_C2R:
+		in_size = n_half * sizeof(fftw_complex);
+		out_size = n * sizeof(double);
+		break;
+
+	case VIPS_FFT_FORWARD:
+	case VIPS_FFT_BACKWARD:
+	default:
+		in_size = n * sizeof(fftw_complex);
+		out_size = in_size;
+		break;
+	}
+
+	/* fftw_malloc() aligns to at least the alignment fftw checks, so we
+	 * can offset to get any alignment class we need.
+	 */
+	in_scratch = fftw_malloc(in_size + plan->in_alignment);
+	out_scratch = plan->inplace
+		? NULL
+		: fftw_malloc(out_size + plan->out_alignment);
+	if (!in_scratch ||
+		(!plan->inplace && !out_scratch)) {
+		VIPS_FREEF(fftw_free, in_scratch);
+		VIPS_FREEF(fftw_free, out_scratch);
+		return NULL;
+	}
+	in = in_scratch + plan->in_alignment;
+	out = plan->inplace ? in : out_scratch + plan->out_alignment;
+
+#ifdef HAVE_FFTW_THREADS
+	fftw_plan_with_nthreads(plan->n_threads);
+#endif /*HAVE_FFTW_THREADS*/
+
+	/* Yes, they really do use nx for height and ny for width.
+	 */
+	switch (plan->kind) {
+	case VIPS_FFT_R2C:
+		result = fftw_plan_dft_r2c_2d(plan->height, plan->width,
+			(double *) in, (fftw_complex *) out, FFTW_MEASURE);
+		break;
+
+	case VIPS_FFT_C2R:
+		result = fftw_plan_dft_c2r_2d(plan->height, plan->width,
+			(fftw_complex *) in, (double *) out, FFTW_MEASURE);
+		break;
+
+	case VIPS_FFT_FORWARD:
+	case VIPS_FFT_BACKWARD:
+	default:
+		result = fftw_plan_dft_2d(plan->height, plan->width,
+			(fftw_complex *) in, (fftw_complex *) out,
+			plan->kind == VIPS_FFT_FORWARD ? FFTW_FORWARD : FFTW_BACKWARD,
+			FFTW_MEASURE);
+		break;
+	}
+
+	VIPS_FREEF(fftw_free, in_scratch);
+	VIPS_FREEF(fftw_free, out_scratch);
+
+	return result;
+}
+
+/* Get a plan to transform @in to @out, a @width by @height image. Unref
+ * the plan when you're done with it.
+ */
+VipsFftPlan *
+vips__fft_plan_get(VipsFftKind kind, int width, int height,
+	void *in, void *out)
+{
+	VipsFftPlan key = { 0 };
+	VipsFftPlan *plan;
+
+	key.kind = kind;
+	key.width = width;
+	key.height = height;
+	key.in_alignment = fftw_alignment_of((double *) in);
+	key.out_alignment = fftw_alignment_of((double *) out);
+	key.inplace = in == out;
+	key.n_threads = 1;
+#ifdef HAVE_FFTW_THREADS
+	if ((guint64) width * height >= VIPS_FFT_THREADED_MIN)
+		key.n_threads = VIPS_MAX(1, vips_concurrency_get());
+#endif /*HAVE_FFTW_THREADS*/
+
+	g_mutex_lock(&vips__fft_lock);
+
+	vips_fft_init();
+
+	if ((plan = g_hash_table_lookup(vips_fft_plans, &key))) {
+		plan->ref_count += 1;
+		g_mutex_unlock(&vips__fft_lock);
+
+		return plan;
+	}
+
+#ifdef DEBUG
+	printf("vips__fft_plan_get: planning %d x %d, kind %d\n",
+		width, height, kind);
+#endif /*DEBUG*/
+
+	plan = g_new(VipsFftPlan, 1);
+	*plan = key;
+	if (!(plan->plan = vips_fft_plan_make(plan))) {
+		g_mutex_unlock(&vips__fft_lock);
+		g_free(plan);
+		vips_error("fft", "%s", _("unable to create transform plan"));
+		return NULL;
+	}
+
+	/* Full? Drop the whole cache, it's very unlikely we'll see this many
+	 * sizes in normal use.
+	 */
+	if (g_hash_table_size(vips_fft_plans) >= VIPS_FFT_PLAN_MAX) {
+		GHashTableIter iter;
+		VipsFftPlan *old;
+
+		g_hash_table_iter_init(&iter, vips_fft_plans);
+		while (g_hash_table_iter_next(&iter, (gpointer *) &old, NULL)) {
+			g_hash_table_iter_remove(&iter);
+			old->cached = FALSE;
+			if (old->ref_count == 0)
+				vips_fft_plan_free(old);
+		}
+	}
+
+	plan->ref_count = 1;
+	plan->cached = TRUE;
+	g_hash_table_add(vips_fft_plans, plan);
+
+	g_mutex_unlock(&vips__fft_lock);
+
+	return plan;
+}
+
+void
+vips__fft_plan_unref(VipsFftPlan *plan)
+{
+	g_mutex_lock(&vips__fft_lock);
+
+	g_assert(plan->ref_count > 0);
+
+	plan->ref_count -= 1;
+	if (plan->ref_count == 0 &&
+		!plan->cached)
+		vips_fft_plan_free(plan);
+
+	g_mutex_unlock(&vips__fft_lock);
+}
+
+/* Run a plan on a pair of arrays. They must have the same alignment and
+ * in-placeness as the arrays the plan was made for, and execute does not
+ * need the lock.
+ */
+void
+vips__fft_plan_execute(VipsFftPlan *plan, void *in, void *out)
+{
+	g_assert(plan->in_alignment == fftw_alignment_of((double *) in));
+	g_assert(plan->out_alignment == fftw_alignment_of((double *) out));
+
+	switch (plan->kind) {
+	case VIPS_FFT_R2C:
+		fftw_execute_dft_r2c(plan->plan,
+			(double *) in, (fftw_complex *) out);
+		break;
+
+	case VIPS_FFT_C2R:
+		fftw_execute_dft_c2r(plan->plan,
+			(fftw_complex *) in, (double *) out);
+		break;
+
+	case VIPS_FFT_FORWARD:
+	case VIPS_FFT_BACKWARD:
+	default:
+		fftw_execute_dft(plan->plan,
+			(fftw_complex *) in, (fftw_complex *) out);
+		break;
+	}
+}
+
+#endif /*HAVE_FFTW*/
+
+/**
+ * vips_fft_wisdom_import:
+ * @filename: file to load wisdom from
+ *
+ * Load FFT planner wisdom from @filename. Plans for sizes covered by the
+ * wisdom can then be made without measuring.
+ *
+ * Setting the environment variable `VIPS_FFT_WISDOM` to a filename will
+ * load wisdom from that file before the first transform.
+ *
+ * ::: seealso
+ *     [func@fft_wisdom_export].
+ *
+ * Returns: 0 on success, or -1 on error.
+ */
+int
+vips_fft_wisdom_import(const char *filename)
+{
+#ifdef HAVE_FFTW
+	int result;
+
+	g_mutex_lock(&vips__fft_lock);
+	vips_fft_init();
+	result = fftw_import_wisdom_from_filename(filename);
+	g_mutex_unlock(&vips__fft_lock);
+
+	if (!result) {
+		vips_error("fft",
+			_("unable to load wisdom from \"%s\""), filename);
+		return -1;
+	}
+
+	return 0;
+#else  /*!HAVE_FFTW*/
+	vips_error("fft",
+		"%s", _("libvips built without FFT support"));
+	return -1;
+#endif /*HAVE_FFTW*/
+}
+
+/**
+ * vips_fft_wisdom_export:
+ * @filename: file to write wisdom to
+ *
+ * Save the FFT planner wisdom gathered so far to @filename. Use this after
+ * a run of typical transforms to make a file you can load with
+ * [func@fft_wisdom_import], or with the `VIPS_FFT_WISDOM` environment
+ * variable.
+ *
+ * Returns: 0 on success, or -1 on error.
+ */
+int
+vips_fft_wisdom_export(const char *filename)
+{
+#ifdef HAVE_FFTW
+	int result;
+
+	g_mutex_lock(&vips__fft_lock);
+	result = fftw_export_wisdom_to_filename(filename);
+	g_mutex_unlock(&vips__fft_lock);
+
+	if (!result) {
+		vips_error("fft",
+			_("unable to save wisdom to \"%s\""), filename);
+		return -1;
+	}
+
+	return 0;
+#else  /*!HAVE_FFTW*/
+	vips_error("fft",
+		"%s", _("libvips built without FFT support"));
+	return -1;
+#endif /*HAVE_FFTW*/
+}
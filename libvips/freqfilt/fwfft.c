@@ -39,6 +39,8 @@
  * 	- redone as a class
  * 15/12/23 [akash-akya]
  *	- add locks
+ * 18/10/26
+ *	- use the plan cache
  */
 
 /*
@@ -109,9 +111,8 @@ rfwfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 	const int half_width = in->Xsize / 2 + 1;
 
 	double *half_complex;
-	double *planner_scratch;
 
-	fftw_plan plan;
+	VipsFftPlan *plan;
 	double *buf, *q, *p;
 	int x, y;
 
@@ -126,33 +127,14 @@ rfwfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 		vips_image_write(t[0], t[1]))
 		return -1;
 
-	/* Make the plan for the transform. Yes, they really do use nx for
-	 * height and ny for width. Use a separate scratch buffer for the
-	 * planner, we can't overwrite real->data
-	 */
-	if (!(planner_scratch = VIPS_ARRAY(fwfft,
-			  VIPS_IMAGE_N_PELS(in), double)))
-		return -1;
 	if (!(half_complex = VIPS_ARRAY(fwfft,
 			  in->Ysize * half_width * 2, double)))
 		return -1;
-	g_mutex_lock(&vips__fft_lock);
-	if (!(plan = fftw_plan_dft_r2c_2d(in->Ysize, in->Xsize,
-			  planner_scratch, (fftw_complex *) half_complex,
-			  0))) {
-		g_mutex_unlock(&vips__fft_lock);
-		vips_error(class->nickname,
-			"%s", _("unable to create transform plan"));
+	if (!(plan = vips__fft_plan_get(VIPS_FFT_R2C, in->Xsize, in->Ysize,
+			  t[1]->data, half_complex)))
 		return -1;
-	}
-	g_mutex_unlock(&vips__fft_lock);
-
-	fftw_execute_dft_r2c(plan,
-		(double *) t[1]->data, (fftw_complex *) half_complex);
-
-	g_mutex_lock(&vips__fft_lock);
-	fftw_destroy_plan(plan);
-	g_mutex_unlock(&vips__fft_lock);
+	vips__fft_plan_execute(plan, t[1]->data, half_complex);
+	vips__fft_plan_unref(plan);
 
 	/* Write to out as another memory buffer.
 	 */
@@ -231,8 +213,7 @@ cfwfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 	VipsImage **t = (VipsImage **) vips_object_local_array(object, 4);
 	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(fwfft);
 
-	fftw_plan plan;
-	double *planner_scratch;
+	VipsFftPlan *plan;
 	double *buf, *q, *p;
 	int x, y;
 
@@ -247,33 +228,11 @@ cfwfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 		vips_image_write(t[0], t[1]))
 		return -1;
 
-	/* We have to have a separate buffer for the planner to work on.
-	 */
-	if (!(planner_scratch = VIPS_ARRAY(fwfft,
-			  VIPS_IMAGE_N_PELS(in) * 2, double)))
-		return -1;
-
-	/* Make the plan for the transform.
-	 */
-	g_mutex_lock(&vips__fft_lock);
-	if (!(plan = fftw_plan_dft_2d(in->Ysize, in->Xsize,
-			  (fftw_complex *) planner_scratch,
-			  (fftw_complex *) planner_scratch,
-			  FFTW_FORWARD,
-			  0))) {
-		g_mutex_unlock(&vips__fft_lock);
-		vips_error(class->nickname,
-			"%s", _("unable to create transform plan"));
+	if (!(plan = vips__fft_plan_get(VIPS_FFT_FORWARD, in->Xsize, in->Ysize,
+			  t[1]->data, t[1]->data)))
 		return -1;
-	}
-	g_mutex_unlock(&vips__fft_lock);
-
-	fftw_execute_dft(plan,
-		(fftw_complex *) t[1]->data, (fftw_complex *) t[1]->data);
-
-	g_mutex_lock(&vips__fft_lock);
-	fftw_destroy_plan(plan);
-	g_mutex_unlock(&vips__fft_lock);
+	vips__fft_plan_execute(plan, t[1]->data, t[1]->data);
+	vips__fft_plan_unref(plan);
 
 	/* Write to out as another memory buffer.
 	 */
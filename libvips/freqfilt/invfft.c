@@ -28,6 +28,8 @@
  * 	- redone as a class
  * 15/12/23 [akash-akya]
  *	- add locks
+ * 18/10/26
+ *	- use the plan cache
  */
 
 /*
@@ -93,8 +95,7 @@ cinvfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 	VipsInvfft *invfft = (VipsInvfft *) object;
 	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(invfft);
 
-	fftw_plan plan;
-	double *planner_scratch;
+	VipsFftPlan *plan;
 
 	if (vips_check_mono(class->nickname, in) ||
 		vips_check_uncoded(class->nickname, in))
@@ -107,31 +108,11 @@ cinvfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 		vips_image_write(t[0], *out))
 		return -1;
 
-	/* Make the plan for the transform. Yes, they really do use nx for
-	 * height and ny for width.
-	 */
-	if (!(planner_scratch = VIPS_ARRAY(invfft,
-			  VIPS_IMAGE_N_PELS(in) * 2, double)))
-		return -1;
-	g_mutex_lock(&vips__fft_lock);
-	if (!(plan = fftw_plan_dft_2d(in->Ysize, in->Xsize,
-			  (fftw_complex *) planner_scratch,
-			  (fftw_complex *) planner_scratch,
-			  FFTW_BACKWARD,
-			  0))) {
-		g_mutex_unlock(&vips__fft_lock);
-		vips_error(class->nickname,
-			"%s", _("unable to create transform plan"));
+	if (!(plan = vips__fft_plan_get(VIPS_FFT_BACKWARD, in->Xsize, in->Ysize,
+			  (*out)->data, (*out)->data)))
 		return -1;
-	}
-	g_mutex_unlock(&vips__fft_lock);
-
-	fftw_execute_dft(plan,
-		(fftw_complex *) (*out)->data, (fftw_complex *) (*out)->data);
-
-	g_mutex_lock(&vips__fft_lock);
-	fftw_destroy_plan(plan);
-	g_mutex_unlock(&vips__fft_lock);
+	vips__fft_plan_execute(plan, (*out)->data, (*out)->data);
+	vips__fft_plan_unref(plan);
 
 	(*out)->Type = VIPS_INTERPRETATION_B_W;
 
@@ -145,12 +126,10 @@ rinvfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 {
 	VipsImage **t = (VipsImage **) vips_object_local_array(object, 4);
 	VipsInvfft *invfft = (VipsInvfft *) object;
-	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(invfft);
 	const int half_width = in->Xsize / 2 + 1;
 
 	double *half_complex;
-	double *planner_scratch;
-	fftw_plan plan;
+	VipsFftPlan *plan;
 	int x, y;
 	double *q, *p;
 
@@ -188,29 +167,11 @@ rinvfft1(VipsObject *object, VipsImage *in, VipsImage **out)
 	if (vips_image_write_prepare(*out))
 		return -1;
 
-	/* Make the plan for the transform. Yes, they really do use nx for
-	 * height and ny for width.
-	 */
-	if (!(planner_scratch = VIPS_ARRAY(invfft,
-			  t[1]->Ysize * half_width * 2, double)))
-		return -1;
-	g_mutex_lock(&vips__fft_lock);
-	if (!(plan = fftw_plan_dft_c2r_2d(t[1]->Ysize, t[1]->Xsize,
-			  (fftw_complex *) planner_scratch, (double *) (*out)->data,
-			  0))) {
-		g_mutex_unlock(&vips__fft_lock);
-		vips_error(class->nickname,
-			"%s", _("unable to create transform plan"));
+	if (!(plan = vips__fft_plan_get(VIPS_FFT_C2R, t[1]->Xsize, t[1]->Ysize,
+			  half_complex, (*out)->data)))
 		return -1;
-	}
-	g_mutex_unlock(&vips__fft_lock);
-
-	fftw_execute_dft_c2r(plan,
-		(fftw_complex *) half_complex, (double *) (*out)->data);
-
-	g_mutex_lock(&vips__fft_lock);
-	fftw_destroy_plan(plan);
-	g_mutex_unlock(&vips__fft_lock);
+	vips__fft_plan_execute(plan, half_complex, (*out)->data);
+	vips__fft_plan_unref(plan);
 
 	return 0;
 }
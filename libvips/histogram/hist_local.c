@@ -27,6 +27,13 @@
  * 	  current value
  * 	- scale result by 255, not 256, to avoid overflow
  * 	- off by 1 fix for odd window widths
+ * 18/10/26
+ * 	- uchar keeps a histogram per column, so cost no longer depends on
+ * 	  window size
+ * 	- add ushort support, the window moves in a serpentine
+ * 	- add @tiled, tile LUTs are made on first use
+ * 	- tiled mode reads through a cache of tile rows, so it stays
+ * 	  sequential
  */
 
 /*
@@ -78,6 +85,19 @@ typedef struct _VipsHistLocal {
 	int height;
 
 	int max_slope;
+	gboolean tiled;
+
+	/* For tiled mode, the grid of tiles, the number of histogram bins,
+	 * and a LUT for every band of every tile. LUTs are made a row of tiles
+	 * at a time, on first use, and row_done is protected by lock.
+	 */
+	int tiles_across;
+	int tiles_down;
+	int n_bins;
+	int shift;
+	unsigned short *luts;
+	gboolean *row_done;
+	GMutex lock;
 
 } VipsHistLocal;
 
@@ -85,29 +105,61 @@ typedef VipsOperationClass VipsHistLocalClass;
 
 G_DEFINE_TYPE(VipsHistLocal, vips_hist_local, VIPS_TYPE_OPERATION);
 
+static void
+vips_hist_local_finalize(GObject *gobject)
+{
+	VipsHistLocal *local = (VipsHistLocal *) gobject;
+
+	g_mutex_clear(&local->lock);
+
+	G_OBJECT_CLASS(vips_hist_local_parent_class)->finalize(gobject);
+}
+
+/* The uchar path keeps a histogram per column for this many output columns
+ * at a time.
+ */
+#define VIPS_HIST_LOCAL_CHUNK (512)
+
 /* Our sequence value: the region this sequence is using, and local stats.
  */
 typedef struct {
 	VipsRegion *ir; /* Input region */
 
-	/* A 256-element hist for every band.
+	/* For uchar, a 256-bin histogram for each column in a chunk, with a
+	 * 16-bin coarse histogram alongside. For ushort, just the window.
+	 */
+	unsigned int *col;
+	unsigned int *col_coarse;
+
+	/* The window at the start of the line (uchar only), the current
+	 * window, and for ushort the amount over max_slope in each coarse
+	 * bin. In tiled mode, fine is a tile histogram.
 	 */
-	unsigned int **hist;
+	unsigned int *start;
+	unsigned int *start_coarse;
+	unsigned int *fine;
+	unsigned int *coarse;
+	unsigned int *excess;
+
+	/* Tiled mode makes a row of LUTs here.
+	 */
+	unsigned short *row;
 } VipsHistLocalSequence;
 
 static int
 vips_hist_local_stop(void *vseq, void *a, void *b)
 {
 	VipsHistLocalSequence *seq = (VipsHistLocalSequence *) vseq;
-	VipsImage *in = (VipsImage *) a;
 
 	VIPS_UNREF(seq->ir);
-
-	if (seq->hist &&
-		in)
-		for (int i = 0; i < in->Bands; i++)
-			VIPS_FREE(seq->hist[i]);
-	VIPS_FREE(seq->hist);
+	VIPS_FREE(seq->col);
+	VIPS_FREE(seq->col_coarse);
+	VIPS_FREE(seq->start);
+	VIPS_FREE(seq->start_coarse);
+	VIPS_FREE(seq->fine);
+	VIPS_FREE(seq->coarse);
+	VIPS_FREE(seq->excess);
+	VIPS_FREE(seq->row);
 	VIPS_FREE(seq);
 
 	return 0;
@@ -117,30 +169,132 @@ static void *
 vips_hist_local_start(VipsImage *out, void *a, void *b)
 {
 	VipsImage *in = (VipsImage *) a;
+	VipsHistLocal *local = (VipsHistLocal *) b;
 	VipsHistLocalSequence *seq;
 
 	if (!(seq = VIPS_NEW(NULL, VipsHistLocalSequence)))
 		return NULL;
 	seq->ir = NULL;
-	seq->hist = NULL;
-
-	if (!(seq->ir = vips_region_new(in)) ||
-		!(seq->hist = VIPS_ARRAY(NULL, in->Bands, unsigned int *))) {
+	seq->col = NULL;
+	seq->col_coarse = NULL;
+	seq->start = NULL;
+	seq->start_coarse = NULL;
+	seq->fine = NULL;
+	seq->coarse = NULL;
+	seq->excess = NULL;
+	seq->row = NULL;
+
+	if (!(seq->ir = vips_region_new(in))) {
 		vips_hist_local_stop(seq, NULL, NULL);
 		return NULL;
 	}
 
-	for (int i = 0; i < in->Bands; i++)
-		if (!(seq->hist[i] = VIPS_ARRAY(NULL, 256, unsigned int))) {
+	if (local->tiled) {
+		size_t size = (size_t) local->tiles_across * in->Bands *
+			local->n_bins;
+
+		if (!(seq->fine = VIPS_ARRAY(NULL, local->n_bins, unsigned int)) ||
+			!(seq->row = VIPS_ARRAY(NULL, size, unsigned short))) {
 			vips_hist_local_stop(seq, NULL, NULL);
 			return NULL;
 		}
 
+		return seq;
+	}
+
+	if (in->BandFmt == VIPS_FORMAT_UCHAR) {
+		size_t n_cols = VIPS_HIST_LOCAL_CHUNK + local->width;
+
+		if (!(seq->col = VIPS_ARRAY(NULL, n_cols * 256, unsigned int)) ||
+			!(seq->col_coarse =
+					VIPS_ARRAY(NULL, n_cols * 16, unsigned int)) ||
+			!(seq->start = VIPS_ARRAY(NULL, 256, unsigned int)) ||
+			!(seq->start_coarse = VIPS_ARRAY(NULL, 16, unsigned int)) ||
+			!(seq->fine = VIPS_ARRAY(NULL, 256, unsigned int)) ||
+			!(seq->coarse = VIPS_ARRAY(NULL, 16, unsigned int))) {
+			vips_hist_local_stop(seq, NULL, NULL);
+			return NULL;
+		}
+	}
+	else {
+		/* The ushort window is emptied at the end of every band, so we
+		 * only need to zero it once.
+		 */
+		if (!(seq->fine = VIPS_ARRAY(NULL, 65536, unsigned int)) ||
+			!(seq->coarse = VIPS_ARRAY(NULL, 256, unsigned int)) ||
+			!(seq->excess = VIPS_ARRAY(NULL, 256, unsigned int))) {
+			vips_hist_local_stop(seq, NULL, NULL);
+			return NULL;
+		}
+
+		memset(seq->fine, 0, 65536 * sizeof(unsigned int));
+		memset(seq->coarse, 0, 256 * sizeof(unsigned int));
+		memset(seq->excess, 0, 256 * sizeof(unsigned int));
+	}
+
 	return seq;
 }
 
+/* Sum a 256-bin histogram up to and including target.
+ */
+static int
+vips_hist_local_sum_uchar(const unsigned int *restrict hist,
+	const unsigned int *restrict coarse, int target, int max_slope)
+{
+	int sum;
+
+	sum = 0;
+
+	/* For CLAHE we need to limit the height of the hist to limit
+	 * the amount we boost the contrast by.
+	 */
+	if (max_slope > 0) {
+		int i;
+		int sum_over;
+
+		sum_over = 0;
+
+		/* Must be <= target, since a cum hist always includes
+		 * the current element.
+		 */
+		for (i = 0; i <= target; i++) {
+			if (hist[i] > max_slope) {
+				sum_over += hist[i] - max_slope;
+				sum += max_slope;
+			}
+			else
+				sum += hist[i];
+		}
+
+		for (; i < 256; i++) {
+			if (hist[i] > max_slope)
+				sum_over += hist[i] - max_slope;
+		}
+
+		/* The extra clipped off bit from the top of the hist is
+		 * spread over all bins equally, then summed to target.
+		 */
+		sum += (target + 1) * sum_over / 256;
+	}
+	else {
+		/* Whole coarse bins below target, then the fine bins.
+		 */
+		for (int i = 0; i < target >> 4; i++)
+			sum += coarse[i];
+		for (int i = target & ~15; i <= target; i++)
+			sum += hist[i];
+	}
+
+	return sum;
+}
+
+/* The uchar path. Keep a histogram for every column and move them down a
+ * line at a time, then slide the window along the line by adding and
+ * subtracting whole column histograms. The cost per pixel is independent of
+ * the window size, and the inner loops vectorise.
+ */
 static int
-vips_hist_local_generate(VipsRegion *out_region,
+vips_hist_local_generate_uchar(VipsRegion *out_region,
 	void *vseq, void *a, void *b, gboolean *stop)
 {
 	VipsHistLocalSequence *seq = (VipsHistLocalSequence *) vseq;
@@ -149,6 +303,8 @@ vips_hist_local_generate(VipsRegion *out_region,
 	VipsRect *r = &out_region->valid;
 	const int bands = in->Bands;
 	const int max_slope = local->max_slope;
+	const int width = local->width;
+	const int height = local->height;
 
 	VipsRect s;
 	int lsk;
@@ -158,117 +314,478 @@ vips_hist_local_generate(VipsRegion *out_region,
 	 * than the section of the output image we are producing.
 	 */
 	s = *r;
-	s.width += local->width;
-	s.height += local->height - 1;
+	s.width += width;
+	s.height += height - 1;
 	if (vips_region_prepare(seq->ir, &s))
 		return -1;
 
 	lsk = VIPS_REGION_LSKIP(seq->ir);
-	centre = lsk * (local->height / 2) + bands * (local->width / 2);
+	centre = lsk * (height / 2) + bands * (width / 2);
+
+	for (int b = 0; b < bands; b++)
+		for (int cx = 0; cx < r->width; cx += VIPS_HIST_LOCAL_CHUNK) {
+			const int chunk = VIPS_MIN(VIPS_HIST_LOCAL_CHUNK, r->width - cx);
+			const int n_cols = chunk + width - 1;
+			VipsPel *p0 =
+				VIPS_REGION_ADDR(seq->ir, r->left + cx, r->top) + b;
+
+			/* Histograms for the columns, and for the window at the
+			 * start of the first line.
+			 */
+			memset(seq->col, 0, n_cols * 256 * sizeof(unsigned int));
+			memset(seq->col_coarse, 0, n_cols * 16 * sizeof(unsigned int));
+			for (int j = 0; j < height; j++) {
+				VipsPel *restrict p1 = p0 + j * lsk;
+
+				for (int c = 0; c < n_cols; c++) {
+					const int v = p1[c * bands];
+
+					seq->col[c * 256 + v] += 1;
+					seq->col_coarse[c * 16 + (v >> 4)] += 1;
+				}
+			}
 
-	for (int y = 0; y < r->height; y++) {
-		/* Get input and output pointers for this line.
-		 */
-		VipsPel *restrict p =
-			VIPS_REGION_ADDR(seq->ir, r->left, r->top + y);
-		VipsPel *restrict q =
-			VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+			memset(seq->start, 0, 256 * sizeof(unsigned int));
+			memset(seq->start_coarse, 0, 16 * sizeof(unsigned int));
+			for (int c = 0; c < width; c++) {
+				for (int i = 0; i < 256; i++)
+					seq->start[i] += seq->col[c * 256 + i];
+				for (int i = 0; i < 16; i++)
+					seq->start_coarse[i] += seq->col_coarse[c * 16 + i];
+			}
 
-		VipsPel *restrict p1;
+			for (int y = 0; y < r->height; y++) {
+				VipsPel *restrict p = p0 + y * lsk;
+				VipsPel *restrict q = b +
+					VIPS_REGION_ADDR(out_region, r->left + cx, r->top + y);
 
-		/* Find histogram for the start of this line.
-		 */
-		for (int b = 0; b < bands; b++)
-			memset(seq->hist[b], 0, 256 * sizeof(unsigned int));
-		p1 = p;
-		for (int j = 0; j < local->height; j++) {
-			int i;
-
-			i = 0;
-			for (int x = 0; x < local->width; x++)
-				for (int b = 0; b < bands; b++, i++)
-					seq->hist[b][p1[i]] += 1;
-
-			p1 += lsk;
+				/* Move the column histograms down a line.
+				 */
+				if (y > 0) {
+					VipsPel *restrict p_out = p - lsk;
+					VipsPel *restrict p_in = p + (height - 1) * lsk;
+
+					for (int c = 0; c < n_cols; c++) {
+						const int vo = p_out[c * bands];
+						const int vi = p_in[c * bands];
+
+						seq->col[c * 256 + vo] -= 1;
+						seq->col[c * 256 + vi] += 1;
+						seq->col_coarse[c * 16 + (vo >> 4)] -= 1;
+						seq->col_coarse[c * 16 + (vi >> 4)] += 1;
+
+						if (c < width) {
+							seq->start[vo] -= 1;
+							seq->start[vi] += 1;
+							seq->start_coarse[vo >> 4] -= 1;
+							seq->start_coarse[vi >> 4] += 1;
+						}
+					}
+				}
+
+				memcpy(seq->fine, seq->start, 256 * sizeof(unsigned int));
+				memcpy(seq->coarse, seq->start_coarse,
+					16 * sizeof(unsigned int));
+
+				for (int x = 0; x < chunk; x++) {
+					unsigned int *restrict fine = seq->fine;
+					unsigned int *restrict coarse = seq->coarse;
+					const int sum = vips_hist_local_sum_uchar(fine, coarse,
+						p[centre + x * bands], max_slope);
+
+					/* This can't overflow, even in contrast-limited mode.
+					 *
+					 * Scale by 255, not 256, or we'll get overflow.
+					 */
+					q[x * bands] = 255 * sum / (width * height);
+
+					/* Adapt histogram -- remove the left hand column, add
+					 * in a new right-hand column.
+					 */
+					if (x < chunk - 1) {
+						const unsigned int *restrict add =
+							seq->col + (x + width) * 256;
+						const unsigned int *restrict sub =
+							seq->col + x * 256;
+						const unsigned int *restrict add_coarse =
+							seq->col_coarse + (x + width) * 16;
+						const unsigned int *restrict sub_coarse =
+							seq->col_coarse + x * 16;
+
+						for (int i = 0; i < 256; i++)
+							fine[i] += add[i] - sub[i];
+						for (int i = 0; i < 16; i++)
+							coarse[i] += add_coarse[i] - sub_coarse[i];
+					}
+				}
+			}
 		}
 
-		/* Loop for output pels.
+	return 0;
+}
+
+/* Add and remove a pixel from the ushort window, tracking the amount each
+ * coarse bin is over max_slope.
+ */
+#define ADD(V) \
+	{ \
+		const int v = (V); \
+\
+		if (max_slope > 0 && \
+			fine[v] >= max_slope) { \
+			excess[v >> 8] += 1; \
+			sum_over += 1; \
+		} \
+		fine[v] += 1; \
+		coarse[v >> 8] += 1; \
+	}
+
+#define REMOVE(V) \
+	{ \
+		const int v = (V); \
+\
+		if (max_slope > 0 && \
+			fine[v] > max_slope) { \
+			excess[v >> 8] -= 1; \
+			sum_over -= 1; \
+		} \
+		fine[v] -= 1; \
+		coarse[v >> 8] -= 1; \
+	}
+
+/* The ushort path. A 65536-bin window histogram is too large to add and
+ * subtract, so move the window one pixel at a time, and find the rank with a
+ * 256-bin coarse histogram. The window runs left to right on even lines and
+ * right to left on odd lines, so it is only built once per band. The amount
+ * over max_slope is tracked as we go, so CLAHE does not need to scan the
+ * whole histogram either.
+ */
+static int
+vips_hist_local_generate_ushort(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsHistLocalSequence *seq = (VipsHistLocalSequence *) vseq;
+	VipsImage *in = (VipsImage *) a;
+	const VipsHistLocal *local = (VipsHistLocal *) b;
+	VipsRect *r = &out_region->valid;
+	const int bands = in->Bands;
+	const int max_slope = local->max_slope;
+	const int width = local->width;
+	const int height = local->height;
+	const guint64 n = (guint64) width * height;
+	unsigned int *restrict fine = seq->fine;
+	unsigned int *restrict coarse = seq->coarse;
+	unsigned int *restrict excess = seq->excess;
+
+	VipsRect s;
+	int lsk;
+	int centre;
+
+	s = *r;
+	s.width += width;
+	s.height += height - 1;
+	if (vips_region_prepare(seq->ir, &s))
+		return -1;
+
+	lsk = VIPS_REGION_LSKIP(seq->ir) / sizeof(unsigned short);
+	centre = lsk * (height / 2) + bands * (width / 2);
+
+	for (int b = 0; b < bands; b++) {
+		unsigned short *p0 = (unsigned short *)
+			VIPS_REGION_ADDR(seq->ir, r->left, r->top) + b;
+
+		guint64 sum_over;
+		int x;
+
+		/* The window for the top-left pixel.
 		 */
-		for (int x = 0; x < r->width; x++) {
-			for (int b = 0; b < bands; b++) {
-				/* Sum histogram up to current pel.
-				 */
-				unsigned int *restrict hist = seq->hist[b];
-				const int target = p[centre + b];
+		sum_over = 0;
+		for (int j = 0; j < height; j++)
+			for (int i = 0; i < width; i++)
+				ADD(p0[j * lsk + i * bands]);
+
+		x = 0;
+		for (int y = 0; y < r->height; y++) {
+			unsigned short *restrict p = p0 + y * lsk;
+			unsigned short *restrict q = (unsigned short *)
+				VIPS_REGION_ADDR(out_region, r->left, r->top + y) + b;
+			const int dx = (y & 1) ? -1 : 1;
+
+			/* Move the window down a line.
+			 */
+			if (y > 0)
+				for (int i = 0; i < width; i++) {
+					REMOVE(p[-lsk + (x + i) * bands]);
+					ADD(p[(height - 1) * lsk + (x + i) * bands]);
+				}
+
+			for (int k = 0; k < r->width; k++) {
+				const int target = p[centre + x * bands];
+				const int cb = target >> 8;
 
-				int sum;
+				guint64 sum;
 
 				sum = 0;
+				for (int i = 0; i < cb; i++)
+					sum += coarse[i];
+				for (int i = cb << 8; i <= target; i++)
+					sum += fine[i];
 
-				/* For CLAHE we need to limit the height of the hist to limit
-				 * the amount we boost the contrast by.
+				/* Clip, and spread the excess over all bins, as
+				 * for uchar.
 				 */
 				if (max_slope > 0) {
-					int i;
-					int sum_over;
+					guint64 over;
 
-					sum_over = 0;
+					over = 0;
+					for (int i = 0; i < cb; i++)
+						over += excess[i];
+					for (int i = cb << 8; i <= target; i++)
+						if (fine[i] > max_slope)
+							over += fine[i] - max_slope;
 
-					/* Must be <= target, since a cum hist always includes
-					 * the current element.
-					 */
-					for (i = 0; i <= target; i++) {
-						if (hist[i] > max_slope) {
-							sum_over += hist[i] - max_slope;
-							sum += max_slope;
-						}
-						else
-							sum += hist[i];
-					}
+					sum -= over;
+					sum += (target + 1) * sum_over / 65536;
+				}
 
-					for (; i < 256; i++) {
-						if (hist[i] > max_slope)
-							sum_over += hist[i] - max_slope;
-					}
+				q[x * bands] = 65535 * sum / n;
 
-					/* The extra clipped off bit from the top of the hist is
-					 * spread over all bins equally, then summed to target.
-					 */
-					sum += (target + 1) * sum_over / 256;
-				}
-				else {
-					sum = 0;
-					for (int i = 0; i <= target; i++)
-						sum += hist[i];
+				/* Slide the window one pixel along the line.
+				 */
+				if (k < r->width - 1) {
+					if (dx > 0)
+						for (int j = 0; j < height; j++) {
+							REMOVE(p[j * lsk + x * bands]);
+							ADD(p[j * lsk + (x + width) * bands]);
+						}
+					else
+						for (int j = 0; j < height; j++) {
+							REMOVE(p[j * lsk + (x + width - 1) * bands]);
+							ADD(p[j * lsk + (x - 1) * bands]);
+						}
+
+					x += dx;
 				}
+			}
+		}
 
-				/* This can't overflow, even in contrast-limited mode.
-				 *
-				 * Scale by 255, not 256, or we'll get overflow.
-				 */
-				q[b] = 255 * sum / (local->width * local->height);
+		/* Empty the window ready for the next band.
+		 */
+		for (int j = 0; j < height; j++)
+			for (int i = 0; i < width; i++)
+				REMOVE(p0[(r->height - 1 + j) * lsk + (x + i) * bands]);
+	}
 
-				/* Adapt histogram -- remove the pels from the left hand column,
-				 * add in pels for a new right-hand column.
-				 */
-				const int next = bands * local->width;
-				p1 = p + b;
-				for (int j = 0; j < local->height; j++) {
-					hist[p1[0]] -= 1;
-					hist[p1[next]] += 1;
+	return 0;
+}
+
+/* Make the LUTs for row ty of tiles: a clipped histogram per tile, with the
+ * excess spread evenly over all bins, then scaled to a cumulative LUT.
+ */
+#define TILE_HIST(TYPE) \
+	{ \
+		for (int y = 0; y < area.height; y++) { \
+			TYPE *restrict p = (TYPE *) VIPS_REGION_ADDR(region, \
+				area.left, area.top + y) + b; \
+\
+			for (int x = 0; x < area.width; x++) \
+				hist[p[x * bands] >> shift] += 1; \
+		} \
+	}
+
+static int
+vips_hist_local_tile_row(const VipsHistLocal *local, VipsRegion *region,
+	unsigned int *hist, unsigned short *row, int ty)
+{
+	VipsImage *in = region->im;
+	const int bands = in->Bands;
+	const int n_bins = local->n_bins;
+	const int shift = local->shift;
+	const int max_value = in->BandFmt == VIPS_FORMAT_UCHAR ? 255 : 65535;
+
+	VipsRect area;
+
+	area.left = 0;
+	area.top = ty * local->height;
+	area.width = in->Xsize;
+	area.height = VIPS_MIN(local->height, in->Ysize - area.top);
+	if (vips_region_prepare(region, &area))
+		return -1;
+
+	for (int tx = 0; tx < local->tiles_across; tx++) {
+		const int left = tx * local->width;
+
+		area.left = left;
+		area.width = VIPS_MIN(local->width, in->Xsize - left);
+
+		for (int b = 0; b < bands; b++) {
+			const guint64 n = (guint64) area.width * area.height;
+			unsigned short *lut = row + ((size_t) tx * bands + b) * n_bins;
+
+			guint64 sum;
+
+			memset(hist, 0, n_bins * sizeof(unsigned int));
+			if (in->BandFmt == VIPS_FORMAT_UCHAR)
+				TILE_HIST(unsigned char)
+			else
+				TILE_HIST(unsigned short)
+
+			/* As for the sliding window, max_slope is the most
+			 * pixels each value can have. 16-bit bins hold
+			 * several values.
+			 */
+			if (local->max_slope > 0) {
+				const unsigned int limit = local->max_slope << shift;
+
+				guint64 over;
+				guint64 step;
 
-					p1 += lsk;
+				over = 0;
+				for (int i = 0; i < n_bins; i++)
+					if (hist[i] > limit) {
+						over += hist[i] - limit;
+						hist[i] = limit;
+					}
+
+				for (int i = 0; i < n_bins; i++)
+					hist[i] += over / n_bins;
+
+				/* And any remainder spread through the range.
+				 */
+				over %= n_bins;
+				if (over > 0) {
+					step = n_bins / over;
+					for (int i = 0; i < n_bins && over > 0; i += step) {
+						hist[i] += 1;
+						over -= 1;
+					}
 				}
 			}
 
-			p += bands;
-			q += bands;
+			sum = 0;
+			for (int i = 0; i < n_bins; i++) {
+				sum += hist[i];
+				lut[i] = (max_value * sum + n / 2) / n;
+			}
 		}
 	}
 
 	return 0;
 }
 
+/* Make sure the LUTs for row ty of tiles exist. Make them without the lock,
+ * so we never wait for upstream while holding it. Two threads can race to
+ * make the same row, but they will make the same LUTs.
+ */
+static int
+vips_hist_local_tile_need(VipsHistLocal *local,
+	VipsHistLocalSequence *seq, int ty)
+{
+	const size_t size = (size_t) local->tiles_across *
+		seq->ir->im->Bands * local->n_bins;
+
+	gboolean done;
+
+	g_mutex_lock(&local->lock);
+	done = local->row_done[ty];
+	g_mutex_unlock(&local->lock);
+
+	if (!done) {
+		if (vips_hist_local_tile_row(local, seq->ir, seq->fine, seq->row, ty))
+			return -1;
+
+		g_mutex_lock(&local->lock);
+		if (!local->row_done[ty]) {
+			memcpy(local->luts + ty * size, seq->row,
+				size * sizeof(unsigned short));
+			local->row_done[ty] = TRUE;
+		}
+		g_mutex_unlock(&local->lock);
+	}
+
+	return 0;
+}
+
+/* Tiled mode output: bilinear interpolation between the LUTs of the four
+ * nearest tile centres.
+ */
+#define TILE_MAP(TYPE) \
+	{ \
+		TYPE *restrict p = (TYPE *) \
+			VIPS_REGION_ADDR(seq->ir, r->left, r->top + y); \
+		TYPE *restrict q = (TYPE *) \
+			VIPS_REGION_ADDR(out_region, r->left, r->top + y); \
+\
+		for (int x = 0; x < r->width; x++) { \
+			const double fx = (r->left + x + 0.5) / local->width - 0.5; \
+			const int tx = floor(fx); \
+			const double wx = fx - tx; \
+			const int tx0 = VIPS_CLIP(0, tx, local->tiles_across - 1); \
+			const int tx1 = VIPS_CLIP(0, tx + 1, local->tiles_across - 1); \
+			const unsigned short *l00 = row0 + (size_t) tx0 * stride; \
+			const unsigned short *l01 = row0 + (size_t) tx1 * stride; \
+			const unsigned short *l10 = row1 + (size_t) tx0 * stride; \
+			const unsigned short *l11 = row1 + (size_t) tx1 * stride; \
+\
+			for (int b = 0; b < bands; b++) { \
+				const int i = b * n_bins + (p[b] >> shift); \
+				const double top = l00[i] + wx * (l01[i] - l00[i]); \
+				const double bottom = l10[i] + wx * (l11[i] - l10[i]); \
+\
+				q[b] = top + wy * (bottom - top) + 0.5; \
+			} \
+\
+			p += bands; \
+			q += bands; \
+		} \
+	}
+
+static int
+vips_hist_local_generate_tiled(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsHistLocalSequence *seq = (VipsHistLocalSequence *) vseq;
+	VipsImage *in = (VipsImage *) a;
+	VipsHistLocal *local = (VipsHistLocal *) b;
+	VipsRect *r = &out_region->valid;
+	const int bands = in->Bands;
+	const int n_bins = local->n_bins;
+	const int shift = local->shift;
+	const size_t stride = (size_t) bands * n_bins;
+	const int ty_first = VIPS_CLIP(0,
+		(int) floor((r->top + 0.5) / local->height - 0.5),
+		local->tiles_down - 1);
+	const int ty_last = VIPS_CLIP(0,
+		(int) floor((VIPS_RECT_BOTTOM(r) - 0.5) / local->height - 0.5) + 1,
+		local->tiles_down - 1);
+
+	for (int ty = ty_first; ty <= ty_last; ty++)
+		if (vips_hist_local_tile_need(local, seq, ty))
+			return -1;
+
+	if (vips_region_prepare(seq->ir, r))
+		return -1;
+
+	for (int y = 0; y < r->height; y++) {
+		const double fy = (r->top + y + 0.5) / local->height - 0.5;
+		const int ty = floor(fy);
+		const double wy = fy - ty;
+		const int ty0 = VIPS_CLIP(0, ty, local->tiles_down - 1);
+		const int ty1 = VIPS_CLIP(0, ty + 1, local->tiles_down - 1);
+		const unsigned short *row0 =
+			local->luts + (size_t) ty0 * local->tiles_across * stride;
+		const unsigned short *row1 =
+			local->luts + (size_t) ty1 * local->tiles_across * stride;
+
+		if (in->BandFmt == VIPS_FORMAT_UCHAR)
+			TILE_MAP(unsigned char)
+		else
+			TILE_MAP(unsigned short)
+	}
+
+	return 0;
+}
+
 static int
 vips_hist_local_build(VipsObject *object)
 {
@@ -277,6 +794,10 @@ vips_hist_local_build(VipsObject *object)
 	VipsImage **t = (VipsImage **) vips_object_local_array(object, 3);
 
 	VipsImage *in;
+	VipsGenerateFn generate;
+	int tile_width;
+	int tile_height;
+	int n_lines;
 
 	if (VIPS_OBJECT_CLASS(vips_hist_local_parent_class)->build(object))
 		return -1;
@@ -287,9 +808,60 @@ vips_hist_local_build(VipsObject *object)
 		return -1;
 	in = t[0];
 
-	if (vips_check_format(class->nickname, in, VIPS_FORMAT_UCHAR))
+	if (vips_check_u8or16(class->nickname, in))
 		return -1;
 
+	if (local->tiled) {
+		/* 16-bit images use 4096 bins per tile, or the LUTs get
+		 * very large.
+		 */
+		local->tiles_across = VIPS_ROUND_UP(in->Xsize, local->width) /
+			local->width;
+		local->tiles_down = VIPS_ROUND_UP(in->Ysize, local->height) /
+			local->height;
+		local->n_bins = in->BandFmt == VIPS_FORMAT_UCHAR ? 256 : 4096;
+		local->shift = in->BandFmt == VIPS_FORMAT_UCHAR ? 0 : 4;
+		if (!(local->luts = VIPS_ARRAY(object,
+				  (size_t) local->tiles_across * local->tiles_down *
+					  in->Bands * local->n_bins,
+				  unsigned short)) ||
+			!(local->row_done = VIPS_ARRAY(object,
+				  local->tiles_down, gboolean)))
+			return -1;
+		memset(local->row_done, 0, local->tiles_down * sizeof(gboolean));
+
+		/* The LUTs for tile row ty + 1 are made while we are still
+		 * writing lines from tile row ty, so we read ahead of the
+		 * output. Cache whole tile rows, enough for the current row,
+		 * the one ahead, and threading non-locality, so a sequential
+		 * source never sees a read behind its current position.
+		 */
+		vips_get_tile_size(in, &tile_width, &tile_height, &n_lines);
+		if (vips_tilecache(in, &t[1],
+				"tile_width", in->Xsize,
+				"tile_height", local->height,
+				"max_tiles", 3 + 4 * n_lines / local->height,
+				"access", VIPS_ACCESS_SEQUENTIAL,
+				NULL))
+			return -1;
+		in = t[1];
+
+		g_object_set(object, "out", vips_image_new(), NULL);
+
+		if (vips_image_pipelinev(local->out,
+				VIPS_DEMAND_STYLE_THINSTRIP, in, NULL))
+			return -1;
+
+		if (vips_image_generate(local->out,
+				vips_hist_local_start,
+				vips_hist_local_generate_tiled,
+				vips_hist_local_stop,
+				in, local))
+			return -1;
+
+		return 0;
+	}
+
 	if (local->width > in->Xsize ||
 		local->height > in->Ysize) {
 		vips_error(class->nickname, "%s", _("window too large"));
@@ -317,9 +889,14 @@ vips_hist_local_build(VipsObject *object)
 	local->out->Xsize -= local->width;
 	local->out->Ysize -= local->height - 1;
 
+	if (in->BandFmt == VIPS_FORMAT_UCHAR)
+		generate = vips_hist_local_generate_uchar;
+	else
+		generate = vips_hist_local_generate_ushort;
+
 	if (vips_image_generate(local->out,
 			vips_hist_local_start,
-			vips_hist_local_generate,
+			generate,
 			vips_hist_local_stop,
 			in, local))
 		return -1;
@@ -339,6 +916,7 @@ vips_hist_local_class_init(VipsHistLocalClass *class)
 	VipsObjectClass *object_class = (VipsObjectClass *) class;
 	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
 
+	gobject_class->finalize = vips_hist_local_finalize;
 	gobject_class->set_property = vips_object_set_property;
 	gobject_class->get_property = vips_object_get_property;
 
@@ -380,11 +958,19 @@ vips_hist_local_class_init(VipsHistLocalClass *class)
 		VIPS_ARGUMENT_OPTIONAL_INPUT,
 		G_STRUCT_OFFSET(VipsHistLocal, max_slope),
 		0, 100, 0);
+
+	VIPS_ARG_BOOL(class, "tiled", 7,
+		_("Tiled"),
+		_("Equalise tiles and interpolate between them (CLAHE)"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsHistLocal, tiled),
+		FALSE);
 }
 
 static void
 vips_hist_local_init(VipsHistLocal *local)
 {
+	g_mutex_init(&local->lock);
 }
 
 /**
@@ -406,8 +992,19 @@ vips_hist_local_init(VipsHistLocal *local)
  * performed. A value of 3 is often used. Local histogram equalization with
  * contrast limiting is usually called CLAHE.
  *
+ * @in can be 8- or 16-bit unsigned. The output has the same format.
+ *
+ * Set @tiled to divide the image into tiles of @width by @height instead,
+ * and equalise each tile. Each output pixel is mapped with a bilinear
+ * interpolation of the four nearest tiles, so there are no seams. This is
+ * much faster than a sliding window, but the input is read twice: once to
+ * make the tile histograms, as each row of tiles is first needed, and once
+ * to map it. @max_slope has the same meaning as for the sliding window.
+ * 16-bit images are equalised with 4096 bins per tile.
+ *
  * ::: tip "Optional arguments"
  *     * @max_slope: `gint`, maximum brightening
+ *     * @tiled: `gboolean`, equalise tiles and interpolate
  *
  * ::: seealso
  *     [method@Image.hist_equal].
@@ -541,6 +541,9 @@ VIPS_API
 int vips_stats(VipsImage *in, VipsImage **out, ...)
 	G_GNUC_NULL_TERMINATED;
 VIPS_API
+int vips_summary(VipsImage *in, VipsImage **stats, ...)
+	G_GNUC_NULL_TERMINATED;
+VIPS_API
 int vips_measure(VipsImage *in, VipsImage **out, int h, int v, ...)
 	G_GNUC_NULL_TERMINATED;
 VIPS_API
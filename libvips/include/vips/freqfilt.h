@@ -57,6 +57,11 @@ VIPS_API
 int vips_phasecor(VipsImage *in1, VipsImage *in2, VipsImage **out, ...)
 	G_GNUC_NULL_TERMINATED;
 
+VIPS_API
+int vips_fft_wisdom_import(const char *filename);
+VIPS_API
+int vips_fft_wisdom_export(const char *filename);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
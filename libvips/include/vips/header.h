@@ -171,6 +171,23 @@ extern "C" {
  */
 #define VIPS_META_N_SUBIFDS "n-subifds"
 
+/**
+ * VIPS_META_PAGE_SIZES:
+ *
+ * If set, the width and height of each page in the original file, as an
+ * array of ints. Loaders use this to describe pyramids without having to
+ * open each level.
+ */
+#define VIPS_META_PAGE_SIZES "page-sizes"
+
+/**
+ * VIPS_META_SUBIFD_SIZES:
+ *
+ * If set, the width and height of each subifd in the loaded page, as an
+ * array of ints.
+ */
+#define VIPS_META_SUBIFD_SIZES "subifd-sizes"
+
 /**
  * VIPS_META_CONCURRENCY:
  *
@@ -164,6 +164,28 @@ int vips_threadset_run(VipsThreadset *set,
 	const char *domain, GFunc func, gpointer data);
 void vips_threadset_free(VipsThreadset *set);
 
+typedef void (*VipsParallelFn)(void *a, guint i, int thread);
+VIPS_API int vips__threads_reserve(int n);
+VIPS_API void vips__threads_release(int n);
+VIPS_API void vips__parallel_range(const char *domain, int n_threads,
+	guint start, guint end, VipsParallelFn fn, void *a);
+
+/* The FFT plan cache in freqfilt, shared with convolution.
+ */
+typedef enum {
+	VIPS_FFT_R2C,
+	VIPS_FFT_C2R,
+	VIPS_FFT_FORWARD,
+	VIPS_FFT_BACKWARD
+} VipsFftKind;
+
+typedef struct _VipsFftPlan VipsFftPlan;
+
+VipsFftPlan *vips__fft_plan_get(VipsFftKind kind, int width, int height,
+	void *in, void *out);
+void vips__fft_plan_unref(VipsFftPlan *plan);
+void vips__fft_plan_execute(VipsFftPlan *plan, void *in, void *out);
+
 VIPS_API void vips__worker_lock(GMutex *mutex);
 VIPS_API void vips__worker_cond_wait(GCond *cond, GMutex *mutex);
 gboolean vips__worker_exit(void);
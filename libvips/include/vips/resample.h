@@ -94,6 +94,10 @@ VIPS_API
 int vips_thumbnail_source(VipsSource *source, VipsImage **out,
 	int width, ...)
 	G_GNUC_NULL_TERMINATED;
+VIPS_API
+int vips_thumbnail_multi(const char *filename, const char *format,
+	const int *sizes, int n, ...)
+	G_GNUC_NULL_TERMINATED;
 
 VIPS_API
 int vips_similarity(VipsImage *in, VipsImage **out, ...)
@@ -23,6 +23,8 @@
  * 	- don't depend on image width when setting n_lines
  * 27/2/19 jtorresfabra
  * 	- free threadpool earlier
+ * 18/10/26
+ * 	- add vips__parallel_range() for codec-internal threading
  */
 
 /*
@@ -151,6 +153,172 @@ vips_thread_execute(const char *domain, GFunc func, gpointer data)
 	return vips_threadset_run(vips__threadset, domain, func, data);
 }
 
+/* The number of threads currently lent to codecs, see
+ * vips__threads_reserve().
+ */
+static int vips__threads_reserved = 0;
+
+/* Codecs like libjxl and openjpeg can run work in parallel. Rather than
+ * letting each image start its own set of threads, they reserve helpers
+ * from a single budget of vips_concurrency_get() threads shared by all
+ * images. This returns the number reserved, between 0 and @n.
+ */
+int
+vips__threads_reserve(int n)
+{
+	int limit = vips_concurrency_get();
+
+	int reserved;
+	int take;
+
+	do {
+		reserved = g_atomic_int_get(&vips__threads_reserved);
+		take = VIPS_CLIP(0, limit - reserved, n);
+		if (take == 0)
+			return 0;
+	} while (!g_atomic_int_compare_and_exchange(&vips__threads_reserved,
+		reserved, reserved + take));
+
+	return take;
+}
+
+void
+vips__threads_release(int n)
+{
+	if (n > 0)
+		g_atomic_int_add(&vips__threads_reserved, -n);
+}
+
+typedef struct _VipsParallel {
+	GMutex lock;
+	GCond done;
+
+	VipsParallelFn fn;
+	void *a;
+
+	/* The next value to run, and the end of the range.
+	 */
+	guint next;
+	guint end;
+
+	/* Threads currently inside fn.
+	 */
+	int n_running;
+
+	/* The next thread number to hand out.
+	 */
+	int thread;
+
+	/* The caller, plus helpers which have not yet exited. Helpers can
+	 * start after the caller has returned, so the last one out frees.
+	 */
+	int ref;
+} VipsParallel;
+
+static void
+vips_parallel_unref(VipsParallel *parallel)
+{
+	gboolean last;
+
+	g_mutex_lock(&parallel->lock);
+	last = --parallel->ref == 0;
+	g_mutex_unlock(&parallel->lock);
+
+	if (last) {
+		g_mutex_clear(&parallel->lock);
+		g_cond_clear(&parallel->done);
+		g_free(parallel);
+	}
+}
+
+static void
+vips_parallel_work(VipsParallel *parallel, int thread)
+{
+	g_mutex_lock(&parallel->lock);
+
+	while (parallel->next < parallel->end) {
+		guint i = parallel->next++;
+
+		parallel->n_running += 1;
+		g_mutex_unlock(&parallel->lock);
+
+		parallel->fn(parallel->a, i, thread);
+
+		g_mutex_lock(&parallel->lock);
+		parallel->n_running -= 1;
+	}
+
+	g_cond_broadcast(&parallel->done);
+
+	g_mutex_unlock(&parallel->lock);
+}
+
+static void
+vips_parallel_helper(void *data, void *user_data)
+{
+	VipsParallel *parallel = (VipsParallel *) data;
+
+	int thread;
+
+	g_mutex_lock(&parallel->lock);
+	thread = parallel->thread++;
+	g_mutex_unlock(&parallel->lock);
+
+	vips_parallel_work(parallel, thread);
+
+	vips__threads_release(1);
+	vips_parallel_unref(parallel);
+}
+
+/* Run @fn for every value in [@start, @end) on up to @n_threads threads.
+ *
+ * The calling thread is thread 0 and works too, so the range is always
+ * completed, even if the threadset is busy and the helpers never get to
+ * start. The @n_threads - 1 helpers must have been reserved with
+ * vips__threads_reserve(), they are released as the helpers exit. Thread
+ * numbers passed to @fn are less than @n_threads.
+ */
+void
+vips__parallel_range(const char *domain, int n_threads,
+	guint start, guint end, VipsParallelFn fn, void *a)
+{
+	VipsParallel *parallel;
+
+	parallel = g_new0(VipsParallel, 1);
+	g_mutex_init(&parallel->lock);
+	g_cond_init(&parallel->done);
+	parallel->fn = fn;
+	parallel->a = a;
+	parallel->next = start;
+	parallel->end = end;
+	parallel->thread = 1;
+	parallel->ref = 1;
+
+	for (int i = 1; i < n_threads; i++) {
+		g_mutex_lock(&parallel->lock);
+		parallel->ref += 1;
+		g_mutex_unlock(&parallel->lock);
+
+		if (vips_thread_execute(domain, vips_parallel_helper, parallel)) {
+			/* Thread create has failed, carry on with the
+			 * helpers we have.
+			 */
+			vips__threads_release(n_threads - i);
+			vips_parallel_unref(parallel);
+			break;
+		}
+	}
+
+	vips_parallel_work(parallel, 0);
+
+	g_mutex_lock(&parallel->lock);
+	while (parallel->n_running > 0)
+		g_cond_wait(&parallel->done, &parallel->lock);
+	g_mutex_unlock(&parallel->lock);
+
+	vips_parallel_unref(parallel);
+}
+
 G_DEFINE_TYPE(VipsThreadState, vips_thread_state, VIPS_TYPE_OBJECT);
 
 static void
@@ -4,6 +4,9 @@
  *	- renamed from im_segment()
  * 11/2/14
  * 	- redo as a class
+ * 18/10/26
+ * 	- label in parallel strips with union-find across the seams
+ * 	- add @stream and @stats
  */
 
 /*
@@ -39,66 +42,627 @@
 #include <glib/gi18n-lib.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include <vips/vips.h>
 #include <vips/internal.h>
 
 #include "pmorphology.h"
 
+/* Area and bounding box of a label.
+ */
+typedef struct _VipsLabelregionsBox {
+	gint64 area;
+	int left;
+	int top;
+	int right;
+	int bottom;
+} VipsLabelregionsBox;
+
+/* What we keep for each strip of the image after the first pass.
+ */
+typedef struct _VipsLabelregionsStrip {
+	/* Number of labels in this strip. Labels are numbered from 1 in order
+	 * of first appearance.
+	 */
+	int n;
+
+	/* Labels along the top line, or zero where a pixel differs from the
+	 * one above, and labels along the bottom line.
+	 */
+	int *first;
+	int *last;
+
+	/* Area and bounding box of each label.
+	 */
+	VipsLabelregionsBox *box;
+} VipsLabelregionsStrip;
+
 typedef struct _VipsLabelregions {
 	VipsMorphology parent_instance;
 
 	VipsImage *mask;
 	int segments;
+	VipsImage *stats;
+	gboolean stream;
+
+	/* We label the image in full-width strips of this many lines.
+	 */
+	int strip_height;
+	int n_strips;
+	VipsLabelregionsStrip *strips;
+
+	/* Next strip to allocate to a worker.
+	 */
+	int next;
+
+	/* The first global label in each strip, and the map from global
+	 * labels to final region numbers.
+	 */
+	int *base;
+	int *final;
 } VipsLabelregions;
 
 typedef VipsMorphologyClass VipsLabelregionsClass;
 
 G_DEFINE_TYPE(VipsLabelregions, vips_labelregions, VIPS_TYPE_MORPHOLOGY);
 
+static void
+vips_labelregions_free_strips(VipsLabelregions *labelregions)
+{
+	if (labelregions->strips) {
+		for (int i = 0; i < labelregions->n_strips; i++) {
+			VipsLabelregionsStrip *strip = &labelregions->strips[i];
+
+			VIPS_FREE(strip->first);
+			VIPS_FREE(strip->last);
+			VIPS_FREE(strip->box);
+		}
+
+		VIPS_FREE(labelregions->strips);
+	}
+}
+
+static void
+vips_labelregions_dispose(GObject *gobject)
+{
+	VipsLabelregions *labelregions = (VipsLabelregions *) gobject;
+
+	vips_labelregions_free_strips(labelregions);
+
+	G_OBJECT_CLASS(vips_labelregions_parent_class)->dispose(gobject);
+}
+
+static inline gboolean
+vips_labelregions_equal(VipsPel *a, VipsPel *b, int ps)
+{
+	if (ps == 1)
+		return a[0] == b[0];
+	else
+		return memcmp(a, b, ps) == 0;
+}
+
+/* Links always go from a larger to a smaller index, so the root of a set is
+ * always its smallest member.
+ */
+static inline int
+vips_labelregions_find(int *parent, int i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+
+	return i;
+}
+
+static inline void
+vips_labelregions_union(int *parent, int a, int b)
+{
+	a = vips_labelregions_find(parent, a);
+	b = vips_labelregions_find(parent, b);
+
+	if (a < b)
+		parent[b] = a;
+	else if (b < a)
+		parent[a] = b;
+}
+
+/* Replace each entry of @parent with the number of its set, counting from
+ * 1 in order of each set's smallest member. Return the number of sets.
+ */
+static int
+vips_labelregions_compact(int *parent, int n)
+{
+	int serial;
+
+	/* Entries always point to a smaller index, so everything below @i
+	 * has already been renumbered.
+	 */
+	serial = 1;
+	for (int i = 0; i < n; i++)
+		if (parent[i] == i)
+			parent[i] = serial++;
+		else
+			parent[i] = parent[parent[i]];
+
+	return serial - 1;
+}
+
+/* Label a full-width strip of @ir, @height lines from @top, into @labels.
+ * Regions are numbered from 1 in order of first appearance. @parent must
+ * have room for a label per pixel. Return the number of regions.
+ */
+static int
+vips_labelregions_strip(VipsRegion *ir, int top, int height,
+	int *labels, int *parent)
+{
+	const int width = ir->im->Xsize;
+	const int ps = VIPS_IMAGE_SIZEOF_PEL(ir->im);
+
+	int n;
+
+	/* Provisional labels, with a union for every join.
+	 */
+	n = 0;
+	for (int y = 0; y < height; y++) {
+		VipsPel *p = VIPS_REGION_ADDR(ir, 0, top + y);
+		VipsPel *above = p - VIPS_REGION_LSKIP(ir);
+		int *l = labels + y * width;
+		int *la = l - width;
+
+		for (int x = 0; x < width; x++) {
+			gboolean left = x > 0 &&
+				vips_labelregions_equal(p, p - ps, ps);
+			gboolean up = y > 0 &&
+				vips_labelregions_equal(p, above, ps);
+
+			if (left) {
+				l[x] = l[x - 1];
+				if (up &&
+					la[x] != l[x])
+					vips_labelregions_union(parent, la[x], l[x]);
+			}
+			else if (up)
+				l[x] = la[x];
+			else {
+				parent[n] = n;
+				l[x] = n;
+				n += 1;
+			}
+
+			p += ps;
+			above += ps;
+		}
+	}
+
+	/* A region's first pixel always gets a new label, so set roots are in
+	 * order of first appearance.
+	 */
+	n = vips_labelregions_compact(parent, n);
+
+	for (int i = 0; i < width * height; i++)
+		labels[i] = parent[labels[i]];
+
+	return n;
+}
+
+static int
+vips_labelregions_allocate(VipsThreadState *state, void *a, gboolean *stop)
+{
+	VipsLabelregions *labelregions = (VipsLabelregions *) a;
+
+	if (labelregions->next >= labelregions->n_strips) {
+		*stop = TRUE;
+		return 0;
+	}
+
+	state->y = labelregions->next;
+	labelregions->next += 1;
+
+	return 0;
+}
+
+/* First pass: label a strip with local region numbers, and note the joins
+ * with the strip above, plus region sizes.
+ */
+static int
+vips_labelregions_label_work(VipsThreadState *state, void *a)
+{
+	VipsLabelregions *labelregions = (VipsLabelregions *) a;
+	VipsImage *in = state->im;
+	VipsLabelregionsStrip *strip = &labelregions->strips[state->y];
+	const int width = in->Xsize;
+	const int top = state->y * labelregions->strip_height;
+	const int height =
+		VIPS_MIN(labelregions->strip_height, in->Ysize - top);
+	const int ps = VIPS_IMAGE_SIZEOF_PEL(in);
+
+	VipsRect area;
+	int *labels;
+	int *parent;
+
+	/* We need the line above too, if there is one.
+	 */
+	area.left = 0;
+	area.top = VIPS_MAX(0, top - 1);
+	area.width = width;
+	area.height = top + height - area.top;
+	if (vips_region_prepare(state->reg, &area))
+		return -1;
+
+	if (labelregions->stream)
+		labels = VIPS_ARRAY(NULL, (size_t) width * height, int);
+	else
+		labels = (int *) VIPS_IMAGE_ADDR(labelregions->mask, 0, top);
+	parent = VIPS_ARRAY(NULL, (size_t) width * height, int);
+	if (!labels ||
+		!parent) {
+		if (labelregions->stream)
+			VIPS_FREE(labels);
+		VIPS_FREE(parent);
+		return -1;
+	}
+
+	strip->n = vips_labelregions_strip(state->reg, top, height,
+		labels, parent);
+
+	VIPS_FREE(parent);
+
+	if (!(strip->first = VIPS_ARRAY(NULL, width, int)) ||
+		!(strip->last = VIPS_ARRAY(NULL, width, int)) ||
+		!(strip->box = VIPS_ARRAY(NULL, strip->n, VipsLabelregionsBox))) {
+		if (labelregions->stream)
+			VIPS_FREE(labels);
+		return -1;
+	}
+
+	if (top > 0) {
+		VipsPel *p = VIPS_REGION_ADDR(state->reg, 0, top);
+		VipsPel *above = VIPS_REGION_ADDR(state->reg, 0, top - 1);
+
+		for (int x = 0; x < width; x++)
+			strip->first[x] =
+				vips_labelregions_equal(p + x * ps, above + x * ps, ps)
+				? labels[x]
+				: 0;
+	}
+	else
+		memset(strip->first, 0, width * sizeof(int));
+	memcpy(strip->last, labels + (height - 1) * width, width * sizeof(int));
+
+	for (int i = 0; i < strip->n; i++) {
+		VipsLabelregionsBox *box = &strip->box[i];
+
+		box->area = 0;
+		box->left = width;
+		box->top = in->Ysize;
+		box->right = -1;
+		box->bottom = -1;
+	}
+
+	for (int y = 0; y < height; y++) {
+		int *l = labels + y * width;
+
+		for (int x = 0; x < width; x++) {
+			VipsLabelregionsBox *box = &strip->box[l[x] - 1];
+
+			box->area += 1;
+			box->left = VIPS_MIN(box->left, x);
+			box->right = VIPS_MAX(box->right, x);
+			box->top = VIPS_MIN(box->top, top + y);
+			box->bottom = VIPS_MAX(box->bottom, top + y);
+		}
+	}
+
+	if (labelregions->stream)
+		VIPS_FREE(labels);
+
+	return 0;
+}
+
+/* Second pass: map local labels in the memory mask to final region numbers.
+ */
+static int
+vips_labelregions_relabel_work(VipsThreadState *state, void *a)
+{
+	VipsLabelregions *labelregions = (VipsLabelregions *) a;
+	VipsImage *mask = labelregions->mask;
+	const int top = state->y * labelregions->strip_height;
+	const int height =
+		VIPS_MIN(labelregions->strip_height, mask->Ysize - top);
+	const int *final = labelregions->final + labelregions->base[state->y] - 1;
+	int *l = (int *) VIPS_IMAGE_ADDR(mask, 0, top);
+
+	for (size_t i = 0; i < (size_t) mask->Xsize * height; i++)
+		l[i] = final[l[i]];
+
+	return 0;
+}
+
+/* Join regions across strip boundaries, and number them. Return the number
+ * of segments, or -1 on error.
+ */
+static int
+vips_labelregions_merge(VipsLabelregions *labelregions, int width)
+{
+	VipsLabelregionsStrip *strips = labelregions->strips;
+
+	int n;
+
+	if (!(labelregions->base = VIPS_ARRAY(labelregions,
+			  labelregions->n_strips, int)))
+		return -1;
+
+	n = 0;
+	for (int i = 0; i < labelregions->n_strips; i++) {
+		labelregions->base[i] = n;
+		n += strips[i].n;
+	}
+
+	if (!(labelregions->final = VIPS_ARRAY(labelregions, n, int)))
+		return -1;
+	for (int i = 0; i < n; i++)
+		labelregions->final[i] = i;
+
+	for (int i = 1; i < labelregions->n_strips; i++) {
+		int *first = strips[i].first;
+		int *last = strips[i - 1].last;
+		int a = labelregions->base[i - 1] - 1;
+		int b = labelregions->base[i] - 1;
+
+		for (int x = 0; x < width; x++)
+			if (first[x])
+				vips_labelregions_union(labelregions->final,
+					a + last[x], b + first[x]);
+	}
+
+	/* Strips are in order and local labels are in order of first
+	 * appearance, so numbering by smallest member keeps the raster order
+	 * of the old flood-fill labeller.
+	 */
+	return vips_labelregions_compact(labelregions->final, n) + 1;
+}
+
+static int
+vips_labelregions_make_stats(VipsLabelregions *labelregions, int segments)
+{
+	VipsImage *stats;
+	VipsLabelregionsBox *boxes;
+
+	if (!(boxes = VIPS_ARRAY(NULL, segments, VipsLabelregionsBox)))
+		return -1;
+	for (int i = 0; i < segments; i++) {
+		boxes[i].area = 0;
+		boxes[i].left = INT_MAX;
+		boxes[i].top = INT_MAX;
+		boxes[i].right = -1;
+		boxes[i].bottom = -1;
+	}
+
+	for (int i = 0; i < labelregions->n_strips; i++) {
+		VipsLabelregionsStrip *strip = &labelregions->strips[i];
+		const int *final = labelregions->final + labelregions->base[i];
+
+		for (int j = 0; j < strip->n; j++) {
+			VipsLabelregionsBox *from = &strip->box[j];
+			VipsLabelregionsBox *to = &boxes[final[j]];
+
+			to->area += from->area;
+			to->left = VIPS_MIN(to->left, from->left);
+			to->top = VIPS_MIN(to->top, from->top);
+			to->right = VIPS_MAX(to->right, from->right);
+			to->bottom = VIPS_MAX(to->bottom, from->bottom);
+		}
+	}
+
+	/* Row 0 is the unused label zero, leave it blank.
+	 */
+	stats = vips_image_new_matrix(5, segments);
+	for (int i = 1; i < segments; i++) {
+		*VIPS_MATRIX(stats, 0, i) = boxes[i].area;
+		*VIPS_MATRIX(stats, 1, i) = boxes[i].left;
+		*VIPS_MATRIX(stats, 2, i) = boxes[i].top;
+		*VIPS_MATRIX(stats, 3, i) = boxes[i].right - boxes[i].left + 1;
+		*VIPS_MATRIX(stats, 4, i) = boxes[i].bottom - boxes[i].top + 1;
+	}
+
+	g_object_set(labelregions,
+		"stats", stats,
+		NULL);
+
+	VIPS_FREE(boxes);
+
+	return 0;
+}
+
+typedef struct {
+	VipsRegion *ir;
+
+	/* The strip we have labels for, or -1.
+	 */
+	int strip;
+	int *labels;
+	int *parent;
+} VipsLabelregionsSequence;
+
+static int
+vips_labelregions_stop(void *vseq, void *a, void *b)
+{
+	VipsLabelregionsSequence *seq = (VipsLabelregionsSequence *) vseq;
+
+	VIPS_UNREF(seq->ir);
+	VIPS_FREE(seq->labels);
+	VIPS_FREE(seq->parent);
+	VIPS_FREE(seq);
+
+	return 0;
+}
+
+static void *
+vips_labelregions_start(VipsImage *out, void *a, void *b)
+{
+	VipsImage *in = (VipsImage *) a;
+	VipsLabelregions *labelregions = (VipsLabelregions *) b;
+	size_t n = (size_t) in->Xsize * labelregions->strip_height;
+	VipsLabelregionsSequence *seq;
+
+	if (!(seq = VIPS_NEW(NULL, VipsLabelregionsSequence)))
+		return NULL;
+	seq->ir = NULL;
+	seq->strip = -1;
+	seq->labels = NULL;
+	seq->parent = NULL;
+
+	if (!(seq->ir = vips_region_new(in)) ||
+		!(seq->labels = VIPS_ARRAY(NULL, n, int)) ||
+		!(seq->parent = VIPS_ARRAY(NULL, n, int))) {
+		vips_labelregions_stop(seq, in, labelregions);
+		return NULL;
+	}
+
+	return (void *) seq;
+}
+
+/* Streaming output: label whole strips again and map to final numbers.
+ */
+static int
+vips_labelregions_gen(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsLabelregionsSequence *seq = (VipsLabelregionsSequence *) vseq;
+	VipsImage *in = (VipsImage *) a;
+	VipsLabelregions *labelregions = (VipsLabelregions *) b;
+	VipsRect *r = &out_region->valid;
+
+	for (int y = r->top; y < VIPS_RECT_BOTTOM(r); y++) {
+		int i = y / labelregions->strip_height;
+		int top = i * labelregions->strip_height;
+		const int *final = labelregions->final + labelregions->base[i] - 1;
+		int *q = (int *) VIPS_REGION_ADDR(out_region, r->left, y);
+
+		int *l;
+
+		if (seq->strip != i) {
+			VipsRect area;
+
+			area.left = 0;
+			area.top = top;
+			area.width = in->Xsize;
+			area.height =
+				VIPS_MIN(labelregions->strip_height, in->Ysize - top);
+			if (vips_region_prepare(seq->ir, &area))
+				return -1;
+
+			vips_labelregions_strip(seq->ir, top, area.height,
+				seq->labels, seq->parent);
+			seq->strip = i;
+		}
+
+		l = seq->labels + (y - top) * in->Xsize + r->left;
+		for (int x = 0; x < r->width; x++)
+			q[x] = final[l[x]];
+	}
+
+	return 0;
+}
+
 static int
 vips_labelregions_build(VipsObject *object)
 {
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
 	VipsMorphology *morphology = VIPS_MORPHOLOGY(object);
+	VipsLabelregions *labelregions = (VipsLabelregions *) object;
 	VipsImage *in = morphology->in;
-	VipsImage **t = (VipsImage **) vips_object_local_array(object, 2);
-	VipsImage *mask;
 
+	VipsImage *mask;
 	int segments;
-	int *m;
-	int x, y;
 
 	if (VIPS_OBJECT_CLASS(vips_labelregions_parent_class)->build(object))
 		return -1;
 
-	/* Create the zero mask image in memory.
+	if (vips_check_coding_known(class->nickname, in))
+		return -1;
+
+	/* Strips of around 4M pixels keep the per-thread working set
+	 * reasonable, and the seams between them few.
 	 */
-	if (vips_black(&t[0], in->Xsize, in->Ysize, NULL) ||
-		vips_cast(t[0], &t[1], VIPS_FORMAT_INT, NULL) ||
-		!(t[2] = vips_image_copy_memory(t[1])))
+	labelregions->strip_height =
+		VIPS_CLIP(64, (4 << 20) / in->Xsize, 1024);
+	labelregions->n_strips =
+		(in->Ysize + labelregions->strip_height - 1) /
+		labelregions->strip_height;
+	if (!(labelregions->strips = VIPS_ARRAY(NULL,
+			  labelregions->n_strips, VipsLabelregionsStrip)))
 		return -1;
+	memset(labelregions->strips, 0,
+		labelregions->n_strips * sizeof(VipsLabelregionsStrip));
 
-	mask = t[2];
-	g_object_set(object,
-		"mask", mask,
-		NULL);
+	/* Without streaming, the first pass labels straight into the mask.
+	 */
+	if (!labelregions->stream) {
+		g_object_set(object,
+			"mask", vips_image_new_memory(),
+			NULL);
+		mask = labelregions->mask;
+
+		vips_image_init_fields(mask,
+			in->Xsize, in->Ysize, 1,
+			VIPS_FORMAT_INT, VIPS_CODING_NONE,
+			VIPS_INTERPRETATION_B_W, in->Xres, in->Yres);
+		if (vips_image_write_prepare(mask))
+			return -1;
+	}
 
-	segments = 1;
-	m = (int *) mask->data;
-	for (y = 0; y < mask->Ysize; y++) {
-		for (x = 0; x < mask->Xsize; x++) {
-			if (!m[x]) {
-				/* Use a direct path for speed.
-				 */
-				if (vips__draw_flood_direct(mask, in,
-						segments, x, y))
-					return -1;
-
-				segments += 1;
-			}
-		}
+	labelregions->next = 0;
+	if (vips_threadpool_run(in,
+			vips_thread_state_new,
+			vips_labelregions_allocate,
+			vips_labelregions_label_work,
+			NULL,
+			labelregions))
+		return -1;
+
+	if ((segments = vips_labelregions_merge(labelregions, in->Xsize)) < 0 ||
+		vips_labelregions_make_stats(labelregions, segments))
+		return -1;
 
-		m += mask->Xsize;
+	vips_labelregions_free_strips(labelregions);
+
+	if (!labelregions->stream) {
+		labelregions->next = 0;
+		if (vips_threadpool_run(labelregions->mask,
+				vips_thread_state_new,
+				vips_labelregions_allocate,
+				vips_labelregions_relabel_work,
+				NULL,
+				labelregions))
+			return -1;
+	}
+	else {
+		g_object_set(object,
+			"mask", vips_image_new(),
+			NULL);
+		mask = labelregions->mask;
+
+		/* We generate whole strips, so FATSTRIP.
+		 */
+		if (vips_image_pipelinev(mask,
+				VIPS_DEMAND_STYLE_FATSTRIP, in, NULL))
+			return -1;
+		mask->Bands = 1;
+		mask->BandFmt = VIPS_FORMAT_INT;
+		mask->Coding = VIPS_CODING_NONE;
+		mask->Type = VIPS_INTERPRETATION_B_W;
+
+		if (vips_image_generate(mask,
+				vips_labelregions_start,
+				vips_labelregions_gen,
+				vips_labelregions_stop,
+				in, labelregions))
+			return -1;
 	}
 
 	g_object_set(object,
@@ -114,6 +678,7 @@ vips_labelregions_class_init(VipsLabelregionsClass *class)
 	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
 	VipsObjectClass *vobject_class = VIPS_OBJECT_CLASS(class);
 
+	gobject_class->dispose = vips_labelregions_dispose;
 	gobject_class->set_property = vips_object_set_property;
 	gobject_class->get_property = vips_object_get_property;
 
@@ -133,6 +698,19 @@ vips_labelregions_class_init(VipsLabelregionsClass *class)
 		VIPS_ARGUMENT_OPTIONAL_OUTPUT,
 		G_STRUCT_OFFSET(VipsLabelregions, segments),
 		0, 1000000000, 0);
+
+	VIPS_ARG_IMAGE(class, "stats", 4,
+		_("Stats"),
+		_("Area and bounding box of each region"),
+		VIPS_ARGUMENT_OPTIONAL_OUTPUT,
+		G_STRUCT_OFFSET(VipsLabelregions, stats));
+
+	VIPS_ARG_BOOL(class, "stream", 5,
+		_("Stream"),
+		_("Generate the mask on demand rather than in memory"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsLabelregions, stream),
+		FALSE);
 }
 
 static void
@@ -148,15 +726,24 @@ vips_labelregions_init(VipsLabelregions *labelregions)
  *
  * Label regions of equal pixels in an image.
  *
- * Repeatedly scans @in for regions of 4-connected pixels
- * with the same pixel value. Every time a region is discovered, those
- * pixels are marked in @mask with a unique serial number. Once all pixels
- * have been labelled, the operation returns, setting @segments to the number
- * of discrete regions which were detected.
+ * Scans @in for regions of 4-connected pixels with the same pixel value.
+ * Each region is marked in @mask with a unique serial number, counting from
+ * 1 in the order in which regions are first met in a raster scan. @segments
+ * is set to one more than the number of discrete regions which were
+ * detected.
  *
  * @mask is always a 1-band [enum@Vips.BandFormat.INT] image of the same
  * dimensions as @in.
  *
+ * The image is labelled in parallel strips, which are then joined. By
+ * default @mask is built in memory. Set @stream to instead generate @mask on
+ * demand, so memory use does not depend on image size. @in is computed
+ * twice in this case.
+ *
+ * @stats is a matrix image with a row for each region number, and columns
+ * for area, left, top, width and height of the region's bounding box. Row 0
+ * is unused.
+ *
  * This operation is useful for, for example, blob counting. You can use the
  * morphological operators to detect and isolate a series of objects, then use
  * [method@Image.labelregions] to number them all.
@@ -165,6 +752,8 @@ vips_labelregions_init(VipsLabelregions *labelregions)
  *
  * ::: tip "Optional arguments"
  *     * @segments: `gint`, output, number of regions found
+ *     * @stats: [class@Image], output, area and bounding box of each region
+ *     * @stream: `gboolean`, generate @mask on demand
  *
  * ::: seealso
  *     [method@Image.hist_find_indexed].
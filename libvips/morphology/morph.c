@@ -26,6 +26,9 @@
  * 25/2/20 kleisauke
  * 	- rewritten as a class
  * 	- merged with hitmiss
+ * 18/10/26
+ * 	- add a van Herk/Gil-Werman path for masks which are a union of
+ * 	  rectangles, eg. rectangles, lines and disks
  */
 
 /*
@@ -66,6 +69,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 
 #include <vips/vips.h>
@@ -133,6 +137,12 @@ typedef struct {
 
 	guint8 *coeff; /* Mask coefficients */
 
+	/* If the mask is a union of rectangles of 255, the rectangles in mask
+	 * coordinates, for the van Herk/Gil-Werman path.
+	 */
+	int n_rect;
+	VipsRect *rect;
+
 #ifdef HAVE_ORC
 	/* The passes we generate for this mask.
 	 */
@@ -157,6 +167,16 @@ typedef struct {
 
 	int last_bpl; /* Avoid recalcing offsets, if we can */
 
+	/* Buffers for the van Herk/Gil-Werman path: the horizontal pass
+	 * result, suffixes for each pass, a running prefix. We grow these
+	 * as regions need them.
+	 */
+	VipsPel *hpass;
+	VipsPel *suffix;
+	VipsPel *hsuffix;
+	VipsPel *prefix;
+	size_t vhgw_size;
+
 #ifdef HAVE_ORC
 	/* In vector mode we need a pair of intermediate buffers to keep the
 	 * results of each pass in.
@@ -188,6 +208,10 @@ vips_morph_stop(void *vseq, void *a, void *b)
 	VipsMorphSequence *seq = (VipsMorphSequence *) vseq;
 
 	VIPS_UNREF(seq->ir);
+	VIPS_FREE(seq->hpass);
+	VIPS_FREE(seq->suffix);
+	VIPS_FREE(seq->hsuffix);
+	VIPS_FREE(seq->prefix);
 #ifdef HAVE_ORC
 	VIPS_FREE(seq->t1);
 	VIPS_FREE(seq->t2);
@@ -218,6 +242,11 @@ vips_morph_start(VipsImage *out, void *a, void *b)
 	seq->nn128 = 0;
 	seq->coeff = NULL;
 	seq->last_bpl = -1;
+	seq->hpass = NULL;
+	seq->suffix = NULL;
+	seq->hsuffix = NULL;
+	seq->prefix = NULL;
+	seq->vhgw_size = 0;
 #ifdef HAVE_ORC
 	seq->t1 = NULL;
 	seq->t2 = NULL;
@@ -825,6 +854,324 @@ vips_erode_gen(VipsRegion *out_region,
 	return 0;
 }
 
+#define VHGW_OP(A, B) (dilate ? (A) | (B) : (A) & (B))
+
+/* van Herk/Gil-Werman along a line: q[x] is the AND (or OR) of the k pixels
+ * from p[x]. Split p into blocks of k pixels, keep a suffix within each
+ * block and a running prefix, then each output is a single suffix op prefix,
+ * whatever the size of k.
+ */
+static void
+vips_morph_vhgw_h(VipsPel *restrict q, VipsPel *restrict p,
+	VipsPel *restrict suffix, VipsPel *restrict prefix,
+	int bands, int n, int k, gboolean dilate, gboolean accumulate)
+{
+	const int len = n + k - 1;
+
+	for (int b = 0; b < len; b += k) {
+		int end = VIPS_MIN(b + k, len) - 1;
+
+		memcpy(suffix + end * bands, p + end * bands, bands);
+		for (int x = end - 1; x >= b; x--)
+			for (int z = 0; z < bands; z++)
+				suffix[x * bands + z] = VHGW_OP(p[x * bands + z],
+					suffix[(x + 1) * bands + z]);
+	}
+
+	memcpy(prefix, p, bands);
+	for (int x = 1; x < k - 1; x++)
+		for (int z = 0; z < bands; z++)
+			prefix[z] = VHGW_OP(prefix[z], p[x * bands + z]);
+
+	for (int x = 0; x < n; x++) {
+		const int e = x + k - 1;
+
+		if (e % k == 0)
+			memcpy(prefix, p + e * bands, bands);
+		else
+			for (int z = 0; z < bands; z++)
+				prefix[z] = VHGW_OP(prefix[z], p[e * bands + z]);
+
+		for (int z = 0; z < bands; z++) {
+			VipsPel v = VHGW_OP(suffix[x * bands + z], prefix[z]);
+
+			q[x * bands + z] = accumulate ? VHGW_OP(q[x * bands + z], v) : v;
+		}
+	}
+}
+
+/* The same, but down columns, so we can work a whole line at a time.
+ */
+static void
+vips_morph_vhgw_v(VipsPel *out, int out_lsk, VipsPel *in, int in_lsk,
+	VipsPel *restrict suffix, VipsPel *restrict prefix,
+	int ne, int n, int k, gboolean dilate, gboolean accumulate)
+{
+	const int rows = n + k - 1;
+
+#ifdef HAVE_HWY
+	if (vips_vector_isenabled()) {
+		vips_morph_vhgw_uchar_hwy(out, out_lsk, in, in_lsk,
+			suffix, prefix, ne, n, k, dilate, accumulate);
+		return;
+	}
+#endif /*HAVE_HWY*/
+
+	if (k == 1) {
+		for (int y = 0; y < n; y++) {
+			VipsPel *q = out + y * out_lsk;
+			VipsPel *p = in + y * in_lsk;
+
+			for (int x = 0; x < ne; x++)
+				q[x] = accumulate ? VHGW_OP(q[x], p[x]) : p[x];
+		}
+
+		return;
+	}
+
+	for (int b = 0; b < rows; b += k) {
+		int end = VIPS_MIN(b + k, rows) - 1;
+
+		memcpy(suffix + end * ne, in + end * in_lsk, ne);
+		for (int y = end - 1; y >= b; y--) {
+			VipsPel *s = suffix + y * ne;
+			VipsPel *p = in + y * in_lsk;
+
+			for (int x = 0; x < ne; x++)
+				s[x] = VHGW_OP(p[x], s[x + ne]);
+		}
+	}
+
+	memcpy(prefix, in, ne);
+	for (int y = 1; y < k - 1; y++) {
+		VipsPel *p = in + y * in_lsk;
+
+		for (int x = 0; x < ne; x++)
+			prefix[x] = VHGW_OP(prefix[x], p[x]);
+	}
+
+	for (int y = 0; y < n; y++) {
+		const int e = y + k - 1;
+		VipsPel *p = in + e * in_lsk;
+		VipsPel *s = suffix + y * ne;
+		VipsPel *q = out + y * out_lsk;
+
+		if (e % k == 0)
+			memcpy(prefix, p, ne);
+		else
+			for (int x = 0; x < ne; x++)
+				prefix[x] = VHGW_OP(prefix[x], p[x]);
+
+		for (int x = 0; x < ne; x++) {
+			VipsPel v = VHGW_OP(s[x], prefix[x]);
+
+			q[x] = accumulate ? VHGW_OP(q[x], v) : v;
+		}
+	}
+}
+
+/* Make sure the sequence buffers are large enough for @r.
+ */
+static int
+vips_morph_vhgw_alloc(VipsMorphSequence *seq, VipsRect *r)
+{
+	VipsMorph *morph = seq->morph;
+	const int bands = seq->ir->im->Bands;
+	size_t size = (size_t) (r->height + morph->M->Ysize) *
+		(r->width + morph->M->Xsize) * bands;
+
+	if (size > seq->vhgw_size) {
+		VIPS_FREE(seq->hpass);
+		VIPS_FREE(seq->suffix);
+		VIPS_FREE(seq->hsuffix);
+		VIPS_FREE(seq->prefix);
+
+		if (!(seq->hpass = VIPS_ARRAY(NULL, size, VipsPel)) ||
+			!(seq->suffix = VIPS_ARRAY(NULL, size, VipsPel)) ||
+			!(seq->hsuffix = VIPS_ARRAY(NULL, size, VipsPel)) ||
+			!(seq->prefix = VIPS_ARRAY(NULL, size, VipsPel))) {
+			seq->vhgw_size = 0;
+			return -1;
+		}
+
+		seq->vhgw_size = size;
+	}
+
+	return 0;
+}
+
+/* Erode or dilate by each rectangle in turn with separable van
+ * Herk/Gil-Werman passes, and join the results.
+ */
+static int
+vips_morph_vhgw_gen(VipsRegion *out_region,
+	void *vseq, void *a, void *b, gboolean *stop)
+{
+	VipsMorphSequence *seq = (VipsMorphSequence *) vseq;
+	VipsMorph *morph = (VipsMorph *) b;
+	VipsImage *M = morph->M;
+	VipsRegion *ir = seq->ir;
+	VipsRect *r = &out_region->valid;
+	const int bands = ir->im->Bands;
+	const int ne = r->width * bands;
+	const gboolean dilate =
+		morph->morph == VIPS_OPERATION_MORPHOLOGY_DILATE;
+
+	VipsRect s;
+
+	/* Prepare the section of the input image we need. A little larger
+	 * than the section of the output image we are producing.
+	 */
+	s = *r;
+	s.width += M->Xsize - 1;
+	s.height += M->Ysize - 1;
+	if (vips_region_prepare(ir, &s))
+		return -1;
+
+	if (vips_morph_vhgw_alloc(seq, r))
+		return -1;
+
+	VIPS_GATE_START("vips_morph_vhgw_gen: work");
+
+	for (int i = 0; i < morph->n_rect; i++) {
+		VipsRect *rect = &morph->rect[i];
+		const gboolean accumulate = i > 0;
+
+		VipsPel *t;
+		int t_lsk;
+
+		if (rect->height == 1) {
+			/* Horizontal line: straight to the output.
+			 */
+			for (int y = 0; y < r->height; y++)
+				vips_morph_vhgw_h(
+					VIPS_REGION_ADDR(out_region, r->left, r->top + y),
+					VIPS_REGION_ADDR(ir,
+						r->left + rect->left, r->top + rect->top + y),
+					seq->hsuffix, seq->prefix,
+					bands, r->width, rect->width,
+					dilate, accumulate);
+
+			continue;
+		}
+
+		if (rect->width == 1) {
+			/* Vertical line: no horizontal pass.
+			 */
+			t = VIPS_REGION_ADDR(ir,
+				r->left + rect->left, r->top + rect->top);
+			t_lsk = VIPS_REGION_LSKIP(ir);
+		}
+		else {
+			for (int y = 0; y < r->height + rect->height - 1; y++)
+				vips_morph_vhgw_h(seq->hpass + y * ne,
+					VIPS_REGION_ADDR(ir,
+						r->left + rect->left, r->top + rect->top + y),
+					seq->hsuffix, seq->prefix,
+					bands, r->width, rect->width,
+					dilate, FALSE);
+			t = seq->hpass;
+			t_lsk = ne;
+		}
+
+		vips_morph_vhgw_v(
+			VIPS_REGION_ADDR(out_region, r->left, r->top),
+			VIPS_REGION_LSKIP(out_region),
+			t, t_lsk, seq->suffix, seq->prefix,
+			ne, r->height, rect->height, dilate, accumulate);
+	}
+
+	VIPS_GATE_STOP("vips_morph_vhgw_gen: work");
+
+	VIPS_COUNT_PIXELS(out_region, "vips_morph_vhgw_gen");
+
+	return 0;
+}
+
+/* Try to express the mask as a union of rectangles of 255. Each line must
+ * have at most one run of 255, with everything else 128. Each line's run
+ * then gives a rectangle, extended up and down while the lines above and
+ * below contain the run. Erode and dilate by a union are the AND and OR of
+ * erode and dilate by each part, so this is exact.
+ *
+ * Return the number of 255 elements, or 0 if the mask can't be split.
+ */
+static int
+vips_morph_rectangles(VipsMorph *morph)
+{
+	VipsImage *M = morph->M;
+	const int width = M->Xsize;
+	const int height = M->Ysize;
+
+	int *left;
+	int *right;
+	int n_set;
+
+	if (!(left = VIPS_ARRAY(morph, height, int)) ||
+		!(right = VIPS_ARRAY(morph, height, int)) ||
+		!(morph->rect = VIPS_ARRAY(morph, height, VipsRect)))
+		return 0;
+
+	n_set = 0;
+	for (int y = 0; y < height; y++) {
+		guint8 *coeff = morph->coeff + y * width;
+
+		left[y] = -1;
+		right[y] = -2;
+		for (int x = 0; x < width; x++) {
+			if (coeff[x] == 0)
+				return 0;
+			if (coeff[x] == 255) {
+				if (left[y] == -1)
+					left[y] = x;
+				else if (right[y] != x - 1)
+					/* A second run on this line.
+					 */
+					return 0;
+
+				right[y] = x;
+				n_set += 1;
+			}
+		}
+	}
+
+	morph->n_rect = 0;
+	for (int y = 0; y < height; y++) {
+		VipsRect rect;
+		int top, bottom;
+		int i;
+
+		if (left[y] == -1)
+			continue;
+
+		for (top = y; top > 0; top--)
+			if (left[top - 1] == -1 ||
+				left[top - 1] > left[y] ||
+				right[top - 1] < right[y])
+				break;
+		for (bottom = y; bottom < height - 1; bottom++)
+			if (left[bottom + 1] == -1 ||
+				left[bottom + 1] > left[y] ||
+				right[bottom + 1] < right[y])
+				break;
+
+		rect.left = left[y];
+		rect.top = top;
+		rect.width = right[y] - left[y] + 1;
+		rect.height = bottom - top + 1;
+
+		for (i = 0; i < morph->n_rect; i++)
+			if (vips_rect_equalsrect(&rect, &morph->rect[i]))
+				break;
+		if (i == morph->n_rect) {
+			morph->rect[i] = rect;
+			morph->n_rect += 1;
+		}
+	}
+
+	return n_set;
+}
+
 static int
 vips_morph_build(VipsObject *object)
 {
@@ -838,6 +1185,7 @@ vips_morph_build(VipsObject *object)
 	VipsGenerateFn generate;
 	double *coeff;
 	int i;
+	int n_set;
 
 	if (VIPS_OBJECT_CLASS(vips_morph_parent_class)->build(object))
 		return -1;
@@ -891,8 +1239,18 @@ vips_morph_build(VipsObject *object)
 		morph->coeff[i] = (guint8) coeff[i];
 	}
 
-	/* Try to make a vector path.
+	/* Try to make a fast path. If the mask is a union of a few rectangles,
+	 * eg. a rectangle, a line or a disk, van Herk/Gil-Werman needs around
+	 * six ops per pixel per rectangle, whatever the size. Otherwise, try
+	 * to make a vector path.
 	 */
+	n_set = vips_morph_rectangles(morph);
+	if (n_set > 0 &&
+		morph->n_rect * 8 < n_set) {
+		generate = vips_morph_vhgw_gen;
+		g_info("morph: using van Herk/Gil-Werman path");
+	}
+	else
 #ifdef HAVE_HWY
 	if (vips_vector_isenabled()) {
 		generate = morph->morph == VIPS_OPERATION_MORPHOLOGY_DILATE
@@ -983,6 +1341,8 @@ vips_morph_init(VipsMorph *morph)
 {
 	morph->morph = VIPS_OPERATION_MORPHOLOGY_ERODE;
 	morph->coeff = NULL;
+	morph->n_rect = 0;
+	morph->rect = NULL;
 }
 
 /**
@@ -1021,6 +1381,11 @@ vips_morph_init(VipsMorph *morph)
  * and [method@Image.eorimage]
  * for analogues of the usual set difference and set union operations.
  *
+ * Masks which are a union of rectangles of 255, for example rectangles,
+ * horizontal and vertical lines, and disks, are evaluated with the van
+ * Herk/Gil-Werman algorithm, so the cost per pixel depends on the number of
+ * rectangles rather than the size of the mask.
+ *
  * Operations are performed using the processor's vector unit,
  * if possible. Disable this with `--vips-novector` or `VIPS_NOVECTOR` or
  * [func@vector_set_enabled].
@@ -2,6 +2,8 @@
  * 	- initial implementation
  * 20/08/23 kleisauke
  * 	- speed-up implementation
+ * 18/10/26
+ * 	- add van Herk/Gil-Werman vertical pass
  */
 
 /*
@@ -39,6 +41,7 @@
 #include <cstdio>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <cmath>
 
 #include <vips/vips.h>
@@ -168,11 +171,101 @@ vips_erode_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
 	}
 }
 
+/* q = a | b for dilate, q = a & b for erode. q may be a.
+ */
+template <bool dilate>
+HWY_ATTR HWY_INLINE void
+vips_morph_row(uint8_t *q, const uint8_t *a, const uint8_t *b, int32_t ne)
+{
+	HWY_LANES_CONSTEXPR int32_t N = Lanes(du8);
+
+	int32_t x = 0;
+	for (; x + N <= ne; x += N) {
+		auto va = LoadU(du8, a + x);
+		auto vb = LoadU(du8, b + x);
+
+		StoreU(dilate ? Or(va, vb) : And(va, vb), du8, q + x);
+	}
+
+	for (; x < ne; ++x)
+		q[x] = dilate ? a[x] | b[x] : a[x] & b[x];
+}
+
+/* Each output line is the AND (or OR) of k input lines. Split the input
+ * into blocks of k lines and keep a suffix within each block, and a running
+ * prefix, then every output line is a single suffix op prefix.
+ */
+template <bool dilate>
+HWY_ATTR HWY_INLINE void
+vips_morph_vhgw(uint8_t *out, int32_t out_lsk,
+	const uint8_t *in, int32_t in_lsk,
+	uint8_t *HWY_RESTRICT suffix, uint8_t *HWY_RESTRICT prefix,
+	int32_t ne, int32_t n, int32_t k, bool accumulate)
+{
+	const int32_t rows = n + k - 1;
+
+	if (k == 1) {
+		for (int32_t y = 0; y < n; ++y)
+			if (accumulate)
+				vips_morph_row<dilate>(out + y * out_lsk,
+					out + y * out_lsk, in + y * in_lsk, ne);
+			else
+				memcpy(out + y * out_lsk, in + y * in_lsk, ne);
+
+		return;
+	}
+
+	for (int32_t b = 0; b < rows; b += k) {
+		int32_t end = HWY_MIN(b + k, rows) - 1;
+
+		memcpy(suffix + end * ne, in + end * in_lsk, ne);
+		for (int32_t y = end - 1; y >= b; --y)
+			vips_morph_row<dilate>(suffix + y * ne,
+				in + y * in_lsk, suffix + (y + 1) * ne, ne);
+	}
+
+	memcpy(prefix, in, ne);
+	for (int32_t z = 1; z < k - 1; ++z)
+		vips_morph_row<dilate>(prefix, prefix, in + z * in_lsk, ne);
+
+	for (int32_t y = 0; y < n; ++y) {
+		const int32_t z = y + k - 1;
+		uint8_t *q = out + y * out_lsk;
+
+		if (z % k == 0)
+			memcpy(prefix, in + z * in_lsk, ne);
+		else
+			vips_morph_row<dilate>(prefix, prefix, in + z * in_lsk, ne);
+
+		if (accumulate) {
+			vips_morph_row<dilate>(q, q, suffix + y * ne, ne);
+			vips_morph_row<dilate>(q, q, prefix, ne);
+		}
+		else
+			vips_morph_row<dilate>(q, suffix + y * ne, prefix, ne);
+	}
+}
+
+HWY_ATTR void
+vips_morph_vhgw_uchar_hwy(VipsPel *out, int32_t out_lsk,
+	const VipsPel *in, int32_t in_lsk,
+	VipsPel *HWY_RESTRICT suffix, VipsPel *HWY_RESTRICT prefix,
+	int32_t ne, int32_t n, int32_t k, int32_t dilate, int32_t accumulate)
+{
+	if (dilate)
+		vips_morph_vhgw<true>(out, out_lsk, in, in_lsk,
+			suffix, prefix, ne, n, k, accumulate);
+	else
+		vips_morph_vhgw<false>(out, out_lsk, in, in_lsk,
+			suffix, prefix, ne, n, k, accumulate);
+}
+
 } /*namespace HWY_NAMESPACE*/
 
 #if HWY_ONCE
 HWY_EXPORT(vips_dilate_uchar_hwy);
 HWY_EXPORT(vips_erode_uchar_hwy);
+HWY_EXPORT(vips_morph_vhgw_uchar_hwy);
 
 void
 vips_dilate_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
@@ -193,6 +286,18 @@ vips_erode_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
 		nn128, offsets, coeff);
 	/* clang-format on */
 }
+
+void
+vips_morph_vhgw_uchar_hwy(VipsPel *out, int out_lsk,
+	const VipsPel *in, int in_lsk, VipsPel *restrict suffix,
+	VipsPel *restrict prefix, int ne, int n, int k,
+	gboolean dilate, gboolean accumulate)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_morph_vhgw_uchar_hwy)(out, out_lsk,
+		in, in_lsk, suffix, prefix, ne, n, k, dilate, accumulate);
+	/* clang-format on */
+}
 #endif /*HWY_ONCE*/
 
 #endif /*HAVE_HWY*/
@@ -71,6 +71,11 @@ void vips_dilate_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
 void vips_erode_uchar_hwy(VipsRegion *out_region, VipsRegion *ir, VipsRect *r,
 	int sz, int nn128, int *restrict offsets, guint8 *restrict coeff);
 
+void vips_morph_vhgw_uchar_hwy(VipsPel *out, int out_lsk,
+	const VipsPel *in, int in_lsk, VipsPel *restrict suffix,
+	VipsPel *restrict prefix, int ne, int n, int k,
+	gboolean dilate, gboolean accumulate);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
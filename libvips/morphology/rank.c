@@ -28,6 +28,9 @@
  * 	- oop, allow index == 0, thanks Rob
  * 12/1/21
  * 	- add hist path for large windows on uchar images
+ * 18/10/26
+ * 	- add a two-level hist path for 16-bit images
+ * 	- add a sorted window path for 32-bit images
  */
 
 /*
@@ -85,6 +88,10 @@ typedef struct _VipsRank {
 
 	gboolean hist_path;
 
+	/* Keep a sorted copy of the window for 32-bit images.
+	 */
+	gboolean sort_path;
+
 } VipsRank;
 
 typedef VipsMorphologyClass VipsRankClass;
@@ -103,6 +110,20 @@ typedef struct {
 	/* For large uchar images, the sort histogram.
 	 */
 	unsigned int **hist;
+
+	/* For large 16-bit images, a fine histogram with a bin for every
+	 * value and a coarse one with a bin for every top byte.
+	 */
+	unsigned int *fine;
+	unsigned int *coarse;
+
+	/* For large 32-bit images, the sorted window, a buffer we merge
+	 * into, and the columns leaving and entering the window.
+	 */
+	guint32 *window;
+	guint32 *merge;
+	guint32 *column_out;
+	guint32 *column_in;
 } VipsRankSequence;
 
 static int
@@ -119,6 +140,12 @@ vips_rank_stop(void *vseq, void *a, void *b)
 		for (int i = 0; i < in->Bands; i++)
 			VIPS_FREE(seq->hist[i]);
 	VIPS_FREE(seq->hist);
+	VIPS_FREE(seq->fine);
+	VIPS_FREE(seq->coarse);
+	VIPS_FREE(seq->window);
+	VIPS_FREE(seq->merge);
+	VIPS_FREE(seq->column_out);
+	VIPS_FREE(seq->column_in);
 	VIPS_FREE(seq);
 
 	return 0;
@@ -136,6 +163,12 @@ vips_rank_start(VipsImage *out, void *a, void *b)
 	seq->ir = NULL;
 	seq->sort = NULL;
 	seq->hist = NULL;
+	seq->fine = NULL;
+	seq->coarse = NULL;
+	seq->window = NULL;
+	seq->merge = NULL;
+	seq->column_out = NULL;
+	seq->column_in = NULL;
 
 	seq->ir = vips_region_new(in);
 	if (!(seq->sort = VIPS_ARRAY(NULL,
@@ -144,7 +177,20 @@ vips_rank_start(VipsImage *out, void *a, void *b)
 		return NULL;
 	}
 
-	if (rank->hist_path) {
+	if (rank->hist_path &&
+		in->BandFmt != VIPS_FORMAT_UCHAR) {
+		/* The 16-bit path removes the last window at the end of each
+		 * line, so we only need to zero the histograms once.
+		 */
+		if (!(seq->fine = VIPS_ARRAY(NULL, 65536, unsigned int)) ||
+			!(seq->coarse = VIPS_ARRAY(NULL, 256, unsigned int))) {
+			vips_rank_stop(seq, in, rank);
+			return NULL;
+		}
+		memset(seq->fine, 0, 65536 * sizeof(unsigned int));
+		memset(seq->coarse, 0, 256 * sizeof(unsigned int));
+	}
+	else if (rank->hist_path) {
 		if (!(seq->hist = VIPS_ARRAY(NULL, in->Bands, unsigned int *))) {
 			vips_rank_stop(seq, in, rank);
 			return NULL;
@@ -157,6 +203,18 @@ vips_rank_start(VipsImage *out, void *a, void *b)
 			}
 	}
 
+	if (rank->sort_path) {
+		if (!(seq->window = VIPS_ARRAY(NULL, rank->n, guint32)) ||
+			!(seq->merge = VIPS_ARRAY(NULL, rank->n, guint32)) ||
+			!(seq->column_out =
+					VIPS_ARRAY(NULL, rank->height, guint32)) ||
+			!(seq->column_in =
+					VIPS_ARRAY(NULL, rank->height, guint32))) {
+			vips_rank_stop(seq, in, rank);
+			return NULL;
+		}
+	}
+
 	return (void *) seq;
 }
 
@@ -231,6 +289,283 @@ vips_rank_generate_uchar(VipsRegion *out_region,
 	}
 }
 
+/* Histogram path for large 16-bit ranks.
+ *
+ * A 65536-bin histogram is too large to search for every output pixel, so
+ * we also keep a 256-bin coarse histogram of the top byte, and track the
+ * coarse bin holding the index-th value as the window slides. Finding the
+ * value is then a short walk in the coarse histogram plus a scan of at most
+ * 256 fine bins.
+ */
+static void
+vips_rank_generate_16(VipsRegion *out_region,
+	VipsRankSequence *seq, VipsRank *rank, int y)
+{
+	VipsImage *in = seq->ir->im;
+	VipsRect *r = &out_region->valid;
+	const int bands = in->Bands;
+	const int lsk = VIPS_REGION_LSKIP(seq->ir) / sizeof(unsigned short);
+	const int next = bands * rank->width;
+	const unsigned int index = rank->index;
+
+	/* Flip the sign bit of signed shorts to get an unsigned bin index
+	 * with the same ordering.
+	 */
+	const unsigned short flip =
+		in->BandFmt == VIPS_FORMAT_SHORT ? 0x8000 : 0;
+
+	unsigned int *restrict fine = seq->fine;
+	unsigned int *restrict coarse = seq->coarse;
+
+	/* Get input and output pointers for this line.
+	 */
+	unsigned short *restrict p = (unsigned short *)
+		VIPS_REGION_ADDR(seq->ir, r->left, r->top + y);
+	unsigned short *restrict q = (unsigned short *)
+		VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+
+	for (int b = 0; b < bands; b++) {
+		unsigned short *restrict p1;
+		unsigned int cb;
+		unsigned int below;
+
+		/* Find histogram for the first output pixel.
+		 */
+		p1 = p + b;
+		for (int j = 0; j < rank->height; j++) {
+			for (int i = 0; i < next; i += bands) {
+				int v = p1[i] ^ flip;
+
+				fine[v] += 1;
+				coarse[v >> 8] += 1;
+			}
+
+			p1 += lsk;
+		}
+
+		/* The coarse bin we think holds the result, and the number of
+		 * values in the bins below it.
+		 */
+		cb = 0;
+		below = 0;
+
+		for (int x = 0; x < r->width; x++) {
+			unsigned int *restrict f;
+			unsigned int sum;
+			int value;
+
+			/* Move to the coarse bin holding the index-th value.
+			 */
+			while (below + coarse[cb] <= index) {
+				below += coarse[cb];
+				cb += 1;
+			}
+			while (below > index) {
+				cb -= 1;
+				below -= coarse[cb];
+			}
+
+			/* And scan the fine bins within it.
+			 */
+			f = fine + (cb << 8);
+			sum = below;
+			for (value = 0; value < 255; value++) {
+				sum += f[value];
+				if (sum > index)
+					break;
+			}
+			q[x * bands + b] = ((cb << 8) | value) ^ flip;
+
+			/* Adapt histogram -- remove the pels from the left hand
+			 * column, add in pels for a new right-hand column.
+			 */
+			p1 = p + x * bands + b;
+			for (int j = 0; j < rank->height; j++) {
+				int v0 = p1[0] ^ flip;
+				int v1 = p1[next] ^ flip;
+
+				fine[v0] -= 1;
+				coarse[v0 >> 8] -= 1;
+				below -= (unsigned int) (v0 >> 8) < cb;
+
+				fine[v1] += 1;
+				coarse[v1 >> 8] += 1;
+				below += (unsigned int) (v1 >> 8) < cb;
+
+				p1 += lsk;
+			}
+		}
+
+		/* Remove the final window, leaving the histograms zeroed for
+		 * the next band.
+		 */
+		p1 = p + r->width * bands + b;
+		for (int j = 0; j < rank->height; j++) {
+			for (int i = 0; i < next; i += bands) {
+				int v = p1[i] ^ flip;
+
+				fine[v] -= 1;
+				coarse[v >> 8] -= 1;
+			}
+
+			p1 += lsk;
+		}
+	}
+}
+
+/* Map 32-bit values to unsigned keys with the same ordering. Floats get a
+ * total order, so NaN is handled consistently.
+ */
+static inline guint32
+vips_rank_key(guint32 v, VipsBandFormat format)
+{
+	switch (format) {
+	case VIPS_FORMAT_INT:
+		return v ^ 0x80000000;
+
+	case VIPS_FORMAT_FLOAT:
+		return (v & 0x80000000) ? ~v : v | 0x80000000;
+
+	default:
+		return v;
+	}
+}
+
+static inline guint32
+vips_rank_unkey(guint32 k, VipsBandFormat format)
+{
+	switch (format) {
+	case VIPS_FORMAT_INT:
+		return k ^ 0x80000000;
+
+	case VIPS_FORMAT_FLOAT:
+		return (k & 0x80000000) ? k & 0x7fffffff : ~k;
+
+	default:
+		return k;
+	}
+}
+
+static int
+vips_rank_compare_key(const void *a, const void *b)
+{
+	guint32 ka = *((guint32 *) a);
+	guint32 kb = *((guint32 *) b);
+
+	return ka < kb ? -1 : ka > kb ? 1 : 0;
+}
+
+static void
+vips_rank_sort_keys(guint32 *keys, int n)
+{
+	/* Columns are usually short, insert-sort them.
+	 */
+	if (n > 32)
+		qsort(keys, n, sizeof(guint32), vips_rank_compare_key);
+	else
+		for (int i = 1; i < n; i++) {
+			guint32 k = keys[i];
+			int j;
+
+			for (j = i; j > 0 && keys[j - 1] > k; j--)
+				keys[j] = keys[j - 1];
+			keys[j] = k;
+		}
+}
+
+/* Sorted window path for large 32-bit ranks.
+ *
+ * Keep the window sorted as it slides along the line. Each step sorts the
+ * outgoing and incoming columns, then makes the new window with a single
+ * merge pass, so the index-th value is just a lookup.
+ */
+static void
+vips_rank_generate_sort(VipsRegion *out_region,
+	VipsRankSequence *seq, VipsRank *rank, int y)
+{
+	VipsImage *in = seq->ir->im;
+	VipsBandFormat format = in->BandFmt;
+	VipsRect *r = &out_region->valid;
+	const int bands = in->Bands;
+	const int lsk = VIPS_REGION_LSKIP(seq->ir) / sizeof(guint32);
+	const int next = bands * rank->width;
+	const int n = rank->n;
+	const int height = rank->height;
+
+	/* Get input and output pointers for this line.
+	 */
+	guint32 *restrict p = (guint32 *)
+		VIPS_REGION_ADDR(seq->ir, r->left, r->top + y);
+	guint32 *restrict q = (guint32 *)
+		VIPS_REGION_ADDR(out_region, r->left, r->top + y);
+
+	for (int b = 0; b < bands; b++) {
+		guint32 *restrict p1;
+		int k;
+
+		/* Sort the window for the first output pixel.
+		 */
+		p1 = p + b;
+		k = 0;
+		for (int j = 0; j < height; j++) {
+			for (int i = 0; i < next; i += bands)
+				seq->window[k++] = vips_rank_key(p1[i], format);
+
+			p1 += lsk;
+		}
+		qsort(seq->window, n, sizeof(guint32), vips_rank_compare_key);
+
+		for (int x = 0; x < r->width; x++) {
+			guint32 *restrict window = seq->window;
+			guint32 *restrict merge = seq->merge;
+			guint32 *restrict column_out = seq->column_out;
+			guint32 *restrict column_in = seq->column_in;
+			int o, c, m;
+
+			q[x * bands + b] =
+				vips_rank_unkey(window[rank->index], format);
+
+			/* The left-hand column leaves, a new right-hand column
+			 * arrives.
+			 */
+			p1 = p + x * bands + b;
+			for (int j = 0; j < height; j++) {
+				column_out[j] = vips_rank_key(p1[0], format);
+				column_in[j] = vips_rank_key(p1[next], format);
+
+				p1 += lsk;
+			}
+			vips_rank_sort_keys(column_out, height);
+			vips_rank_sort_keys(column_in, height);
+
+			/* Every outgoing key is in the window, so we can drop
+			 * them in order as we meet them.
+			 */
+			o = 0;
+			c = 0;
+			m = 0;
+			for (int i = 0; i < n; i++) {
+				guint32 w = window[i];
+
+				if (o < height &&
+					w == column_out[o]) {
+					o += 1;
+					continue;
+				}
+
+				while (c < height &&
+					column_in[c] <= w)
+					merge[m++] = column_in[c++];
+				merge[m++] = w;
+			}
+			while (c < height)
+				merge[m++] = column_in[c++];
+
+			VIPS_SWAP(guint32 *, seq->window, seq->merge);
+		}
+	}
+}
+
 /* Inner loop for select-sorting TYPE.
  */
 #define LOOP_SELECT(TYPE) \
@@ -442,8 +777,13 @@ vips_rank_generate(VipsRegion *out_region,
 	ls = VIPS_REGION_LSKIP(ir) / VIPS_IMAGE_SIZEOF_ELEMENT(in);
 
 	for (int y = 0; y < r->height; y++) {
-		if (rank->hist_path)
+		if (rank->hist_path &&
+			in->BandFmt == VIPS_FORMAT_UCHAR)
 			vips_rank_generate_uchar(out_region, seq, rank, y);
+		else if (rank->hist_path)
+			vips_rank_generate_16(out_region, seq, rank, y);
+		else if (rank->sort_path)
+			vips_rank_generate_sort(out_region, seq, rank, y);
 		else if (rank->index == 0)
 			SWITCH(LOOP_MIN)
 		else if (rank->index == rank->n - 1)
@@ -501,6 +841,29 @@ vips_rank_build(VipsObject *object)
 			rank->index != rank->n - 1)
 			rank->hist_path = TRUE;
 	}
+	else if (in->BandFmt == VIPS_FORMAT_USHORT ||
+		in->BandFmt == VIPS_FORMAT_SHORT) {
+		/* The two-level hist has a larger setup cost per line, so
+		 * needs a slightly larger window to pay off.
+		 */
+		if (rank->n > 90)
+			rank->hist_path = TRUE;
+		else if (rank->n > 25 &&
+			rank->index != 0 &&
+			rank->index != rank->n - 1)
+			rank->hist_path = TRUE;
+	}
+	else if (in->BandFmt == VIPS_FORMAT_UINT ||
+		in->BandFmt == VIPS_FORMAT_INT ||
+		in->BandFmt == VIPS_FORMAT_FLOAT) {
+		/* Max and min are a simple scan, so the sorted window only
+		 * helps the select case.
+		 */
+		if (rank->n > 25 &&
+			rank->index != 0 &&
+			rank->index != rank->n - 1)
+			rank->sort_path = TRUE;
+	}
 
 	/* Expand the input.
 	 */
@@ -615,6 +978,12 @@ vips_rank_init(VipsRank *rank)
  * The special cases n == 0 and n == m * m - 1 are useful dilate and
  * expand operators.
  *
+ * Large windows on 8 and 16-bit images use a sliding histogram, so the cost
+ * per pixel grows with the window height rather than the window area.
+ * Large windows on 32-bit images keep a sorted copy of the window and merge
+ * each new column into it. This is still linear in the window area, but much
+ * cheaper than selecting from the whole window at every pixel.
+ *
  * ::: seealso
  *     [method@Image.conv], [method@Image.median], [method@Image.spcor].
  *
@@ -90,6 +90,8 @@
  * 	- premultiply alpha
  * 18/5/20
  * 	- add "premultiplied" flag
+ * 18/10/26
+ * 	- interpolate runs of pixels with a row method, if we can
  */
 
 /*
@@ -250,6 +252,15 @@ vips_affine_gen(VipsRegion *out_region,
 	int ps = VIPS_IMAGE_SIZEOF_PEL(in);
 	int x, y, z;
 
+	/* If the interpolator has a row method, we batch up runs of
+	 * in-range pixels here.
+	 */
+	VipsInterpolateRowMethod interpolate_row;
+	double run_x[VIPS_INTERPOLATE_RUN];
+	double run_y[VIPS_INTERPOLATE_RUN];
+	VipsPel *run_q;
+	int n;
+
 	VipsRect image, want, need, clipped;
 
 #ifdef DEBUG_VERBOSE
@@ -317,6 +328,8 @@ vips_affine_gen(VipsRegion *out_region,
 	if (vips_region_prepare(ir, &clipped))
 		return -1;
 
+	interpolate_row = vips__interpolate_get_row_method(interpolate, ir);
+
 	VIPS_GATE_START("vips_affine_gen: work");
 
 	/* Resample! x/y loop over pixels in the output image (5).
@@ -362,6 +375,8 @@ vips_affine_gen(VipsRegion *out_region,
 		iy += window_offset;
 
 		q = VIPS_REGION_ADDR(out_region, le, y);
+		run_q = q;
+		n = 0;
 
 		for (x = le; x < ri; x++) {
 			int fx, fy;
@@ -387,11 +402,32 @@ vips_affine_gen(VipsRegion *out_region,
 					(int) iy - window_offset +
 						window_size - 1));
 
-				interpolate_method(interpolate, q, ir, ix, iy);
+				if (interpolate_row) {
+					if (n == 0)
+						run_q = q;
+					run_x[n] = ix;
+					run_y[n] = iy;
+					n += 1;
+
+					if (n == VIPS_INTERPOLATE_RUN) {
+						interpolate_row(interpolate,
+							run_q, ir, run_x, run_y, n);
+						n = 0;
+					}
+				}
+				else
+					interpolate_method(interpolate, q, ir, ix, iy);
 			}
 			else {
-				/* Out of range: paint the background.
+				/* Out of range: finish any run, then paint the
+				 * background.
 				 */
+				if (n > 0) {
+					interpolate_row(interpolate,
+						run_q, ir, run_x, run_y, n);
+					n = 0;
+				}
+
 				for (z = 0; z < ps; z++)
 					q[z] = affine->ink[z];
 			}
@@ -400,6 +436,9 @@ vips_affine_gen(VipsRegion *out_region,
 			iy += ddy;
 			q += ps;
 		}
+
+		if (n > 0)
+			interpolate_row(interpolate, run_q, ir, run_x, run_y, n);
 	}
 
 	VIPS_GATE_STOP("vips_affine_gen: work");
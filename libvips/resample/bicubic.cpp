@@ -4,6 +4,8 @@
  * 	- revise window_size / window_offset stuff again
  * 7/2/16
  * 	- double intermediate for 32-bit int types
+ * 18/10/26
+ * 	- add a row method for Highway
  */
 
 /*
@@ -52,6 +54,7 @@
 #include <vips/vips.h>
 #include <vips/internal.h>
 
+#include "presample.h"
 #include "templates.h"
 
 #define VIPS_TYPE_INTERPOLATE_BICUBIC \
@@ -618,6 +621,23 @@ vips_interpolate_bicubic_interpolate(VipsInterpolate *interpolate,
 	}
 }
 
+#ifdef HAVE_HWY
+/* Interpolate a run of pixels with Highway. Only called for uchar, ushort
+ * and float, see vips__interpolate_get_row_method().
+ */
+void
+vips__interpolate_bicubic_row(VipsInterpolate *interpolate,
+	void *out, VipsRegion *in, const double *x, const double *y, int n)
+{
+	vips_interpolate_bicubic_row_hwy((VipsPel *) out,
+		VIPS_REGION_ADDR(in, in->valid.left, in->valid.top),
+		in->im->BandFmt, in->im->Bands,
+		VIPS_REGION_LSKIP(in), in->valid.left, in->valid.top,
+		x, y, n,
+		&vips_bicubic_matrixi[0][0], &vips_bicubic_matrixf[0][0]);
+}
+#endif /*HAVE_HWY*/
+
 static void
 vips_interpolate_bicubic_class_init(VipsInterpolateBicubicClass *iclass)
 {
@@ -18,6 +18,8 @@
  * 	- faster bilinear
  * 27/2/19 s-sajid-ali
  * 	- more accurate bilinear
+ * 18/10/26
+ * 	- add row-at-a-time nearest, bilinear and bicubic with Highway
  */
 
 /*
@@ -58,10 +60,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include <vips/vips.h>
+#include <vips/vector.h>
 #include <vips/internal.h>
 
+#include "presample.h"
+
 /**
  * VipsInterpolate:
  *
@@ -604,6 +610,67 @@ vips_interpolate_bilinear_static(void)
 	return interpolate;
 }
 
+#ifdef HAVE_HWY
+static void
+vips_interpolate_nearest_row(VipsInterpolate *interpolate,
+	void *out, VipsRegion *in, const double *x, const double *y, int n)
+{
+	vips_interpolate_nearest_row_hwy((VipsPel *) out,
+		VIPS_REGION_ADDR(in, in->valid.left, in->valid.top),
+		VIPS_REGION_LSKIP(in), in->valid.left, in->valid.top,
+		x, y, n);
+}
+
+static void
+vips_interpolate_bilinear_row(VipsInterpolate *interpolate,
+	void *out, VipsRegion *in, const double *x, const double *y, int n)
+{
+	vips_interpolate_bilinear_row_hwy((VipsPel *) out,
+		VIPS_REGION_ADDR(in, in->valid.left, in->valid.top),
+		in->im->BandFmt, in->im->Bands,
+		VIPS_REGION_LSKIP(in), in->valid.left, in->valid.top,
+		x, y, n);
+}
+#endif /*HAVE_HWY*/
+
+/* Find a method to interpolate a run of pixels from @in, or NULL if there's
+ * no fast path for this interpolator and region and the caller must
+ * interpolate a pixel at a time.
+ *
+ * @in must have been prepared, since the vector paths address the region
+ * with 32-bit offsets.
+ */
+VipsInterpolateRowMethod
+vips__interpolate_get_row_method(VipsInterpolate *interpolate,
+	VipsRegion *in)
+{
+#ifdef HAVE_HWY
+	GType type = G_OBJECT_TYPE(interpolate);
+	VipsImage *im = in->im;
+
+	if (!vips_vector_isenabled() ||
+		(gint64) VIPS_REGION_LSKIP(in) * in->valid.height > INT_MAX)
+		return NULL;
+
+	if (type == VIPS_TYPE_INTERPOLATE_NEAREST &&
+		VIPS_IMAGE_SIZEOF_PEL(im) == 4)
+		return vips_interpolate_nearest_row;
+
+	if (im->Coding != VIPS_CODING_NONE ||
+		(im->BandFmt != VIPS_FORMAT_UCHAR &&
+			im->BandFmt != VIPS_FORMAT_USHORT &&
+			im->BandFmt != VIPS_FORMAT_FLOAT))
+		return NULL;
+
+	if (type == VIPS_TYPE_INTERPOLATE_BILINEAR)
+		return vips_interpolate_bilinear_row;
+	if (type == vips_interpolate_bicubic_get_type())
+		return vips__interpolate_bicubic_row;
+#endif /*HAVE_HWY*/
+
+	return NULL;
+}
+
 /* Called on startup: register the base libvips interpolators.
  */
 void
@@ -0,0 +1,507 @@
+/* row-at-a-time nearest, bilinear and bicubic interpolation
+ *
+ * 18/10/26
+ * 	- from reduceh_hwy.cpp
+ */
+
+/*
+
+	This file is part of VIPS.
+
+	VIPS is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+	02110-1301  USA
+
+ */
+
+/*
+
+	These files are distributed with VIPS - http://www.vips.ecs.soton.ac.uk
+
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /*HAVE_CONFIG_H*/
+#include <glib/gi18n-lib.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <cmath>
+
+#include <vips/vips.h>
+#include <vips/vector.h>
+#include <vips/debug.h>
+#include <vips/internal.h>
+
+#include "presample.h"
+
+#ifdef HAVE_HWY
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "libvips/resample/interpolate_hwy.cpp"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+namespace HWY_NAMESPACE {
+
+using namespace hwy::HWY_NAMESPACE;
+
+/* Output pixels are computed across the vector, one band at a time. Cap the
+ * vector length so the per-lane scratch arrays can live on the stack.
+ */
+#define MAX_LANES (16)
+
+using DI32 = CappedTag<int32_t, MAX_LANES>;
+using DU32 = CappedTag<uint32_t, MAX_LANES>;
+using DF64 = CappedTag<double, MAX_LANES>;
+using DF32 = Rebind<float, DF64>;
+constexpr DI32 di32;
+constexpr DU32 du32;
+constexpr DF64 df64;
+constexpr DF32 df32;
+
+/* Copy 4-byte pixels with a gather.
+ */
+HWY_ATTR void
+vips_interpolate_nearest_row_hwy(VipsPel *pout, const VipsPel *pin,
+	int32_t lskip, int32_t left, int32_t top,
+	const double *HWY_RESTRICT x, const double *HWY_RESTRICT y, int32_t n)
+{
+	const int32_t N = Lanes(du32);
+	const uint32_t *HWY_RESTRICT p = (const uint32_t *) pin;
+	const int32_t l1 = lskip / 4;
+
+	HWY_ALIGN int32_t index[MAX_LANES];
+	HWY_ALIGN uint32_t result[MAX_LANES];
+
+	for (int32_t i = 0; i < n; i += N) {
+		const int32_t count = HWY_MIN(N, n - i);
+
+		/* Repeat the last pixel to pad the vector.
+		 */
+		for (int32_t j = 0; j < N; j++) {
+			const int32_t k = i + HWY_MIN(j, count - 1);
+
+			index[j] = ((int) y[k] - top) * l1 + ((int) x[k] - left);
+		}
+
+		auto pix = GatherIndex(du32, p, Load(di32, index));
+
+		Store(pix, du32, result);
+		memcpy(pout + i * 4, result, count * 4);
+	}
+}
+
+/* Fixed-point bilinear for 8 and 16-bit unsigned types. This must match
+ * BILINEAR_INT in interpolate.c.
+ */
+template <typename T>
+HWY_ATTR HWY_INLINE void
+bilinear_int(T *HWY_RESTRICT q, const T *HWY_RESTRICT p,
+	int32_t bands, int32_t l1, int32_t left, int32_t top,
+	const double *HWY_RESTRICT x, const double *HWY_RESTRICT y, int32_t n)
+{
+	const int32_t N = Lanes(di32);
+	const auto scale = Set(di32, VIPS_INTERPOLATE_SCALE);
+	const auto round_by = Set(di32, VIPS_INTERPOLATE_SCALE >> 1);
+
+	HWY_ALIGN int32_t offset[MAX_LANES];
+	HWY_ALIGN int32_t fx[MAX_LANES];
+	HWY_ALIGN int32_t fy[MAX_LANES];
+	HWY_ALIGN int32_t pix[4][MAX_LANES];
+	HWY_ALIGN int32_t result[MAX_LANES];
+
+	for (int32_t i = 0; i < n; i += N) {
+		const int32_t count = HWY_MIN(N, n - i);
+
+		for (int32_t j = 0; j < N; j++) {
+			const int32_t k = i + HWY_MIN(j, count - 1);
+			const int ix = (int) x[k];
+			const int iy = (int) y[k];
+
+			offset[j] = (iy - top) * l1 + (ix - left) * bands;
+			fx[j] = (x[k] - ix) * VIPS_INTERPOLATE_SCALE;
+			fy[j] = (y[k] - iy) * VIPS_INTERPOLATE_SCALE;
+		}
+
+		const auto X = Load(di32, fx);
+		const auto Y = Load(di32, fy);
+		const auto Yd = Sub(scale, Y);
+
+		const auto c4 = ShiftRight<VIPS_INTERPOLATE_SHIFT>(Mul(Y, X));
+		const auto c2 = ShiftRight<VIPS_INTERPOLATE_SHIFT>(Mul(Yd, X));
+		const auto c3 = Sub(Y, c4);
+		const auto c1 = Sub(Yd, c2);
+
+		for (int32_t b = 0; b < bands; b++) {
+			for (int32_t j = 0; j < N; j++) {
+				const T *HWY_RESTRICT p1 = p + offset[j] + b;
+
+				pix[0][j] = p1[0];
+				pix[1][j] = p1[bands];
+				pix[2][j] = p1[l1];
+				pix[3][j] = p1[l1 + bands];
+			}
+
+			auto sum = Mul(c1, Load(di32, pix[0]));
+			sum = Add(sum, Mul(c2, Load(di32, pix[1])));
+			sum = Add(sum, Mul(c3, Load(di32, pix[2])));
+			sum = Add(sum, Mul(c4, Load(di32, pix[3])));
+			sum = ShiftRight<VIPS_INTERPOLATE_SHIFT>(Add(sum, round_by));
+
+			Store(sum, di32, result);
+			for (int32_t j = 0; j < count; j++)
+				q[(i + j) * bands + b] = result[j];
+		}
+	}
+}
+
+/* Bilinear for float, with double arithmetic. This must match
+ * BILINEAR_FLOAT in interpolate.c.
+ */
+HWY_ATTR HWY_INLINE void
+bilinear_float(float *HWY_RESTRICT q, const float *HWY_RESTRICT p,
+	int32_t bands, int32_t l1, int32_t left, int32_t top,
+	const double *HWY_RESTRICT x, const double *HWY_RESTRICT y, int32_t n)
+{
+	const int32_t N = Lanes(df64);
+	const auto one = Set(df64, 1.0);
+
+	HWY_ALIGN int32_t offset[MAX_LANES];
+	HWY_ALIGN double fx[MAX_LANES];
+	HWY_ALIGN double fy[MAX_LANES];
+	HWY_ALIGN double pix[4][MAX_LANES];
+	HWY_ALIGN double result[MAX_LANES];
+
+	for (int32_t i = 0; i < n; i += N) {
+		const int32_t count = HWY_MIN(N, n - i);
+
+		for (int32_t j = 0; j < N; j++) {
+			const int32_t k = i + HWY_MIN(j, count - 1);
+			const int ix = (int) x[k];
+			const int iy = (int) y[k];
+
+			offset[j] = (iy - top) * l1 + (ix - left) * bands;
+			fx[j] = x[k] - ix;
+			fy[j] = y[k] - iy;
+		}
+
+		const auto X = Load(df64, fx);
+		const auto Y = Load(df64, fy);
+		const auto Yd = Sub(one, Y);
+
+		const auto c4 = Mul(Y, X);
+		const auto c2 = Mul(Yd, X);
+		const auto c3 = Sub(Y, c4);
+		const auto c1 = Sub(Yd, c2);
+
+		for (int32_t b = 0; b < bands; b++) {
+			for (int32_t j = 0; j < N; j++) {
+				const float *HWY_RESTRICT p1 = p + offset[j] + b;
+
+				pix[0][j] = p1[0];
+				pix[1][j] = p1[bands];
+				pix[2][j] = p1[l1];
+				pix[3][j] = p1[l1 + bands];
+			}
+
+			auto sum = Mul(c1, Load(df64, pix[0]));
+			sum = Add(sum, Mul(c2, Load(df64, pix[1])));
+			sum = Add(sum, Mul(c3, Load(df64, pix[2])));
+			sum = Add(sum, Mul(c4, Load(df64, pix[3])));
+
+			Store(sum, df64, result);
+			for (int32_t j = 0; j < count; j++)
+				q[(i + j) * bands + b] = result[j];
+		}
+	}
+}
+
+/* Find the top-left of the 4x4 stencil and the mask index for each lane.
+ * This must match vips_interpolate_bicubic_interpolate().
+ */
+HWY_ATTR HWY_INLINE void
+bicubic_prepare(int32_t *HWY_RESTRICT offset,
+	int32_t *HWY_RESTRICT tx, int32_t *HWY_RESTRICT ty,
+	int32_t N, int32_t i, int32_t count,
+	int32_t bands, int32_t l1, int32_t left, int32_t top,
+	const double *HWY_RESTRICT x, const double *HWY_RESTRICT y)
+{
+	for (int32_t j = 0; j < N; j++) {
+		const int32_t k = i + HWY_MIN(j, count - 1);
+		const int sx = x[k] * VIPS_TRANSFORM_SCALE * 2;
+		const int sy = y[k] * VIPS_TRANSFORM_SCALE * 2;
+		const int six = sx & (VIPS_TRANSFORM_SCALE * 2 - 1);
+		const int siy = sy & (VIPS_TRANSFORM_SCALE * 2 - 1);
+		const int ix = (int) x[k];
+		const int iy = (int) y[k];
+
+		offset[j] = (iy - 1 - top) * l1 + (ix - 1 - left) * bands;
+		tx[j] = (six + 1) >> 1;
+		ty[j] = (siy + 1) >> 1;
+	}
+}
+
+/* Fixed-point bicubic for 8-bit unsigned. This must match
+ * bicubic_unsigned_int().
+ */
+template <typename T, int max_value>
+HWY_ATTR HWY_INLINE void
+bicubic_int(T *HWY_RESTRICT q, const T *HWY_RESTRICT p,
+	int32_t bands, int32_t l1, int32_t left, int32_t top,
+	const double *HWY_RESTRICT x, const double *HWY_RESTRICT y, int32_t n,
+	const int *HWY_RESTRICT matrixi)
+{
+	const int32_t N = Lanes(di32);
+	const auto round_by = Set(di32, VIPS_INTERPOLATE_SCALE >> 1);
+	const auto zero = Zero(di32);
+	const auto max = Set(di32, max_value);
+
+	HWY_ALIGN int32_t offset[MAX_LANES];
+	HWY_ALIGN int32_t tx[MAX_LANES];
+	HWY_ALIGN int32_t ty[MAX_LANES];
+	HWY_ALIGN int32_t cx[4][MAX_LANES];
+	HWY_ALIGN int32_t cy[4][MAX_LANES];
+	HWY_ALIGN int32_t pix[16][MAX_LANES];
+	HWY_ALIGN int32_t result[MAX_LANES];
+
+	for (int32_t i = 0; i < n; i += N) {
+		const int32_t count = HWY_MIN(N, n - i);
+
+		bicubic_prepare(offset, tx, ty, N, i, count,
+			bands, l1, left, top, x, y);
+
+		for (int32_t j = 0; j < N; j++)
+			for (int32_t c = 0; c < 4; c++) {
+				cx[c][j] = matrixi[tx[j] * 4 + c];
+				cy[c][j] = matrixi[ty[j] * 4 + c];
+			}
+
+		const auto cx0 = Load(di32, cx[0]);
+		const auto cx1 = Load(di32, cx[1]);
+		const auto cx2 = Load(di32, cx[2]);
+		const auto cx3 = Load(di32, cx[3]);
+
+		for (int32_t b = 0; b < bands; b++) {
+			for (int32_t j = 0; j < N; j++) {
+				const T *HWY_RESTRICT p1 = p + offset[j] + b;
+
+				for (int32_t r = 0; r < 4; r++)
+					for (int32_t c = 0; c < 4; c++)
+						pix[r * 4 + c][j] = p1[r * l1 + c * bands];
+			}
+
+			auto sum = zero;
+			for (int32_t r = 0; r < 4; r++) {
+				auto row = Mul(cx0, Load(di32, pix[r * 4]));
+				row = Add(row, Mul(cx1, Load(di32, pix[r * 4 + 1])));
+				row = Add(row, Mul(cx2, Load(di32, pix[r * 4 + 2])));
+				row = Add(row, Mul(cx3, Load(di32, pix[r * 4 + 3])));
+				row = ShiftRight<VIPS_INTERPOLATE_SHIFT>(Add(row, round_by));
+
+				sum = Add(sum, Mul(Load(di32, cy[r]), row));
+			}
+			sum = ShiftRight<VIPS_INTERPOLATE_SHIFT>(Add(sum, round_by));
+			sum = Min(Max(sum, zero), max);
+
+			Store(sum, di32, result);
+			for (int32_t j = 0; j < count; j++)
+				q[(i + j) * bands + b] = result[j];
+		}
+	}
+}
+
+/* Bicubic with double arithmetic for 16-bit and float. For float,
+ * round_rows is set and the intermediate row sums are rounded to float, as
+ * bicubic_float<float>() does. Integer types are clipped instead. This must
+ * match bicubic_unsigned_int32_tab() and bicubic_float_tab().
+ */
+template <typename T, bool round_rows>
+HWY_ATTR HWY_INLINE void
+bicubic_double(T *HWY_RESTRICT q, const T *HWY_RESTRICT p,
+	int32_t bands, int32_t l1, int32_t left, int32_t top,
+	const double *HWY_RESTRICT x, const double *HWY_RESTRICT y, int32_t n,
+	const double *HWY_RESTRICT matrixf, double min_value, double max_value)
+{
+	const int32_t N = Lanes(df64);
+	const auto min = Set(df64, min_value);
+	const auto max = Set(df64, max_value);
+
+	HWY_ALIGN int32_t offset[MAX_LANES];
+	HWY_ALIGN int32_t tx[MAX_LANES];
+	HWY_ALIGN int32_t ty[MAX_LANES];
+	HWY_ALIGN double cx[4][MAX_LANES];
+	HWY_ALIGN double cy[4][MAX_LANES];
+	HWY_ALIGN double pix[16][MAX_LANES];
+	HWY_ALIGN double result[MAX_LANES];
+
+	for (int32_t i = 0; i < n; i += N) {
+		const int32_t count = HWY_MIN(N, n - i);
+
+		bicubic_prepare(offset, tx, ty, N, i, count,
+			bands, l1, left, top, x, y);
+
+		for (int32_t j = 0; j < N; j++)
+			for (int32_t c = 0; c < 4; c++) {
+				cx[c][j] = matrixf[tx[j] * 4 + c];
+				cy[c][j] = matrixf[ty[j] * 4 + c];
+			}
+
+		const auto cx0 = Load(df64, cx[0]);
+		const auto cx1 = Load(df64, cx[1]);
+		const auto cx2 = Load(df64, cx[2]);
+		const auto cx3 = Load(df64, cx[3]);
+
+		for (int32_t b = 0; b < bands; b++) {
+			for (int32_t j = 0; j < N; j++) {
+				const T *HWY_RESTRICT p1 = p + offset[j] + b;
+
+				for (int32_t r = 0; r < 4; r++)
+					for (int32_t c = 0; c < 4; c++)
+						pix[r * 4 + c][j] = p1[r * l1 + c * bands];
+			}
+
+			/* Accumulate in the same order as the C path, so we round in
+			 * the same way. 0 + x is exact.
+			 */
+			auto sum = Zero(df64);
+			for (int32_t r = 0; r < 4; r++) {
+				auto row = Mul(cx0, Load(df64, pix[r * 4]));
+				row = Add(row, Mul(cx1, Load(df64, pix[r * 4 + 1])));
+				row = Add(row, Mul(cx2, Load(df64, pix[r * 4 + 2])));
+				row = Add(row, Mul(cx3, Load(df64, pix[r * 4 + 3])));
+				if (round_rows)
+					row = PromoteTo(df64, DemoteTo(df32, row));
+
+				sum = Add(sum, Mul(Load(df64, cy[r]), row));
+			}
+			if (!round_rows)
+				sum = Min(Max(sum, min), max);
+
+			Store(sum, df64, result);
+			for (int32_t j = 0; j < count; j++)
+				q[(i + j) * bands + b] = result[j];
+		}
+	}
+}
+
+HWY_ATTR void
+vips_interpolate_bilinear_row_hwy(VipsPel *pout, const VipsPel *pin,
+	VipsBandFormat format, int32_t bands, int32_t lskip,
+	int32_t left, int32_t top,
+	const double *HWY_RESTRICT x, const double *HWY_RESTRICT y, int32_t n)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		bilinear_int<uint8_t>((uint8_t *) pout, (const uint8_t *) pin,
+			bands, lskip, left, top, x, y, n);
+		break;
+
+	case VIPS_FORMAT_USHORT:
+		bilinear_int<uint16_t>((uint16_t *) pout, (const uint16_t *) pin,
+			bands, lskip / 2, left, top, x, y, n);
+		break;
+
+	case VIPS_FORMAT_FLOAT:
+		bilinear_float((float *) pout, (const float *) pin,
+			bands, lskip / 4, left, top, x, y, n);
+		break;
+
+	default:
+		g_assert_not_reached();
+		break;
+	}
+}
+
+HWY_ATTR void
+vips_interpolate_bicubic_row_hwy(VipsPel *pout, const VipsPel *pin,
+	VipsBandFormat format, int32_t bands, int32_t lskip,
+	int32_t left, int32_t top,
+	const double *HWY_RESTRICT x, const double *HWY_RESTRICT y, int32_t n,
+	const int *HWY_RESTRICT matrixi, const double *HWY_RESTRICT matrixf)
+{
+	switch (format) {
+	case VIPS_FORMAT_UCHAR:
+		bicubic_int<uint8_t, UCHAR_MAX>(
+			(uint8_t *) pout, (const uint8_t *) pin,
+			bands, lskip, left, top, x, y, n, matrixi);
+		break;
+
+	case VIPS_FORMAT_USHORT:
+		bicubic_double<uint16_t, false>(
+			(uint16_t *) pout, (const uint16_t *) pin,
+			bands, lskip / 2, left, top, x, y, n, matrixf,
+			0, USHRT_MAX);
+		break;
+
+	case VIPS_FORMAT_FLOAT:
+		bicubic_double<float, true>(
+			(float *) pout, (const float *) pin,
+			bands, lskip / 4, left, top, x, y, n, matrixf,
+			0, 0);
+		break;
+
+	default:
+		g_assert_not_reached();
+		break;
+	}
+}
+
+} /*namespace HWY_NAMESPACE*/
+
+#if HWY_ONCE
+HWY_EXPORT(vips_interpolate_nearest_row_hwy);
+HWY_EXPORT(vips_interpolate_bilinear_row_hwy);
+HWY_EXPORT(vips_interpolate_bicubic_row_hwy);
+
+void
+vips_interpolate_nearest_row_hwy(VipsPel *pout, const VipsPel *pin,
+	int lskip, int left, int top,
+	const double *x, const double *y, int n)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_interpolate_nearest_row_hwy)(pout, pin,
+		lskip, left, top, x, y, n);
+	/* clang-format on */
+}
+
+void
+vips_interpolate_bilinear_row_hwy(VipsPel *pout, const VipsPel *pin,
+	VipsBandFormat format, int bands, int lskip, int left, int top,
+	const double *x, const double *y, int n)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_interpolate_bilinear_row_hwy)(pout, pin,
+		format, bands, lskip, left, top, x, y, n);
+	/* clang-format on */
+}
+
+void
+vips_interpolate_bicubic_row_hwy(VipsPel *pout, const VipsPel *pin,
+	VipsBandFormat format, int bands, int lskip, int left, int top,
+	const double *x, const double *y, int n,
+	const int *matrixi, const double *matrixf)
+{
+	/* clang-format off */
+	HWY_DYNAMIC_DISPATCH(vips_interpolate_bicubic_row_hwy)(pout, pin,
+		format, bands, lskip, left, top, x, y, n, matrixi, matrixf);
+	/* clang-format on */
+}
+#endif /*HWY_ONCE*/
+
+#endif /*HAVE_HWY*/
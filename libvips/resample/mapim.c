@@ -12,6 +12,8 @@
  * 21/12/21
  * 	- improve edge antialiasing with "background" and "extend"
  * 	- add "premultiplied" param
+ * 18/10/26
+ * 	- interpolate runs of pixels with a row method, if we can
  */
 
 /*
@@ -223,6 +225,36 @@ vips_mapim_region_minmax(VipsRegion *region, VipsRect *r, VipsRect *bounds)
 	bounds->height = (max_y - min_y) + 1;
 }
 
+/* Interpolate a pixel, or add it to the current run if the interpolator has
+ * a row method.
+ */
+#define INTERPOLATE(X, Y) \
+	{ \
+		if (interpolate_row) { \
+			if (n == 0) \
+				run_q = q; \
+			run_x[n] = (X); \
+			run_y[n] = (Y); \
+			n += 1; \
+\
+			if (n == VIPS_INTERPOLATE_RUN) \
+				FLUSH; \
+		} \
+		else \
+			interpolate(mapim->interpolate, q, ir[0], (X), (Y)); \
+	}
+
+/* Interpolate any pixels in the current run.
+ */
+#define FLUSH \
+	{ \
+		if (n > 0) { \
+			interpolate_row(mapim->interpolate, \
+				run_q, ir[0], run_x, run_y, n); \
+			n = 0; \
+		} \
+	}
+
 /* Unsigned int types.
  */
 #define ULOOKUP(TYPE) \
@@ -235,12 +267,12 @@ vips_mapim_region_minmax(VipsRegion *region, VipsRect *r, VipsRect *bounds)
 \
 			if (px >= clip_width || \
 				py >= clip_height) { \
+				FLUSH; \
 				for (z = 0; z < ps; z++) \
 					q[z] = mapim->ink[z]; \
 			} \
 			else \
-				interpolate(mapim->interpolate, q, ir[0], \
-					px + window_offset + 1, \
+				INTERPOLATE(px + window_offset + 1, \
 					py + window_offset + 1); \
 \
 			p1 += 2; \
@@ -262,12 +294,12 @@ vips_mapim_region_minmax(VipsRegion *region, VipsRect *r, VipsRect *bounds)
 				px >= clip_width || \
 				py < -1 || \
 				py >= clip_height) { \
+				FLUSH; \
 				for (z = 0; z < ps; z++) \
 					q[z] = mapim->ink[z]; \
 			} \
 			else \
-				interpolate(mapim->interpolate, q, ir[0], \
-					px + window_offset + 1, \
+				INTERPOLATE(px + window_offset + 1, \
 					py + window_offset + 1); \
 \
 			p1 += 2; \
@@ -291,12 +323,12 @@ vips_mapim_region_minmax(VipsRegion *region, VipsRect *r, VipsRect *bounds)
 				px >= clip_width || \
 				py < -1 || \
 				py >= clip_height) { \
+				FLUSH; \
 				for (z = 0; z < ps; z++) \
 					q[z] = mapim->ink[z]; \
 			} \
 			else \
-				interpolate(mapim->interpolate, q, ir[0], \
-					px + window_offset + 1, \
+				INTERPOLATE(px + window_offset + 1, \
 					py + window_offset + 1); \
 \
 			p1 += 2; \
@@ -326,6 +358,15 @@ vips_mapim_gen(VipsRegion *out_region,
 	VipsRect bounds, need, image, clipped;
 	int x, y, z;
 
+	/* If the interpolator has a row method, we batch up runs of
+	 * in-range pixels here.
+	 */
+	VipsInterpolateRowMethod interpolate_row;
+	double run_x[VIPS_INTERPOLATE_RUN];
+	double run_y[VIPS_INTERPOLATE_RUN];
+	VipsPel *run_q;
+	int n;
+
 #ifdef DEBUG_VERBOSE
 	printf("vips_mapim_gen: generating left=%d, top=%d, width=%d, height=%d\n",
 		r->left,
@@ -379,6 +420,9 @@ vips_mapim_gen(VipsRegion *out_region,
 	if (vips_region_prepare(ir[0], &clipped))
 		return -1;
 
+	interpolate_row =
+		vips__interpolate_get_row_method(mapim->interpolate, ir[0]);
+
 	VIPS_GATE_START("vips_mapim_gen: work");
 
 	/* Resample! x/y loop over pixels in the output (and index) images.
@@ -389,6 +433,9 @@ vips_mapim_gen(VipsRegion *out_region,
 		VipsPel *restrict q =
 			VIPS_REGION_ADDR(out_region, r->left, y + r->top);
 
+		run_q = q;
+		n = 0;
+
 		switch (ir[1]->im->BandFmt) {
 		case VIPS_FORMAT_UCHAR:
 			ULOOKUP(unsigned char);
@@ -420,6 +467,8 @@ vips_mapim_gen(VipsRegion *out_region,
 		default:
 			g_assert_not_reached();
 		}
+
+		FLUSH;
 	}
 
 	VIPS_GATE_STOP("vips_mapim_gen: work");
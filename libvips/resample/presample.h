@@ -85,6 +85,33 @@ void vips_shrinkv_add_line_uchar_hwy(VipsPel *pin,
 void vips_shrinkv_write_line_uchar_hwy(VipsPel *pout,
 	int ne, int vshrink, unsigned int *restrict sum);
 
+/* Interpolate a run of n output pixels at input coordinates x[i], y[i].
+ * Callers batch up to VIPS_INTERPOLATE_RUN pixels at a time.
+ */
+#define VIPS_INTERPOLATE_RUN (64)
+
+typedef void (*VipsInterpolateRowMethod)(VipsInterpolate *interpolate,
+	void *out, VipsRegion *in, const double *x, const double *y, int n);
+
+VipsInterpolateRowMethod vips__interpolate_get_row_method(
+	VipsInterpolate *interpolate, VipsRegion *in);
+
+GType vips_interpolate_bicubic_get_type(void);
+
+void vips__interpolate_bicubic_row(VipsInterpolate *interpolate,
+	void *out, VipsRegion *in, const double *x, const double *y, int n);
+
+void vips_interpolate_nearest_row_hwy(VipsPel *pout, const VipsPel *pin,
+	int lskip, int left, int top,
+	const double *x, const double *y, int n);
+void vips_interpolate_bilinear_row_hwy(VipsPel *pout, const VipsPel *pin,
+	VipsBandFormat format, int bands, int lskip, int left, int top,
+	const double *x, const double *y, int n);
+void vips_interpolate_bicubic_row_hwy(VipsPel *pout, const VipsPel *pin,
+	VipsBandFormat format, int bands, int lskip, int left, int top,
+	const double *x, const double *y, int n,
+	const int *matrixi, const double *matrixf);
+
 #ifdef __cplusplus
 }
 #endif /*__cplusplus*/
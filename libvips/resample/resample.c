@@ -128,6 +128,7 @@ vips_resample_operation_init(void)
 	extern GType vips_thumbnail_buffer_get_type(void);
 	extern GType vips_thumbnail_image_get_type(void);
 	extern GType vips_thumbnail_source_get_type(void);
+	extern GType vips_thumbnail_multi_get_type(void);
 	extern GType vips_mapim_get_type(void);
 	extern GType vips_shrink_get_type(void);
 	extern GType vips_shrinkh_get_type(void);
@@ -145,6 +146,7 @@ vips_resample_operation_init(void)
 	vips_thumbnail_buffer_get_type();
 	vips_thumbnail_image_get_type();
 	vips_thumbnail_source_get_type();
+	vips_thumbnail_multi_get_type();
 	vips_mapim_get_type();
 	vips_shrink_get_type();
 	vips_shrinkh_get_type();
@@ -43,6 +43,11 @@
  *	- make icc profile transforms always write 8 bits
  * 22/8/25 kleisauke
  *	- remove seq line cache from thumbnail_image, use hint instead
+ * 18/10/26
+ * 	- use page and subifd sizes from the header for pyramid detection
+ * 	- add thumbnail_multi
+ * 	- use jpeg shrink-on-load of 16 and 32 for very large shrinks
+ * 	- use jxlload shrink-on-load
  */
 
 /*
@@ -84,6 +89,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #include <vips/vips.h>
 #include <vips/internal.h>
@@ -144,6 +150,14 @@ typedef struct _VipsThumbnail {
 	int level_width[MAX_LEVELS];
 	int level_height[MAX_LEVELS];
 
+	/* Sizes of pages and subifds, if the loader set them in the header.
+	 * Pairs of width and height.
+	 */
+	int n_page_sizes;
+	int page_sizes[2 * MAX_LEVELS];
+	int n_subifd_sizes;
+	int subifd_sizes[2 * MAX_LEVELS];
+
 	/* For HEIF, try to fetch the size of the stored thumbnail.
 	 */
 	int heif_thumbnail_width;
@@ -217,6 +231,24 @@ get_int(VipsImage *image, const char *field, int default_value)
 	return default_value;
 }
 
+/* Copy an array of sizes from the header, if it's there.
+ */
+static int
+get_sizes(VipsImage *image, const char *field, int *sizes)
+{
+	int *array;
+	int n;
+
+	if (!vips_image_get_typeof(image, field) ||
+		vips_image_get_array_int(image, field, &array, &n))
+		return 0;
+
+	n = VIPS_MIN(n / 2, MAX_LEVELS);
+	memcpy(sizes, array, 2 * n * sizeof(int));
+
+	return n;
+}
+
 static void
 vips_thumbnail_read_header(VipsThumbnail *thumbnail, VipsImage *image)
 {
@@ -227,6 +259,10 @@ vips_thumbnail_read_header(VipsThumbnail *thumbnail, VipsImage *image)
 	thumbnail->page_height = vips_image_get_page_height(image);
 	thumbnail->n_pages = vips_image_get_n_pages(image);
 	thumbnail->n_subifds = vips_image_get_n_subifds(image);
+	thumbnail->n_page_sizes =
+		get_sizes(image, VIPS_META_PAGE_SIZES, thumbnail->page_sizes);
+	thumbnail->n_subifd_sizes =
+		get_sizes(image, VIPS_META_SUBIFD_SIZES, thumbnail->subifd_sizes);
 
 	/* VIPS_META_N_PAGES is the number of pages in the document,
 	 * not the number we've read out into this image. We calculate
@@ -259,6 +295,32 @@ vips_thumbnail_read_header(VipsThumbnail *thumbnail, VipsImage *image)
 	}
 }
 
+/* Get the size of pyramid level @i, from @sizes if the loader told us,
+ * otherwise by opening it.
+ */
+static int
+vips_thumbnail_get_level_size(VipsThumbnail *thumbnail,
+	int n_sizes, int *sizes, int i, int *width, int *height)
+{
+	VipsThumbnailClass *class = VIPS_THUMBNAIL_GET_CLASS(thumbnail);
+
+	VipsImage *level;
+
+	if (i < n_sizes) {
+		*width = sizes[2 * i];
+		*height = sizes[2 * i + 1];
+	}
+	else {
+		if (!(level = class->open(thumbnail, i)))
+			return -1;
+		*width = level->Xsize;
+		*height = level->Ysize;
+		VIPS_UNREF(level);
+	}
+
+	return 0;
+}
+
 /* Detect a pyramid made of pages following a roughly /2 shrink.
  *
  * This may not be a pyr tiff, so no error if we can't find the layers.
@@ -266,7 +328,6 @@ vips_thumbnail_read_header(VipsThumbnail *thumbnail, VipsImage *image)
 static void
 vips_thumbnail_get_pyramid_page(VipsThumbnail *thumbnail)
 {
-	VipsThumbnailClass *class = VIPS_THUMBNAIL_GET_CLASS(thumbnail);
 	int i;
 
 #ifdef DEBUG
@@ -281,17 +342,15 @@ vips_thumbnail_get_pyramid_page(VipsThumbnail *thumbnail)
 		return;
 
 	for (i = 0; i < thumbnail->n_pages; i++) {
-		VipsImage *page;
 		int level_width;
 		int level_height;
 		int expected_level_width;
 		int expected_level_height;
 
-		if (!(page = class->open(thumbnail, i)))
+		if (vips_thumbnail_get_level_size(thumbnail,
+				thumbnail->n_page_sizes, thumbnail->page_sizes,
+				i, &level_width, &level_height))
 			return;
-		level_width = page->Xsize;
-		level_height = page->Ysize;
-		VIPS_UNREF(page);
 
 		expected_level_width = thumbnail->input_width / (1 << i);
 		expected_level_height = thumbnail->input_height / (1 << i);
@@ -328,7 +387,6 @@ vips_thumbnail_get_pyramid_page(VipsThumbnail *thumbnail)
 static void
 vips_thumbnail_get_tiff_pyramid_subifd(VipsThumbnail *thumbnail)
 {
-	VipsThumbnailClass *class = VIPS_THUMBNAIL_GET_CLASS(thumbnail);
 	int i;
 
 #ifdef DEBUG
@@ -342,17 +400,15 @@ vips_thumbnail_get_tiff_pyramid_subifd(VipsThumbnail *thumbnail)
 		return;
 
 	for (i = 0; i < thumbnail->n_subifds; i++) {
-		VipsImage *page;
 		int level_width;
 		int level_height;
 		int expected_level_width;
 		int expected_level_height;
 
-		if (!(page = class->open(thumbnail, i)))
+		if (vips_thumbnail_get_level_size(thumbnail,
+				thumbnail->n_subifd_sizes, thumbnail->subifd_sizes,
+				i, &level_width, &level_height))
 			return;
-		level_width = page->Xsize;
-		level_height = page->Ysize;
-		VIPS_UNREF(page);
 
 		/* The main image is size 1, subifd 0 is half that.
 		 */
@@ -505,8 +561,17 @@ vips_thumbnail_find_jpegshrink(VipsThumbnail *thumbnail,
 	 * final size.
 	 *
 	 * Leave at least a factor of two for the final resize step.
+	 *
+	 * jpegload (but not uhdrload) can go beyond 8 by decoding just the
+	 * DC coefficients and block averaging.
 	 */
-	if (shrink >= 16)
+	if (vips_isprefix("VipsForeignLoadJpeg", thumbnail->loader) &&
+		shrink >= 64)
+		return 32;
+	else if (vips_isprefix("VipsForeignLoadJpeg", thumbnail->loader) &&
+		shrink >= 32)
+		return 16;
+	else if (shrink >= 16)
 		return 8;
 	else if (shrink >= 8)
 		return 4;
@@ -612,6 +677,13 @@ vips_thumbnail_open(VipsThumbnail *thumbnail)
 			thumbnail->input_width, thumbnail->input_height);
 		g_info("loading with factor %g pre-shrink", factor);
 	}
+	else if (vips_isprefix("VipsForeignLoadJxl", thumbnail->loader)) {
+		/* jxlload shrinks each frame, so size from the page height.
+		 */
+		factor = vips_thumbnail_find_jpegshrink(thumbnail,
+			thumbnail->input_width, thumbnail->page_height);
+		g_info("loading with factor %g pre-shrink", factor);
+	}
 	else if (vips_isprefix("VipsForeignLoadTiff", thumbnail->loader) ||
 		vips_isprefix("VipsForeignLoadJp2k", thumbnail->loader) ||
 		vips_isprefix("VipsForeignLoadOpenslide", thumbnail->loader)) {
@@ -1334,7 +1406,8 @@ vips_thumbnail_file_open(VipsThumbnail *thumbnail, double factor)
 	VipsThumbnailFile *file = (VipsThumbnailFile *) thumbnail;
 
 	if (vips_isprefix("VipsForeignLoadJpeg", thumbnail->loader) ||
-		vips_isprefix("VipsForeignLoadUhdr", thumbnail->loader)) {
+		vips_isprefix("VipsForeignLoadUhdr", thumbnail->loader) ||
+		vips_isprefix("VipsForeignLoadJxl", thumbnail->loader)) {
 		return vips_image_new_from_file(file->filename,
 			"access", VIPS_ACCESS_SEQUENTIAL,
 			"fail_on", thumbnail->fail_on,
@@ -1576,7 +1649,8 @@ vips_thumbnail_buffer_open(VipsThumbnail *thumbnail, double factor)
 	VipsThumbnailBuffer *buffer = (VipsThumbnailBuffer *) thumbnail;
 
 	if (vips_isprefix("VipsForeignLoadJpeg", thumbnail->loader) ||
-		vips_isprefix("VipsForeignLoadUhdr", thumbnail->loader)) {
+		vips_isprefix("VipsForeignLoadUhdr", thumbnail->loader) ||
+		vips_isprefix("VipsForeignLoadJxl", thumbnail->loader)) {
 		return vips_image_new_from_buffer(
 			buffer->buf->data, buffer->buf->length,
 			buffer->option_string,
@@ -1795,7 +1869,8 @@ vips_thumbnail_source_open(VipsThumbnail *thumbnail, double factor)
 	VipsThumbnailSource *source = (VipsThumbnailSource *) thumbnail;
 
 	if (vips_isprefix("VipsForeignLoadJpeg", thumbnail->loader) ||
-		vips_isprefix("VipsForeignLoadUhdr", thumbnail->loader)) {
+		vips_isprefix("VipsForeignLoadUhdr", thumbnail->loader) ||
+		vips_isprefix("VipsForeignLoadJxl", thumbnail->loader)) {
 		return vips_image_new_from_source(
 			source->source,
 			source->option_string,
@@ -2079,3 +2154,300 @@ vips_thumbnail_image(VipsImage *in, VipsImage **out, int width, ...)
 
 	return result;
 }
+
+typedef struct _VipsThumbnailMulti {
+	VipsOperation parent_object;
+
+	char *filename;
+	char *format;
+	VipsArrayInt *sizes;
+
+	VipsSize size;
+	gboolean no_rotate;
+	VipsInteresting crop;
+	gboolean linear;
+	char *input_profile;
+	char *output_profile;
+	VipsIntent intent;
+	VipsFailOn fail_on;
+} VipsThumbnailMulti;
+
+typedef VipsOperationClass VipsThumbnailMultiClass;
+
+G_DEFINE_TYPE(VipsThumbnailMulti, vips_thumbnail_multi, VIPS_TYPE_OPERATION);
+
+static int
+vips_thumbnail_multi_compare(const void *a, const void *b)
+{
+	/* Largest first.
+	 */
+	return *((int *) b) - *((int *) a);
+}
+
+static int
+vips_thumbnail_multi_build(VipsObject *object)
+{
+	VipsObjectClass *class = VIPS_OBJECT_GET_CLASS(object);
+	VipsThumbnailMulti *multi = (VipsThumbnailMulti *) object;
+
+	const char *p;
+	int *array;
+	int *sizes;
+	int n;
+	VipsImage **t;
+	VipsImage *in;
+	int i, j;
+
+	in = NULL;
+
+	if (VIPS_OBJECT_CLASS(vips_thumbnail_multi_parent_class)->build(object))
+		return -1;
+
+	if (!(p = strstr(multi->format, "%d"))) {
+		vips_error(class->nickname,
+			"%s", _("format must contain %d for the size"));
+		return -1;
+	}
+
+	array = vips_array_int_get(multi->sizes, &n);
+	if (n < 1) {
+		vips_error(class->nickname, "%s", _("no sizes given"));
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+		if (array[i] < 1 ||
+			array[i] > VIPS_MAX_COORD) {
+			vips_error(class->nickname, _("bad size %d"), array[i]);
+			return -1;
+		}
+
+	/* Each size is made from the one before, so work largest first.
+	 * Repeated sizes would just write the same file again, so drop them.
+	 */
+	if (!(sizes = VIPS_ARRAY(object, n, int)))
+		return -1;
+	memcpy(sizes, array, n * sizeof(int));
+	qsort(sizes, n, sizeof(int), vips_thumbnail_multi_compare);
+	for (i = 1, j = 1; i < n; i++)
+		if (sizes[i] != sizes[j - 1])
+			sizes[j++] = sizes[i];
+	n = j;
+
+	t = (VipsImage **) vips_object_local_array(object, 2 * n);
+
+	for (i = 0; i < n; i++) {
+		char *filename;
+		int result;
+
+		/* Only the largest size is loaded, with shrink-on-load, colour
+		 * management and orientation. The rest are resized from the
+		 * previous size.
+		 */
+		if (i == 0) {
+			if (vips_thumbnail(multi->filename, &t[0], sizes[0],
+					"size", multi->size,
+					"no_rotate", multi->no_rotate,
+					"crop", multi->crop,
+					"linear", multi->linear,
+					"input_profile", multi->input_profile,
+					"output_profile", multi->output_profile,
+					"intent", multi->intent,
+					"fail_on", multi->fail_on,
+					NULL))
+				return -1;
+		}
+		else {
+			/* The previous size is already in the output space,
+			 * but pass the profile on so thumbnail does not pick
+			 * a different one.
+			 */
+			if (vips_thumbnail_image(in, &t[2 * i], sizes[i],
+					"size", multi->size,
+					"no_rotate", TRUE,
+					"crop", multi->crop,
+					"output_profile", multi->output_profile,
+					"intent", multi->intent,
+					NULL))
+				return -1;
+		}
+
+		/* Render to memory, so the smaller sizes don't decode the
+		 * file again.
+		 */
+		if (!(t[2 * i + 1] = vips_image_copy_memory(t[2 * i])))
+			return -1;
+		in = t[2 * i + 1];
+
+		filename = g_strdup_printf("%.*s%d%s",
+			(int) (p - multi->format), multi->format, sizes[i], p + 2);
+		result = vips_image_write_to_file(in, filename, NULL);
+		g_free(filename);
+		if (result)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void
+vips_thumbnail_multi_class_init(VipsThumbnailMultiClass *class)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS(class);
+	VipsObjectClass *vobject_class = VIPS_OBJECT_CLASS(class);
+	VipsOperationClass *operation_class = VIPS_OPERATION_CLASS(class);
+
+	gobject_class->set_property = vips_object_set_property;
+	gobject_class->get_property = vips_object_get_property;
+
+	vobject_class->nickname = "thumbnail_multi";
+	vobject_class->description =
+		_("generate thumbnails of several sizes from file");
+	vobject_class->build = vips_thumbnail_multi_build;
+
+	/* We write files, so never cache.
+	 */
+	operation_class->flags |= VIPS_OPERATION_NOCACHE;
+
+	VIPS_ARG_STRING(class, "filename", 1,
+		_("Filename"),
+		_("Filename to read from"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, filename),
+		NULL);
+
+	VIPS_ARG_STRING(class, "format", 2,
+		_("Format"),
+		_("Filename to save to, with %d for the size"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, format),
+		NULL);
+
+	VIPS_ARG_BOXED(class, "sizes", 3,
+		_("Sizes"),
+		_("Make thumbnails of these sizes"),
+		VIPS_ARGUMENT_REQUIRED_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, sizes),
+		VIPS_TYPE_ARRAY_INT);
+
+	VIPS_ARG_ENUM(class, "size", 114,
+		_("Size"),
+		_("Only upsize, only downsize, or both"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, size),
+		VIPS_TYPE_SIZE, VIPS_SIZE_BOTH);
+
+	VIPS_ARG_BOOL(class, "no_rotate", 115,
+		_("No rotate"),
+		_("Don't use orientation tags to rotate image upright"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, no_rotate),
+		FALSE);
+
+	VIPS_ARG_ENUM(class, "crop", 116,
+		_("Crop"),
+		_("Reduce to fill target rectangle, then crop"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, crop),
+		VIPS_TYPE_INTERESTING, VIPS_INTERESTING_NONE);
+
+	VIPS_ARG_BOOL(class, "linear", 119,
+		_("Linear"),
+		_("Reduce in linear light"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, linear),
+		FALSE);
+
+	VIPS_ARG_STRING(class, "input_profile", 120,
+		_("Input profile"),
+		_("Fallback input profile"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, input_profile),
+		NULL);
+
+	VIPS_ARG_STRING(class, "output_profile", 121,
+		_("Output profile"),
+		_("Fallback output profile"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, output_profile),
+		NULL);
+
+	VIPS_ARG_ENUM(class, "intent", 122,
+		_("Intent"),
+		_("Rendering intent"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, intent),
+		VIPS_TYPE_INTENT, VIPS_INTENT_RELATIVE);
+
+	VIPS_ARG_ENUM(class, "fail_on", 123,
+		_("Fail on"),
+		_("Error level to fail on"),
+		VIPS_ARGUMENT_OPTIONAL_INPUT,
+		G_STRUCT_OFFSET(VipsThumbnailMulti, fail_on),
+		VIPS_TYPE_FAIL_ON, VIPS_FAIL_ON_NONE);
+}
+
+static void
+vips_thumbnail_multi_init(VipsThumbnailMulti *multi)
+{
+	multi->size = VIPS_SIZE_BOTH;
+	multi->crop = VIPS_INTERESTING_NONE;
+	multi->intent = VIPS_INTENT_RELATIVE;
+	multi->fail_on = VIPS_FAIL_ON_NONE;
+}
+
+/**
+ * vips_thumbnail_multi:
+ * @filename: file to read from
+ * @format: filename to save to, with `%d` for the size
+ * @sizes: (array length=n): sizes to make
+ * @n: number of sizes
+ * @...: `NULL`-terminated list of optional named arguments
+ *
+ * Make a set of thumbnails from a file, decoding it only once.
+ *
+ * The largest size is made with [ctor@Image.thumbnail], so it can use any
+ * shrink-on-load feature of the image load library, and so that colour
+ * management and orientation are handled once. Each smaller size is then
+ * resized from the one before.
+ *
+ * Each thumbnail is written to @format with the `%d` replaced by the size,
+ * for example `"tn_%d.jpg[Q=90]"` will write `tn_128.jpg`, `tn_256.jpg`
+ * and so on.
+ *
+ * Each thumbnail will fit within a square of that size. Repeated sizes are
+ * only made once. The optional arguments have the same meaning as for
+ * [ctor@Image.thumbnail]. @linear only applies to the first resize.
+ *
+ * ::: tip "Optional arguments"
+ *     * @size: [enum@Size], upsize, downsize, both or force
+ *     * @no_rotate: `gboolean`, don't rotate upright using orientation tag
+ *     * @crop: [enum@Interesting], shrink and crop to fill target
+ *     * @linear: `gboolean`, perform shrink in linear light
+ *     * @input_profile: `gchararray`, fallback input ICC profile
+ *     * @output_profile: `gchararray`, output ICC profile
+ *     * @intent: [enum@Intent], rendering intent
+ *     * @fail_on: [enum@FailOn], load error types to fail on
+ *
+ * ::: seealso
+ *     [ctor@Image.thumbnail].
+ *
+ * Returns: 0 on success, -1 on error.
+ */
+int
+vips_thumbnail_multi(const char *filename, const char *format,
+	const int *sizes, int n, ...)
+{
+	va_list ap;
+	VipsArrayInt *array;
+	int result;
+
+	array = vips_array_int_new(sizes, n);
+
+	va_start(ap, n);
+	result = vips_call_split("thumbnail_multi", ap, filename, format, array);
+	va_end(ap);
+
+	vips_area_unref(VIPS_AREA(array));
+
+	return result;
+}
@@ -0,0 +1,217 @@
+/* Time float convolution on the C and vector paths at several mask sizes,
+ * then compare convf and convfft for large masks.
+ *
+ * Run with:
+ *
+ * 	meson test -C build --benchmark --verbose convf
+ *
+ * Times are the best of several runs, in milliseconds, for a single band
+ * image computed with the default number of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vips/vips.h>
+
+#define WIDTH (2000)
+#define HEIGHT (2000)
+#define REPEATS (3)
+
+/* The FFT comparison uses a smaller image, since convf is slow for large
+ * masks.
+ */
+#define FFT_SIZE (1000)
+
+typedef int (*BenchFn)(VipsImage *in, VipsImage *mask, VipsImage **out);
+
+static int
+bench_conv(VipsImage *in, VipsImage *mask, VipsImage **out)
+{
+	return vips_conv(in, out, mask,
+		"precision", VIPS_PRECISION_FLOAT,
+		NULL);
+}
+
+static int
+bench_convsep(VipsImage *in, VipsImage *mask, VipsImage **out)
+{
+	return vips_convsep(in, out, mask,
+		"precision", VIPS_PRECISION_FLOAT,
+		NULL);
+}
+
+static int
+bench_convf(VipsImage *in, VipsImage *mask, VipsImage **out)
+{
+	return vips_convf(in, out, mask, NULL);
+}
+
+static int
+bench_convfft(VipsImage *in, VipsImage *mask, VipsImage **out)
+{
+	return vips_convfft(in, out, mask, NULL);
+}
+
+/* A width x height mask of ones, scaled to sum to 1.
+ */
+static VipsImage *
+bench_mask(int width, int height)
+{
+	VipsImage *mask;
+	int x, y;
+
+	mask = vips_image_new_matrix(width, height);
+	for (y = 0; y < height; y++)
+		for (x = 0; x < width; x++)
+			*VIPS_MATRIX(mask, x, y) = 1.0;
+	vips_image_set_double(mask, "scale", width * height);
+
+	return mask;
+}
+
+/* Best of REPEATS, in milliseconds, or -1 for error.
+ */
+static double
+bench_time(BenchFn fn, VipsImage *in, VipsImage *mask, gboolean vector)
+{
+	double best;
+	int i;
+
+	vips_vector_set_enabled(vector);
+
+	best = -1;
+	for (i = 0; i < REPEATS; i++) {
+		GTimer *timer = g_timer_new();
+
+		VipsImage *out;
+		double avg;
+		double elapsed;
+
+		if (fn(in, mask, &out)) {
+			g_timer_destroy(timer);
+			return -1;
+		}
+		if (vips_avg(out, &avg, NULL)) {
+			g_object_unref(out);
+			g_timer_destroy(timer);
+			return -1;
+		}
+		g_object_unref(out);
+
+		elapsed = 1000.0 * g_timer_elapsed(timer, NULL);
+		g_timer_destroy(timer);
+
+		if (best < 0 ||
+			elapsed < best)
+			best = elapsed;
+	}
+
+	return best;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const VipsBandFormat formats[] = {
+		VIPS_FORMAT_UCHAR,
+		VIPS_FORMAT_USHORT,
+		VIPS_FORMAT_FLOAT
+	};
+	static const int sizes[] = { 3, 7, 15, 31 };
+	static const int fft_sizes[] = { 15, 31, 63, 95 };
+
+	VipsImage *noise;
+	int i, j;
+
+	if (VIPS_INIT(argv[0]))
+		vips_error_exit(NULL);
+
+	/* The vector path is picked at build time, so we must not reuse
+	 * operations from the cache.
+	 */
+	vips_cache_set_max(0);
+
+	if (vips_gaussnoise(&noise, WIDTH, HEIGHT,
+			"mean", 128.0,
+			"sigma", 30.0,
+			NULL))
+		vips_error_exit(NULL);
+
+	printf("%-8s %-8s %6s %10s %10s %8s\n",
+		"op", "format", "mask", "C (ms)", "vec (ms)", "speedup");
+
+	for (i = 0; i < VIPS_NUMBER(formats); i++) {
+		VipsImage *t;
+		VipsImage *in;
+
+		if (vips_cast(noise, &t, formats[i], NULL))
+			vips_error_exit(NULL);
+		if (!(in = vips_image_copy_memory(t)))
+			vips_error_exit(NULL);
+		g_object_unref(t);
+
+		for (j = 0; j < VIPS_NUMBER(sizes); j++) {
+			const char *format =
+				vips_enum_nick(VIPS_TYPE_BAND_FORMAT, formats[i]);
+
+			VipsImage *mask;
+			double c, vec;
+
+			mask = bench_mask(sizes[j], sizes[j]);
+			if ((c = bench_time(bench_conv, in, mask, FALSE)) < 0 ||
+				(vec = bench_time(bench_conv, in, mask, TRUE)) < 0)
+				vips_error_exit(NULL);
+			printf("%-8s %-8s %3dx%-3d %10.1f %10.1f %7.2fx\n",
+				"conv", format, sizes[j], sizes[j], c, vec, c / vec);
+			g_object_unref(mask);
+
+			mask = bench_mask(sizes[j], 1);
+			if ((c = bench_time(bench_convsep, in, mask, FALSE)) < 0 ||
+				(vec = bench_time(bench_convsep, in, mask, TRUE)) < 0)
+				vips_error_exit(NULL);
+			printf("%-8s %-8s %3dx%-3d %10.1f %10.1f %7.2fx\n",
+				"convsep", format, sizes[j], sizes[j], c, vec, c / vec);
+			g_object_unref(mask);
+		}
+
+		g_object_unref(in);
+	}
+
+	/* convfft is only there if we have fftw.
+	 */
+	if (vips_type_find("VipsOperation", "convfft")) {
+		VipsImage *t;
+		VipsImage *in;
+
+		if (vips_crop(noise, &t, 0, 0, FFT_SIZE, FFT_SIZE, NULL) ||
+			!(in = vips_image_copy_memory(t)))
+			vips_error_exit(NULL);
+		g_object_unref(t);
+
+		printf("\n%-8s %-8s %6s %10s %10s %8s\n",
+			"op", "format", "mask", "convf (ms)", "fft (ms)", "speedup");
+
+		for (j = 0; j < VIPS_NUMBER(fft_sizes); j++) {
+			VipsImage *mask;
+			double direct, fft;
+
+			mask = bench_mask(fft_sizes[j], fft_sizes[j]);
+			if ((direct = bench_time(bench_convf, in, mask, TRUE)) < 0 ||
+				(fft = bench_time(bench_convfft, in, mask, TRUE)) < 0)
+				vips_error_exit(NULL);
+			printf("%-8s %-8s %3dx%-3d %10.1f %10.1f %7.2fx\n",
+				"convfft", "float", fft_sizes[j], fft_sizes[j],
+				direct, fft, direct / fft);
+			g_object_unref(mask);
+		}
+
+		g_object_unref(in);
+	}
+
+	g_object_unref(noise);
+
+	vips_shutdown();
+
+	return 0;
+}
@@ -24,6 +24,12 @@ TIF4_FILE = os.path.join(IMAGES, "4bit.tif")
 TIF_OJPEG_TILE_FILE = os.path.join(IMAGES, "ojpeg-tile.tif")
 TIF_OJPEG_STRIP_FILE = os.path.join(IMAGES, "ojpeg-strip.tif")
 TIF_SUBSAMPLED_FILE = os.path.join(IMAGES, "subsampled.tif")
+TIF_LZW_BE_FILE = os.path.join(IMAGES, "lzw-be.tif")
+TIF_DEFLATE_BE_FILE = os.path.join(IMAGES, "deflate-be.tif")
+TIF_ZSTD_BE_FILE = os.path.join(IMAGES, "zstd-be.tif")
+TIF_LZW_TRUNCATED_FILE = os.path.join(IMAGES, "lzw-truncated.tif")
+TIF_DEFLATE_TRUNCATED_FILE = os.path.join(IMAGES, "deflate-truncated.tif")
+TIF_ZSTD_TRUNCATED_FILE = os.path.join(IMAGES, "zstd-truncated.tif")
 OME_FILE = os.path.join(IMAGES, "multi-channel-z-series.ome.tif")
 ANALYZE_FILE = os.path.join(IMAGES, "t00740_tr1_segm.hdr")
 GIF_FILE = os.path.join(IMAGES, "cramps.gif")
@@ -63,6 +69,8 @@ TGA_FILE = os.path.join(IMAGES, "targa.tga")
 SGI_FILE = os.path.join(IMAGES, "silicongraphics.sgi")
 AVIF_FILE = os.path.join(IMAGES, "avif-orientation-6.avif")
 AVIF_FILE_HUGE = os.path.join(IMAGES, "17000x17000.avif")
+AVIF_GRID_FILE = os.path.join(IMAGES, "grid-3x2.avif")
+AVIF_GRID_DAMAGED_FILE = os.path.join(IMAGES, "grid-3x2-damaged.avif")
 HEIC_FILE = os.path.join(IMAGES, "heic-orientation-6.heic")
 RGBA_FILE = os.path.join(IMAGES, "rgba.png")
 RGBA_CORRECT_FILE = os.path.join(IMAGES, "rgba-correct.ppm")
@@ -351,6 +351,32 @@ class TestArithmetic:
             assert_almost_equal_objects(hist(20, 0), [5000])
             assert_almost_equal_objects(hist(5, 0), [0])
 
+    def test_histfind_counts(self):
+        # odd widths exercise the end of the unrolled uchar loop
+        x = pyvips.Image.xyz(101, 37)[0]
+        im = x.bandjoin([x, x]).cast("uchar")
+
+        hist = im.hist_find()
+        assert hist.width == 256
+        assert hist.bands == 3
+        assert hist(0, 0) == [37, 37, 37]
+        assert hist(100, 0) == [37, 37, 37]
+        assert hist(101, 0) == [0, 0, 0]
+
+        hist = im.hist_find(band=1)
+        assert hist.width == 101
+        assert hist.avg() == 37
+
+        # ushort values spread over the whole range
+        im = (pyvips.Image.xyz(256, 7)[0] * 257).cast("ushort")
+        hist = im.hist_find()
+        assert hist.width == 65536
+        assert hist(0, 0) == [7]
+        assert hist(257 * 100, 0) == [7]
+        assert hist(257 * 100 + 1, 0) == [0]
+        assert hist(65535, 0) == [7]
+        assert hist.avg() * 65536 == 256 * 7
+
     def test_histfind_indexed(self):
         im = pyvips.Image.black(50, 100)
         test = im.insert(im + 10, 50, 0, expand=True)
@@ -731,6 +757,95 @@ class TestArithmetic:
             assert_almost_equal_objects(matrix(4, 1), [a.avg()])
             assert_almost_equal_objects(matrix(5, 1), [a.deviate()])
 
+    def test_vector_formats(self):
+        # uchar, ushort and float have a vector path, check they match the C
+        # path for similar formats ... use an odd width to test the tail
+        im = self.colour.crop(0, 0, 97, 100)
+        im2 = im.flip("horizontal")
+
+        for fmt, ref in [["uchar", "short"],
+                         ["ushort", "int"],
+                         ["float", "double"]]:
+            a = im.cast(fmt)
+            b = im2.cast(fmt)
+            c = a.cast(ref)
+            d = b.cast(ref)
+
+            for fn in [lambda x, y: x + y,
+                       lambda x, y: x - y,
+                       lambda x, y: x * y,
+                       lambda x, y: x / y,
+                       lambda x, y: x < y,
+                       lambda x, y: x >= y,
+                       lambda x, y: x == y,
+                       lambda x, y: x * 1.5 + 3,
+                       lambda x, y: x.linear(0.5, 2, uchar=True),
+                       lambda x, y: x > 40,
+                       lambda x, y: x != 40]:
+                assert (fn(a, b) - fn(c, d)).abs().max() < 0.001
+
+            if fmt != "float":
+                for fn in [lambda x, y: x & y,
+                           lambda x, y: x | y,
+                           lambda x, y: x ^ y,
+                           lambda x, y: x & 6,
+                           lambda x, y: x ^ 255]:
+                    assert (fn(a, b) - fn(c, d)).abs().max() == 0
+
+    def test_fused_chain(self):
+        # chains of point operations are fused into a single pass ... check
+        # against the same chain with every step computed to memory
+        def chain(x, step):
+            x = step(x * 1.2)
+            x = step(x + 10)
+            x = step(x.abs())
+            x = step(x - [1, 2, 3])
+            x = step(x > 50)
+            return step(x & 128)
+
+        for fmt in noncomplex_formats:
+            im = self.colour.cast(fmt)
+            fused = chain(im, lambda x: x)
+            stepped = chain(im, lambda x: x.copy_memory())
+            assert fused.format == stepped.format
+            assert fused.bands == stepped.bands
+            assert (fused - stepped).abs().max() == 0
+
+        # a binary operation can start a chain
+        fused = (self.colour + self.mono) * 2 + 1
+        stepped = ((self.colour + self.mono).copy_memory() * 2) + 1
+        assert (fused - stepped).abs().max() == 0
+
+    def test_summary(self):
+        im = pyvips.Image.black(50, 50)
+        test = im.insert(im + 10, 50, 0, expand=True)
+
+        for x in noncomplex_formats:
+            a = test.cast(x)
+            matrix, opts = a.summary(hist=True, thresholds=True,
+                                     percent=[10, 50, 90])
+            stats = a.stats()
+
+            for y in range(0, stats.height):
+                for col in range(0, stats.width):
+                    assert_almost_equal_objects(matrix(col, y),
+                                                stats(col, y))
+
+            hist = a.hist_find()
+            assert opts["hist"].width == hist.width
+            assert (opts["hist"] - hist).abs().max() == 0
+
+            for p, t in zip([10, 50, 90], opts["thresholds"]):
+                assert abs(t - a.percent(p)) <= 1
+
+        im = self.colour
+        matrix = im.summary()
+        stats = im.stats()
+        assert matrix.height == im.bands + 1
+        for y in range(0, stats.height):
+            assert_almost_equal_objects(matrix(0, y), stats(0, y))
+            assert_almost_equal_objects(matrix(5, y), stats(5, y))
+
     def test_sum(self):
         for fmt in all_formats:
             im = pyvips.Image.black(50, 50)
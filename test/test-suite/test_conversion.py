@@ -1,5 +1,7 @@
 # vim: set fileencoding=utf-8 :
 import filecmp
+import math
+import struct
 from functools import reduce
 
 import os
@@ -75,6 +77,56 @@ class TestConversion:
         im2 = im.cast("char")
         assert im2.avg() == max_value["char"]
 
+    def test_cast_formats(self):
+        # an odd width, so we test the vector path and the scalar tail
+        values = [-3e9, -70000.7, -40000, -300.5, -1.5, -0.5, 0, 0.5,
+                  1, 127.9, 255, 256.2, 32767.5, 40000, 65535, 65536.5,
+                  3e9]
+        row = [values[i % len(values)] for i in range(97)]
+        ranges = {
+            "uchar": (0, 255),
+            "ushort": (0, 65535),
+            "short": (-32768, 32767),
+            "int": (-2 ** 31, 2 ** 31 - 1),
+        }
+        formats = ["uchar", "ushort", "short", "int", "float", "double"]
+
+        def cast_value(v, fmt):
+            if fmt in ranges:
+                lo, hi = ranges[fmt]
+                return math.trunc(min(max(v, lo), hi))
+            elif fmt == "float":
+                return struct.unpack("f", struct.pack("f", v))[0]
+            else:
+                return v
+
+        def same(im, expected):
+            diff = im.cast("double") - pyvips.Image.new_from_list([expected])
+            return diff.abs().max() == 0
+
+        source = pyvips.Image.new_from_list([row])
+        for a in formats:
+            im = source.cast(a)
+            a_row = [cast_value(v, a) for v in row]
+            assert same(im, a_row)
+            for b in formats:
+                assert same(im.cast(b), [cast_value(v, b) for v in a_row])
+
+        # shift between 8 and 16 bits
+        row = [i % 256 for i in range(97)]
+        up_row = [(v << 8) | (255 if v & 1 else 0) for v in row]
+        im = pyvips.Image.new_from_list([row]).cast("uchar")
+        up = im.cast("ushort", shift=True)
+        assert same(up, up_row)
+        assert same(up.cast("uchar", shift=True), row)
+
+        # coded images decode to float first, so this is float -> float
+        # and must match a plain decode
+        labq = self.colour.colourspace("lab").Lab2LabQ()
+        assert (labq.cast("float") - labq.LabQ2Lab()).abs().max() == 0
+        rad = self.colour.cast("float").float2rad()
+        assert (rad.cast("float") - rad.rad2float()).abs().max() == 0
+
     def test_band_and(self):
         def band_and(x):
             if isinstance(x, pyvips.Image):
@@ -85,6 +85,48 @@ class TestConvolution:
         convolved = im.conv(self.sharp, precision=pyvips.Precision.INTEGER)
         assert convolved(24, 49) == [0]
 
+    @skip_if_no("convfft")
+    def test_convfft(self):
+        # the FFT error is bounded by the sum of the absolute mask elements
+        # times the largest absolute input value, not by the output, which
+        # can be near zero for masks with negative elements
+        def bound(im, msk):
+            total = msk.abs().avg() * msk.width * msk.height
+            return 1e-5 * total / msk.get("scale") * im.abs().max()
+
+        msk = pyvips.Image.gaussmat(8, 0.01)
+        for im in [self.mono, self.colour]:
+            for fmt in [pyvips.BandFormat.UCHAR, pyvips.BandFormat.FLOAT,
+                        pyvips.BandFormat.DOUBLE]:
+                test = im.crop(3, 5, 97, 83).cast(fmt)
+                true = test.convf(msk)
+
+                for result in [test.convfft(msk), test.conv(msk)]:
+                    assert result.width == true.width
+                    assert result.height == true.height
+                    assert result.format == true.format
+                    assert (result - true).abs().max() < bound(test, msk)
+
+        # a large mask with negative elements over an image of many blocks
+        # ... conv switches to the FFT for this
+        msk = pyvips.Image.new_from_array(
+            [[(x * 7 + y * 13) % 11 - 5 for x in range(41)]
+             for y in range(41)], scale=100)
+        im = pyvips.Image.new_from_file(JPEG_FILE)
+        true = im.convf(msk)
+        for result in [im.convfft(msk), im.conv(msk)]:
+            assert result.format == true.format
+            assert (result - true).abs().max() < bound(im, msk)
+
+        # a zero-mean edge mask, so the output is small compared to the
+        # bound, but must still be within it
+        msk = pyvips.Image.new_from_array(
+            [[1 if x < 20 else -1 if x > 20 else 0 for x in range(41)]
+             for y in range(41)])
+        true = im.convf(msk)
+        for result in [im.convfft(msk), im.conv(msk)]:
+            assert (result - true).abs().max() < bound(im, msk)
+
     # don't test conva, it's still not done
     def dont_est_conva(self):
         for im in self.all_images:
@@ -156,6 +198,29 @@ class TestConvolution:
 
                 assert_almost_equal_objects(a_point, b_point, threshold=0.1)
 
+    def test_conv_formats(self):
+        # the vector float path accumulates in double, like the C path, so
+        # it should match the double C path to within float rounding of the
+        # output, for all mask sizes, for both the 2D and separable cases
+        for fmt in ['uchar', 'char', 'ushort', 'short', 'float']:
+            im = (self.colour * 30).cast(fmt)
+            ref = im.cast('double')
+            for sigma in [0.5, 2, 5]:
+                gmask = pyvips.Image.gaussmat(sigma, 0.1,
+                                              precision='float')
+                gmask_sep = pyvips.Image.gaussmat(sigma, 0.1,
+                                                  separable=True,
+                                                  precision='float')
+
+                a = im.conv(gmask, precision='float')
+                b = ref.conv(gmask, precision='float')
+                assert a.format == 'float'
+                assert (a - b).abs().max() < 0.001
+
+                a = im.convsep(gmask_sep, precision='float')
+                b = ref.convsep(gmask_sep, precision='float')
+                assert (a - b).abs().max() < 0.001
+
     def test_fastcor(self):
         for im in self.all_images:
             for fmt in noncomplex_formats:
@@ -195,6 +260,41 @@ class TestConvolution:
                     assert_almost_equal_objects(a_point, b_point,
                                                 threshold=0.1)
 
+    def test_gaussblur_recursive(self):
+        im = pyvips.Image.gaussnoise(200, 150, sigma=40, mean=128)
+
+        for sigma in [5, 20, 50]:
+            a = im.gaussblur(sigma, min_ampl=0.0001, precision="float",
+                             recursive=False)
+            b = im.gaussblur(sigma, recursive=True, precision="float")
+
+            assert a.format == b.format
+            assert a.width == b.width
+            assert a.height == b.height
+            assert (a - b).abs().max() < 2
+
+        # output format follows precision, as for the mask path
+        im = im.cast("uchar")
+        a = im.gaussblur(40, recursive=True)
+        b = im.gaussblur(40, recursive=True, precision="float")
+
+        assert a.format == pyvips.BandFormat.UCHAR
+        assert b.format == pyvips.BandFormat.FLOAT
+        assert (a - b).abs().max() < 1
+
+        # large sigma switches to the recursive path, unless precision is
+        # integer
+        im = im.cast("float")
+        a = im.gaussblur(40, precision="float")
+        b = im.gaussblur(40, precision="float", recursive=True)
+        assert (a - b).abs().max() == 0
+        a = im.gaussblur(20, precision="float")
+        b = im.gaussblur(20, precision="float", recursive=False)
+        assert (a - b).abs().max() == 0
+        a = im.gaussblur(40)
+        b = im.gaussblur(40, recursive=False)
+        assert (a - b).abs().max() == 0
+
     def test_sharpen(self):
         for im in self.all_images:
             for fmt in noncomplex_formats:
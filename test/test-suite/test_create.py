@@ -77,6 +77,16 @@ class TestCreate:
         im = pyvips.Image.black(2, 1)
         im.fwfft()
 
+    @skip_if_no("fwfft")
+    def test_fwfft_roundtrip(self):
+        # run each size twice, the second time round uses a cached plan
+        for width, height in [(64, 64), (37, 20), (64, 64), (37, 20)]:
+            im = pyvips.Image.gaussnoise(width, height)
+            back = im.fwfft().invfft(real=True)
+            assert (back - im).abs().max() < 0.001
+            back = im.cast("complex").fwfft().invfft()
+            assert (back.real() - im).abs().max() < 0.001
+
     @skip_if_no("fwfft")
     def test_fractsurf(self):
         im = pyvips.Image.fractsurf(100, 90, 2.5)
@@ -268,6 +268,28 @@ class TestForeign:
             # format area at the end
             assert y.startswith("hello world")
 
+    @skip_if_no("jpegload")
+    def test_jpeg_shrink(self):
+        for shrink in [16, 32]:
+            x = pyvips.Image.new_from_file(JPEG_FILE, shrink=shrink)
+            assert x.width == 290 // shrink
+            assert x.height == 442 // shrink
+
+            # block averaged from the 1/8 decode
+            y = pyvips.Image.new_from_file(JPEG_FILE, shrink=8)
+            y = y.crop(0, 0, x.width * shrink // 8, x.height * shrink // 8)
+            y = y.shrink(shrink // 8, shrink // 8)
+            assert (x - y).abs().max() == 0
+
+        # progressive images only decode the first scan, so allow a little
+        # error from the missing low bits of DC
+        buf = self.colour.jpegsave_buffer(interlace=True)
+        x = pyvips.Image.new_from_buffer(buf, "", shrink=16)
+        y = pyvips.Image.new_from_buffer(buf, "", shrink=8)
+        y = y.crop(0, 0, x.width * 2, x.height * 2).shrink(2, 2)
+        assert x.width == self.colour.width // 16
+        assert (x - y).abs().max() < 10
+
     @skip_if_no("jpegsave")
     def test_jpegsave(self):
         im = pyvips.Image.new_from_file(JPEG_FILE)
@@ -981,6 +1003,21 @@ class TestForeign:
                             self.colour, 80)
         self.save_load_file(".tif", "[bigtiff]", self.colour)
         self.save_load_file(".tif", "[compression=jpeg]", self.colour, 80)
+
+        # lossless codecs we decompress ourselves, in strips and tiles, with
+        # and without predictors
+        ushort = (self.colour * 256).cast("ushort")
+        fl = self.colour.cast("float") / 3.0
+        for compression in ["lzw", "deflate"]:
+            for layout in ["", "tile,", "tile,pyramid,"]:
+                for predictor in ["none", "horizontal"]:
+                    options = f"[{layout}compression={compression}," \
+                              f"predictor={predictor}]"
+                    self.save_load_file(".tif", options, self.colour)
+                    self.save_load_file(".tif", options, ushort)
+                self.save_load_file(".tif",
+                                    f"[{layout}compression={compression},"
+                                    "predictor=float]", fl)
         self.save_load_file(".tif",
                             "[tile,tile-width=256]", self.colour, 10)
 
@@ -1001,6 +1038,36 @@ class TestForeign:
         assert x.width == 72
         assert abs(x.avg() - 117.3) < 1
 
+        # the header lists the size of each level
+        x = pyvips.Image.new_from_file(filename)
+        sizes = x.get("subifd-sizes")
+        assert len(sizes) == 2 * x.get("n-subifds")
+        for i in range(x.get("n-subifds")):
+            y = pyvips.Image.new_from_file(filename, subifd=i)
+            assert sizes[2 * i:2 * i + 2] == [y.width, y.height]
+        assert x.get("page-sizes") == [x.width, x.height]
+
+        # pyramid layers are compressed in parallel, but the tiles for each
+        # layer must land in the same place as a plain tiled save
+        filename = temp_filename(self.tempdir, '.tif')
+        self.colour.write_to_file(filename, tile=True, pyramid=True,
+                                  tile_width=64, tile_height=64,
+                                  compression="jpeg")
+        filename2 = temp_filename(self.tempdir, '.tif')
+        self.colour.write_to_file(filename2, tile=True,
+                                  tile_width=64, tile_height=64,
+                                  compression="jpeg")
+        x = pyvips.Image.new_from_file(filename)
+        y = pyvips.Image.new_from_file(filename2)
+        assert (x - y).abs().max() == 0
+        n_pages = x.get("n-pages")
+        assert n_pages > 2
+        for page in range(1, n_pages):
+            y = pyvips.Image.new_from_file(filename, page=page)
+            assert y.width == x.width // 2
+            assert abs(y.avg() - 117.3) < 1
+            x = y
+
         filename = temp_filename(self.tempdir, '.tif')
         x = pyvips.Image.new_from_file(TIF_FILE)
         x = x.copy()
@@ -1144,6 +1211,116 @@ class TestForeign:
         assert y.get("tile-width") == 192
         assert y.get("tile-height") == 224
 
+        # tiles read ahead must match plain reads, including with a
+        # limit too small to hold a whole row of tiles, and in random
+        # access order
+        x = pyvips.Image.new_from_file(TIF_FILE)
+        buf = x.tiffsave_buffer(tile=True, tile_width=64, tile_height=64,
+                                compression="jpeg")
+        a = pyvips.Image.new_from_buffer(buf, "", readahead=0)
+        for readahead in [10000, 4 * 1024 * 1024]:
+            b = pyvips.Image.new_from_buffer(buf, "", readahead=readahead)
+            assert (a == b).min() == 255
+            b = pyvips.Image.new_from_buffer(buf, "", readahead=readahead)
+            for left, top in [(200, 300), (0, 0), (100, 150)]:
+                assert (a.crop(left, top, 90, 90) ==
+                        b.crop(left, top, 90, 90)).min() == 255
+
+    @staticmethod
+    def have_tiff_compression(compression):
+        try:
+            pyvips.Image.black(16, 16).tiffsave_buffer(compression=compression)
+        except pyvips.Error:
+            return False
+        return True
+
+    @skip_if_no("tiffload")
+    def test_tiff_codecs(self):
+        # little-endian round trip for every codec we decompress ourselves,
+        # with each predictor, in strips, short strips and tiles
+        uchar = self.colour
+        ushort = (self.colour * 256 + self.colour).cast("ushort")
+        fl = self.colour.cast("float") / 3.0 - 20
+        compressions = ["lzw", "deflate"]
+        if self.have_tiff_compression("zstd"):
+            compressions.append("zstd")
+        for compression in compressions:
+            # strips of 128 rows, 16 rows, 200 rows (too tall for the
+            # tile reader) and tiles
+            for layout in ["", "tile-height=16,", "tile-height=200,", "tile,"]:
+                for predictor in ["none", "horizontal"]:
+                    options = f"[{layout}compression={compression}," \
+                              f"predictor={predictor}]"
+                    self.save_load_file(".tif", options, uchar)
+                    self.save_load_file(".tif", options, ushort)
+                for predictor in ["none", "float"]:
+                    self.save_load_file(".tif",
+                                        f"[{layout}compression={compression},"
+                                        f"predictor={predictor}]", fl)
+
+        if self.have_tiff_compression("webp"):
+            for layout in ["", "tile,"]:
+                options = f"[{layout}compression=webp,lossless]"
+                self.save_load_file(".tif", options, uchar)
+                self.save_load_file(".tif", options, self.rgba)
+
+        # big-endian files, written independently of libtiff, with strips
+        # of 5 rows and 16x16 tiles, must match the formula they were
+        # generated from
+        xyz = pyvips.Image.xyz(20, 12)
+        x = xyz[0]
+        y = xyz[1]
+        expected = [
+            [(x * 17 + y * 29 + b * 80) % 256 for b in range(3)],
+            [(x * 4099 + y * 771 + b * 1000) % 65536 for b in range(3)],
+            [x * 0.25 - y * 1.5 + b * 100.0 for b in range(3)],
+        ]
+        formats = ["uchar", "ushort", "float"]
+
+        files = [TIF_LZW_BE_FILE, TIF_DEFLATE_BE_FILE]
+        if self.have_tiff_compression("zstd"):
+            files.append(TIF_ZSTD_BE_FILE)
+        for filename in files:
+            # pages are no predictor strips, predictor strips and predictor
+            # tiles for each format
+            for i, format in enumerate(formats):
+                ref = expected[i][0].bandjoin(expected[i][1:]).cast(format)
+                for j in range(3):
+                    im = pyvips.Image.new_from_file(filename, page=3 * i + j)
+                    assert im.format == format
+                    assert im.width == 20
+                    assert im.height == 12
+                    assert im.bands == 3
+                    assert (im - ref).abs().max() == 0
+
+    @skip_if_no("tiffload")
+    def test_tiff_truncated(self):
+        # uchar RGB, horizontal predictor, strips of 4 rows, with the final
+        # strip of each file cut to half its length
+        xyz = pyvips.Image.xyz(20, 12)
+        x = xyz[0]
+        y = xyz[1]
+        ref = [(x * 17 + y * 29 + b * 80) % 256 for b in range(3)]
+        ref = ref[0].bandjoin(ref[1:]).cast("uchar")
+
+        files = [TIF_LZW_TRUNCATED_FILE, TIF_DEFLATE_TRUNCATED_FILE]
+        if self.have_tiff_compression("zstd"):
+            files.append(TIF_ZSTD_TRUNCATED_FILE)
+        for filename in files:
+            # loads with a warning, the undamaged strips are intact and the
+            # missing part of the final strip is zero-filled
+            im = pyvips.Image.new_from_file(filename)
+            assert im.width == 20
+            assert im.height == 12
+            assert (im.crop(0, 0, 20, 8) - ref.crop(0, 0, 20, 8)).abs().max() == 0
+            assert im.crop(0, 11, 20, 1).max() == 0
+
+            # and every fail_on level stops at the damaged strip
+            for fail_on in ["truncated", "error", "warning"]:
+                with pytest.raises(Exception):
+                    im = pyvips.Image.new_from_file(filename, fail_on=fail_on)
+                    im.avg()
+
     @skip_if_no("tiffload")
     @pytest.mark.xfail(raises=AssertionError, reason="fails when libtiff was configured with --disable-old-jpeg")
     def test_tiff_ojpeg(self):
@@ -1398,6 +1575,37 @@ class TestForeign:
         buf_size = len(x.webpsave_buffer(target_size=20_000, keep='none'))
         assert 19600 < buf_size < 20400
 
+    @skip_if_no("webpsave")
+    def test_webp_incremental(self):
+        # stills are fed to libwebp in chunks, so make one large enough to
+        # need many
+        im = self.colour.replicate(4, 4)
+
+        # libwebp drops a constant 255 alpha, so use a varying one, with
+        # exact=True to keep the RGB under the zero alpha pixels
+        alpha = (pyvips.Image.xyz(im.width, im.height)[0] % 3 * 64)
+        alpha = alpha.cast("uchar")
+        for image in [im, im.bandjoin(alpha)]:
+            buf = image.webpsave_buffer(lossless=True, exact=True)
+            assert len(buf) > 4 * 64 * 1024
+
+            im2 = pyvips.Image.webpload_buffer(buf)
+            assert im2.bands == image.bands
+            assert (image - im2).abs().max() == 0
+
+            # shrink-on-load decodes incrementally too
+            im2 = pyvips.Image.webpload_buffer(buf, scale=0.5)
+            assert im2.width == image.width // 2
+            assert im2.height == image.height // 2
+            assert abs(im2.avg() - image.avg()) < 2
+
+        # truncated stills must fail
+        buf = im.webpsave_buffer(lossless=True)
+        with pytest.raises(Exception):
+            im2 = pyvips.Image.webpload_buffer(buf[:len(buf) // 2],
+                                               fail=True)
+            im2.avg()
+
     @skip_if_no("analyzeload")
     def test_analyzeload(self):
         def analyze_valid(im):
@@ -1977,6 +2185,49 @@ class TestForeign:
             im = pyvips.Image.heifload(AVIF_FILE_HUGE)
             assert im.avg() == 0.0
 
+    @skip_if_no("heifload")
+    def test_heifload_grid(self):
+        # a 180x90 image made of 3x2 tiles of 64x48, so the right column
+        # and bottom row of tiles overhang the image
+        # n=-1 decodes the whole grid in one go, the default is a single
+        # page load, which decodes tiles on demand
+        full = pyvips.Image.heifload(AVIF_GRID_FILE, n=-1).copy_memory()
+        assert full.width == 180
+        assert full.height == 90
+        assert full.bands == 3
+
+        for left, top, width, height in [(0, 0, 180, 90),
+                                         (60, 40, 10, 10),
+                                         (170, 80, 10, 10),
+                                         (64, 0, 64, 48),
+                                         (100, 50, 5, 40)]:
+            im = pyvips.Image.heifload(AVIF_GRID_FILE)
+            crop = im.crop(left, top, width, height)
+            assert (crop - full.crop(left, top, width, height)).abs().max() == 0
+
+        # the bottom right tile of this file is zeroed out, so it fails to
+        # decode
+        with pytest.raises(Exception):
+            im = pyvips.Image.heifload(AVIF_GRID_DAMAGED_FILE, n=-1)
+            im.avg()
+
+        try:
+            im = pyvips.Image.heifload(AVIF_GRID_DAMAGED_FILE).copy_memory()
+        except pyvips.error.Error:
+            pytest.skip("libheif does not support tile decode")
+
+        # other tiles decode, the damaged one is left black
+        assert (im.crop(0, 0, 128, 90) -
+                full.crop(0, 0, 128, 90)).abs().max() == 0
+        assert (im.crop(0, 0, 180, 48) -
+                full.crop(0, 0, 180, 48)).abs().max() == 0
+        assert im.crop(128, 48, 52, 42).max() == 0
+
+        with pytest.raises(Exception):
+            im = pyvips.Image.heifload(AVIF_GRID_DAMAGED_FILE,
+                                       fail_on="error")
+            im.avg()
+
     @skip_if_no("heifsave")
     def test_avifsave(self):
         self.save_load_buffer("heifsave_buffer", "heifload_buffer",
@@ -2105,6 +2356,26 @@ class TestForeign:
         im3 = pyvips.Image.new_from_file(filename, page=3)
         assert abs(im4.avg() - im3.avg()) < 0.5
 
+        # page-sizes must match the size of each page we load
+        for name in ["Bretagne2_4.j2k", "Bretagne2_1.j2k"]:
+            filename = os.path.join(IMAGES, name)
+            im = pyvips.Image.new_from_file(filename)
+            sizes = im.get("page-sizes")
+            assert len(sizes) == 2 * im.get("n-pages")
+            for page in range(im.get("n-pages")):
+                im2 = pyvips.Image.new_from_file(filename, page=page)
+                assert sizes[2 * page] == im2.width
+                assert sizes[2 * page + 1] == im2.height
+
+        # tiles decode in parallel on a codec per thread ... a shuffled
+        # random access read must match a sequential one
+        filename = os.path.join(IMAGES, "Bretagne2_4.j2k")
+        im = pyvips.Image.new_from_file(filename, access="sequential")
+        im = im.copy_memory()
+        im2 = pyvips.Image.new_from_file(filename, access="random")
+        im2 = im2.rot180().rot180()
+        assert (im - im2).abs().max() == 0
+
     @skip_if_no("jp2kload")
     @pytest.mark.xfail(raises=pyvips.error.Error, reason="requires OpenJPEG >= 2.5.1")
     def test_jp2kload_palette(self):
@@ -2218,6 +2489,36 @@ class TestForeign:
         assert im.format == "uchar"
         assert im.get("bits-per-sample") == 8
 
+    @skip_if_no("jxlsave")
+    def test_jxl_shrink(self):
+        # lossy files can stop decode early, lossless ones decode in full
+        for lossless in [False, True]:
+            buf = self.colour.jxlsave_buffer(lossless=lossless)
+            im = pyvips.Image.jxlload_buffer(buf)
+
+            for shrink in [2, 4, 8]:
+                im2 = pyvips.Image.jxlload_buffer(buf, shrink=shrink)
+                assert im2.width == im.width // shrink
+                assert im2.height == im.height // shrink
+                assert im2.bands == im.bands
+
+                # should be close to a block shrink of the full image
+                im3 = im.crop(0, 0,
+                              im2.width * shrink,
+                              im2.height * shrink).shrink(shrink, shrink)
+                assert abs(im2.avg() - im3.avg()) < 5
+
+        # animations are shrunk frame by frame
+        frame = self.colour.crop(0, 0, 100, 99)
+        strip = pyvips.Image.arrayjoin([frame, frame.invert()], across=1)
+        strip = strip.copy()
+        strip.set_type(pyvips.GValue.gint_type, "page-height", 99)
+        buf = strip.jxlsave_buffer(lossless=True)
+        im = pyvips.Image.jxlload_buffer(buf, n=-1, shrink=4)
+        assert im.width == 25
+        assert im.get("page-height") == 24
+        assert im.height == 48
+
     @skip_if_no("qoiload")
     def test_qoi(self):
         def qoi_valid(im):
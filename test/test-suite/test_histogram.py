@@ -1,4 +1,6 @@
 # vim: set fileencoding=utf-8 :
+import array
+import collections
 import pytest
 
 import pyvips
@@ -49,6 +51,102 @@ class TestHistogram:
 
         assert im3.deviate() < im2.deviate()
 
+    def test_hist_local_ushort(self):
+        im = pyvips.Image.new_from_file(JPEG_FILE)
+        im16 = im.cast("ushort") << 8
+
+        im2 = im.hist_local(10, 10)
+        im3 = im16.hist_local(10, 10)
+
+        assert im3.format == pyvips.BandFormat.USHORT
+        assert im3.width == im2.width
+        assert im3.height == im2.height
+
+        # 16 bit output should be close to 8 bit, scaled up
+        assert abs(im3.avg() / 256 - im2.avg()) < 2
+
+        im4 = im16.hist_local(10, 10, max_slope=3)
+        assert im4.deviate() < im3.deviate()
+
+    # the classic algorithm: a histogram for every window, one band only
+    @staticmethod
+    def hist_local_reference(im, width, height, max_slope):
+        if im.format == "uchar":
+            typecode, n_bins = "B", 256
+        else:
+            typecode, n_bins = "H", 65536
+        max_value = n_bins - 1
+
+        big = im.embed(width // 2, height // 2,
+                       im.width + width, im.height + height - 1,
+                       extend="mirror")
+        p = array.array(typecode, big.write_to_memory())
+        q = array.array(typecode, [0] * (im.width * im.height))
+
+        for y in range(im.height):
+            for x in range(im.width):
+                window = collections.Counter(p[(y + j) * big.width + x + i]
+                                             for j in range(height)
+                                             for i in range(width))
+                target = p[(y + height // 2) * big.width + x + width // 2]
+
+                if max_slope > 0:
+                    total = sum(min(c, max_slope)
+                                for v, c in window.items() if v <= target)
+                    over = sum(c - max_slope
+                               for c in window.values() if c > max_slope)
+                    total += (target + 1) * over // n_bins
+                else:
+                    total = sum(c for v, c in window.items() if v <= target)
+
+                q[y * im.width + x] = max_value * total // (width * height)
+
+        return q
+
+    def test_hist_local_exact(self):
+        # wider than one uchar column chunk
+        im = pyvips.Image.new_from_file(JPEG_FILE).extract_band(1)
+        im = im.crop(100, 100, 190, 12)
+        im = im.join(im, "horizontal").join(im, "horizontal")
+        im = im.copy_memory()
+
+        for x in [im, (im.cast("ushort") * 257).cast("ushort")]:
+            for max_slope in [0, 3]:
+                out = x.hist_local(7, 5, max_slope=max_slope)
+                ref = self.hist_local_reference(x, 7, 5, max_slope)
+
+                assert out.format == x.format
+                assert out.write_to_memory() == ref.tobytes()
+
+    def test_hist_local_tiled(self):
+        im = pyvips.Image.new_from_file(JPEG_FILE)
+
+        for fmt in ["uchar", "ushort"]:
+            x = im.cast(fmt)
+            im2 = x.hist_local(64, 64, tiled=True)
+
+            assert im2.format == x.format
+            assert im2.width == x.width
+            assert im2.height == x.height
+            assert x.deviate() < im2.deviate()
+
+            im3 = x.hist_local(64, 64, tiled=True, max_slope=2)
+            assert im3.deviate() < im2.deviate()
+
+        # max_slope means the same in tiled mode: with one tile the size of
+        # the window, the centre pixel sees the same histogram
+        x = im.extract_band(1).crop(0, 0, 101, 101)
+        a = x.hist_local(101, 101, max_slope=3)
+        b = x.hist_local(101, 101, max_slope=3, tiled=True)
+        assert abs(a(50, 50)[0] - b(50, 50)[0]) <= 1
+
+        # tile LUTs are made ahead of the output line, but a sequential
+        # source must still work and give the same result
+        a = im.hist_local(64, 32, tiled=True)
+        seq = pyvips.Image.new_from_file(JPEG_FILE, access="sequential")
+        b = seq.hist_local(64, 32, tiled=True)
+        assert (a - b).abs().max() == 0
+
     def test_hist_match(self):
         im = pyvips.Image.identity()
         im2 = pyvips.Image.identity()
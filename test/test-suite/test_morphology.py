@@ -19,6 +19,37 @@ class TestMorphology:
         assert opts['segments'] == 3
         assert mask.max() == 2
 
+    def test_labelregions_stream(self):
+        # tall enough to be labelled in several strips
+        im = pyvips.Image.black(100, 300)
+        im = im.draw_circle(255, 50, 150, 40, fill=True)
+        im = im.draw_rect(128, 10, 10, 20, 260, fill=True)
+        noise = pyvips.Image.gaussnoise(100, 300, sigma=100) > 100
+        im = im | (noise & 1)
+
+        mask, opts = im.labelregions(segments=True, stats=True)
+        mask2, opts2 = im.labelregions(segments=True, stream=True)
+
+        assert opts['segments'] == opts2['segments']
+        assert (mask - mask2).abs().max() == 0
+        assert mask(0, 0) == [1]
+        assert mask.max() == opts['segments'] - 1
+
+        stats = opts['stats']
+        assert stats.width == 5
+        assert stats.height == opts['segments']
+        area = stats.crop(0, 1, 1, stats.height - 1).avg() * \
+            (stats.height - 1)
+        assert abs(area - im.width * im.height) < 0.5
+
+        # a solid rect is a single region with the rect as its bbox
+        im = pyvips.Image.black(100, 300)
+        im = im.draw_rect(255, 10, 20, 30, 200, fill=True)
+        mask, opts = im.labelregions(stats=True)
+        stats = opts['stats']
+        assert stats(0, 2) == [30 * 200]
+        assert [stats(x, 2)[0] for x in range(1, 5)] == [10, 20, 30, 200]
+
     def test_erode(self):
         im = pyvips.Image.black(100, 100)
         im = im.draw_circle(255, 50, 50, 25, fill=True)
@@ -41,6 +72,45 @@ class TestMorphology:
         assert im.bands == im2.bands
         assert im2.avg() > im.avg()
 
+    def test_morph_large(self):
+        im = pyvips.Image.gaussnoise(120, 100, sigma=100) > 110
+
+        # for binary images, erode and dilate by a rectangle are min and max
+        for width, height in [(15, 9), (1, 21), (21, 1)]:
+            mask = pyvips.Image.black(width, height) + 255
+            n = width * height
+
+            eroded = im.erode(mask)
+            assert (eroded - im.rank(width, height, 0)).abs().max() == 0
+
+            dilated = im.dilate(mask)
+            assert (dilated - im.rank(width, height, n - 1)).abs().max() == 0
+
+        # a disk is the union of its lines, so erode by the disk is the AND
+        # of erode by each line
+        size = 15
+        xy = pyvips.Image.xyz(size, size) - size // 2
+        disk = ((xy * xy).bandmean() * 2 <= 49).ifthenelse(255, 128)
+
+        lines = []
+        for y in range(size):
+            row = pyvips.Image.black(size, size) + 128
+            row = row.insert(disk.crop(0, y, size, 1), 0, y)
+            if row.max() == 255:
+                lines.append(row)
+
+        eroded = im.erode(disk)
+        ref = im.erode(lines[0])
+        for line in lines[1:]:
+            ref &= im.erode(line)
+        assert (eroded - ref).abs().max() == 0
+
+        dilated = im.dilate(disk)
+        ref = im.dilate(lines[0])
+        for line in lines[1:]:
+            ref |= im.dilate(line)
+        assert (dilated - ref).abs().max() == 0
+
     def test_rank(self):
         im = pyvips.Image.black(100, 100)
         im = im.draw_circle(255, 50, 50, 25, fill=True)
@@ -50,6 +120,37 @@ class TestMorphology:
         assert im.bands == im2.bands
         assert im2.avg() > im.avg()
 
+    def test_rank_formats(self):
+        # large windows take the hist and sorted window paths, check they
+        # agree with the uchar path for each format
+        im = pyvips.Image.gaussnoise(100, 100, mean=128, sigma=60)
+        im = im.bandjoin([im.flip('horizontal'), im.flip('vertical')])
+        im = im.cast('uchar')
+
+        # monotonic maps into each format, and whether they reverse the order
+        cases = [
+            ('ushort', lambda x: x * 257, False),
+            ('short', lambda x: x * 100 - 12000, False),
+            ('uint', lambda x: x * 65536 + 7, False),
+            ('int', lambda x: x * -1000 + 1, True),
+            ('float', lambda x: x / 7.0, False),
+        ]
+
+        for width, height, index in [(7, 7, 24), (15, 15, 112),
+                                     (9, 5, 10), (11, 11, 0)]:
+            ref = im.rank(width, height, index)
+
+            for fmt, fn, reverse in cases:
+                test = fn(im).cast(fmt)
+                if reverse:
+                    result = test.rank(width, height,
+                                       width * height - 1 - index)
+                else:
+                    result = test.rank(width, height, index)
+
+                assert result.format == fmt
+                assert (result - fn(ref).cast(fmt)).abs().max() == 0
+
 
 if __name__ == '__main__':
     pytest.main()
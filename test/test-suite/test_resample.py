@@ -1,5 +1,8 @@
 # vim: set fileencoding=utf-8 :
+import os
 import pytest
+import shutil
+import tempfile
 
 import pyvips
 from helpers import *
@@ -74,6 +77,36 @@ class TestResample:
 
             assert (x - im).abs().max() == 0
 
+    def test_affine_formats(self):
+        # uchar, ushort and float have a vector path, check they match the C
+        # path for similar formats
+        im = pyvips.Image.new_from_file(JPEG_FILE)
+        matrix = [0.9, 0.3, -0.2, 1.1]
+
+        nearest = pyvips.Interpolate.new("nearest")
+        rgba = im.bandjoin(255)
+        a = rgba.affine(matrix, interpolate=nearest)
+        b = pyvips.Image.bandjoin([x.affine(matrix, interpolate=nearest)
+                                   for x in rgba.bandsplit()])
+        assert (a - b).abs().max() == 0
+
+        bilinear = pyvips.Interpolate.new("bilinear")
+        a = im.affine(matrix, interpolate=bilinear)
+        b = im.cast("short").affine(matrix, interpolate=bilinear)
+        assert (a - b).abs().max() == 0
+        a = (im * 100).cast("ushort").affine(matrix, interpolate=bilinear)
+        b = (im * 100).cast("short").affine(matrix, interpolate=bilinear)
+        assert (a - b).abs().max() == 0
+
+        bicubic = pyvips.Interpolate.new("bicubic")
+        a = (im * 200).cast("ushort").affine(matrix, interpolate=bicubic)
+        b = (im * 200).cast("uint").affine(matrix, interpolate=bicubic)
+        assert (a - b).abs().max() == 0
+
+        a = im.cast("float").affine(matrix, interpolate=bilinear)
+        b = im.cast("double").affine(matrix, interpolate=bilinear)
+        assert (a - b).abs().max() < 0.01
+
     def test_reduce(self):
         im = pyvips.Image.new_from_file(JPEG_FILE)
         # cast down to 0-127, the smallest range, so we aren't messed up by
@@ -254,6 +287,40 @@ class TestResample:
             assert thumb.width < thumb.height
             assert thumb.height == 100
 
+    def test_thumbnail_multi(self):
+        tempdir = tempfile.mkdtemp()
+        try:
+            format = os.path.join(tempdir, "tn_%d.png")
+            # repeated sizes are only made once
+            pyvips.Operation.call("thumbnail_multi",
+                                  JPEG_FILE, format, [100, 400, 200, 200])
+
+            for size in [100, 200, 400]:
+                im = pyvips.Image.new_from_file(format % size)
+                true = pyvips.Image.thumbnail(JPEG_FILE, size)
+                # smaller sizes are made from the larger ones, so allow
+                # for rounding
+                assert abs(im.width - true.width) <= 1
+                assert abs(im.height - true.height) <= 1
+                assert max(im.width, im.height) == size
+                assert im.bands == true.bands
+                assert abs(im.avg() - true.avg()) < 1
+
+            # every size is in the output space
+            format = os.path.join(tempdir, "xyb_%d.png")
+            pyvips.Operation.call("thumbnail_multi",
+                                  JPEG_FILE_XYB, format, [100, 400],
+                                  output_profile="srgb")
+
+            for size in [100, 400]:
+                im = pyvips.Image.new_from_file(format % size)
+                true = pyvips.Image.thumbnail(JPEG_FILE_XYB, size,
+                                              output_profile="srgb")
+                assert im.bands == true.bands
+                assert abs(im.avg() - true.avg()) < 1
+        finally:
+            shutil.rmtree(tempdir, ignore_errors=True)
+
     def test_thumbnail_icc(self):
         im = pyvips.Image.thumbnail(JPEG_FILE_XYB, 442, output_profile="srgb")
 